@@ -0,0 +1,32 @@
+# Writes every .spv file of SPIRV_DIR into OUTPUT as a byte array, see src/embeddedShaders.h.
+# Run in script mode: cmake -DSPIRV_DIR=<dir> -DOUTPUT=<file.cpp> -P EmbedSpirv.cmake
+
+file(GLOB SPIRV_FILES "${SPIRV_DIR}/*.spv")
+list(SORT SPIRV_FILES)
+
+set(ARRAYS "")
+set(ENTRIES "")
+set(INDEX 0)
+foreach(SPIRV_FILE ${SPIRV_FILES})
+  get_filename_component(SPIRV_NAME ${SPIRV_FILE} NAME)
+  file(READ ${SPIRV_FILE} SPIRV_HEX HEX)
+  string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," SPIRV_BYTES "${SPIRV_HEX}")
+  string(APPEND ARRAYS "alignas(4) const unsigned char shader${INDEX}[] = {${SPIRV_BYTES}};\n")
+  string(APPEND ENTRIES "    {\"${SPIRV_NAME}\", shader${INDEX}, sizeof(shader${INDEX})},\n")
+  math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+if(INDEX EQUAL 0)
+  message(FATAL_ERROR "EmbedSpirv: no .spv files in ${SPIRV_DIR}")
+endif()
+
+file(WRITE ${OUTPUT}.tmp
+     "// Generated by cmake/EmbedSpirv.cmake, do not edit\n"
+     "#include \"embeddedShaders.h\"\n\n"
+     "namespace VkTools {\n"
+     "namespace {\n${ARRAYS}}  // namespace\n\n"
+     "const EmbeddedShader g_embeddedShaders[] = {\n${ENTRIES}};\n"
+     "const size_t g_numEmbeddedShaders = ${INDEX};\n\n"
+     "}  // namespace VkTools\n")
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different ${OUTPUT}.tmp ${OUTPUT})
+file(REMOVE ${OUTPUT}.tmp)
@@ -166,7 +166,8 @@ void RayTracingPipelineGenerator::EndHitGroup()
 //--------------------------------------------------------------------------------------------------
 //
 // Add a ray generation shader stage, and return the index of the created stage
-uint32_t RayTracingPipelineGenerator::AddRayGenShaderStage(VkShaderModule module)
+uint32_t RayTracingPipelineGenerator::AddRayGenShaderStage(
+    VkShaderModule module, const VkSpecializationInfo* specialization)
 {
     if(m_isHitGroupOpen)
     {
@@ -181,7 +182,7 @@ uint32_t RayTracingPipelineGenerator::AddRayGenShaderStage(VkShaderModule module
     // This member has to be 'main', regardless of the actual entry point of the shader
     stageCreate.pName               = "main";
     stageCreate.flags               = 0;
-    stageCreate.pSpecializationInfo = nullptr;
+    stageCreate.pSpecializationInfo = specialization;
 
     m_shaderStages.emplace_back(stageCreate);
     uint32_t shaderIndex = static_cast<uint32_t>(m_shaderStages.size() - 1);
@@ -252,7 +253,8 @@ void RayTracingPipelineGenerator::SetMaxRecursionDepth(uint32_t maxDepth)
 void RayTracingPipelineGenerator::Generate(VkDevice              device,
                                            VkDescriptorSetLayout descriptorSetLayout,
                                            VkPipeline*           pipeline,
-                                           VkPipelineLayout*     layout)
+                                           VkPipelineLayout*     layout,
+                                           VkPipelineCache       pipelineCache)
 {
     // Create the layout of the pipeline following the provided descriptor set layout
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
@@ -291,7 +293,7 @@ void RayTracingPipelineGenerator::Generate(VkDevice              device,
     rayPipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
     rayPipelineInfo.basePipelineIndex  = 0;
 
-    code = vkCreateRayTracingPipelinesNV(device, nullptr, 1, &rayPipelineInfo, nullptr, pipeline);
+    code = vkCreateRayTracingPipelinesNV(device, pipelineCache, 1, &rayPipelineInfo, nullptr, pipeline);
 
     if(code != VK_SUCCESS)
     {
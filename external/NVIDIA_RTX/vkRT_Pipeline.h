@@ -77,8 +77,10 @@ class RayTracingPipelineGenerator
     /// End the description of the hit group
     void EndHitGroup();
 
-    /// Add a ray generation shader stage, and return the index of the created stage
-    uint32_t AddRayGenShaderStage(VkShaderModule module);
+    /// Add a ray generation shader stage, and return the index of the created stage. The
+    /// specialization info has to stay alive until Generate is called.
+    uint32_t AddRayGenShaderStage(VkShaderModule              module,
+                                  const VkSpecializationInfo* specialization = nullptr);
     /// Add a miss shader stage, and return the index of the created stage
     uint32_t AddMissShaderStage(VkShaderModule module);
 
@@ -88,11 +90,12 @@ class RayTracingPipelineGenerator
     /// algorithms must be flattened to a loop in the ray generation program for best performance.
     void SetMaxRecursionDepth(uint32_t maxDepth);
 
-    /// Compiles the raytracing state object
+    /// Compiles the raytracing state object, optionally through a pipeline cache
     void Generate(VkDevice              device,
                   VkDescriptorSetLayout descriptorSetLayout,
                   VkPipeline*           pipeline,
-                  VkPipelineLayout*     layout);
+                  VkPipelineLayout*     layout,
+                  VkPipelineCache       pipelineCache = VK_NULL_HANDLE);
 
     private:
     /// Shader stages contained in the pipeline
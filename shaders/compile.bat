@@ -10,5 +10,9 @@ glslangValidator.exe -V pathRT.rmiss -o spirv/pathRT.rmiss.spv
 glslangValidator.exe -V pathRTBounce.rchit -o spirv/pathRTBounce.rchit.spv
 glslangValidator.exe -V pathRTBounce.rmiss -o spirv/pathRTBounce.rmiss.spv
 glslangValidator.exe -V pathRTpostProcess.comp -o spirv/pathRTpostProcess.comp.spv
+glslangValidator.exe -V denoiseTemporal.comp -o spirv/denoiseTemporal.comp.spv
+glslangValidator.exe -V denoiseAtrous.comp -o spirv/denoiseAtrous.comp.spv
+glslangValidator.exe -V reprojectAccumulation.comp -o spirv/reprojectAccumulation.comp.spv
+glslangValidator.exe -V cullClusters.comp -o spirv/cullClusters.comp.spv
 
 pause
\ No newline at end of file
@@ -0,0 +1,703 @@
+#include "Benchmark.h"
+
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <tinyobjloader/tiny_obj_loader.h>
+
+#include "Clusters.h"
+#include "CpuPathTracer.h"
+#include "Denoiser.h"
+#include "IniFile.h"
+#include "LightSampler.h"
+#include "Model.h"
+#include "ObjLoader.h"
+#include "PacketTraversal.h"
+#include "Reprojection.h"
+#include "SceneFile.h"
+#include "TextureResidency.h"
+#include "TriangleIntersection.h"
+
+namespace rtutils {
+namespace {
+
+using Clock        = std::chrono::high_resolution_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+std::string escapeJson(const std::string& s)
+{
+    std::string result;
+    for(const char c : s)
+    {
+        if(c == '\n')
+        {
+            result += "\\n";
+            continue;
+        }
+        if(c == '"' || c == '\\')
+        {
+            result += '\\';
+        }
+        result += c;
+    }
+    return result;
+}
+
+std::string escapeCsv(const std::string& s)
+{
+    if(s.find_first_of(",\"\n") == std::string::npos)
+    {
+        return s;
+    }
+    std::string result = "\"";
+    for(const char c : s)
+    {
+        result += c == '"' ? std::string("\"\"") : std::string(1, c);
+    }
+    return result + "\"";
+}
+
+// Negative values were not measured, null in JSON and empty in CSV
+std::string optionalValue(double value, const char* missing)
+{
+    std::ostringstream s;
+    if(value >= 0.0)
+    {
+        s << value;
+    }
+    else
+    {
+        s << missing;
+    }
+    return s.str();
+}
+
+// First CPU iteration of the noisy (stream 0) or reference (stream 1) render of a seed. Hashing
+// instead of packing seed and stream into the iteration's bits keeps every seed and sample count
+// valid, the consecutive ranges only overlap by chance.
+uint32_t firstIteration(uint32_t seed, uint32_t stream)
+{
+    return Pcg32((uint64_t(stream) << 32) | seed).next();
+}
+
+// Vulkan depth range like CameraControls
+glm::mat4 viewProjInverse(const BenchmarkScene& scene)
+{
+    const float aspect = float(scene.width) / float(scene.height);
+    glm::mat4   proj   = glm::perspectiveRH_ZO(glm::radians(scene.fov), aspect, 0.01f, 100.0f);
+    proj[1][1] *= -1.0f;
+    const glm::mat4 view = glm::lookAt(scene.eye, scene.target, glm::vec3(0.0f, 1.0f, 0.0f));
+    return glm::inverse(view) * glm::inverse(proj);
+}
+
+// Geometry, environment and the camera and light of scene
+CpuScene loadCpuScene(const BenchmarkScene& scene)
+{
+    CpuScene cpuScene;
+    appendModel(VkTools::Model(scene.model), &cpuScene);
+    if(!scene.environment.empty())
+    {
+        auto environment = std::make_shared<EnvironmentMap>();
+        environment->load(scene.environment);
+        cpuScene.environment = environment;
+    }
+
+    const glm::mat4 view = glm::lookAt(scene.eye, scene.target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    cpuScene.viewProjInverse = viewProjInverse(scene);
+    cpuScene.light.transform = glm::inverse(view);
+    cpuScene.light.size      = glm::vec2(scene.lightSize);
+    cpuScene.light.radiance  = glm::vec3(scene.lightE);
+    return cpuScene;
+}
+
+// Pixel center camera rays like getPrimaryRay(vec2(0.5)), ordered by tiles of one packet each
+std::vector<Ray> tiledPrimaryRays(const glm::mat4& viewProjInverse, uint32_t width,
+                                  uint32_t height, uint32_t packetSize)
+{
+    const uint32_t tileWidth  = packetSize >= 4 ? 4 : packetSize;
+    const uint32_t tileHeight = packetSize / tileWidth;
+
+    std::vector<Ray> rays;
+    rays.reserve(size_t(width) * height);
+    for(uint32_t ty = 0; ty < height; ty += tileHeight)
+    {
+        for(uint32_t tx = 0; tx < width; tx += tileWidth)
+        {
+            for(uint32_t y = ty; y < std::min(ty + tileHeight, height); ++y)
+            {
+                for(uint32_t x = tx; x < std::min(tx + tileWidth, width); ++x)
+                {
+                    const glm::vec2 d =
+                        glm::vec2((x + 0.5f) / float(width), (y + 0.5f) / float(height)) * 2.0f
+                        - 1.0f;
+                    const glm::vec4 p0 = viewProjInverse * glm::vec4(d, 0.0f, 1.0f);
+                    const glm::vec4 p1 = viewProjInverse * glm::vec4(d, 1.0f, 1.0f);
+
+                    Ray ray;
+                    ray.origin = glm::vec3(p0) / p0.w;
+                    ray.dir    = glm::normalize(glm::vec3(p1) / p1.w - ray.origin);
+                    rays.push_back(ray);
+                }
+            }
+        }
+    }
+    return rays;
+}
+
+// From every primary hit to the center of the area light, in the order of the primary rays
+std::vector<Ray> shadowRays(const CpuScene&            scene,
+                            const std::vector<Ray>&    primary,
+                            const std::vector<RayHit>& hits)
+{
+    const glm::vec3  light = glm::vec3(scene.light.transform[3]);
+    std::vector<Ray> rays;
+    rays.reserve(primary.size());
+    for(size_t i = 0; i < primary.size(); ++i)
+    {
+        const glm::vec3 p    = primary[i].origin + hits[i].t * primary[i].dir;
+        const float     dist = glm::length(light - p);
+        if(!hits[i].valid() || dist <= 0.0f)
+        {
+            continue;
+        }
+
+        Ray ray;
+        ray.origin = p;
+        ray.dir    = (light - p) / dist;
+        ray.tmin   = 1e-3f;
+        ray.tmax   = dist * (1.0f - 1e-3f);
+        rays.push_back(ray);
+    }
+    return rays;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+std::vector<BenchmarkScene> loadBenchmarkManifest(const std::string& path)
+{
+    std::vector<BenchmarkScene> scenes;
+    for(const IniLine& line : readIniFile(path))
+    {
+        if(line.key.empty())
+        {
+            scenes.emplace_back();
+            scenes.back().name = line.section;
+            continue;
+        }
+        if(scenes.empty())
+        {
+            throwIniError(path, line, "key outside of a [name] section");
+        }
+
+        BenchmarkScene&    scene = scenes.back();
+        const std::string& key   = line.key;
+        const std::string& value = line.value;
+
+        bool valid = true;
+        if(key == "model" || key == "environment")
+        {
+            (key == "model" ? scene.model : scene.environment) = resolveIniPath(path, value);
+            valid = !value.empty();
+        }
+        else if(key == "eye" || key == "target")
+        {
+            valid = parseValues(value, key == "eye" ? &scene.eye.x : &scene.target.x, 3);
+        }
+        else if(key == "fov" || key == "lightSize" || key == "lightE")
+        {
+            float* target = key == "fov" ? &scene.fov
+                                         : key == "lightSize" ? &scene.lightSize : &scene.lightE;
+            valid = parseValues(value, target, 1);
+        }
+        else if(key == "width" || key == "height" || key == "spp" || key == "seed")
+        {
+            uint32_t* target = key == "width"    ? &scene.width
+                               : key == "height" ? &scene.height
+                               : key == "spp"    ? &scene.spp
+                                                 : &scene.seed;
+            valid = parseValues(value, target, 1) && *target > 0;
+        }
+        else if(key == "bounces")
+        {
+            valid = parseValues(value, &scene.bounces, 1) && scene.bounces >= 0;
+        }
+        else
+        {
+            throwIniError(path, line, "unknown key '" + key + "'");
+        }
+
+        if(!valid)
+        {
+            throwIniError(path, line, "invalid value '" + value + "' for " + key);
+        }
+    }
+
+    for(const auto& scene : scenes)
+    {
+        if(scene.model.empty())
+        {
+            throw std::runtime_error(path + ": [" + scene.name + "] has no model");
+        }
+    }
+    return scenes;
+}
+
+// ----------------------------------------------------------------------------
+//  Same camera and light setup as the GPU backend: the projection is flipped like the UBO and
+//  the area light sits at the camera facing along the view direction
+//
+
+BenchmarkResult runCpuBenchmark(const BenchmarkScene& scene)
+{
+    BenchmarkResult result;
+    result.scene   = scene.name;
+    result.backend = "cpu";
+    result.device  = std::to_string(std::thread::hardware_concurrency()) + " threads";
+    result.width   = scene.width;
+    result.height  = scene.height;
+    result.spp     = scene.spp;
+    result.bounces = scene.bounces;
+    result.seed    = scene.seed;
+
+    const auto start = Clock::now();
+
+    const auto     loadStart = Clock::now();
+    const CpuScene cpuScene  = loadCpuScene(scene);
+    result.loadMs            = Milliseconds(Clock::now() - loadStart).count();
+
+    const auto          buildStart = Clock::now();
+    const CpuPathTracer tracer(cpuScene);
+    result.buildMs = Milliseconds(Clock::now() - buildStart).count();
+
+    PathTracerSettings settings;
+    settings.maxBounces = scene.bounces;
+
+    Image4f       accumulation(scene.width, scene.height);
+    RayStatistics rays;
+    {
+        const auto traceStart = Clock::now();
+        const uint32_t first = firstIteration(scene.seed, 0);
+        for(uint32_t i = 0; i < scene.spp; ++i)
+        {
+            rays += tracer.render(settings, first + i, &accumulation);
+        }
+        result.traceMs = Milliseconds(Clock::now() - traceStart).count();
+        result.rays    = rays.total();
+    }
+
+    const auto    postprocessStart = Clock::now();
+    const Image4f image            = resolveAccumulation(accumulation);
+    double        luminanceSum     = 0.0;
+    for(const auto& p : image.pixels)
+    {
+        luminanceSum += luminance(glm::vec3(p));
+    }
+    result.postprocessMs = Milliseconds(Clock::now() - postprocessStart).count();
+    result.meanLuminance = luminanceSum / std::max<size_t>(image.pixels.size(), 1);
+
+    result.totalMs = Milliseconds(Clock::now() - start).count();
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+//  Static camera, so the denoiser runs on a single frame without history like after a camera
+//  cut. rays counts the noisy render only.
+//
+
+BenchmarkResult runDenoiserBenchmark(const BenchmarkScene& scene, uint32_t referenceFactor)
+{
+    BenchmarkResult result;
+    result.scene   = scene.name;
+    result.backend = "denoiser";
+    result.device  = std::to_string(std::thread::hardware_concurrency()) + " threads, reference "
+                    + std::to_string(scene.spp * referenceFactor) + " spp";
+    result.width   = scene.width;
+    result.height  = scene.height;
+    result.spp     = scene.spp;
+    result.bounces = scene.bounces;
+    result.seed    = scene.seed;
+
+    const auto start = Clock::now();
+
+    const auto     loadStart = Clock::now();
+    const CpuScene cpuScene  = loadCpuScene(scene);
+    result.loadMs            = Milliseconds(Clock::now() - loadStart).count();
+
+    PathTracerSettings settings;
+    settings.maxBounces = scene.bounces;
+
+    // The noisy image uses the iterations of the cpu backend
+    const auto          buildStart = Clock::now();
+    const CpuPathTracer tracer(cpuScene);
+    Image4f             referenceSum(scene.width, scene.height);
+    const uint32_t      firstReference = firstIteration(scene.seed, 1);
+    for(uint32_t i = 0; i < scene.spp * referenceFactor; ++i)
+    {
+        tracer.render(settings, firstReference + i, &referenceSum);
+    }
+    const Image4f reference = resolveAccumulation(referenceSum);
+
+    GBuffer gbuffer;
+    gbuffer.normalDepth = Image4f(scene.width, scene.height);
+    tracer.renderGBuffer(scene.eye, &gbuffer.normalDepth, &gbuffer.albedo, &gbuffer.emission);
+    result.buildMs = Milliseconds(Clock::now() - buildStart).count();
+
+    Image4f       noisySum(scene.width, scene.height);
+    RayStatistics rays;
+    {
+        const auto traceStart = Clock::now();
+        const uint32_t first = firstIteration(scene.seed, 0);
+        for(uint32_t i = 0; i < scene.spp; ++i)
+        {
+            rays += tracer.render(settings, first + i, &noisySum);
+        }
+        result.traceMs = Milliseconds(Clock::now() - traceStart).count();
+        result.rays    = rays.total();
+    }
+
+    FrameCamera camera;
+    camera.viewProjInverse = cpuScene.viewProjInverse;
+    camera.prevViewProj    = glm::inverse(cpuScene.viewProjInverse);
+    camera.position        = scene.eye;
+    camera.prevPosition    = scene.eye;
+
+    Denoiser denoiser(scene.width, scene.height);
+    denoiser.m_settings.enabled = true;
+
+    Image4f             denoised;
+    const DenoiseReport report = evaluateDenoiser(denoiser, resolveAccumulation(noisySum), gbuffer,
+                                                  camera, reference, &denoised);
+    result.postprocessMs       = report.milliseconds;
+    result.rmseInput           = report.rmseInput;
+    result.rmseOutput          = report.rmseOutput;
+    if(report.rmseOutput > report.rmseInput)
+    {
+        result.status = "denoised RMSE " + std::to_string(report.rmseOutput) + " above noisy "
+                        + std::to_string(report.rmseInput);
+    }
+
+    double luminanceSum = 0.0;
+    for(const auto& p : denoised.pixels)
+    {
+        luminanceSum += luminance(glm::vec3(p));
+    }
+    result.meanLuminance = luminanceSum / std::max<size_t>(denoised.pixels.size(), 1);
+
+    result.totalMs = Milliseconds(Clock::now() - start).count();
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+//  Primary rays in tiles of one packet and their shadow rays, traced repetitions times by both
+//  tracers. The packet results are compared against the single ray ones, any difference ends up
+//  in the status.
+//
+
+std::vector<BenchmarkResult> runPacketBenchmark(const BenchmarkScene& scene, uint32_t repetitions)
+{
+    const uint32_t threads = std::thread::hardware_concurrency();
+    const auto     start   = Clock::now();
+
+    const auto     loadStart = Clock::now();
+    const CpuScene cpuScene  = loadCpuScene(scene);
+    const double   loadMs    = Milliseconds(Clock::now() - loadStart).count();
+
+    const auto          buildStart = Clock::now();
+    const CpuPathTracer pathTracer(cpuScene);
+    const double        buildMs = Milliseconds(Clock::now() - buildStart).count();
+
+    const PacketTracer single(pathTracer.bvh(), SimdLevel::Scalar);
+    const PacketTracer packets(pathTracer.bvh(), detectSimdLevel());
+
+    // Same rays for both, tiled for the packet width
+    const std::vector<Ray> primary = tiledPrimaryRays(cpuScene.viewProjInverse, scene.width,
+                                                      scene.height, packets.packetSize());
+    std::vector<RayHit> primaryHits;
+    single.intersect(primary, &primaryHits);
+    const std::vector<Ray> shadow = shadowRays(cpuScene, primary, primaryHits);
+
+    std::vector<BenchmarkResult> results;
+    std::vector<RayHit>          referenceHits;
+    std::vector<uint8_t>         referenceOccluded;
+    for(const PacketTracer* tracer : {&single, &packets})
+    {
+        BenchmarkResult result;
+        result.scene   = scene.name;
+        result.backend = std::string("cpu-") + toString(tracer->level());
+        result.device  = std::to_string(threads) + " threads, "
+                        + std::to_string(tracer->packetSize()) + " rays per packet";
+        result.width   = scene.width;
+        result.height  = scene.height;
+        result.spp     = repetitions;
+        result.seed    = scene.seed;
+        result.loadMs  = loadMs;
+        result.buildMs = buildMs;
+
+        std::vector<RayHit>  hits;
+        std::vector<uint8_t> occluded;
+        const auto           traceStart = Clock::now();
+        for(uint32_t i = 0; i < repetitions; ++i)
+        {
+            tracer->intersect(primary, &hits);
+            tracer->occluded(shadow, &occluded);
+        }
+        result.traceMs = Milliseconds(Clock::now() - traceStart).count();
+        result.rays    = uint64_t(repetitions) * (primary.size() + shadow.size());
+
+        if(tracer == &single)
+        {
+            referenceHits     = hits;
+            referenceOccluded = occluded;
+        }
+        else
+        {
+            // Packets may pick the other triangle of a shared edge, the distance has to agree
+            size_t primaryMismatches = 0;
+            for(size_t i = 0; i < hits.size(); ++i)
+            {
+                const RayHit& a = hits[i];
+                const RayHit& b = referenceHits[i];
+                if(a.valid() != b.valid()
+                   || (a.valid() && std::abs(a.t - b.t) > 1e-4f * std::max(1.0f, b.t)))
+                {
+                    ++primaryMismatches;
+                }
+            }
+            size_t shadowMismatches = 0;
+            for(size_t i = 0; i < occluded.size(); ++i)
+            {
+                shadowMismatches += occluded[i] != referenceOccluded[i] ? 1 : 0;
+            }
+            if(primaryMismatches > 0 || shadowMismatches > 0)
+            {
+                result.status = std::to_string(primaryMismatches) + " primary and "
+                                + std::to_string(shadowMismatches)
+                                + " shadow rays differ from single ray traversal";
+            }
+        }
+
+        result.totalMs = Milliseconds(Clock::now() - start).count();
+        results.push_back(result);
+    }
+    return results;
+}
+
+// ----------------------------------------------------------------------------
+//  Every kernel checks itself with checkWatertight first, a failure ends up in its status
+//
+
+std::vector<BenchmarkResult> runTriangleBenchmark(const BenchmarkScene& scene)
+{
+    const uint32_t raysPerSide = 32;
+    const auto     start       = Clock::now();
+
+    const auto           loadStart = Clock::now();
+    const VkTools::Model model(scene.model);
+    const double         loadMs = Milliseconds(Clock::now() - loadStart).count();
+
+    const auto   buildStart = Clock::now();
+    TriangleSoup soup;
+    soup.build(model.m_vertices, model.m_indices);
+    const double buildMs = Milliseconds(Clock::now() - buildStart).count();
+
+    const std::vector<Ray> rays =
+        tiledPrimaryRays(viewProjInverse(scene), raysPerSide, raysPerSide, 1);
+
+    std::vector<BenchmarkResult> results;
+    for(const TriangleThroughput& throughput : benchmarkTriangleKernels(soup, rays))
+    {
+        BenchmarkResult result;
+        result.scene   = scene.name;
+        result.backend = std::string("tri-") + toString(throughput.kernel)
+                         + (throughput.occlusion ? "-occluded" : "");
+        result.device  = std::to_string(std::thread::hardware_concurrency()) + " threads, "
+                        + std::to_string(rays.size()) + " rays, "
+                        + std::to_string(throughput.hits) + " hit";
+        result.width   = raysPerSide;
+        result.height  = raysPerSide;
+        result.loadMs  = loadMs;
+        result.buildMs = buildMs;
+        result.traceMs = throughput.ms;
+        result.rays    = rays.size();
+        result.tests   = throughput.tests;
+
+        const WatertightCheck check = checkWatertight(throughput.kernel);
+        if(!check.passed())
+        {
+            result.status = "watertight check: " + std::to_string(check.leaks) + " of "
+                            + std::to_string(check.rays) + " rays leaked, "
+                            + std::to_string(check.mismatches) + " differ from the scalar test";
+        }
+
+        result.totalMs = Milliseconds(Clock::now() - start).count();
+        results.push_back(result);
+    }
+    return results;
+}
+
+// ----------------------------------------------------------------------------
+//  The file is parsed once before timing so both loaders read it from the page cache
+//
+
+std::vector<BenchmarkResult> runObjBenchmark(const BenchmarkScene& scene)
+{
+    const auto        start     = Clock::now();
+    const std::string directory = scene.model.substr(0, scene.model.find_last_of('/'));
+    VkTools::loadObj(scene.model, directory);
+    const double loadMs = Milliseconds(Clock::now() - start).count();
+
+    const auto                       tinyobjStart = Clock::now();
+    tinyobj::attrib_t                attrib;
+    std::vector<tinyobj::shape_t>    shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string                      warn, err;
+    if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, scene.model.c_str(),
+                         directory.c_str()))
+    {
+        throw std::runtime_error(warn + err);
+    }
+    const double tinyobjMs    = Milliseconds(Clock::now() - tinyobjStart).count();
+    const double tinyobjEndMs = Milliseconds(Clock::now() - start).count();
+
+    const auto             mappedStart = Clock::now();
+    const VkTools::ObjMesh mesh        = VkTools::loadObj(scene.model, directory);
+    const double           mappedMs    = Milliseconds(Clock::now() - mappedStart).count();
+
+    size_t tinyobjTriangles = 0;
+    for(const tinyobj::shape_t& shape : shapes)
+    {
+        tinyobjTriangles += shape.mesh.indices.size() / 3;
+    }
+    const size_t triangles = mesh.indices.size() / 3;
+
+    std::vector<BenchmarkResult> results(2);
+    results[0].backend = "obj-tinyobj";
+    results[0].parseMs = tinyobjMs;
+    results[0].totalMs = tinyobjEndMs;
+    results[0].device  = std::to_string(tinyobjTriangles) + " triangles";
+    results[1].backend = "obj-mmap";
+    results[1].parseMs = mappedMs;
+    results[1].totalMs = Milliseconds(Clock::now() - start).count();
+    results[1].device  = std::to_string(std::thread::hardware_concurrency()) + " threads, "
+                        + std::to_string(triangles) + " triangles";
+    if(triangles != tinyobjTriangles)
+    {
+        results[1].status = std::to_string(triangles) + " triangles, tinyobjloader read "
+                            + std::to_string(tinyobjTriangles);
+    }
+    for(BenchmarkResult& result : results)
+    {
+        result.scene  = scene.name;
+        result.loadMs = loadMs;
+        result.bytes  = mesh.bytes;
+    }
+    return results;
+}
+
+// ----------------------------------------------------------------------------
+//  Checks return their problems, at most the first four end up in the status
+//
+
+std::vector<BenchmarkResult> runSelfChecks()
+{
+    using Check = std::vector<std::string> (*)();
+    const std::pair<const char*, Check> checks[] = {
+        {"clusters", checkClusters},
+        {"light-sampler", checkLightSampler},
+        {"reprojection", checkReprojection},
+        {"scene-file", checkSceneFile},
+        {"texture-residency", checkTextureResidency},
+    };
+
+    std::vector<BenchmarkResult> results;
+    for(const auto& check : checks)
+    {
+        BenchmarkResult result;
+        result.scene   = "-";
+        result.backend = std::string("check-") + check.first;
+
+        const auto start = Clock::now();
+        try
+        {
+            const std::vector<std::string> problems = check.second();
+            for(size_t i = 0; i < std::min<size_t>(problems.size(), 4); ++i)
+            {
+                result.status = i == 0 ? problems[i] : result.status + "; " + problems[i];
+            }
+            if(problems.size() > 4)
+            {
+                result.status += "; " + std::to_string(problems.size() - 4) + " more";
+            }
+        }
+        catch(const std::exception& e)
+        {
+            result.status = e.what();
+        }
+        result.traceMs = Milliseconds(Clock::now() - start).count();
+        result.totalMs = result.traceMs;
+        results.push_back(result);
+    }
+    return results;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+bool writeBenchmarkJson(const std::string& path, const std::vector<BenchmarkResult>& results)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << "[\n";
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& r = results[i];
+        file << "  {\"scene\": \"" << escapeJson(r.scene) << "\", \"backend\": \"" << r.backend
+             << "\", \"device\": \"" << escapeJson(r.device) << "\", \"status\": \""
+             << escapeJson(r.status) << "\", \"width\": " << r.width << ", \"height\": "
+             << r.height << ", \"spp\": " << r.spp << ", \"bounces\": " << r.bounces
+             << ", \"seed\": " << r.seed << ", \"loadMs\": " << r.loadMs
+             << ", \"buildMs\": " << r.buildMs << ", \"traceMs\": " << r.traceMs
+             << ", \"postprocessMs\": " << r.postprocessMs << ", \"totalMs\": " << r.totalMs
+             << ", \"rays\": " << r.rays << ", \"mraysPerSecond\": " << r.raysPerSecond() * 1e-6
+             << ", \"tests\": " << r.tests << ", \"mtestsPerSecond\": " << r.testsPerSecond() * 1e-6
+             << ", \"bytes\": " << r.bytes << ", \"parseMs\": " << r.parseMs
+             << ", \"mbPerSecond\": " << r.bytesPerSecond() * 1e-6
+             << ", \"meanLuminance\": " << optionalValue(r.meanLuminance, "null")
+             << ", \"rmseInput\": " << optionalValue(r.rmseInput, "null")
+             << ", \"rmseOutput\": " << optionalValue(r.rmseOutput, "null") << "}"
+             << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    file << "]\n";
+    return bool(file);
+}
+
+bool writeBenchmarkCsv(const std::string& path, const std::vector<BenchmarkResult>& results)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << "scene,backend,device,status,width,height,spp,bounces,seed,loadMs,buildMs,traceMs,"
+            "postprocessMs,totalMs,rays,mraysPerSecond,tests,mtestsPerSecond,bytes,parseMs,"
+            "mbPerSecond,meanLuminance,rmseInput,rmseOutput\n";
+    for(const BenchmarkResult& r : results)
+    {
+        file << escapeCsv(r.scene) << "," << r.backend << "," << escapeCsv(r.device) << ","
+             << escapeCsv(r.status) << "," << r.width << "," << r.height << "," << r.spp << ","
+             << r.bounces << "," << r.seed << "," << r.loadMs << "," << r.buildMs << ","
+             << r.traceMs << "," << r.postprocessMs << "," << r.totalMs << "," << r.rays << ","
+             << r.raysPerSecond() * 1e-6 << "," << r.tests << "," << r.testsPerSecond() * 1e-6
+             << "," << r.bytes << "," << r.parseMs << ","
+             << r.bytesPerSecond() * 1e-6 << "," << optionalValue(r.meanLuminance, "") << ","
+             << optionalValue(r.rmseInput, "") << "," << optionalValue(r.rmseOutput, "") << "\n";
+    }
+    return bool(file);
+}
+
+}  // namespace rtutils
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace rtutils {
+
+// ----------------------------------------------------------------------------
+//  Fixed view of a scene for pathtracer_bench. The manifest is a list of [name] sections with
+//  key = value lines, # starts a comment:
+//
+//      [cornell]
+//      model   = cornell/cornell.obj
+//      eye     = 0 1 3.5
+//      target  = 0 1 0
+//      spp     = 256
+//
+//  Model and environment paths are relative to the manifest, every other key is optional.
+//
+
+struct BenchmarkScene
+{
+    std::string name;
+    std::string model;
+    std::string environment;  // .hdr, none when empty
+
+    glm::vec3 eye    = glm::vec3(0.0f, 0.0f, 0.0f);
+    glm::vec3 target = glm::vec3(0.0f, 0.0f, -1.0f);
+    float     fov    = 65.0f;  // Vertical, degrees
+
+    uint32_t width   = 640;
+    uint32_t height  = 640;
+    uint32_t spp     = 64;
+    int      bounces = 4;
+    uint32_t seed    = 1;  // Sobol scrambles on the GPU, PCG streams on the CPU
+
+    // Area light placed at the camera like the interactive renderer does on startup
+    float lightSize = 0.02f;
+    float lightE    = 100.0f;
+};
+
+// Throws std::runtime_error naming the file and line on unknown keys or malformed values
+std::vector<BenchmarkScene> loadBenchmarkManifest(const std::string& path);
+
+// Times in milliseconds. GPU backends report GPU timestamps for trace and postprocess, load and
+// build are wall time on both.
+struct BenchmarkResult
+{
+    std::string scene;
+    std::string backend;
+    std::string device;
+    std::string status = "ok";  // "ok", "missing" or the error message
+
+    uint32_t width   = 0;
+    uint32_t height  = 0;
+    uint32_t spp     = 0;
+    int      bounces = 0;
+    uint32_t seed    = 0;
+
+    double   loadMs        = 0.0;
+    double   buildMs       = 0.0;  // BVH or acceleration structures
+    double   traceMs       = 0.0;
+    double   postprocessMs = 0.0;
+    double   totalMs       = 0.0;
+    uint64_t rays          = 0;
+    uint64_t tests         = 0;     // Ray-triangle tests, in traceMs
+    double   meanLuminance = -1.0;  // Of the final image, negative when not read back
+
+    // Input files, parseMs of parsing bytes of them
+    uint64_t bytes   = 0;
+    double   parseMs = 0.0;
+
+    // Against a high sample count reference before and after denoising, negative when not
+    // measured
+    double rmseInput  = -1.0;
+    double rmseOutput = -1.0;
+
+    double raysPerSecond() const { return traceMs > 0.0 ? rays / (traceMs * 1e-3) : 0.0; }
+    double testsPerSecond() const { return traceMs > 0.0 ? tests / (traceMs * 1e-3) : 0.0; }
+    double bytesPerSecond() const { return parseMs > 0.0 ? bytes / (parseMs * 1e-3) : 0.0; }
+};
+
+// Runs scene on the CPU reference path tracer, usable without a Vulkan device
+BenchmarkResult runCpuBenchmark(const BenchmarkScene& scene);
+
+// Renders scene.spp paths per pixel and referenceFactor times as many with the CPU path tracer
+// and denoises the first with the CPU reference denoiser. traceMs is the noisy render,
+// postprocessMs the denoiser, buildMs includes the reference render. A denoised image further
+// from the reference than the noisy one fails the status.
+BenchmarkResult runDenoiserBenchmark(const BenchmarkScene& scene, uint32_t referenceFactor = 16);
+
+// Primary and shadow ray throughput of single ray and SIMD packet traversal of the scene's BVH,
+// one result for each. spp holds the repetitions, the status reports rays the two disagree on.
+std::vector<BenchmarkResult> runPacketBenchmark(const BenchmarkScene& scene,
+                                                uint32_t              repetitions = 8);
+
+// Watertight ray-triangle kernels on the scene's triangles, closest hit and occlusion for each.
+// rays counts the rays traced, tests the ray-triangle tests they took.
+std::vector<BenchmarkResult> runTriangleBenchmark(const BenchmarkScene& scene);
+
+// Parses the scene's .obj with tinyobjloader and with the memory mapped parallel loader, one result
+// each. parseMs times the parse of the file's bytes, loadMs is a first untimed parse that reads
+// the file into the page cache.
+std::vector<BenchmarkResult> runObjBenchmark(const BenchmarkScene& scene);
+
+// The CPU self-checks of the modules, one result per check with backend "check-<name>". They
+// need no scene, the status lists the first problems found.
+std::vector<BenchmarkResult> runSelfChecks();
+
+// One object per result, file is overwritten
+bool writeBenchmarkJson(const std::string& path, const std::vector<BenchmarkResult>& results);
+bool writeBenchmarkCsv(const std::string& path, const std::vector<BenchmarkResult>& results);
+
+}  // namespace rtutils
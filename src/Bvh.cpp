@@ -0,0 +1,358 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace rtutils {
+namespace {
+
+const uint32_t kNumBins       = 16;
+const uint32_t kMinLeafSize   = 4;
+const uint32_t kMaxLeafSize   = 16;
+const float    kTraversalCost = 1.0f;
+
+AABB emptyBounds()
+{
+    return AABB(glm::vec3(std::numeric_limits<float>::max()),
+                glm::vec3(-std::numeric_limits<float>::max()));
+}
+
+// Slab test, returns the entry distance or a negative value on a miss
+float intersectBounds(const AABB& b, const glm::vec3& origin, const glm::vec3& invDir, float tmin,
+                      float tmax)
+{
+    const glm::vec3 t0 = (b.min - origin) * invDir;
+    const glm::vec3 t1 = (b.max - origin) * invDir;
+
+    const glm::vec3 tNear = glm::min(t0, t1);
+    const glm::vec3 tFar  = glm::max(t0, t1);
+
+    const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, tmin));
+    const float exit  = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tmax));
+    return enter <= exit ? enter : -1.0f;
+}
+
+// Moeller-Trumbore, matches the barycentric convention of the closest hit shader
+bool intersectTriangle(const glm::vec3& v0,
+                       const glm::vec3& v1,
+                       const glm::vec3& v2,
+                       const Ray&       ray,
+                       float            tmax,
+                       float*           t,
+                       glm::vec2*       barycentrics)
+{
+    const glm::vec3 e1  = v1 - v0;
+    const glm::vec3 e2  = v2 - v0;
+    const glm::vec3 p   = glm::cross(ray.dir, e2);
+    const float     det = glm::dot(e1, p);
+    if(std::abs(det) < 1e-12f)
+    {
+        return false;
+    }
+
+    const float     invDet = 1.0f / det;
+    const glm::vec3 s      = ray.origin - v0;
+    const float     u      = glm::dot(s, p) * invDet;
+    if(u < 0.0f || u > 1.0f)
+    {
+        return false;
+    }
+
+    const glm::vec3 q = glm::cross(s, e1);
+    const float     v = glm::dot(ray.dir, q) * invDet;
+    if(v < 0.0f || u + v > 1.0f)
+    {
+        return false;
+    }
+
+    const float d = glm::dot(e2, q) * invDet;
+    if(d < ray.tmin || d > tmax)
+    {
+        return false;
+    }
+
+    *t            = d;
+    *barycentrics = glm::vec2(u, v);
+    return true;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void Bvh::build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+{
+    if(indices.size() % 3 != 0)
+    {
+        throw std::runtime_error("Bvh::build: index count is not a multiple of 3");
+    }
+
+    const uint32_t             numTriangles = uint32_t(indices.size() / 3);
+    std::vector<BuildTriangle> triangles(numTriangles);
+    for(uint32_t i = 0; i < numTriangles; ++i)
+    {
+        const glm::vec3& v0 = positions[indices[3 * i + 0]];
+        const glm::vec3& v1 = positions[indices[3 * i + 1]];
+        const glm::vec3& v2 = positions[indices[3 * i + 2]];
+
+        triangles[i].bounds.min = glm::min(v0, glm::min(v1, v2));
+        triangles[i].bounds.max = glm::max(v0, glm::max(v1, v2));
+        triangles[i].centroid   = (v0 + v1 + v2) / 3.0f;
+        triangles[i].id         = i;
+    }
+
+    m_nodes.clear();
+    m_nodes.reserve(2 * size_t(numTriangles) + 1);
+    m_nodes.push_back(Node());
+    m_nodes[0].first = 0;
+    m_nodes[0].count = numTriangles;
+
+    // Depth first with an explicit stack, degenerate scenes can get deep
+    std::vector<std::pair<uint32_t, uint32_t>> stack = {{0u, 0u}};
+    while(!stack.empty())
+    {
+        const uint32_t nodeIndex = stack.back().first;
+        const uint32_t depth     = stack.back().second;
+        stack.pop_back();
+
+        subdivide(nodeIndex, triangles);
+        if(m_nodes[nodeIndex].count == 0)
+        {
+            if(depth + 1 >= kMaxDepth)
+            {
+                throw std::runtime_error("Bvh::build: maximum depth exceeded");
+            }
+            stack.push_back({m_nodes[nodeIndex].first + 0, depth + 1});
+            stack.push_back({m_nodes[nodeIndex].first + 1, depth + 1});
+        }
+    }
+
+    m_triangleIDs.resize(numTriangles);
+    m_vertices.resize(3 * size_t(numTriangles));
+    for(uint32_t i = 0; i < numTriangles; ++i)
+    {
+        const uint32_t id = triangles[i].id;
+        m_triangleIDs[i]  = id;
+        for(uint32_t k = 0; k < 3; ++k)
+        {
+            m_vertices[3 * i + k] = positions[indices[3 * id + k]];
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  Splits the triangle range of a node with a binned SAH, leaves it as a leaf if splitting
+//  does not pay off
+//
+
+void Bvh::subdivide(uint32_t nodeIndex, std::vector<BuildTriangle>& triangles)
+{
+    const uint32_t first = m_nodes[nodeIndex].first;
+    const uint32_t count = m_nodes[nodeIndex].count;
+
+    AABB bounds         = emptyBounds();
+    AABB centroidBounds = emptyBounds();
+    for(uint32_t i = first; i < first + count; ++i)
+    {
+        bounds.expand(triangles[i].bounds);
+        centroidBounds.expand(AABB(triangles[i].centroid, triangles[i].centroid));
+    }
+    m_nodes[nodeIndex].bounds = bounds;
+
+    if(count <= kMinLeafSize)
+    {
+        return;
+    }
+
+    const glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+
+    float    bestCost  = std::numeric_limits<float>::max();
+    int      bestAxis  = -1;
+    uint32_t bestSplit = 0;
+
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        if(extent[axis] <= 0.0f)
+        {
+            continue;
+        }
+
+        AABB     binBounds[kNumBins];
+        uint32_t binCounts[kNumBins] = {};
+        for(uint32_t b = 0; b < kNumBins; ++b)
+        {
+            binBounds[b] = emptyBounds();
+        }
+
+        const float scale = kNumBins / extent[axis];
+        for(uint32_t i = first; i < first + count; ++i)
+        {
+            const uint32_t b = std::min(
+                kNumBins - 1,
+                uint32_t((triangles[i].centroid[axis] - centroidBounds.min[axis]) * scale));
+            binBounds[b].expand(triangles[i].bounds);
+            binCounts[b]++;
+        }
+
+        // Sweep from the right to get the right side areas, then evaluate from the left
+        float    rightArea[kNumBins];
+        uint32_t rightCount[kNumBins];
+        AABB     right = emptyBounds();
+        uint32_t n     = 0;
+        for(uint32_t b = kNumBins - 1; b > 0; --b)
+        {
+            right.expand(binBounds[b]);
+            n += binCounts[b];
+            rightArea[b]  = n > 0 ? right.area() : 0.0f;
+            rightCount[b] = n;
+        }
+
+        AABB left = emptyBounds();
+        n         = 0;
+        for(uint32_t b = 0; b < kNumBins - 1; ++b)
+        {
+            left.expand(binBounds[b]);
+            n += binCounts[b];
+            if(n == 0 || rightCount[b + 1] == 0)
+            {
+                continue;
+            }
+
+            const float cost = left.area() * n + rightArea[b + 1] * rightCount[b + 1];
+            if(cost < bestCost)
+            {
+                bestCost  = cost;
+                bestAxis  = axis;
+                bestSplit = b + 1;
+            }
+        }
+    }
+
+    const float leafCost  = float(count);
+    const float splitCost = bestAxis >= 0 ? kTraversalCost + bestCost / bounds.area()
+                                          : std::numeric_limits<float>::max();
+    if(splitCost >= leafCost && count <= kMaxLeafSize)
+    {
+        return;
+    }
+
+    uint32_t mid = first + count / 2;
+    if(bestAxis >= 0)
+    {
+        const float scale = kNumBins / extent[bestAxis];
+        const float minC  = centroidBounds.min[bestAxis];
+        auto        it    = std::partition(
+            triangles.begin() + first, triangles.begin() + first + count,
+            [&](const BuildTriangle& t) {
+                return std::min(kNumBins - 1, uint32_t((t.centroid[bestAxis] - minC) * scale))
+                       < bestSplit;
+            });
+        mid = uint32_t(it - triangles.begin());
+    }
+    if(mid == first || mid == first + count)
+    {
+        mid = first + count / 2;
+    }
+
+    const uint32_t leftIndex = uint32_t(m_nodes.size());
+    m_nodes.push_back(Node());
+    m_nodes.push_back(Node());
+
+    m_nodes[leftIndex].first     = first;
+    m_nodes[leftIndex].count     = mid - first;
+    m_nodes[leftIndex + 1].first = mid;
+    m_nodes[leftIndex + 1].count = first + count - mid;
+
+    m_nodes[nodeIndex].first = leftIndex;
+    m_nodes[nodeIndex].count = 0;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+template <bool AnyHit>
+bool Bvh::traverse(const Ray& ray, RayHit* hit) const
+{
+    if(m_nodes.empty())
+    {
+        return false;
+    }
+
+    const glm::vec3 invDir = 1.0f / ray.dir;
+    float           tmax   = ray.tmax;
+    bool            found  = false;
+
+    uint32_t stack[kMaxDepth];
+    uint32_t stackSize = 0;
+    if(intersectBounds(m_nodes[0].bounds, ray.origin, invDir, ray.tmin, tmax) < 0.0f)
+    {
+        return false;
+    }
+    stack[stackSize++] = 0;
+
+    while(stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+
+        if(node.count > 0)
+        {
+            for(uint32_t i = node.first; i < node.first + node.count; ++i)
+            {
+                float     t;
+                glm::vec2 barycentrics;
+                if(intersectTriangle(m_vertices[3 * i + 0], m_vertices[3 * i + 1],
+                                     m_vertices[3 * i + 2], ray, tmax, &t, &barycentrics))
+                {
+                    if(AnyHit)
+                    {
+                        return true;
+                    }
+                    tmax               = t;
+                    hit->t             = t;
+                    hit->triangle      = m_triangleIDs[i];
+                    hit->barycentrics  = barycentrics;
+                    found              = true;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first
+        const float tLeft =
+            intersectBounds(m_nodes[node.first].bounds, ray.origin, invDir, ray.tmin, tmax);
+        const float tRight =
+            intersectBounds(m_nodes[node.first + 1].bounds, ray.origin, invDir, ray.tmin, tmax);
+
+        if(tLeft >= 0.0f && tRight >= 0.0f)
+        {
+            const bool leftFirst = tLeft <= tRight;
+            stack[stackSize++]   = leftFirst ? node.first + 1 : node.first;
+            stack[stackSize++]   = leftFirst ? node.first : node.first + 1;
+        }
+        else if(tLeft >= 0.0f)
+        {
+            stack[stackSize++] = node.first;
+        }
+        else if(tRight >= 0.0f)
+        {
+            stack[stackSize++] = node.first + 1;
+        }
+    }
+
+    return found;
+}
+
+bool Bvh::intersect(const Ray& ray, RayHit* hit) const
+{
+    return traverse<false>(ray, hit);
+}
+
+bool Bvh::occluded(const Ray& ray) const
+{
+    return traverse<true>(ray, nullptr);
+}
+
+}  // namespace rtutils
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "rtutils.h"
+
+namespace rtutils {
+
+struct Ray
+{
+    glm::vec3 origin = glm::vec3(0.0f);
+    glm::vec3 dir    = glm::vec3(0.0f, 0.0f, 1.0f);
+    float     tmin   = 0.0f;
+    float     tmax   = std::numeric_limits<float>::max();
+};
+
+struct RayHit
+{
+    float     t        = std::numeric_limits<float>::max();
+    uint32_t  triangle = ~0u;
+    glm::vec2 barycentrics;  // Weights of the second and third vertex, like the hit attributes
+
+    bool valid() const { return triangle != ~0u; }
+};
+
+// ----------------------------------------------------------------------------
+//  Binned SAH bounding volume hierarchy over an indexed triangle mesh, the CPU counterpart of
+//  the acceleration structures built in vkRTX_setup.
+//
+
+class Bvh
+{
+    public:
+    // Deepest level below the root, build throws beyond it. Traversal stacks this large suffice.
+    static const uint32_t kMaxDepth = 64;
+
+    struct Node
+    {
+        AABB     bounds;
+        uint32_t first = 0;  // Left child for inner nodes (right is first + 1), else first triangle
+        uint32_t count = 0;  // Number of triangles in a leaf, 0 for inner nodes
+    };
+
+    void build(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+
+    // Closest hit in [ray.tmin, ray.tmax], hit->triangle indexes the original index buffer
+    bool intersect(const Ray& ray, RayHit* hit) const;
+
+    // Any hit in [ray.tmin, ray.tmax]
+    bool occluded(const Ray& ray) const;
+
+    const std::vector<Node>&      nodes() const { return m_nodes; }
+    const std::vector<uint32_t>&  triangleIDs() const { return m_triangleIDs; }
+    const std::vector<glm::vec3>& leafVertices() const { return m_vertices; }
+    size_t                        numTriangles() const { return m_triangleIDs.size(); }
+
+    private:
+    struct BuildTriangle
+    {
+        AABB      bounds;
+        glm::vec3 centroid;
+        uint32_t  id;
+    };
+
+    void subdivide(uint32_t nodeIndex, std::vector<BuildTriangle>& triangles);
+
+    template <bool AnyHit>
+    bool traverse(const Ray& ray, RayHit* hit) const;
+
+    std::vector<Node>      m_nodes;
+    std::vector<uint32_t>  m_triangleIDs;  // Original triangle index in leaf order
+    std::vector<glm::vec3> m_vertices;     // Three vertices per triangle in leaf order
+};
+
+}  // namespace rtutils
@@ -40,6 +40,31 @@ void CameraControls::initDefaults(float aspect)
     updateViewMatrix();
 }
 
+// ----------------------------------------------------------------------------
+//  Pitch is clamped the same way as mouse look
+//
+
+void CameraControls::lookAt(const glm::vec3& eye, const glm::vec3& target)
+{
+    const glm::vec3 forward = glm::normalize(target - eye);
+
+    m_position   = eye;
+    m_rotation.x = glm::degrees(std::atan2(forward.z, forward.x));
+    m_rotation.y = glm::clamp(glm::degrees(std::asin(forward.y)), -89.0f, 89.0f);
+    updateViewMatrix();
+}
+
+// ----------------------------------------------------------------------------
+//  Position and rotation as returned by the getters, e.g. from a checkpoint
+//
+
+void CameraControls::setPose(const glm::vec3& position, const glm::vec3& rotation)
+{
+    m_position = position;
+    m_rotation = rotation;
+    updateViewMatrix();
+}
+
 // ----------------------------------------------------------------------------
 //
 //
@@ -18,6 +18,7 @@ class CameraControls
 
     const glm::vec3& getPosition() const { return m_position; }
     void             setPosition(glm::vec3& v) { m_position = v; }
+    const glm::vec3& getRotation() const { return m_rotation; }
     float            getSpeed() const { return m_speed; }
     void             setSpeed(float v) { m_speed = v; }
     void             increaseSpeed(float v) { m_speed += v; }
@@ -32,6 +33,8 @@ class CameraControls
     glm::mat4 getCameraToWorld() const;
 
     void initDefaults(float aspect);
+    void lookAt(const glm::vec3& eye, const glm::vec3& target);
+    void setPose(const glm::vec3& position, const glm::vec3& rotation);
     void updateMovements(float timeDelta, const glm::vec3& move);
     void updateMouseMovements(glm::vec2 rotate);
     void updateScroll(float v);
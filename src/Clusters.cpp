@@ -0,0 +1,199 @@
+#include "Clusters.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace rtutils {
+
+std::vector<Cluster> buildClusters(const std::vector<glm::vec3>& positions,
+                                   const std::vector<uint32_t>&  indices,
+                                   const std::vector<uint32_t>&  shapeEnds,
+                                   uint32_t                      maxTriangles)
+{
+    const uint32_t maxIndices = 3 * std::max(maxTriangles, 1u);
+    const AABB     empty(glm::vec3(std::numeric_limits<float>::max()),
+                         glm::vec3(-std::numeric_limits<float>::max()));
+
+    std::vector<Cluster> clusters;
+    uint32_t             shapeStart = 0;
+    for(const uint32_t shapeEnd : shapeEnds)
+    {
+        const uint32_t shapeLast = std::min(shapeEnd, static_cast<uint32_t>(indices.size()));
+        if(shapeLast <= shapeStart)
+        {
+            continue;
+        }
+
+        // Partial triangles at the end of a shape are left out
+        const uint32_t end = shapeStart + (shapeLast - shapeStart) / 3 * 3;
+        for(uint32_t first = shapeStart; first < end; first += maxIndices)
+        {
+            Cluster cluster;
+            cluster.bounds     = empty;
+            cluster.firstIndex = first;
+            cluster.indexCount = std::min(maxIndices, end - first);
+            for(uint32_t i = first; i < first + cluster.indexCount; ++i)
+            {
+                const glm::vec3& p = positions[indices[i]];
+                cluster.bounds.expand(AABB(p, p));
+            }
+            clusters.push_back(cluster);
+        }
+        shapeStart = shapeLast;
+    }
+    return clusters;
+}
+
+std::vector<std::string> validateClusters(const std::vector<glm::vec3>& positions,
+                                          const std::vector<uint32_t>&  indices,
+                                          const std::vector<uint32_t>&  shapeEnds,
+                                          const std::vector<Cluster>&   clusters,
+                                          uint32_t                      maxTriangles)
+{
+    std::vector<std::string> problems;
+    const auto               problem = [&problems](size_t cluster, const std::string& what) {
+        problems.push_back("cluster " + std::to_string(cluster) + " " + what);
+    };
+
+    // Shape of every index of a whole triangle, -1 for partial triangles at shape ends and
+    // indices past the last shape
+    std::vector<int>      shapeOf(indices.size(), -1);
+    std::vector<uint32_t> shapeStarts(shapeEnds.size(), 0);
+    uint32_t              shapeStart = 0;
+    for(size_t s = 0; s < shapeEnds.size(); ++s)
+    {
+        const uint32_t shapeLast = std::min(shapeEnds[s], static_cast<uint32_t>(indices.size()));
+        if(shapeLast <= shapeStart)
+        {
+            continue;
+        }
+        shapeStarts[s] = shapeStart;
+        std::fill(shapeOf.begin() + shapeStart,
+                  shapeOf.begin() + shapeStart + (shapeLast - shapeStart) / 3 * 3, int(s));
+        shapeStart = shapeLast;
+    }
+
+    std::vector<uint32_t> covered(indices.size(), 0);
+    for(size_t c = 0; c < clusters.size(); ++c)
+    {
+        const Cluster& cluster = clusters[c];
+        const uint64_t end     = uint64_t(cluster.firstIndex) + cluster.indexCount;
+        if(cluster.indexCount == 0 || cluster.indexCount % 3 != 0 || end > indices.size())
+        {
+            problem(c, "is not a run of whole triangles in the index buffer");
+            continue;
+        }
+        if(cluster.indexCount > 3 * uint64_t(maxTriangles))
+        {
+            problem(c, "holds " + std::to_string(cluster.indexCount / 3) + " triangles");
+        }
+
+        const int shape = shapeOf[cluster.firstIndex];
+        if(shape < 0 || (cluster.firstIndex - shapeStarts[shape]) % 3 != 0)
+        {
+            problem(c, "does not start at a triangle of a shape");
+        }
+        for(uint32_t i = cluster.firstIndex; i < end; ++i)
+        {
+            if(shapeOf[i] != shape)
+            {
+                problem(c, "crosses a shape end at index " + std::to_string(i));
+                break;
+            }
+        }
+        for(uint32_t i = cluster.firstIndex; i < end; ++i)
+        {
+            const glm::vec3& p = positions[indices[i]];
+            if(glm::any(glm::lessThan(p, cluster.bounds.min))
+               || glm::any(glm::greaterThan(p, cluster.bounds.max)))
+            {
+                problem(c, "bounds miss the vertex of index " + std::to_string(i));
+                break;
+            }
+        }
+        for(uint32_t i = cluster.firstIndex; i < end; ++i)
+        {
+            ++covered[i];
+        }
+    }
+
+    size_t uncovered = 0, repeated = 0, outside = 0;
+    for(size_t i = 0; i < indices.size(); ++i)
+    {
+        if(shapeOf[i] < 0)
+        {
+            outside += covered[i] != 0 ? 1 : 0;
+        }
+        else
+        {
+            uncovered += covered[i] == 0 ? 1 : 0;
+            repeated += covered[i] > 1 ? 1 : 0;
+        }
+    }
+    if(uncovered + repeated + outside > 0)
+    {
+        problems.push_back(std::to_string(uncovered) + " indices in no cluster, "
+                           + std::to_string(repeated) + " in several, "
+                           + std::to_string(outside) + " outside of the shapes clustered");
+    }
+    return problems;
+}
+
+std::vector<std::string> checkClusters()
+{
+    struct Case
+    {
+        uint32_t              triangles;
+        uint32_t              maxTriangles;
+        std::vector<uint32_t> shapeEnds;  // In triangles
+    };
+    const uint32_t          k     = 256;
+    const std::vector<Case> cases = {
+        {1000, k, {1000}},
+        {3 * k, k, {k, 2 * k, 3 * k}},                     // Ends on cluster boundaries
+        {3 * k + 2, k, {k - 1, k + 1, 2 * k, 3 * k + 2}},  // Next to them
+        {700, k, {10, 10, 0, 300, 300, 700}},              // Empty and decreasing shapes
+        {500, k, {1, 2, 3, 4, 600}},                       // End past the index buffer
+        {100, 1, {50, 100}},
+        {1000, 7, {13, 400, 401, 999}},  // Triangles past the last shape
+    };
+
+    std::vector<std::string> problems;
+    Pcg32                    rng(7);
+    for(size_t c = 0; c < cases.size(); ++c)
+    {
+        const Case& test = cases[c];
+
+        std::vector<glm::vec3> positions(test.triangles + 17);
+        for(glm::vec3& p : positions)
+        {
+            p = glm::vec3(rng.uniform(), rng.uniform(), rng.uniform()) * 200.0f - 100.0f;
+        }
+        std::vector<uint32_t> indices(3 * test.triangles);
+        for(uint32_t& i : indices)
+        {
+            i = rng.next() % uint32_t(positions.size());
+        }
+        std::vector<uint32_t> shapeEnds;
+        for(const uint32_t end : test.shapeEnds)
+        {
+            shapeEnds.push_back(3 * end);
+        }
+        // The second shape ends in a partial triangle, the third starts after it
+        if(shapeEnds.size() > 1 && shapeEnds[1] > 0 && shapeEnds[1] < indices.size())
+        {
+            shapeEnds[1] -= 1;
+        }
+
+        const std::vector<Cluster> clusters =
+            buildClusters(positions, indices, shapeEnds, test.maxTriangles);
+        for(const std::string& problem :
+            validateClusters(positions, indices, shapeEnds, clusters, test.maxTriangles))
+        {
+            problems.push_back("case " + std::to_string(c) + ": " + problem);
+        }
+    }
+    return problems;
+}
+
+}  // namespace rtutils
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "rtutils.h"
+
+namespace rtutils {
+
+// Run of whole triangles in an index buffer and the bounds of the vertices they reference
+struct Cluster
+{
+    AABB     bounds;
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+};
+
+// ----------------------------------------------------------------------------
+//  Splits the triangle list into clusters for culling. Shape i covers the indices up to
+//  shapeEnds[i], clusters never span two shapes and hold at most maxTriangles triangles each.
+//  Triangles keep their order, OBJ faces of a shape are usually close to each other.
+//
+
+std::vector<Cluster> buildClusters(const std::vector<glm::vec3>& positions,
+                                   const std::vector<uint32_t>&  indices,
+                                   const std::vector<uint32_t>&  shapeEnds,
+                                   uint32_t                      maxTriangles = 256);
+
+// What is wrong with clusters built from the same arguments, empty when nothing is: the whole
+// triangles of every shape have to be covered exactly once, clusters must not cross a shape end
+// or hold more than maxTriangles triangles, and bounds must contain their vertices
+std::vector<std::string> validateClusters(const std::vector<glm::vec3>& positions,
+                                          const std::vector<uint32_t>&  indices,
+                                          const std::vector<uint32_t>&  shapeEnds,
+                                          const std::vector<Cluster>&   clusters,
+                                          uint32_t                      maxTriangles = 256);
+
+// validateClusters on random meshes with shape ends on, next to and between cluster boundaries,
+// partial triangles, empty shapes and ends past the index buffer
+std::vector<std::string> checkClusters();
+
+}  // namespace rtutils
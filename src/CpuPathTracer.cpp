@@ -0,0 +1,1085 @@
+#include "CpuPathTracer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "Model.h"
+#include "RaySorting.h"
+
+namespace rtutils {
+namespace {
+
+const float kPi    = 3.14159265358979f;
+const float kInvPi = 1.0f / kPi;
+
+// Keep these in sync with pathRT.rgen
+const float kDielectricIor = 1.45f;
+const float kRayEpsilon    = 1e-3f;
+
+// ----------------------------------------------------------------------------
+//  GGX helpers, directions in the shading frame
+//
+
+float ggxDistribution(const glm::vec3& wm, float alpha)
+{
+    if(wm.z <= 0.0f)
+    {
+        return 0.0f;
+    }
+    const float a2   = alpha * alpha;
+    const float cos2 = wm.z * wm.z;
+    const float tan2 = (1.0f - cos2) / cos2;
+    const float d    = a2 + tan2;
+    return a2 / (kPi * cos2 * cos2 * d * d);
+}
+
+float ggxSmithG1(const glm::vec3& w, float alpha)
+{
+    const float a2 = alpha * alpha;
+    return 2.0f * w.z / (w.z + std::sqrt(a2 + (1.0f - a2) * w.z * w.z));
+}
+
+// Height correlated masking-shadowing
+float ggxSmithG2(const glm::vec3& wi, const glm::vec3& wo, float alpha)
+{
+    const float a2     = alpha * alpha;
+    const float denomA = wo.z * std::sqrt(a2 + (1.0f - a2) * wi.z * wi.z);
+    const float denomB = wi.z * std::sqrt(a2 + (1.0f - a2) * wo.z * wo.z);
+    return 2.0f * wi.z * wo.z / std::max(denomA + denomB, 1e-7f);
+}
+
+glm::vec3 schlickFresnel(const glm::vec3& r0, float cosTheta)
+{
+    return r0 + (1.0f - r0) * std::pow(1.0f - cosTheta, 5.0f);
+}
+
+float fresnelDielectric(float cosThetaI, float ni, float nt)
+{
+    const float sinThetaI = std::sqrt(std::max(0.0f, 1.0f - cosThetaI * cosThetaI));
+    const float sinThetaT = ni / nt * sinThetaI;
+    if(sinThetaT >= 1.0f)
+    {
+        return 1.0f;
+    }
+    const float cosThetaT = std::sqrt(std::max(0.0f, 1.0f - sinThetaT * sinThetaT));
+
+    const float rParallel = (nt * cosThetaI - ni * cosThetaT) / (nt * cosThetaI + ni * cosThetaT);
+    const float rPerpendicular =
+        (ni * cosThetaI - nt * cosThetaT) / (ni * cosThetaI + nt * cosThetaT);
+    return 0.5f * (rParallel * rParallel + rPerpendicular * rPerpendicular);
+}
+
+glm::vec3 sampleVNDF(const glm::vec3& wo, float alpha, float u1, float u2)
+{
+    const glm::vec3 v = glm::normalize(glm::vec3(wo.x * alpha, wo.y * alpha, wo.z));
+
+    const glm::vec3 t1 = v.z < 0.9999f
+                             ? glm::normalize(glm::cross(v, glm::vec3(0.0f, 0.0f, 1.0f)))
+                             : glm::vec3(1.0f, 0.0f, 0.0f);
+    const glm::vec3 t2 = glm::cross(t1, v);
+
+    const float a   = 1.0f / (1.0f + v.z);
+    const float r   = std::sqrt(u1);
+    const float phi = u2 < a ? u2 / a * kPi : kPi + (u2 - a) / (1.0f - a) * kPi;
+    const float p1  = r * std::cos(phi);
+    const float p2  = r * std::sin(phi) * (u2 < a ? 1.0f : v.z);
+
+    const glm::vec3 n =
+        p1 * t1 + p2 * t2 + std::sqrt(std::max(0.0f, 1.0f - p1 * p1 - p2 * p2)) * v;
+    return glm::normalize(glm::vec3(alpha * n.x, alpha * n.y, std::max(0.0f, n.z)));
+}
+
+// Cosine weighted, Shirley-Chiu concentric mapping like hemisphereSample2()
+glm::vec3 sampleCosineHemisphere(float u1, float u2)
+{
+    const float a = 2.0f * u1 - 1.0f;
+    const float b = 2.0f * u2 - 1.0f;
+
+    float r, phi;
+    if(a == 0.0f && b == 0.0f)
+    {
+        return glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+    if(a * a > b * b)
+    {
+        r   = a;
+        phi = kPi * 0.25f * (b / a);
+    }
+    else
+    {
+        r   = b;
+        phi = kPi * 0.5f - kPi * 0.25f * (a / b);
+    }
+
+    const float x = r * std::cos(phi);
+    const float y = r * std::sin(phi);
+    return glm::vec3(x, y, std::sqrt(std::max(0.0f, 1.0f - x * x - y * y)));
+}
+
+glm::mat3 formBasis(const glm::vec3& n)
+{
+    glm::vec3 t, b;
+    if(n.z < -0.9999999f)
+    {
+        t = glm::vec3(0.0f, -1.0f, 0.0f);
+        b = glm::vec3(-1.0f, 0.0f, 0.0f);
+    }
+    else
+    {
+        const float a = 1.0f / (1.0f + n.z);
+        const float c = -n.x * n.y * a;
+        t             = glm::vec3(1.0f - n.x * n.x * a, c, -n.x);
+        b             = glm::vec3(c, 1.0f - n.y * n.y * a, -n.y);
+    }
+    return glm::mat3(t, b, n);
+}
+
+float powerHeuristic(float pdfA, float pdfB)
+{
+    const float a = pdfA * pdfA;
+    const float b = pdfB * pdfB;
+    return a + b > 0.0f ? a / (a + b) : 0.0f;
+}
+
+float lobeProbability(const glm::vec3& albedo, const glm::vec3& specular)
+{
+    const float d = luminance(albedo);
+    const float s = luminance(specular);
+    if(s <= 0.0f)
+    {
+        return 0.0f;
+    }
+    if(d <= 0.0f)
+    {
+        return 1.0f;
+    }
+    return glm::clamp(s / (d + s), 0.1f, 0.9f);
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void appendModel(const VkTools::Model& model, CpuScene* scene)
+{
+    const uint32_t baseVertex   = uint32_t(scene->positions.size());
+    const int      baseMaterial = int(scene->materials.size());
+
+    for(const auto& v : model.m_vertices)
+    {
+        scene->positions.push_back(v.p);
+        scene->normals.push_back(v.n);
+    }
+    for(const uint32_t i : model.m_indices)
+    {
+        scene->indices.push_back(baseVertex + i);
+    }
+    // The shader takes the material of the second vertex
+    for(size_t t = 0; t + 2 < model.m_indices.size(); t += 3)
+    {
+        const int id = model.m_vertices[model.m_indices[t + 1]].materialID;
+        scene->materialIDs.push_back(id >= 0 ? baseMaterial + id : -1);
+    }
+
+    for(const auto& m : model.m_materials)
+    {
+        CpuMaterial material;
+        material.diffuse    = m.diffuse;
+        material.specular   = m.specular;
+        material.emission   = m.emission;
+        material.roughness  = glm::clamp(1.0f - m.shininess, 0.001f, 1.0f);
+        material.dielectric = m.dissolve == 0.0f;
+
+        const float maxValue = glm::max(glm::max(material.diffuse.x + material.specular.x,
+                                                 material.diffuse.y + material.specular.y),
+                                        material.diffuse.z + material.specular.z);
+        if(maxValue > 1.0f)
+        {
+            material.diffuse /= maxValue;
+            material.specular /= maxValue;
+        }
+        scene->materials.push_back(material);
+    }
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+const char* toString(SamplingStrategy strategy)
+{
+    switch(strategy)
+    {
+        case SamplingStrategy::Bsdf:
+            return "BSDF";
+        case SamplingStrategy::Light:
+            return "Light";
+        case SamplingStrategy::Mis:
+            return "MIS";
+    }
+    return "Unknown";
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+CpuPathTracer::CpuPathTracer(const CpuScene& scene)
+    : m_scene(scene)
+{
+    m_bvh.build(m_scene.positions, m_scene.indices);
+
+    // Same light list as Model::LoadModelFromFile extracts for the GPU
+    std::vector<EmissiveTriangle> lights;
+    for(uint32_t t = 0; t < uint32_t(m_scene.materialIDs.size()); ++t)
+    {
+        const int id = m_scene.materialIDs[t];
+        if(id < 0 || m_scene.materials[id].emission == glm::vec3(0.0f))
+        {
+            continue;
+        }
+
+        EmissiveTriangle triangle;
+        triangle.p0          = m_scene.positions[m_scene.indices[3 * t + 0]];
+        triangle.p1          = m_scene.positions[m_scene.indices[3 * t + 1]];
+        triangle.p2          = m_scene.positions[m_scene.indices[3 * t + 2]];
+        triangle.emission    = m_scene.materials[id].emission;
+        triangle.primitiveID = t;
+        if(triangle.area() > 0.0f)
+        {
+            lights.push_back(triangle);
+        }
+    }
+    m_lightSampler.build(lights);
+}
+
+// ----------------------------------------------------------------------------
+//  Lambertian diffuse plus GGX reflection, mirrors evalBSDF/pdfBSDF/sampleBSDF in pathRT.rgen
+//
+
+glm::vec3 CpuPathTracer::evalBSDF(const SurfaceBSDF& bsdf,
+                                  const glm::vec3&   wo,
+                                  const glm::vec3&   wi) const
+{
+    if(wi.z <= 0.0f || wo.z <= 0.0f)
+    {
+        return glm::vec3(0.0f);
+    }
+
+    const glm::vec3 wm = glm::normalize(wo + wi);
+    const float     D  = ggxDistribution(wm, bsdf.alpha);
+    const float     G2 = ggxSmithG2(wi, wo, bsdf.alpha);
+    const glm::vec3 F  = schlickFresnel(bsdf.specular, glm::dot(wi, wm));
+
+    return bsdf.albedo * kInvPi + F * D * G2 / (4.0f * wi.z * wo.z);
+}
+
+float CpuPathTracer::pdfBSDF(const SurfaceBSDF& bsdf,
+                             const glm::vec3&   wo,
+                             const glm::vec3&   wi) const
+{
+    if(wi.z <= 0.0f || wo.z <= 0.0f)
+    {
+        return 0.0f;
+    }
+
+    const glm::vec3 wm       = glm::normalize(wo + wi);
+    const float     pdfGloss = ggxSmithG1(wo, bsdf.alpha) * ggxDistribution(wm, bsdf.alpha)
+                           / (4.0f * wo.z);
+    return glm::mix(wi.z * kInvPi, pdfGloss, bsdf.specularProbability);
+}
+
+glm::vec3 CpuPathTracer::sampleBSDF(const SurfaceBSDF& bsdf,
+                                    const glm::vec3&   wo,
+                                    Pcg32&             rng) const
+{
+    const float lobe = rng.uniform();
+    const float u1   = rng.uniform();
+    const float u2   = rng.uniform();
+    if(lobe < bsdf.specularProbability)
+    {
+        return glm::reflect(-wo, sampleVNDF(wo, bsdf.alpha, u1, u2));
+    }
+    return sampleCosineHemisphere(u1, u2);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+float CpuPathTracer::intersectLight(const glm::vec3& origin, const glm::vec3& dir) const
+{
+    const glm::mat4& m           = m_scene.light.transform;
+    const glm::vec3  center      = glm::vec3(m[3]);
+    const glm::vec3  lightNormal = -glm::normalize(glm::vec3(m[2]));
+    const float      cosLight    = -glm::dot(dir, lightNormal);
+    if(cosLight <= 0.0f)
+    {
+        return -1.0f;
+    }
+
+    const float t = glm::dot(origin - center, lightNormal) / cosLight;
+    if(t <= 0.0f)
+    {
+        return -1.0f;
+    }
+
+    const glm::vec3 d     = origin + t * dir - center;
+    const glm::vec3 axisU = glm::vec3(m[0]);
+    const glm::vec3 axisV = glm::vec3(m[1]);
+    const float     u     = glm::dot(d, axisU) / glm::dot(axisU, axisU);
+    const float     v     = glm::dot(d, axisV) / glm::dot(axisV, axisV);
+    if(std::abs(u) > m_scene.light.size.x || std::abs(v) > m_scene.light.size.y)
+    {
+        return -1.0f;
+    }
+    return t;
+}
+
+float CpuPathTracer::lightPdf(float r, float cosLight) const
+{
+    const float pdfArea = 1.0f / (4.0f * m_scene.light.size.x * m_scene.light.size.y);
+    return cosLight > 0.0f ? pdfArea * r * r / cosLight : 0.0f;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+CpuMaterial CpuPathTracer::hitMaterial(const RayHit& hit) const
+{
+    const int materialID = m_scene.materialIDs[hit.triangle];
+    return materialID >= 0 ? m_scene.materials[materialID] : CpuMaterial();
+}
+
+glm::vec3 CpuPathTracer::shadingNormal(const RayHit& hit) const
+{
+    const uint32_t  tri = hit.triangle;
+    const glm::vec3 b(1.0f - hit.barycentrics.x - hit.barycentrics.y, hit.barycentrics);
+    return glm::normalize(m_scene.normals[m_scene.indices[3 * tri + 0]] * b.x
+                          + m_scene.normals[m_scene.indices[3 * tri + 1]] * b.y
+                          + m_scene.normals[m_scene.indices[3 * tri + 2]] * b.z);
+}
+
+CpuPathTracer::SurfaceBSDF CpuPathTracer::surfaceBSDF(const CpuMaterial& mat) const
+{
+    SurfaceBSDF bsdf;
+    bsdf.albedo              = mat.diffuse;
+    bsdf.specular            = mat.specular;
+    bsdf.alpha               = mat.roughness * mat.roughness;
+    bsdf.specularProbability = lobeProbability(mat.diffuse, mat.specular);
+    return bsdf;
+}
+
+// Same camera ray construction as getPrimaryRay(), box filtered jitter
+Ray CpuPathTracer::cameraRay(uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                             Pcg32& rng) const
+{
+    const glm::vec2 d =
+        glm::vec2((x + rng.uniform()) / float(width), (y + rng.uniform()) / float(height)) * 2.0f
+        - 1.0f;
+
+    const glm::vec4 p0 = m_scene.viewProjInverse * glm::vec4(d, 0.0f, 1.0f);
+    const glm::vec4 p1 = m_scene.viewProjInverse * glm::vec4(d, 1.0f, 1.0f);
+
+    Ray ray;
+    ray.origin = glm::vec3(p0) / p0.w;
+    ray.dir    = glm::normalize(glm::vec3(p1) / p1.w - ray.origin);
+    return ray;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+glm::vec3 CpuPathTracer::radiance(Ray                       ray,
+                                  const PathTracerSettings& settings,
+                                  Pcg32&                    rng,
+                                  RayStatistics*            statistics) const
+{
+    const SamplingStrategy strategy    = settings.strategy;
+    const glm::vec3        lightNormal = -glm::normalize(glm::vec3(m_scene.light.transform[2]));
+
+    glm::vec3 L(0.0f);
+    glm::vec3 throughput(1.0f);
+    float     bsdfPdf        = 0.0f;
+    bool      specularBounce = false;
+    float     lightT         = -1.0f;  // The area light stays invisible to camera rays
+
+    int bounce = 0;
+    for(;; ++bounce)
+    {
+        RayHit     hit;
+        const bool found = m_bvh.intersect(ray, &hit);
+        ++(bounce == 0 ? statistics->primary : statistics->extension);
+
+        // Area light reached by the BSDF sampled ray before the next surface
+        if(lightT > 0.0f && (!found || lightT < hit.t))
+        {
+            float weight = 1.0f;
+            if(!specularBounce)
+            {
+                if(strategy == SamplingStrategy::Light)
+                {
+                    weight = 0.0f;
+                }
+                else if(strategy == SamplingStrategy::Mis)
+                {
+                    const float cosLight = -glm::dot(ray.dir, lightNormal);
+                    weight = powerHeuristic(bsdfPdf, lightPdf(lightT, cosLight));
+                }
+            }
+            L += throughput * m_scene.light.radiance * weight;
+        }
+        if(!found)
+        {
+            L += throughput * environmentRadiance(ray.dir, bsdfPdf, bounce > 0 && !specularBounce,
+                                                  strategy);
+            break;
+        }
+
+        const CpuMaterial mat    = hitMaterial(hit);
+        glm::vec3         normal = shadingNormal(hit);
+
+        const bool frontFace = glm::dot(normal, ray.dir) <= 0.0f;
+        if(!frontFace)
+        {
+            normal = -normal;
+        }
+        const glm::vec3 hitPoint = ray.origin + hit.t * ray.dir;
+
+        const bool bsdfSampled = bounce > 0 && !specularBounce;
+        L += throughput * emittedRadiance(ray, hit, bsdfPdf, bsdfSampled, strategy);
+
+        const SurfaceBSDF bsdf = surfaceBSDF(mat);
+
+        const glm::mat3 localToWorld = formBasis(normal);
+        const glm::mat3 worldToLocal = glm::transpose(localToWorld);
+        const glm::vec3 wo           = glm::normalize(worldToLocal * -ray.dir);
+        const bool      lastVertex   = bounce >= settings.maxBounces;
+
+        if(!mat.dielectric && strategy != SamplingStrategy::Bsdf)
+        {  // Next event estimation
+            const glm::vec2 pos =
+                (glm::vec2(rng.uniform(), rng.uniform()) * 2.0f - 1.0f) * m_scene.light.size;
+            const glm::vec3 lightPos =
+                glm::vec3(m_scene.light.transform * glm::vec4(pos, 0.0f, 1.0f));
+
+            const glm::vec3 vLight   = lightPos - hitPoint;
+            const float     r        = glm::length(vLight);
+            const glm::vec3 dir      = vLight / r;
+            const float     cosLight = glm::dot(-dir, lightNormal);
+            const glm::vec3 wi       = worldToLocal * dir;
+
+            if(cosLight > 0.0f && wi.z > 0.0f)
+            {
+                Ray shadowRay;
+                shadowRay.origin = hitPoint;
+                shadowRay.dir    = dir;
+                shadowRay.tmin   = kRayEpsilon;
+                shadowRay.tmax   = r - kRayEpsilon;
+
+                ++statistics->shadow;
+                if(!m_bvh.occluded(shadowRay))
+                {
+                    const float pdfL   = lightPdf(r, cosLight);
+                    const float weight = strategy == SamplingStrategy::Mis && !lastVertex
+                                             ? powerHeuristic(pdfL, pdfBSDF(bsdf, wo, wi))
+                                             : 1.0f;
+                    L += throughput * m_scene.light.radiance * evalBSDF(bsdf, wo, wi) * wi.z
+                         * weight / pdfL;
+                }
+            }
+        }
+
+        if(!mat.dielectric && strategy != SamplingStrategy::Bsdf && !m_lightSampler.empty())
+        {  // Next event estimation on emissive triangles, both sides emit
+            const float       u0 = rng.uniform();
+            const float       u1 = rng.uniform();
+            const float       u2 = rng.uniform();
+            const LightSample ls = m_lightSampler.sample(u0, u1, u2);
+
+            const glm::vec3 vLight   = ls.position - hitPoint;
+            const float     r        = glm::length(vLight);
+            const glm::vec3 dir      = vLight / r;
+            const float     cosLight = std::abs(glm::dot(dir, ls.normal));
+            const glm::vec3 wi       = worldToLocal * dir;
+
+            if(cosLight > 0.0f && wi.z > 0.0f && ls.pdfArea > 0.0f)
+            {
+                Ray shadowRay;
+                shadowRay.origin = hitPoint;
+                shadowRay.dir    = dir;
+                shadowRay.tmin   = kRayEpsilon;
+                shadowRay.tmax   = r - kRayEpsilon;
+
+                ++statistics->shadow;
+                if(!m_bvh.occluded(shadowRay))
+                {
+                    const float pdfL   = ls.pdfArea * r * r / cosLight;
+                    const float weight = strategy == SamplingStrategy::Mis && !lastVertex
+                                             ? powerHeuristic(pdfL, pdfBSDF(bsdf, wo, wi))
+                                             : 1.0f;
+                    L += throughput * ls.emission * m_scene.emissionScale
+                         * evalBSDF(bsdf, wo, wi) * wi.z * weight / pdfL;
+                }
+            }
+        }
+
+        if(!mat.dielectric && strategy != SamplingStrategy::Bsdf && m_scene.environment
+           && m_scene.environment->canSample())
+        {  // Next event estimation on the environment map
+            const float     u0  = rng.uniform();
+            const float     u1  = rng.uniform();
+            float           pdfE;
+            const glm::vec3 dir = m_scene.environment->sample(u0, u1, &pdfE);
+            const glm::vec3 wi  = worldToLocal * dir;
+
+            if(pdfE > 0.0f && wi.z > 0.0f)
+            {
+                Ray shadowRay;
+                shadowRay.origin = hitPoint;
+                shadowRay.dir    = dir;
+                shadowRay.tmin   = kRayEpsilon;
+                shadowRay.tmax   = std::numeric_limits<float>::max();
+
+                ++statistics->shadow;
+                if(!m_bvh.occluded(shadowRay))
+                {
+                    const float weight = strategy == SamplingStrategy::Mis && !lastVertex
+                                             ? powerHeuristic(pdfE, pdfBSDF(bsdf, wo, wi))
+                                             : 1.0f;
+                    L += throughput * m_scene.environment->eval(dir) * m_scene.environmentScale
+                         * evalBSDF(bsdf, wo, wi) * wi.z * weight / pdfE;
+                }
+            }
+        }
+
+        // The other strategies reach the light from the last vertex through next event
+        // estimation, BSDF sampling needs one more ray to cover the same paths
+        if(lastVertex && (mat.dielectric || strategy != SamplingStrategy::Bsdf))
+        {
+            break;
+        }
+
+        glm::vec3 wi;
+        if(mat.dielectric)
+        {
+            const float etaI = frontFace ? 1.0f : kDielectricIor;
+            const float etaT = frontFace ? kDielectricIor : 1.0f;
+            const float fres = fresnelDielectric(wo.z, etaI, etaT);
+
+            wi = glm::refract(-wo, glm::vec3(0.0f, 0.0f, 1.0f), etaI / etaT);
+            if(rng.uniform() < fres || wi == glm::vec3(0.0f))
+            {
+                wi = glm::vec3(-wo.x, -wo.y, wo.z);
+            }
+            wi = glm::normalize(wi);
+
+            throughput *= mat.diffuse;
+            bsdfPdf        = 0.0f;
+            specularBounce = true;
+        }
+        else
+        {
+            wi = sampleBSDF(bsdf, wo, rng);
+
+            bsdfPdf = pdfBSDF(bsdf, wo, wi);
+            if(!(bsdfPdf > 0.0f))
+            {
+                break;
+            }
+            throughput *= evalBSDF(bsdf, wo, wi) * wi.z / bsdfPdf;
+            specularBounce = false;
+        }
+
+        // Russian roulette, survivors are reweighted so the estimate stays unbiased
+        if(settings.russianRouletteDepth >= 0 && bounce >= settings.russianRouletteDepth
+           && !lastVertex)
+        {
+            const float survival =
+                std::min(std::max(throughput.x, std::max(throughput.y, throughput.z)), 0.95f);
+            if(rng.uniform() >= survival)
+            {
+                break;
+            }
+            throughput /= survival;
+        }
+
+        ray.origin = hitPoint;
+        ray.dir    = localToWorld * wi;
+        ray.tmin   = kRayEpsilon;
+        ray.tmax   = std::numeric_limits<float>::max();
+        lightT     = intersectLight(ray.origin, ray.dir);
+
+        if(lastVertex)
+        {
+            // Only emitters are of interest past the last vertex
+            RayHit     next;
+            const bool foundNext = m_bvh.intersect(ray, &next);
+            ++statistics->extension;
+            if(lightT > 0.0f && (!foundNext || lightT < next.t))
+            {
+                L += throughput * m_scene.light.radiance;
+            }
+            if(foundNext)
+            {
+                L += throughput * emittedRadiance(ray, next, bsdfPdf, true, strategy);
+            }
+            else
+            {
+                L += throughput * environmentRadiance(ray.dir, bsdfPdf, true, strategy);
+            }
+            break;
+        }
+    }
+
+    statistics->addPath(bounce);
+    return L;
+}
+
+// ----------------------------------------------------------------------------
+//  Emission of the hit triangle towards the ray origin, weighted against sampling the emissive
+//  triangles when the direction came from BSDF sampling
+//
+
+glm::vec3 CpuPathTracer::emittedRadiance(const Ray&       ray,
+                                         const RayHit&    hit,
+                                         float            bsdfPdf,
+                                         bool             bsdfSampled,
+                                         SamplingStrategy strategy) const
+{
+    const int materialID = m_scene.materialIDs[hit.triangle];
+    if(materialID < 0 || luminance(m_scene.materials[materialID].emission) <= 0.0f)
+    {
+        return glm::vec3(0.0f);
+    }
+    const glm::vec3& emission = m_scene.materials[materialID].emission;
+
+    float weight = 1.0f;
+    if(bsdfSampled && !m_lightSampler.empty())
+    {
+        if(strategy == SamplingStrategy::Light)
+        {
+            weight = 0.0f;
+        }
+        else if(strategy == SamplingStrategy::Mis)
+        {
+            const glm::vec3& p0 = m_scene.positions[m_scene.indices[3 * hit.triangle + 0]];
+            const glm::vec3& p1 = m_scene.positions[m_scene.indices[3 * hit.triangle + 1]];
+            const glm::vec3& p2 = m_scene.positions[m_scene.indices[3 * hit.triangle + 2]];
+
+            // pmf / area of the light sampler, see emissiveTrianglePdf() in pathRT.rgen
+            const float cosLight =
+                std::abs(glm::dot(glm::normalize(glm::cross(p1 - p0, p2 - p0)), ray.dir));
+            const float pdfArea = luminance(emission) / m_lightSampler.aliasTable().totalWeight();
+            const float pdfL    = cosLight > 0.0f ? pdfArea * hit.t * hit.t / cosLight : 0.0f;
+            weight              = powerHeuristic(bsdfPdf, pdfL);
+        }
+    }
+    return emission * m_scene.emissionScale * weight;
+}
+
+// ----------------------------------------------------------------------------
+//  Environment seen by a ray that left the scene, weighted against sampling the environment
+//  map when the direction came from BSDF sampling
+//
+
+glm::vec3 CpuPathTracer::environmentRadiance(const glm::vec3& dir,
+                                             float            bsdfPdf,
+                                             bool             bsdfSampled,
+                                             SamplingStrategy strategy) const
+{
+    if(!m_scene.environment)
+    {
+        return glm::vec3(0.0f);
+    }
+
+    float weight = 1.0f;
+    if(bsdfSampled && m_scene.environment->canSample())
+    {
+        if(strategy == SamplingStrategy::Light)
+        {
+            weight = 0.0f;
+        }
+        else if(strategy == SamplingStrategy::Mis)
+        {
+            weight = powerHeuristic(bsdfPdf, m_scene.environment->pdf(dir));
+        }
+    }
+    return m_scene.environment->eval(dir) * m_scene.environmentScale * weight;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+#pragma omp declare reduction(+ : RayStatistics : omp_out += omp_in)
+
+RayStatistics CpuPathTracer::render(const PathTracerSettings& settings,
+                                    uint32_t                  iteration,
+                                    Image4f*                  accumulation) const
+{
+    const uint32_t width  = accumulation->width;
+    const uint32_t height = accumulation->height;
+
+    RayStatistics statistics;
+#pragma omp parallel for schedule(dynamic, 4) reduction(+ : statistics)
+    for(int y = 0; y < int(height); ++y)
+    {
+        for(uint32_t x = 0; x < width; ++x)
+        {
+            Pcg32     rng((uint64_t(iteration) << 32) ^ (uint64_t(y) * width + x));
+            const Ray ray = cameraRay(x, y, width, height, rng);
+
+            const glm::vec3 L = radiance(ray, settings, rng, &statistics);
+            if(std::isfinite(L.x) && std::isfinite(L.y) && std::isfinite(L.z))
+            {
+                accumulation->at(x, y) += glm::vec4(L, 1.0f);
+            }
+            else
+            {
+                accumulation->at(x, y).w += 1.0f;
+            }
+        }
+    }
+    return statistics;
+}
+
+// ----------------------------------------------------------------------------
+//  Sized by normalDepth, albedo and emission are resized to match. The emission covers the whole
+//  pixel like the box filtered samples of render(), partially covered emitters at silhouettes
+//  would otherwise leak into the illumination the denoiser filters.
+//
+
+void CpuPathTracer::renderGBuffer(const glm::vec3& cameraPosition,
+                                  Image4f*         normalDepth,
+                                  Image4f*         albedo,
+                                  Image4f*         emission) const
+{
+    const uint32_t width  = normalDepth->width;
+    const uint32_t height = normalDepth->height;
+    *albedo               = Image4f(width, height);
+    *emission             = Image4f(width, height);
+
+    const int kEmissionSamples = 4;  // Per side of the pixel
+
+    auto pixelRay = [&](const glm::vec2& pixel) {
+        const glm::vec2 d  = pixel / glm::vec2(width, height) * 2.0f - 1.0f;
+        const glm::vec4 p0 = m_scene.viewProjInverse * glm::vec4(d, 0.0f, 1.0f);
+        const glm::vec4 p1 = m_scene.viewProjInverse * glm::vec4(d, 1.0f, 1.0f);
+
+        Ray ray;
+        ray.origin = glm::vec3(p0) / p0.w;
+        ray.dir    = glm::normalize(glm::vec3(p1) / p1.w - ray.origin);
+        return ray;
+    };
+
+#pragma omp parallel for schedule(dynamic, 4)
+    for(int y = 0; y < int(height); ++y)
+    {
+        for(uint32_t x = 0; x < width; ++x)
+        {
+            // Pixel center like getPrimaryRay(vec2(0.5)), the guides are not jittered
+            const Ray ray = pixelRay(glm::vec2(x + 0.5f, y + 0.5f));
+
+            RayHit hit;
+            if(!m_bvh.intersect(ray, &hit))
+            {
+                normalDepth->at(x, y) = glm::vec4(0.0f, 0.0f, 0.0f, -1.0f);
+                continue;
+            }
+
+            glm::vec3 normal = shadingNormal(hit);
+            if(glm::dot(normal, ray.dir) > 0.0f)
+            {
+                normal = -normal;
+            }
+            const glm::vec3 hitPoint = ray.origin + hit.t * ray.dir;
+            normalDepth->at(x, y)    = glm::vec4(normal, glm::distance(hitPoint, cameraPosition));
+            albedo->at(x, y)         = glm::vec4(hitMaterial(hit).diffuse, 1.0f);
+
+            glm::vec3 emitted(0.0f);
+            for(int i = 0; i < kEmissionSamples * kEmissionSamples; ++i)
+            {
+                const glm::vec2 offset =
+                    (glm::vec2(i % kEmissionSamples, i / kEmissionSamples) + 0.5f)
+                    / float(kEmissionSamples);
+
+                RayHit sampleHit;
+                if(m_bvh.intersect(pixelRay(glm::vec2(x, y) + offset), &sampleHit))
+                {
+                    emitted += hitMaterial(sampleHit).emission;
+                }
+            }
+            emission->at(x, y) = glm::vec4(emitted * m_scene.emissionScale
+                                               / float(kEmissionSamples * kEmissionSamples),
+                                           1.0f);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  Camera rays and the first BSDF sample as radiance() draws them, without the light samples
+//
+
+std::vector<Ray> CpuPathTracer::extensionRays(uint32_t width,
+                                              uint32_t height,
+                                              uint32_t iteration) const
+{
+    std::vector<Ray>     rays(size_t(width) * height);
+    std::vector<uint8_t> valid(rays.size(), 0);
+#pragma omp parallel for schedule(dynamic, 4)
+    for(int y = 0; y < int(height); ++y)
+    {
+        for(uint32_t x = 0; x < width; ++x)
+        {
+            Pcg32     rng((uint64_t(iteration) << 32) ^ (uint64_t(y) * width + x));
+            const Ray ray = cameraRay(x, y, width, height, rng);
+
+            RayHit hit;
+            if(!m_bvh.intersect(ray, &hit))
+            {
+                continue;
+            }
+            const CpuMaterial mat = hitMaterial(hit);
+            if(mat.dielectric)
+            {
+                continue;
+            }
+            glm::vec3 normal = shadingNormal(hit);
+            if(glm::dot(normal, ray.dir) > 0.0f)
+            {
+                normal = -normal;
+            }
+
+            const glm::mat3 localToWorld = formBasis(normal);
+            const glm::vec3 wo = glm::normalize(glm::transpose(localToWorld) * -ray.dir);
+            const glm::vec3 wi = sampleBSDF(surfaceBSDF(mat), wo, rng);
+            if(wi.z <= 0.0f)
+            {
+                continue;
+            }
+
+            const size_t i = size_t(y) * width + x;
+            rays[i].origin = ray.origin + hit.t * ray.dir;
+            rays[i].dir    = glm::normalize(localToWorld * wi);
+            rays[i].tmin   = kRayEpsilon;
+            valid[i]       = 1;
+        }
+    }
+
+    size_t count = 0;
+    for(size_t i = 0; i < rays.size(); ++i)
+    {
+        if(valid[i])
+        {
+            rays[count++] = rays[i];
+        }
+    }
+    rays.resize(count);
+    return rays;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+namespace {
+
+// Iterations past the measured ones so the reference is independent of the runs
+Image4f renderReference(const CpuPathTracer&      tracer,
+                        const PathTracerSettings& settings,
+                        uint32_t                  width,
+                        uint32_t                  height,
+                        uint32_t                  samples)
+{
+    Image4f accumulation(width, height);
+    for(uint32_t i = 0; i < samples; ++i)
+    {
+        tracer.render(settings, (1u << 20) + i, &accumulation);
+    }
+    return resolveAccumulation(accumulation);
+}
+
+}  // namespace
+
+std::vector<ConvergenceSample> measureConvergence(const CpuPathTracer&      tracer,
+                                                  const PathTracerSettings& settings,
+                                                  const Image4f&            reference,
+                                                  double                    secondsBudget)
+{
+    using Clock = std::chrono::high_resolution_clock;
+
+    Image4f                        accumulation(reference.width, reference.height);
+    std::vector<ConvergenceSample> samples;
+
+    const double numPixels = double(reference.width) * double(reference.height);
+    double       seconds   = 0.0;
+    uint64_t     numRays   = 0;
+    uint32_t     iteration = 0;
+    const auto   start     = Clock::now();
+    while(seconds < secondsBudget)
+    {
+        numRays += tracer.render(settings, iteration++, &accumulation).total();
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        ConvergenceSample sample;
+        sample.seconds      = seconds;
+        sample.samples      = iteration;
+        sample.raysPerPixel = double(numRays) / numPixels;
+        sample.rmse         = rmse(resolveAccumulation(accumulation), reference);
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+std::vector<StrategyConvergence> benchmarkSamplingStrategies(const CpuScene& scene,
+                                                             int             maxBounces,
+                                                             uint32_t        width,
+                                                             uint32_t        height,
+                                                             uint32_t        referenceSamples,
+                                                             double          secondsPerStrategy)
+{
+    const CpuPathTracer tracer(scene);
+
+    PathTracerSettings settings;
+    settings.maxBounces = maxBounces;
+    settings.strategy   = SamplingStrategy::Mis;
+
+    const Image4f reference = renderReference(tracer, settings, width, height, referenceSamples);
+
+    std::vector<StrategyConvergence> results;
+    for(const SamplingStrategy strategy :
+        {SamplingStrategy::Bsdf, SamplingStrategy::Light, SamplingStrategy::Mis})
+    {
+        settings.strategy = strategy;
+
+        StrategyConvergence result;
+        result.strategy = strategy;
+        result.samples  = measureConvergence(tracer, settings, reference, secondsPerStrategy);
+        results.push_back(result);
+    }
+    return results;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+RouletteComparison benchmarkRussianRoulette(const CpuScene& scene,
+                                            int             maxBounces,
+                                            int             rouletteDepth,
+                                            uint32_t        width,
+                                            uint32_t        height,
+                                            uint32_t        referenceSamples,
+                                            uint32_t        baselineSamples)
+{
+    using Clock = std::chrono::high_resolution_clock;
+
+    const CpuPathTracer tracer(scene);
+
+    PathTracerSettings settings;
+    settings.maxBounces = maxBounces;
+    settings.strategy   = SamplingStrategy::Mis;
+
+    const Image4f reference = renderReference(tracer, settings, width, height, referenceSamples);
+    const double  numPixels = double(width) * double(height);
+
+    // Renders until the error drops to targetRmse or maxSamples paths per pixel are reached
+    auto run = [&](uint32_t maxSamples, double targetRmse) {
+        Image4f           accumulation(width, height);
+        ConvergenceSample sample;
+        uint64_t          numRays = 0;
+        while(sample.samples < maxSamples)
+        {
+            // Only the rendering is timed, not the error evaluation
+            const auto start = Clock::now();
+            numRays += tracer.render(settings, sample.samples++, &accumulation).total();
+            sample.seconds += std::chrono::duration<double>(Clock::now() - start).count();
+
+            sample.rmse = rmse(resolveAccumulation(accumulation), reference);
+            if(sample.rmse <= targetRmse)
+            {
+                break;
+            }
+        }
+        sample.raysPerPixel = double(numRays) / numPixels;
+        return sample;
+    };
+
+    RouletteComparison result;
+
+    settings.russianRouletteDepth = -1;
+    result.withoutRoulette        = run(baselineSamples, 0.0);
+
+    settings.russianRouletteDepth = rouletteDepth;
+    result.withRoulette           = run(16 * baselineSamples, result.withoutRoulette.rmse);
+    result.converged              = result.withRoulette.rmse <= result.withoutRoulette.rmse;
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+namespace {
+
+// Closest hits of rays in their order, every thread takes contiguous runs of them
+uint64_t traceRays(const Bvh& bvh, const std::vector<Ray>& rays)
+{
+    uint64_t hits = 0;
+#pragma omp parallel for schedule(dynamic, 1024) reduction(+ : hits)
+    for(int i = 0; i < int(rays.size()); ++i)
+    {
+        RayHit hit;
+        hits += bvh.intersect(rays[i], &hit) ? 1 : 0;
+    }
+    return hits;
+}
+
+}  // namespace
+
+RaySortingComparison benchmarkRaySorting(const CpuScene& scene,
+                                         uint32_t        width,
+                                         uint32_t        height,
+                                         uint32_t        iterations)
+{
+    using Clock = std::chrono::high_resolution_clock;
+    const auto milliseconds = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    const CpuPathTracer tracer(scene);
+    const auto&         nodes  = tracer.bvh().nodes();
+    const AABB          bounds = nodes.empty() ? AABB() : nodes[0].bounds;
+
+    RaySortingComparison result;
+    for(uint32_t i = 0; i < iterations; ++i)
+    {
+        std::vector<Ray> rays = tracer.extensionRays(width, height, i);
+        result.rays += rays.size();
+
+        auto start = Clock::now();
+        result.unsortedHits += traceRays(tracer.bvh(), rays);
+        result.unsortedMs += milliseconds(start);
+
+        start = Clock::now();
+        sortRays(&rays, bounds);
+        result.sortMs += milliseconds(start);
+
+        start = Clock::now();
+        result.sortedHits += traceRays(tracer.bvh(), rays);
+        result.sortedMs += milliseconds(start);
+    }
+    return result;
+}
+
+}  // namespace rtutils
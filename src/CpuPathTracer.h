@@ -0,0 +1,237 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+#include "EnvironmentMap.h"
+#include "LightSampler.h"
+#include "rtutils.h"
+
+namespace VkTools {
+struct Model;
+}
+
+namespace rtutils {
+
+// ----------------------------------------------------------------------------
+//  CPU reference of the path tracer in pathRT.rgen: Lambert plus GGX surfaces, smooth
+//  dielectrics, the rectangular area light, emissive triangles picked by power and an
+//  importance sampled environment map, with next event estimation and BSDF sampling combined by
+//  the power heuristic. Textures are not sampled.
+//
+
+// Surface parameters as pathRT.rgen derives them from the material buffer
+struct CpuMaterial
+{
+    glm::vec3 diffuse    = glm::vec3(0.8f);
+    glm::vec3 specular   = glm::vec3(0.0f);
+    glm::vec3 emission   = glm::vec3(0.0f);
+    float     roughness  = 1.0f;
+    bool      dielectric = false;  // dissolve == 0
+};
+
+// Same parametrization as the UBO: points lightTransform * (x, y, 0, 1) with |x| < size.x and
+// |y| < size.y, emitting towards -lightTransform[2]
+struct CpuAreaLight
+{
+    glm::mat4 transform = glm::mat4(1.0f);
+    glm::vec2 size      = glm::vec2(0.25f);
+    glm::vec3 radiance  = glm::vec3(1.0f);
+};
+
+struct CpuScene
+{
+    std::vector<glm::vec3>   positions;
+    std::vector<glm::vec3>   normals;
+    std::vector<uint32_t>    indices;
+    std::vector<int>         materialIDs;  // One per triangle
+    std::vector<CpuMaterial> materials;
+
+    CpuAreaLight light;
+    float        emissionScale   = 1.0f;  // ubo.lightOtherE
+    glm::mat4    viewProjInverse = glm::mat4(1.0f);
+
+    // Radiance of rays leaving the scene, black when null
+    std::shared_ptr<const EnvironmentMap> environment;
+    float                                 environmentScale = 1.0f;  // ubo.environmentE
+};
+
+// Appends the CPU copy of a loaded model's geometry and materials
+void appendModel(const VkTools::Model& model, CpuScene* scene);
+
+enum class SamplingStrategy
+{
+    Bsdf,   // BSDF sampling only
+    Light,  // Next event estimation only
+    Mis     // Both, power heuristic, what pathRT.rgen does
+};
+
+const char* toString(SamplingStrategy strategy);
+
+struct PathTracerSettings
+{
+    int              maxBounces           = 4;  // ubo.numIndirectBounces
+    SamplingStrategy strategy             = SamplingStrategy::Mis;
+    int              russianRouletteDepth = -1;  // ubo.russianRouletteDepth, negative disables
+};
+
+class CpuPathTracer
+{
+    public:
+    explicit CpuPathTracer(const CpuScene& scene);
+
+    // Adds one jittered path per pixel (rgb: radiance sum, w: sample count), returns the rays
+    // traced and the path lengths
+    RayStatistics render(const PathTracerSettings& settings,
+                         uint32_t                  iteration,
+                         Image4f*                  accumulation) const;
+
+    // Adds the rays traced for the path and its length to statistics
+    glm::vec3 radiance(Ray                       ray,
+                       const PathTracerSettings& settings,
+                       Pcg32&                    rng,
+                       RayStatistics*            statistics) const;
+
+    // The BSDF sampled rays leaving the first hit of every pixel in render(), in pixel order.
+    // Pixels whose camera ray misses or hits a dielectric have none.
+    std::vector<Ray> extensionRays(uint32_t width, uint32_t height, uint32_t iteration) const;
+
+    // Denoiser guides of the pixel center rays as pathRT.rgen writes them: shading normal facing
+    // the camera and distance to cameraPosition, w negative on a miss, the diffuse albedo and the
+    // first hit emission averaged over the pixel
+    void renderGBuffer(const glm::vec3& cameraPosition,
+                       Image4f*         normalDepth,
+                       Image4f*         albedo,
+                       Image4f*         emission) const;
+
+    const Bvh& bvh() const { return m_bvh; }
+
+    private:
+    struct SurfaceBSDF
+    {
+        glm::vec3 albedo;
+        glm::vec3 specular;
+        float     alpha;
+        float     specularProbability;
+    };
+
+    CpuMaterial hitMaterial(const RayHit& hit) const;
+    glm::vec3   shadingNormal(const RayHit& hit) const;  // Interpolated, not facing the ray
+    SurfaceBSDF surfaceBSDF(const CpuMaterial& mat) const;
+
+    Ray cameraRay(uint32_t x, uint32_t y, uint32_t width, uint32_t height, Pcg32& rng) const;
+
+    glm::vec3 evalBSDF(const SurfaceBSDF& bsdf, const glm::vec3& wo, const glm::vec3& wi) const;
+    float     pdfBSDF(const SurfaceBSDF& bsdf, const glm::vec3& wo, const glm::vec3& wi) const;
+    glm::vec3 sampleBSDF(const SurfaceBSDF& bsdf, const glm::vec3& wo, Pcg32& rng) const;
+
+    // Distance to the emitting side of the area light along dir, negative on a miss
+    float intersectLight(const glm::vec3& origin, const glm::vec3& dir) const;
+    float lightPdf(float r, float cosLight) const;
+
+    glm::vec3 emittedRadiance(const Ray&       ray,
+                              const RayHit&    hit,
+                              float            bsdfPdf,
+                              bool             bsdfSampled,
+                              SamplingStrategy strategy) const;
+    glm::vec3 environmentRadiance(const glm::vec3& dir,
+                                  float            bsdfPdf,
+                                  bool             bsdfSampled,
+                                  SamplingStrategy strategy) const;
+
+    CpuScene     m_scene;
+    Bvh          m_bvh;
+    LightSampler m_lightSampler;  // Emissive triangles
+};
+
+
+// ----------------------------------------------------------------------------
+//  RMSE versus render time, used to compare the sampling strategies
+//
+
+struct ConvergenceSample
+{
+    double   seconds      = 0.0;
+    uint32_t samples      = 0;
+    double   raysPerPixel = 0.0;
+    double   rmse         = 0.0;
+};
+
+// Renders progressively for secondsBudget and records the error of the running average
+// against reference after every iteration
+std::vector<ConvergenceSample> measureConvergence(const CpuPathTracer&      tracer,
+                                                  const PathTracerSettings& settings,
+                                                  const Image4f&            reference,
+                                                  double                    secondsBudget);
+
+struct StrategyConvergence
+{
+    SamplingStrategy               strategy;
+    std::vector<ConvergenceSample> samples;
+};
+
+// Renders a MIS reference with referenceSamples paths per pixel, then measures every strategy
+std::vector<StrategyConvergence> benchmarkSamplingStrategies(const CpuScene& scene,
+                                                             int             maxBounces,
+                                                             uint32_t        width,
+                                                             uint32_t        height,
+                                                             uint32_t        referenceSamples,
+                                                             double          secondsPerStrategy);
+
+// ----------------------------------------------------------------------------
+//  Cost of Russian roulette at equal error: the path length is not truncated any differently,
+//  so both runs converge to the same image and only time and rays spent differ
+//
+
+struct RouletteComparison
+{
+    ConvergenceSample withoutRoulette;
+    ConvergenceSample withRoulette;
+    bool              converged = false;  // withRoulette reached the error of withoutRoulette
+};
+
+// Renders baselineSamples paths per pixel without Russian roulette, then renders with it from
+// rouletteDepth on until the error against the reference is as low, at most 16 times as long
+RouletteComparison benchmarkRussianRoulette(const CpuScene& scene,
+                                            int             maxBounces,
+                                            int             rouletteDepth,
+                                            uint32_t        width,
+                                            uint32_t        height,
+                                            uint32_t        referenceSamples,
+                                            uint32_t        baselineSamples);
+
+// ----------------------------------------------------------------------------
+//  Closest hit throughput on first bounce extension rays, traced in pixel order and again
+//  after sortRays. Both orders trace the same rays, so the hit counts match.
+//
+
+struct RaySortingComparison
+{
+    uint64_t rays         = 0;
+    uint64_t unsortedHits = 0;
+    uint64_t sortedHits   = 0;
+    double   unsortedMs   = 0.0;
+    double   sortMs       = 0.0;  // Keys and radix sort
+    double   sortedMs     = 0.0;  // Tracing only
+
+    double unsortedRaysPerSecond() const
+    {
+        return unsortedMs > 0.0 ? rays / (unsortedMs * 1e-3) : 0.0;
+    }
+    double sortedRaysPerSecond() const  // Including the sort
+    {
+        return sortMs + sortedMs > 0.0 ? rays / ((sortMs + sortedMs) * 1e-3) : 0.0;
+    }
+};
+
+// Extension rays of iterations width x height frames of the scene's camera
+RaySortingComparison benchmarkRaySorting(const CpuScene& scene,
+                                         uint32_t        width,
+                                         uint32_t        height,
+                                         uint32_t        iterations);
+
+}  // namespace rtutils
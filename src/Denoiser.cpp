@@ -0,0 +1,554 @@
+#include "Denoiser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#define DENOISER_USE_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace rtutils {
+namespace {
+
+// Keep these in sync with denoiseTemporal.comp and denoiseAtrous.comp
+const float kAlbedoEpsilon    = 0.001f;
+const float kNormalTolerance  = 0.9f;
+const float kMaxHistoryLength = 32.0f;
+const float kLuminanceEpsilon = 1e-4f;
+
+// B3 spline a-trous kernel, indexed with the absolute tap offset
+const float kKernel[3] = {3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+
+// The background and black surfaces bypass the filter and are no taps, demodulating the radiance
+// of the latter would blow it up by 1 / kAlbedoEpsilon
+bool isFiltered(const glm::vec4& normalDepth, const glm::vec4& albedo)
+{
+    return normalDepth.w > 0.0f && std::max({albedo.x, albedo.y, albedo.z}) >= kAlbedoEpsilon;
+}
+
+// The first hit emission is not part of the illumination, it is added back after remodulation
+glm::vec3 demodulate(const glm::vec4& color, const glm::vec4& albedo, const glm::vec4& emission)
+{
+    return glm::max(glm::vec3(color) - glm::vec3(emission), glm::vec3(0.0f))
+           / glm::max(glm::vec3(albedo), glm::vec3(kAlbedoEpsilon));
+}
+
+#if DENOISER_USE_SSE
+
+// Cephes style exp and log approximations, accurate to a few ulps in the range used here
+
+inline __m128 exp_ps(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    x = _mm_min_ps(x, _mm_set1_ps(88.3762626647949f));
+    x = _mm_max_ps(x, _mm_set1_ps(-88.3762626647949f));
+
+    // Round x / ln(2) down to integer
+    __m128 fx  = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+    __m128 tmp = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+    fx         = _mm_sub_ps(tmp, _mm_and_ps(_mm_cmpgt_ps(tmp, fx), one));
+
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+
+    const __m128 z = _mm_mul_ps(x, x);
+
+    __m128 y = _mm_set1_ps(1.9875691500e-4f);
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507e-3f));
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073e-3f));
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894e-2f));
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459e-1f));
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201e-1f));
+    y        = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), one);
+
+    // Build 2^n
+    __m128i n = _mm_cvttps_epi32(fx);
+    n         = _mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(0x7f)), 23);
+
+    return _mm_mul_ps(y, _mm_castsi128_ps(n));
+}
+
+// Expects x > 0
+inline __m128 log_ps(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    x = _mm_max_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x00800000)));
+
+    __m128i exponent = _mm_srli_epi32(_mm_castps_si128(x), 23);
+    exponent         = _mm_sub_epi32(exponent, _mm_set1_epi32(0x7f));
+
+    // Mantissa in [0.5, 1)
+    x = _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(~0x7f800000)));
+    x = _mm_or_ps(x, _mm_set1_ps(0.5f));
+
+    __m128 e = _mm_add_ps(_mm_cvtepi32_ps(exponent), one);
+
+    const __m128 mask = _mm_cmplt_ps(x, _mm_set1_ps(0.707106781186547524f));
+    const __m128 tmp  = _mm_and_ps(x, mask);
+    x                 = _mm_sub_ps(x, one);
+    e                 = _mm_sub_ps(e, _mm_and_ps(one, mask));
+    x                 = _mm_add_ps(x, tmp);
+
+    const __m128 z = _mm_mul_ps(x, x);
+
+    __m128 y = _mm_set1_ps(7.0376836292e-2f);
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.1514610310e-1f));
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.1676998740e-1f));
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.2420140846e-1f));
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.4249322787e-1f));
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-1.6668057665e-1f));
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(2.0000714765e-1f));
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(-2.4999993993e-1f));
+    y        = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(3.3333331174e-1f));
+    y        = _mm_mul_ps(_mm_mul_ps(y, x), z);
+
+    y = _mm_add_ps(y, _mm_mul_ps(e, _mm_set1_ps(-2.12194440e-4f)));
+    y = _mm_sub_ps(y, _mm_mul_ps(z, _mm_set1_ps(0.5f)));
+    x = _mm_add_ps(x, y);
+    x = _mm_add_ps(x, _mm_mul_ps(e, _mm_set1_ps(0.693359375f)));
+    return x;
+}
+
+inline __m128 abs_ps(__m128 x)
+{
+    return _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+
+#endif
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+Denoiser::Denoiser(uint32_t width, uint32_t height)
+    : m_width(width)
+    , m_height(height)
+    , m_historyColor(width, height)
+    , m_historyMoments(width, height)
+    , m_moments(width, height)
+    , m_prevNormalDepth(width, height, glm::vec4(0.0f, 0.0f, 0.0f, -1.0f))
+{
+    m_pingPong[0] = Image4f(width, height);
+    m_pingPong[1] = Image4f(width, height);
+
+    const size_t numPixels = size_t(width) * height;
+    for(auto* plane : {&m_planes.nx, &m_planes.ny, &m_planes.nz, &m_planes.depth,
+                       &m_planes.luminance, &m_planes.variance, &m_planes.r, &m_planes.g,
+                       &m_planes.b})
+    {
+        plane->resize(numPixels);
+    }
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void Denoiser::denoise(const Image4f&     color,
+                       const GBuffer&     gbuffer,
+                       const FrameCamera& camera,
+                       Image4f*           output)
+{
+    *output = Image4f(m_width, m_height);
+
+    // Pixels that bypass the filter get a negative depth like the background
+    for(size_t i = 0; i < gbuffer.normalDepth.pixels.size(); ++i)
+    {
+        const glm::vec4& nd = gbuffer.normalDepth.pixels[i];
+        m_planes.nx[i]      = nd.x;
+        m_planes.ny[i]      = nd.y;
+        m_planes.nz[i]      = nd.z;
+        m_planes.depth[i]   = isFiltered(nd, gbuffer.albedo.pixels[i]) ? nd.w : -1.0f;
+    }
+
+    temporalPass(color, gbuffer, camera);
+
+    const int iterations = std::max(1, m_settings.atrousIterations);
+    for(int i = 0; i < iterations; ++i)
+    {
+        const Image4f& in  = m_pingPong[i % 2];
+        Image4f&       out = m_pingPong[(i + 1) % 2];
+        atrousPass(in, 1 << i, i == 0, &out);
+    }
+
+    // Remodulate with the albedo and add the emission back, pixels that bypass the filter were
+    // never demodulated
+    const Image4f& result = m_pingPong[iterations % 2];
+
+#pragma omp parallel for
+    for(int i = 0; i < int(result.pixels.size()); ++i)
+    {
+        glm::vec3 c = glm::vec3(result.pixels[i]);
+        if(m_planes.depth[i] > 0.0f)
+        {
+            c = c * glm::max(glm::vec3(gbuffer.albedo.pixels[i]), glm::vec3(kAlbedoEpsilon))
+                + glm::vec3(gbuffer.emission.pixels[i]);
+        }
+        output->pixels[i] = glm::vec4(c, 1.0f);
+    }
+
+    m_historyMoments  = m_moments;
+    m_prevNormalDepth = gbuffer.normalDepth;
+    m_hasHistory      = true;
+}
+
+// ----------------------------------------------------------------------------
+//  Mirrors denoiseTemporal.comp
+//
+
+void Denoiser::temporalPass(const Image4f& color, const GBuffer& gbuffer, const FrameCamera& camera)
+{
+    Image4f& out = m_pingPong[0];
+
+#pragma omp parallel for schedule(dynamic, 4)
+    for(int y = 0; y < int(m_height); ++y)
+    {
+        for(uint32_t x = 0; x < m_width; ++x)
+        {
+            const glm::vec4& nd = gbuffer.normalDepth.at(x, y);
+
+            if(!isFiltered(nd, gbuffer.albedo.at(x, y)))
+            {
+                out.at(x, y)       = glm::vec4(glm::vec3(color.at(x, y)), 0.0f);
+                m_moments.at(x, y) = glm::vec4(0.0f);
+                continue;
+            }
+
+            const glm::vec3 illumination =
+                demodulate(color.at(x, y), gbuffer.albedo.at(x, y), gbuffer.emission.at(x, y));
+            const float     lum          = luminance(illumination);
+
+            glm::vec3 prevIllumination(0.0f);
+            glm::vec3 prevMoments(0.0f);
+
+            ReprojectionTap taps[4];
+            const int       count =
+                m_hasHistory ? findHistoryTaps(camera, gbuffer.normalDepth, m_prevNormalDepth,
+                                               x, y, taps)
+                             : 0;
+            for(int i = 0; i < count; ++i)
+            {
+                const ReprojectionTap& tap = taps[i];
+                prevIllumination += tap.weight * glm::vec3(m_historyColor.at(tap.x, tap.y));
+                prevMoments += tap.weight * glm::vec3(m_historyMoments.at(tap.x, tap.y));
+            }
+
+            const bool valid = count > 0;
+
+            const float historyLength = valid ? std::min(prevMoments.z + 1.0f, kMaxHistoryLength)
+                                              : 1.0f;
+            const float alpha = valid ? std::max(m_settings.alpha, 1.0f / historyLength) : 1.0f;
+            const float momentsAlpha =
+                valid ? std::max(m_settings.momentsAlpha, 1.0f / historyLength) : 1.0f;
+
+            glm::vec2 moments = glm::mix(glm::vec2(prevMoments), glm::vec2(lum, lum * lum),
+                                         momentsAlpha);
+            glm::vec3 result  = glm::mix(prevIllumination, illumination, alpha);
+            float     variance = std::max(0.0f, moments.y - moments.x * moments.x);
+
+            // Not enough temporal samples, estimate the variance spatially instead
+            if(historyLength < 4.0f)
+            {
+                glm::vec2 spatialMoments(0.0f);
+                float     weight = 0.0f;
+                for(int dy = -1; dy <= 1; ++dy)
+                {
+                    for(int dx = -1; dx <= 1; ++dx)
+                    {
+                        const int qx = int(x) + dx;
+                        const int qy = y + dy;
+                        if(qx < 0 || qy < 0 || qx >= int(m_width) || qy >= int(m_height))
+                        {
+                            continue;
+                        }
+                        const glm::vec4& qnd = gbuffer.normalDepth.at(qx, qy);
+                        if(!isFiltered(qnd, gbuffer.albedo.at(qx, qy))
+                           || glm::dot(glm::vec3(qnd), glm::vec3(nd)) < kNormalTolerance)
+                        {
+                            continue;
+                        }
+                        const float l = luminance(demodulate(color.at(qx, qy),
+                                                             gbuffer.albedo.at(qx, qy),
+                                                             gbuffer.emission.at(qx, qy)));
+                        spatialMoments += glm::vec2(l, l * l);
+                        weight += 1.0f;
+                    }
+                }
+                spatialMoments /= std::max(weight, 1.0f);
+                variance = std::max(0.0f, spatialMoments.y - spatialMoments.x * spatialMoments.x);
+                variance *= 4.0f / historyLength;
+            }
+
+            out.at(x, y)       = glm::vec4(result, variance);
+            m_moments.at(x, y) = glm::vec4(moments, historyLength, 0.0f);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  Mirrors denoiseAtrous.comp. Interior pixels are filtered four at a time from the
+//  structure of arrays planes, borders fall back to atrousPixel.
+//
+
+void Denoiser::atrousPass(const Image4f& in, int stepSize, bool writeHistory, Image4f* out)
+{
+    const int width  = int(m_width);
+    const int height = int(m_height);
+
+    for(size_t i = 0; i < in.pixels.size(); ++i)
+    {
+        const glm::vec4& c = in.pixels[i];
+        m_planes.r[i]      = c.x;
+        m_planes.g[i]      = c.y;
+        m_planes.b[i]      = c.z;
+        m_planes.luminance[i] = luminance(glm::vec3(c));
+    }
+
+    // Prefilter the variance with a 3x3 gaussian
+#pragma omp parallel for
+    for(int y = 0; y < height; ++y)
+    {
+        for(int x = 0; x < width; ++x)
+        {
+            const float g[2] = {1.0f / 4.0f, 1.0f / 8.0f};
+            float       sum  = 0.0f;
+            float       sumW = 0.0f;
+            for(int dy = -1; dy <= 1; ++dy)
+            {
+                for(int dx = -1; dx <= 1; ++dx)
+                {
+                    const int qx = x + dx;
+                    const int qy = y + dy;
+                    if(qx < 0 || qy < 0 || qx >= width || qy >= height)
+                    {
+                        continue;
+                    }
+                    const float w = g[std::abs(dx)] * g[std::abs(dy)] * 4.0f;
+                    sum += w * in.at(qx, qy).w;
+                    sumW += w;
+                }
+            }
+            m_planes.variance[size_t(y) * width + x] = sum / sumW;
+        }
+    }
+
+#pragma omp parallel for schedule(dynamic, 4)
+    for(int y = 0; y < height; ++y)
+    {
+        int x = 0;
+
+#if DENOISER_USE_SSE
+        const int    reach     = 2 * stepSize;
+        const __m128 phiNormal = _mm_set1_ps(m_settings.phiNormal);
+        const __m128 zero      = _mm_setzero_ps();
+
+        // Scalar path for the left border
+        for(; x < std::min(reach, width); ++x)
+        {
+            atrousPixel(in, x, y, stepSize, out);
+        }
+
+        for(; x + 3 + reach < width; x += 4)
+        {
+            const size_t p = size_t(y) * width + x;
+
+            const __m128 nx = _mm_loadu_ps(&m_planes.nx[p]);
+            const __m128 ny = _mm_loadu_ps(&m_planes.ny[p]);
+            const __m128 nz = _mm_loadu_ps(&m_planes.nz[p]);
+            const __m128 z  = _mm_loadu_ps(&m_planes.depth[p]);
+            const __m128 l  = _mm_loadu_ps(&m_planes.luminance[p]);
+
+            const __m128 phiL = _mm_add_ps(
+                _mm_mul_ps(_mm_set1_ps(m_settings.phiColor),
+                           _mm_sqrt_ps(_mm_max_ps(_mm_loadu_ps(&m_planes.variance[p]), zero))),
+                _mm_set1_ps(kLuminanceEpsilon));
+            const __m128 invPhiL = _mm_div_ps(_mm_set1_ps(1.0f), phiL);
+            const __m128 invPhiZ = _mm_div_ps(
+                _mm_set1_ps(1.0f),
+                _mm_mul_ps(_mm_set1_ps(m_settings.phiDepth), _mm_max_ps(z, _mm_set1_ps(1e-4f))));
+
+            const float  kc   = kKernel[0] * kKernel[0];
+            __m128       sumW = _mm_set1_ps(kc);
+            __m128       sumR = _mm_mul_ps(sumW, _mm_loadu_ps(&m_planes.r[p]));
+            __m128       sumG = _mm_mul_ps(sumW, _mm_loadu_ps(&m_planes.g[p]));
+            __m128       sumB = _mm_mul_ps(sumW, _mm_loadu_ps(&m_planes.b[p]));
+            const __m128 varC = _mm_set_ps(in.pixels[p + 3].w, in.pixels[p + 2].w,
+                                           in.pixels[p + 1].w, in.pixels[p].w);
+            __m128       sumV = _mm_mul_ps(_mm_set1_ps(kc * kc), varC);
+
+            for(int dy = -2; dy <= 2; ++dy)
+            {
+                const int qy = y + dy * stepSize;
+                if(qy < 0 || qy >= height)
+                {
+                    continue;
+                }
+                for(int dx = -2; dx <= 2; ++dx)
+                {
+                    if(dx == 0 && dy == 0)
+                    {
+                        continue;
+                    }
+
+                    const size_t q = size_t(qy) * width + x + dx * stepSize;
+
+                    const float  dist = float(stepSize) * std::sqrt(float(dx * dx + dy * dy));
+                    const __m128 k    = _mm_set1_ps(kKernel[std::abs(dx)] * kKernel[std::abs(dy)]);
+
+                    const __m128 qz = _mm_loadu_ps(&m_planes.depth[q]);
+                    const __m128 qdot =
+                        _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(&m_planes.nx[q])),
+                                              _mm_mul_ps(ny, _mm_loadu_ps(&m_planes.ny[q]))),
+                                   _mm_mul_ps(nz, _mm_loadu_ps(&m_planes.nz[q])));
+
+                    // Zero weight for background and back facing neighbours
+                    const __m128 valid = _mm_and_ps(_mm_cmpgt_ps(qz, zero), _mm_cmpgt_ps(qdot, zero));
+
+                    __m128 exponent = _mm_mul_ps(phiNormal, log_ps(_mm_max_ps(qdot, _mm_set1_ps(1e-8f))));
+                    exponent        = _mm_sub_ps(
+                        exponent, _mm_mul_ps(_mm_mul_ps(abs_ps(_mm_sub_ps(z, qz)), invPhiZ),
+                                             _mm_set1_ps(1.0f / dist)));
+                    exponent = _mm_sub_ps(
+                        exponent,
+                        _mm_mul_ps(abs_ps(_mm_sub_ps(l, _mm_loadu_ps(&m_planes.luminance[q]))),
+                                   invPhiL));
+
+                    const __m128 w = _mm_and_ps(_mm_mul_ps(k, exp_ps(exponent)), valid);
+
+                    const __m128 qv = _mm_set_ps(in.pixels[q + 3].w, in.pixels[q + 2].w,
+                                                 in.pixels[q + 1].w, in.pixels[q].w);
+
+                    sumR = _mm_add_ps(sumR, _mm_mul_ps(w, _mm_loadu_ps(&m_planes.r[q])));
+                    sumG = _mm_add_ps(sumG, _mm_mul_ps(w, _mm_loadu_ps(&m_planes.g[q])));
+                    sumB = _mm_add_ps(sumB, _mm_mul_ps(w, _mm_loadu_ps(&m_planes.b[q])));
+                    sumV = _mm_add_ps(sumV, _mm_mul_ps(_mm_mul_ps(w, w), qv));
+                    sumW = _mm_add_ps(sumW, w);
+                }
+            }
+
+            alignas(16) float r[4], g[4], b[4], v[4], depth[4];
+            const __m128      invW = _mm_div_ps(_mm_set1_ps(1.0f), sumW);
+            _mm_store_ps(r, _mm_mul_ps(sumR, invW));
+            _mm_store_ps(g, _mm_mul_ps(sumG, invW));
+            _mm_store_ps(b, _mm_mul_ps(sumB, invW));
+            _mm_store_ps(v, _mm_mul_ps(sumV, _mm_mul_ps(invW, invW)));
+            _mm_store_ps(depth, z);
+
+            for(int lane = 0; lane < 4; ++lane)
+            {
+                out->pixels[p + lane] = depth[lane] > 0.0f
+                                            ? glm::vec4(r[lane], g[lane], b[lane], v[lane])
+                                            : in.pixels[p + lane];
+            }
+        }
+#endif
+
+        for(; x < width; ++x)
+        {
+            atrousPixel(in, x, y, stepSize, out);
+        }
+    }
+
+    if(writeHistory)
+    {
+        m_historyColor = *out;
+    }
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void Denoiser::atrousPixel(const Image4f& in,
+                           uint32_t       x,
+                           uint32_t       y,
+                           int            stepSize,
+                           Image4f*       out) const
+{
+    const size_t p = size_t(y) * m_width + x;
+    const float  z = m_planes.depth[p];
+
+    if(z <= 0.0f)
+    {
+        out->pixels[p] = in.pixels[p];
+        return;
+    }
+
+    const glm::vec3 n(m_planes.nx[p], m_planes.ny[p], m_planes.nz[p]);
+    const float     l       = m_planes.luminance[p];
+    const float     phiL    = m_settings.phiColor * std::sqrt(std::max(m_planes.variance[p], 0.0f))
+                       + kLuminanceEpsilon;
+    const float     phiZ    = m_settings.phiDepth * std::max(z, 1e-4f);
+
+    const float kc   = kKernel[0] * kKernel[0];
+    glm::vec3   sum  = kc * glm::vec3(in.pixels[p]);
+    float       sumV = kc * kc * in.pixels[p].w;
+    float       sumW = kc;
+
+    for(int dy = -2; dy <= 2; ++dy)
+    {
+        for(int dx = -2; dx <= 2; ++dx)
+        {
+            const int qx = int(x) + dx * stepSize;
+            const int qy = int(y) + dy * stepSize;
+            if((dx == 0 && dy == 0) || qx < 0 || qy < 0 || qx >= int(m_width)
+               || qy >= int(m_height))
+            {
+                continue;
+            }
+
+            const size_t q    = size_t(qy) * m_width + qx;
+            const float  qz   = m_planes.depth[q];
+            const float  qdot = glm::dot(n, glm::vec3(m_planes.nx[q], m_planes.ny[q], m_planes.nz[q]));
+            if(qz <= 0.0f || qdot <= 0.0f)
+            {
+                continue;
+            }
+
+            const float dist = float(stepSize) * std::sqrt(float(dx * dx + dy * dy));
+            const float exponent = m_settings.phiNormal * std::log(std::max(qdot, 1e-8f))
+                                   - std::abs(z - qz) / (phiZ * dist)
+                                   - std::abs(l - m_planes.luminance[q]) / phiL;
+
+            const float w = kKernel[std::abs(dx)] * kKernel[std::abs(dy)] * std::exp(exponent);
+
+            sum += w * glm::vec3(in.pixels[q]);
+            sumV += w * w * in.pixels[q].w;
+            sumW += w;
+        }
+    }
+
+    out->pixels[p] = glm::vec4(sum / sumW, sumV / (sumW * sumW));
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+DenoiseReport evaluateDenoiser(Denoiser&          denoiser,
+                               const Image4f&     noisy,
+                               const GBuffer&     gbuffer,
+                               const FrameCamera& camera,
+                               const Image4f&     reference,
+                               Image4f*           output)
+{
+    DenoiseReport report;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    denoiser.denoise(noisy, gbuffer, camera, output);
+    auto end = std::chrono::high_resolution_clock::now();
+
+    report.milliseconds =
+        std::chrono::duration<double, std::chrono::milliseconds::period>(end - start).count();
+    report.rmseInput  = rmse(noisy, reference);
+    report.rmseOutput = rmse(*output, reference);
+    return report;
+}
+
+}  // namespace rtutils
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "Reprojection.h"
+#include "rtutils.h"
+
+namespace rtutils {
+
+// ----------------------------------------------------------------------------
+//  Parameters shared by the compute passes (denoiseTemporal.comp, denoiseAtrous.comp)
+//  and the CPU reference implementation below.
+//
+
+struct DenoiserSettings
+{
+    bool  enabled          = false;
+    int   atrousIterations = 5;
+    float phiColor         = 4.0f;    // Luminance edge stopping, in standard deviations
+    float phiNormal        = 128.0f;  // Exponent of the normal edge stopping term
+    float phiDepth         = 0.05f;   // Relative depth change tolerated per pixel of offset
+    float alpha            = 0.2f;    // Temporal blend factor for illumination
+    float momentsAlpha     = 0.2f;    // Temporal blend factor for luminance moments
+};
+
+// First hit guides written by pathRT.rgen.
+// normalDepth: shading normal facing the camera + distance to the camera, negative on a miss
+// emission: first hit emission averaged over the pixel, kept out of the filter and added back
+struct GBuffer
+{
+    Image4f normalDepth;
+    Image4f albedo;
+    Image4f emission;
+};
+
+// ----------------------------------------------------------------------------
+//  CPU reference of the SVGF style denoiser. Illumination without the first hit emission is
+//  demodulated by the first hit albedo, accumulated temporally with reprojected history and
+//  filtered with an edge-avoiding a-trous wavelet. The wavelet runs on 4 pixels at a time with
+//  SSE when available.
+//
+
+class Denoiser
+{
+    public:
+    Denoiser(uint32_t width, uint32_t height);
+
+    void reset() { m_hasHistory = false; }
+
+    // color holds radiance already divided by the sample count
+    void denoise(const Image4f&     color,
+                 const GBuffer&     gbuffer,
+                 const FrameCamera& camera,
+                 Image4f*           output);
+
+    DenoiserSettings m_settings;
+
+    private:
+    void temporalPass(const Image4f& color, const GBuffer& gbuffer, const FrameCamera& camera);
+    void atrousPass(const Image4f& in, int stepSize, bool writeHistory, Image4f* out);
+    void atrousPixel(const Image4f& in, uint32_t x, uint32_t y, int stepSize, Image4f* out) const;
+
+    uint32_t m_width  = 0;
+    uint32_t m_height = 0;
+    bool     m_hasHistory = false;
+
+    Image4f m_historyColor;     // rgb: filtered illumination of the previous frame
+    Image4f m_historyMoments;   // x: luminance, y: luminance^2, z: history length
+    Image4f m_moments;          // Moments of the current frame
+    Image4f m_prevNormalDepth;  // G-buffer of the previous frame
+    Image4f m_pingPong[2];      // rgb: illumination, w: variance
+
+    // Structure of arrays copy of the guides and the current iteration, used by the
+    // vectorized wavelet
+    struct
+    {
+        std::vector<float> nx, ny, nz, depth;
+        std::vector<float> luminance, variance;
+        std::vector<float> r, g, b;
+    } m_planes;
+};
+
+struct DenoiseReport
+{
+    double rmseInput    = 0.0;
+    double rmseOutput   = 0.0;
+    double milliseconds = 0.0;
+};
+
+// Denoise a single frame and compare both the noisy input and the result against a high
+// sample count reference.
+DenoiseReport evaluateDenoiser(Denoiser&          denoiser,
+                               const Image4f&     noisy,
+                               const GBuffer&     gbuffer,
+                               const FrameCamera& camera,
+                               const Image4f&     reference,
+                               Image4f*           output);
+
+}  // namespace rtutils
@@ -0,0 +1,215 @@
+#include "EnvironmentMap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#include <stb/stb_image.h>
+
+#include "rtutils.h"
+
+namespace rtutils {
+namespace {
+
+const float kPi = 3.14159265358979f;
+
+// Index of the interval of cdf containing u, cdf holds count + 1 increasing values from 0 to 1
+uint32_t findInterval(const float* cdf, uint32_t count, float u)
+{
+    const float* it = std::upper_bound(cdf, cdf + count + 1, u);
+    const long   i  = long(it - cdf) - 1;
+    return uint32_t(std::min(std::max(i, 0l), long(count) - 1));
+}
+
+}  // namespace
+
+glm::vec2 directionToEquirect(const glm::vec3& dir)
+{
+    const float u = 0.5f + std::atan2(dir.z, dir.x) / (2.0f * kPi);
+    const float v = std::acos(glm::clamp(dir.y, -1.0f, 1.0f)) / kPi;
+    return glm::vec2(u, v);
+}
+
+glm::vec3 equirectToDirection(const glm::vec2& uv)
+{
+    const float phi      = (uv.x - 0.5f) * 2.0f * kPi;
+    const float theta    = uv.y * kPi;
+    const float sinTheta = std::sin(theta);
+    return glm::vec3(sinTheta * std::cos(phi), std::cos(theta), sinTheta * std::sin(phi));
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void EnvironmentMap::load(const std::string& path)
+{
+    int    width, height, channels;
+    float* pixels = stbi_loadf(path.c_str(), &width, &height, &channels, STBI_rgb);
+    if(!pixels)
+    {
+        throw std::runtime_error("EnvironmentMap::load: cannot read " + path);
+    }
+
+    std::vector<glm::vec3> texels(size_t(width) * size_t(height));
+    std::memcpy(texels.data(), pixels, texels.size() * sizeof(glm::vec3));
+    stbi_image_free(pixels);
+
+    build(uint32_t(width), uint32_t(height), std::move(texels));
+}
+
+void EnvironmentMap::build(uint32_t width, uint32_t height, std::vector<glm::vec3> texels)
+{
+    if(texels.size() != size_t(width) * size_t(height))
+    {
+        throw std::runtime_error("EnvironmentMap::build: texel count does not match the size");
+    }
+
+    m_width  = width;
+    m_height = height;
+    m_texels = std::move(texels);
+    buildTables();
+}
+
+// ----------------------------------------------------------------------------
+//  Rows are independent, the conditional CDFs are built in parallel and the marginal CDF over
+//  the row sums is a short serial pass. Sums are kept in double, 8K rows are long.
+//
+
+void EnvironmentMap::buildTables()
+{
+    const uint32_t w = m_width;
+    const uint32_t h = m_height;
+
+    m_conditionalCdf.resize(size_t(h) * (w + 1));
+    m_marginalCdf.resize(h + 1);
+    std::vector<double> rowSums(h);
+
+#pragma omp parallel for schedule(dynamic, 16)
+    for(int y = 0; y < int(h); ++y)
+    {
+        const float      sinTheta = std::sin((float(y) + 0.5f) / float(h) * kPi);
+        const glm::vec3* row      = &m_texels[size_t(y) * w];
+        float*           cdf      = &m_conditionalCdf[size_t(y) * (w + 1)];
+
+        double sum = 0.0;
+        cdf[0]     = 0.0f;
+        for(uint32_t x = 0; x < w; ++x)
+        {
+            sum += std::max(luminance(row[x]), 0.0f) * sinTheta;
+            cdf[x + 1] = float(sum);
+        }
+        rowSums[y] = sum;
+
+        // Black rows are never picked, keep their table valid anyway
+        for(uint32_t x = 1; x < w; ++x)
+        {
+            cdf[x] = sum > 0.0 ? float(cdf[x] / sum) : float(x) / float(w);
+        }
+        cdf[w] = 1.0f;
+    }
+
+    double total     = 0.0;
+    m_marginalCdf[0] = 0.0f;
+    for(uint32_t y = 0; y < h; ++y)
+    {
+        total += rowSums[y];
+        m_marginalCdf[y + 1] = float(total);
+    }
+    for(uint32_t y = 1; y < h; ++y)
+    {
+        m_marginalCdf[y] = total > 0.0 ? float(m_marginalCdf[y] / total) : float(y) / float(h);
+    }
+    m_marginalCdf[h] = 1.0f;
+
+    m_integral = float(total);
+}
+
+// ----------------------------------------------------------------------------
+//  Mirrored in pathRT.rgen
+//
+
+float EnvironmentMap::texelPdf(uint32_t x, uint32_t y) const
+{
+    const float* cdf       = &m_conditionalCdf[size_t(y) * (m_width + 1)];
+    const float  pdfRow    = (m_marginalCdf[y + 1] - m_marginalCdf[y]) * float(m_height);
+    const float  pdfColumn = (cdf[x + 1] - cdf[x]) * float(m_width);
+    return pdfRow * pdfColumn;
+}
+
+glm::vec3 EnvironmentMap::eval(const glm::vec3& dir) const
+{
+    const glm::vec2 uv = directionToEquirect(dir);
+    const uint32_t  x  = std::min(uint32_t(std::max(uv.x, 0.0f) * m_width), m_width - 1);
+    const uint32_t  y  = std::min(uint32_t(std::max(uv.y, 0.0f) * m_height), m_height - 1);
+    return m_texels[size_t(y) * m_width + x];
+}
+
+glm::vec3 EnvironmentMap::sample(float u0, float u1, float* pdf) const
+{
+    const uint32_t y   = findInterval(m_marginalCdf.data(), m_height, u0);
+    const float*   cdf = &m_conditionalCdf[size_t(y) * (m_width + 1)];
+    const uint32_t x   = findInterval(cdf, m_width, u1);
+
+    // Continuous position inside the texel
+    const float m0 = m_marginalCdf[y];
+    const float m1 = m_marginalCdf[y + 1];
+    const float dv = m1 > m0 ? (u0 - m0) / (m1 - m0) : 0.5f;
+    const float du = cdf[x + 1] > cdf[x] ? (u1 - cdf[x]) / (cdf[x + 1] - cdf[x]) : 0.5f;
+
+    const glm::vec2 uv((float(x) + du) / float(m_width), (float(y) + dv) / float(m_height));
+    const float     sinTheta = std::sin(uv.y * kPi);
+
+    *pdf = sinTheta > 0.0f ? texelPdf(x, y) / (2.0f * kPi * kPi * sinTheta) : 0.0f;
+    return equirectToDirection(uv);
+}
+
+float EnvironmentMap::pdf(const glm::vec3& dir) const
+{
+    const glm::vec2 uv       = directionToEquirect(dir);
+    const uint32_t  x        = std::min(uint32_t(std::max(uv.x, 0.0f) * m_width), m_width - 1);
+    const uint32_t  y        = std::min(uint32_t(std::max(uv.y, 0.0f) * m_height), m_height - 1);
+    const float     sinTheta = std::sqrt(std::max(0.0f, 1.0f - dir.y * dir.y));
+    return sinTheta > 0.0f ? texelPdf(x, y) / (2.0f * kPi * kPi * sinTheta) : 0.0f;
+}
+
+// ----------------------------------------------------------------------------
+//  Sky gradient with a small bright sun, the tables only depend on the luminance distribution
+//
+
+double benchmarkEnvironmentTables(uint32_t width, uint32_t height, int iterations)
+{
+    using Clock = std::chrono::high_resolution_clock;
+
+    std::vector<glm::vec3> texels(size_t(width) * size_t(height));
+#pragma omp parallel for
+    for(int y = 0; y < int(height); ++y)
+    {
+        for(uint32_t x = 0; x < width; ++x)
+        {
+            const float     v   = (float(y) + 0.5f) / float(height);
+            const float     du  = (float(x) + 0.5f) / float(width) - 0.3f;
+            const float     dv  = v - 0.25f;
+            const glm::vec3 sky = glm::mix(glm::vec3(0.3f, 0.5f, 1.0f), glm::vec3(0.1f), v);
+            const float     sun = du * du + dv * dv < 1e-4f ? 5e4f : 0.0f;
+
+            texels[size_t(y) * width + x] = sky + glm::vec3(sun);
+        }
+    }
+
+    EnvironmentMap map;
+    map.build(width, height, std::move(texels));
+
+    double milliseconds = 0.0;
+    for(int i = 0; i < iterations; ++i)
+    {
+        const auto start = Clock::now();
+        map.buildTables();
+        milliseconds += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+    return milliseconds / std::max(iterations, 1);
+}
+
+}  // namespace rtutils
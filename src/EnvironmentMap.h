@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace rtutils {
+
+// ----------------------------------------------------------------------------
+//  Equirectangular HDR environment with +y up. Row 0 is the zenith and
+//  u = 0.5 + atan(d.z, d.x) / 2pi, the same mapping as pathRT.rgen.
+//
+//  Directions are importance sampled with a marginal CDF over the rows and a conditional CDF
+//  per row, both over luminance * sin(theta). The tables are uploaded as they are for the shader.
+//
+
+glm::vec2 directionToEquirect(const glm::vec3& dir);
+glm::vec3 equirectToDirection(const glm::vec2& uv);
+
+class EnvironmentMap
+{
+    public:
+    // Anything stbi_loadf reads, .hdr in practice. Throws if the file cannot be read.
+    void load(const std::string& path);
+
+    // Takes width * height texels, rows from the top
+    void build(uint32_t width, uint32_t height, std::vector<glm::vec3> texels);
+
+    bool     empty() const { return m_texels.empty(); }
+    bool     canSample() const { return m_integral > 0.0f; }
+    uint32_t width() const { return m_width; }
+    uint32_t height() const { return m_height; }
+    float    integral() const { return m_integral; }
+
+    // Nearest texel towards the normalized direction dir
+    glm::vec3 eval(const glm::vec3& dir) const;
+
+    // Returns a direction, pdf is the solid angle density. Requires canSample().
+    glm::vec3 sample(float u0, float u1, float* pdf) const;
+
+    // Solid angle density of sample() producing dir
+    float pdf(const glm::vec3& dir) const;
+
+    // Rebuilds the sampling tables from the texels, build() and load() call this
+    void buildTables();
+
+    // The marginal CDF has height + 1 entries, the conditional CDF width + 1 per row
+    const std::vector<glm::vec3>& texels() const { return m_texels; }
+    const std::vector<float>&     marginalCdf() const { return m_marginalCdf; }
+    const std::vector<float>&     conditionalCdf() const { return m_conditionalCdf; }
+
+    private:
+    float texelPdf(uint32_t x, uint32_t y) const;
+
+    uint32_t               m_width    = 0;
+    uint32_t               m_height   = 0;
+    float                  m_integral = 0.0f;  // Sum of the sampling weights
+    std::vector<glm::vec3> m_texels;
+    std::vector<float>     m_marginalCdf;
+    std::vector<float>     m_conditionalCdf;
+};
+
+// Builds the sampling tables of a synthetic width x height map iterations times and returns the
+// average time in milliseconds
+double benchmarkEnvironmentTables(uint32_t width, uint32_t height, int iterations);
+
+}  // namespace rtutils
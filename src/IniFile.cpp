@@ -0,0 +1,99 @@
+#include "IniFile.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace rtutils {
+namespace {
+
+std::string trim(const std::string& s)
+{
+    const size_t begin = s.find_first_not_of(" \t\r");
+    const size_t end   = s.find_last_not_of(" \t\r");
+    return begin == std::string::npos ? std::string() : s.substr(begin, end - begin + 1);
+}
+
+bool isAbsolute(const std::string& path)
+{
+    return !path.empty()
+           && (path[0] == '/' || path[0] == '\\' || path.find(':') != std::string::npos);
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+std::vector<IniLine> readIniFile(const std::string& path)
+{
+    std::ifstream file(path);
+    if(!file)
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+    return readIni(file, path);
+}
+
+std::vector<IniLine> readIni(std::istream& stream, const std::string& path)
+{
+    std::vector<IniLine> lines;
+    std::string          section;
+    std::string          text;
+    for(int number = 1; std::getline(stream, text); ++number)
+    {
+        IniLine line;
+        line.number = number;
+
+        text = trim(text.substr(0, text.find('#')));
+        if(text.empty())
+        {
+            continue;
+        }
+
+        if(text.front() == '[')
+        {
+            if(text.back() != ']' || text.size() < 3)
+            {
+                throwIniError(path, line, "expected [section]");
+            }
+            section      = trim(text.substr(1, text.size() - 2));
+            line.section = section;
+            lines.push_back(line);
+            continue;
+        }
+
+        const size_t equals = text.find('=');
+        if(equals == std::string::npos)
+        {
+            throwIniError(path, line, "expected key = value");
+        }
+        line.section = section;
+        line.key     = trim(text.substr(0, equals));
+        line.value   = trim(text.substr(equals + 1));
+        if(line.key.empty())
+        {
+            throwIniError(path, line, "expected key = value");
+        }
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+void throwIniError(const std::string& path, const IniLine& line, const std::string& message)
+{
+    throw std::runtime_error(path + ":" + std::to_string(line.number) + ": " + message);
+}
+
+std::string resolveIniPath(const std::string& iniPath, const std::string& path)
+{
+    if(path.empty() || isAbsolute(path))
+    {
+        return path;
+    }
+    const size_t slash = iniPath.find_last_of("/\\");
+    return (slash == std::string::npos ? std::string(".") : iniPath.substr(0, slash)) + "/"
+           + path;
+}
+
+}  // namespace rtutils
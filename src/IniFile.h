@@ -0,0 +1,58 @@
+#pragma once
+
+#include <istream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace rtutils {
+
+// ----------------------------------------------------------------------------
+//  Reader for the benchmark manifest and scene files. Lines are key = value pairs grouped by
+//  [section] headers, # starts a comment and blank lines are skipped.
+//
+
+struct IniLine
+{
+    std::string section;  // Name of the enclosing [section], empty before the first one
+    std::string key;      // Empty for the [section] header itself
+    std::string value;
+    int         number = 0;
+};
+
+// Throws std::runtime_error naming the file and line on malformed lines
+std::vector<IniLine> readIniFile(const std::string& path);
+
+// Same for text that did not come from a file, path only names it in errors
+std::vector<IniLine> readIni(std::istream& stream, const std::string& path);
+
+// Throws std::runtime_error with "path:line: message"
+[[noreturn]] void throwIniError(const std::string& path, const IniLine& line,
+                                const std::string& message);
+
+// Relative paths are taken relative to the directory of the ini file
+std::string resolveIniPath(const std::string& iniPath, const std::string& path);
+
+// Reads exactly count values of T from value, anything left over is an error. Negative values
+// are errors for unsigned T, streams would wrap them around.
+template <typename T>
+bool parseValues(const std::string& value, T* out, int count)
+{
+    std::istringstream stream(value);
+    for(int i = 0; i < count; ++i)
+    {
+        if(std::is_unsigned<T>::value && (stream >> std::ws).peek() == '-')
+        {
+            return false;
+        }
+        if(!(stream >> out[i]))
+        {
+            return false;
+        }
+    }
+    std::string rest;
+    return !(stream >> rest);
+}
+
+}  // namespace rtutils
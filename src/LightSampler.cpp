@@ -0,0 +1,302 @@
+#include "LightSampler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "rtutils.h"
+
+namespace rtutils {
+
+float lightWeight(const EmissiveTriangle& triangle)
+{
+    return luminance(triangle.emission) * triangle.area();
+}
+
+// ----------------------------------------------------------------------------
+//  Vose's construction, small and large bins are paired until every bin holds 1/n
+//
+
+void AliasTable::build(const std::vector<float>& weights)
+{
+    m_entries.clear();
+    m_totalWeight = 0.0f;
+
+    double sum = 0.0;
+    for(const float w : weights)
+    {
+        sum += std::max(w, 0.0f);
+    }
+    if(sum <= 0.0)
+    {
+        return;
+    }
+
+    const size_t n = weights.size();
+    m_entries.resize(n);
+    m_totalWeight = float(sum);
+
+    std::vector<double>   scaled(n);
+    std::vector<uint32_t> small, large;
+    for(size_t i = 0; i < n; ++i)
+    {
+        const double p     = std::max(weights[i], 0.0f) / sum;
+        m_entries[i].pmf   = float(p);
+        m_entries[i].alias = uint32_t(i);
+        scaled[i]          = p * double(n);
+        (scaled[i] < 1.0 ? small : large).push_back(uint32_t(i));
+    }
+
+    while(!small.empty() && !large.empty())
+    {
+        const uint32_t s = small.back();
+        const uint32_t l = large.back();
+        small.pop_back();
+        large.pop_back();
+
+        m_entries[s].probability = float(scaled[s]);
+        m_entries[s].alias       = l;
+
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+        (scaled[l] < 1.0 ? small : large).push_back(l);
+    }
+
+    // Leftovers are 1 up to rounding
+    for(const uint32_t i : large)
+    {
+        m_entries[i].probability = 1.0f;
+    }
+    for(const uint32_t i : small)
+    {
+        m_entries[i].probability = 1.0f;
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  Mirrored in pathRT.rgen
+//
+
+uint32_t AliasTable::sample(float u, float* pmf) const
+{
+    const float    scaled = u * float(m_entries.size());
+    const uint32_t bin    = std::min(uint32_t(scaled), uint32_t(m_entries.size() - 1));
+    const float    f      = scaled - float(bin);
+
+    const uint32_t index = f < m_entries[bin].probability ? bin : m_entries[bin].alias;
+    *pmf                 = m_entries[index].pmf;
+    return index;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void LightSampler::build(const std::vector<EmissiveTriangle>& triangles)
+{
+    m_triangles = triangles;
+
+    std::vector<float> weights(m_triangles.size());
+    for(size_t i = 0; i < m_triangles.size(); ++i)
+    {
+        weights[i] = lightWeight(m_triangles[i]);
+    }
+    m_aliasTable.build(weights);
+
+    if(m_aliasTable.empty())
+    {
+        m_triangles.clear();
+    }
+}
+
+LightSample LightSampler::sample(float u0, float u1, float u2) const
+{
+    LightSample result;
+
+    float pmf;
+    result.index                = m_aliasTable.sample(u0, &pmf);
+    const EmissiveTriangle& tri = m_triangles[result.index];
+
+    // Uniform on the triangle
+    const float su = std::sqrt(u1);
+    const float b0 = 1.0f - su;
+    const float b1 = u2 * su;
+
+    const glm::vec3 n = glm::cross(tri.p1 - tri.p0, tri.p2 - tri.p0);
+
+    result.position = b0 * tri.p0 + b1 * tri.p1 + (1.0f - b0 - b1) * tri.p2;
+    result.normal   = glm::normalize(n);
+    result.emission = tri.emission;
+    result.pdfArea  = pmf / (0.5f * glm::length(n));
+    return result;
+}
+
+float LightSampler::pdfArea(uint32_t index) const
+{
+    return m_aliasTable.pmf(index) / m_triangles[index].area();
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+namespace {
+
+bool nearlyEqual(double a, double b, double tolerance)
+{
+    return std::abs(a - b) <= tolerance * std::max(1.0, std::max(std::abs(a), std::abs(b)));
+}
+
+}  // namespace
+
+std::vector<std::string> checkLightSampler()
+{
+    std::vector<std::string> problems;
+    Pcg32                    rng(29);
+
+    std::vector<std::vector<float>> weightSets = {
+        {1.0f, 2.0f, 3.0f, 4.0f},
+        {0.0f, 5.0f, 0.0f, 1.0f},
+        {-1.0f, 2.0f, 0.0f, 3.0f, -0.5f},
+        {7.0f},
+        {0.0f, 0.0f, 2.0f},
+        {1e-6f, 1e6f, 1.0f},
+    };
+    std::vector<float> skewed(1000);
+    for(float& w : skewed)
+    {
+        w = rng.uniform() < 0.3f ? 0.0f : std::pow(rng.uniform(), 8.0f) * 100.0f;
+    }
+    weightSets.push_back(skewed);
+
+    for(size_t set = 0; set < weightSets.size(); ++set)
+    {
+        const std::vector<float>& weights = weightSets[set];
+        const auto problem = [&](const std::string& what) {
+            problems.push_back("weights " + std::to_string(set) + ": " + what);
+        };
+
+        AliasTable table;
+        table.build(weights);
+        if(table.size() != weights.size())
+        {
+            problem("table has " + std::to_string(table.size()) + " entries");
+            continue;
+        }
+
+        double sum = 0.0;
+        for(const float w : weights)
+        {
+            sum += std::max(w, 0.0f);
+        }
+
+        // Probability of every index from the bins: kept with probability, else the alias
+        const size_t        n = table.size();
+        std::vector<double> selected(n, 0.0);
+        for(size_t bin = 0; bin < n; ++bin)
+        {
+            const AliasTable::Entry& entry = table.entries()[bin];
+            selected[bin] += std::min(std::max(entry.probability, 0.0f), 1.0f) / double(n);
+            selected[entry.alias] += (1.0 - std::min(std::max(entry.probability, 0.0f), 1.0f))
+                                     / double(n);
+        }
+        for(size_t i = 0; i < n; ++i)
+        {
+            const double expected = std::max(weights[i], 0.0f) / sum;
+            if(!nearlyEqual(table.pmf(uint32_t(i)), expected, 1e-5)
+               || !nearlyEqual(selected[i], expected, 1e-5))
+            {
+                problem("index " + std::to_string(i) + " has pmf " + std::to_string(table.pmf(i))
+                        + " and is selected with " + std::to_string(selected[i]) + ", expected "
+                        + std::to_string(expected));
+            }
+        }
+
+        // Stratified sampling never returns a zero weight and reports the pmf of what it returns
+        for(uint32_t k = 0; k < 64 * n; ++k)
+        {
+            float          pmf   = -1.0f;
+            const uint32_t index = table.sample((k + 0.5f) / float(64 * n), &pmf);
+            if(index >= n || pmf != table.pmf(index) || pmf <= 0.0f)
+            {
+                problem("sample " + std::to_string(k) + " returned index " + std::to_string(index)
+                        + " with pmf " + std::to_string(pmf));
+                break;
+            }
+        }
+    }
+
+    for(const std::vector<float>& weights :
+        {std::vector<float>(), std::vector<float>(3, 0.0f), std::vector<float>{-1.0f, 0.0f}})
+    {
+        AliasTable table;
+        table.build(weights);
+        if(!table.empty())
+        {
+            problems.push_back("weights without a positive one give a table of "
+                               + std::to_string(table.size()));
+        }
+    }
+
+    // Random triangles, some of them dark, sampled uniformly. Every sample lies on its light and
+    // the mean of 1 / pdfArea estimates the area of the lights that can be picked.
+    std::vector<EmissiveTriangle> triangles(50);
+    double                        litArea = 0.0;
+    for(EmissiveTriangle& t : triangles)
+    {
+        t.p0       = glm::vec3(rng.uniform(), rng.uniform(), rng.uniform()) * 10.0f;
+        t.p1       = t.p0 + glm::vec3(rng.uniform(), rng.uniform(), rng.uniform());
+        t.p2       = t.p0 + glm::vec3(rng.uniform(), rng.uniform(), rng.uniform());
+        t.emission = rng.uniform() < 0.2f ? glm::vec3(0.0f)
+                                          : glm::vec3(rng.uniform(), rng.uniform(), 1.0f) * 10.0f;
+        litArea += lightWeight(t) > 0.0f ? t.area() : 0.0f;
+    }
+
+    LightSampler sampler;
+    sampler.build(triangles);
+    const uint32_t samples    = 100000;
+    double         inverseSum = 0.0;
+    uint32_t       badPdfs    = 0;
+    uint32_t       offLight   = 0;
+    for(uint32_t k = 0; k < samples; ++k)
+    {
+        const LightSample sample = sampler.sample(rng.uniform(), rng.uniform(), rng.uniform());
+        const EmissiveTriangle& t    = sampler.triangles()[sample.index];
+        const float             area = t.area();
+        if(!(sample.pdfArea > 0.0f)
+           || !nearlyEqual(sample.pdfArea, sampler.pdfArea(sample.index), 1e-4))
+        {
+            ++badPdfs;
+            continue;
+        }
+        inverseSum += 1.0 / sample.pdfArea;
+
+        // Sub-triangles with the sample as corner add up to the whole one
+        const glm::vec3 a     = t.p0 - sample.position;
+        const glm::vec3 b     = t.p1 - sample.position;
+        const glm::vec3 c     = t.p2 - sample.position;
+        const float     split = 0.5f
+                            * (glm::length(glm::cross(a, b)) + glm::length(glm::cross(b, c))
+                               + glm::length(glm::cross(c, a)));
+        if(!nearlyEqual(split, area, 1e-3) || !nearlyEqual(glm::length(sample.normal), 1.0, 1e-4))
+        {
+            ++offLight;
+        }
+    }
+    if(badPdfs > 0)
+    {
+        problems.push_back(std::to_string(badPdfs) + " light samples with a pdfArea other than "
+                           "pdfArea() of their light");
+    }
+    if(offLight > 0)
+    {
+        problems.push_back(std::to_string(offLight) + " light samples off their triangle");
+    }
+    const double estimate = inverseSum / samples;
+    if(!nearlyEqual(estimate, litArea, 0.02))
+    {
+        problems.push_back("light area estimated at " + std::to_string(estimate) + ", "
+                           + std::to_string(litArea) + " expected");
+    }
+    return problems;
+}
+
+}  // namespace rtutils
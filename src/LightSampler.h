@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace rtutils {
+
+// Triangle with a non-zero emission, extracted from the scene when it is loaded
+struct EmissiveTriangle
+{
+    glm::vec3 p0, p1, p2;
+    glm::vec3 emission;
+    uint32_t  primitiveID = 0;  // Triangle index in the model's index buffer
+
+    float area() const { return 0.5f * glm::length(glm::cross(p1 - p0, p2 - p0)); }
+};
+
+// Selection weight of a light, proportional to the emitted power. pathRT.rgen recomputes it for
+// emissive hits from the material and the triangle, keep the two in sync.
+float lightWeight(const EmissiveTriangle& triangle);
+
+// ----------------------------------------------------------------------------
+//  Walker's alias method, O(1) sampling from a discrete distribution. The entry layout is the
+//  one uploaded for pathRT.rgen.
+//
+
+class AliasTable
+{
+    public:
+    struct Entry
+    {
+        float    probability = 1.0f;  // Probability of keeping this bin instead of the alias
+        uint32_t alias       = 0;
+        float    pmf         = 0.0f;  // Probability of selecting this bin overall
+        uint32_t pad         = 0;
+    };
+
+    // Weights need not be normalized, all zero weights give an empty table
+    void build(const std::vector<float>& weights);
+
+    // u in [0, 1), returns the selected index
+    uint32_t sample(float u, float* pmf) const;
+
+    float  pmf(uint32_t index) const { return m_entries[index].pmf; }
+    float  totalWeight() const { return m_totalWeight; }
+    size_t size() const { return m_entries.size(); }
+    bool   empty() const { return m_entries.empty(); }
+
+    const std::vector<Entry>& entries() const { return m_entries; }
+
+    private:
+    std::vector<Entry> m_entries;
+    float              m_totalWeight = 0.0f;
+};
+
+// ----------------------------------------------------------------------------
+//  Samples points on emissive triangles, lights picked proportionally to their power
+//
+
+struct LightSample
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec3 emission;
+    float     pdfArea = 0.0f;  // Includes the probability of picking the light
+    uint32_t  index   = 0;
+};
+
+class LightSampler
+{
+    public:
+    void build(const std::vector<EmissiveTriangle>& triangles);
+
+    bool empty() const { return m_triangles.empty(); }
+
+    // Three uniform numbers in [0, 1): light selection and position on the triangle
+    LightSample sample(float u0, float u1, float u2) const;
+
+    // Area density of sample() producing a point on light index
+    float pdfArea(uint32_t index) const;
+
+    const std::vector<EmissiveTriangle>& triangles() const { return m_triangles; }
+    const AliasTable&                    aliasTable() const { return m_aliasTable; }
+
+    private:
+    std::vector<EmissiveTriangle> m_triangles;
+    AliasTable                    m_aliasTable;
+};
+
+// Builds alias tables from weights with zeros, negative values and a single entry and light
+// samplers from random triangles, returns what went wrong: selection probabilities that differ
+// from the normalized weights, sample() returning a pdfArea other than pdfArea() or a point off
+// its light
+std::vector<std::string> checkLightSampler();
+
+}  // namespace rtutils
@@ -5,70 +5,49 @@
 #include <unordered_map>
 
 #include <stb/stb_image.h>
-#include <tinyobjloader/tiny_obj_loader.h>
 
+#include "ObjLoader.h"
 #include "vkContext.h"
+#include "vkTextureRegistry.h"
 
 using namespace VkTools;
 
 
+// Images and the sampler belong to the texture registry of the context
 void VkTools::Model::cleanUp()
 {
-    if(vertexBuffer != VK_NULL_HANDLE)
-    {
-        vmaDestroyBuffer(vkctx->getAllocator(), vertexBuffer, vertexMemory);
-    }
-    if(indexBuffer != VK_NULL_HANDLE)
-    {
-        vmaDestroyBuffer(vkctx->getAllocator(), indexBuffer, indexMemory);
-    }
-    if(materialBuffer != VK_NULL_HANDLE)
-    {
-        vmaDestroyBuffer(vkctx->getAllocator(), materialBuffer, materialMemory);
-    }
-
-    for(auto& t : m_textures)
-    {
-        if(t.view != VK_NULL_HANDLE)
-        {
-            vkDestroyImageView(vkctx->getDevice(), t.view, nullptr);
-        }
-        if(t.image != VK_NULL_HANDLE)
-        {
-            vmaDestroyImage(vkctx->getAllocator(), t.image, t.memory);
-        }
-        if(t.sampler != VK_NULL_HANDLE)
-        {
-            vkDestroySampler(vkctx->getDevice(), t.sampler, nullptr);
-        }
-    }
+    m_textures.clear();
+    m_placeholder = Texture();
 }
 
 void VkTools::Model::LoadModelFromFile(const std::string& filepath)
 {
-    tinyobj::attrib_t                attrib;
-    std::vector<tinyobj::shape_t>    shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string                      warn, err;
-
-    if(!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str(),
-                         directory.c_str()))
+    ObjMesh mesh = loadObj(filepath, directory, m_transform);
+    if(!mesh.warnings.empty())
     {
-        throw std::runtime_error(warn + err);
+        std::cout << mesh.warnings << "\n";
     }
-    std::cout << warn << "\n";  // TODO: remove this later
 
-    numVertices = 0;
-    numIndices  = 0;
-    for(const auto& shape : shapes)
-    {
-        numVertices += shape.mesh.indices.size();
-        numIndices += shape.mesh.indices.size();
-    }
-    m_vertices.reserve(numVertices);
-    m_indices.reserve(numIndices);
+    numVertices = mesh.vertices.size();
+    numIndices  = mesh.indices.size();
+
+    // Slot of every texture name, materials sharing a file share its slot
+    std::unordered_map<std::string, int> textureSlots;
+    const auto textureSlot = [this, &textureSlots](std::string name) {
+        if(name.empty())
+        {
+            return -1;
+        }
+        std::replace(name.begin(), name.end(), '\\', '/');
+        const auto slot = textureSlots.emplace(name, static_cast<int>(m_texturePaths.size()));
+        if(slot.second)
+        {
+            m_texturePaths.push_back(name);
+        }
+        return slot.first->second;
+    };
 
-    for(const auto& mat : materials)
+    for(const auto& mat : mesh.materials)
     {
         Material m;
         m.ambient  = glm::vec3(mat.ambient[0], mat.ambient[1], mat.ambient[2]);
@@ -90,62 +69,9 @@ void VkTools::Model::LoadModelFromFile(const std::string& filepath)
         }
 
 
-        {   // Diffuse
-            bool skip = false;
-            for(size_t i = 0; i < m_texturePaths.size(); ++i)
-            {
-                if(std::strcmp(m_texturePaths[i].c_str(), mat.diffuse_texname.c_str()) == 0)
-                {
-                    m.diffuseTextureID = i;
-                    skip               = true;
-                    break;
-                }
-            }
-            if(!skip && !mat.diffuse_texname.empty())
-            {
-                auto ret = replaceSubString(mat.diffuse_texname, "\\\\", "/");
-                m_texturePaths.push_back(ret);
-                m.diffuseTextureID = static_cast<uint32_t>(m_texturePaths.size() - 1);
-            }
-        }
-
-        {   // Specular
-            bool skip = false;
-            for(size_t i = 0; i < m_texturePaths.size(); ++i)
-            {
-                if(std::strcmp(m_texturePaths[i].c_str(), mat.specular_texname.c_str()) == 0)
-                {
-                    m.specularTextureID = i;
-                    skip               = true;
-                    break;
-                }
-            }
-            if(!skip && !mat.specular_texname.empty())
-            {
-                auto ret = replaceSubString(mat.specular_texname, "\\\\", "/");
-                m_texturePaths.push_back(ret);
-                m.specularTextureID = static_cast<uint32_t>(m_texturePaths.size() - 1);
-            }
-        }
-
-        {   // Normal map
-            bool skip = false;
-            for(size_t i = 0; i < m_texturePaths.size(); ++i)
-            {
-                if(std::strcmp(m_texturePaths[i].c_str(), mat.bump_texname.c_str()) == 0)
-                {
-                    m.normalTextureID = i;
-                    skip               = true;
-                    break;
-                }
-            }
-            if(!skip && !mat.bump_texname.empty())
-            {
-                auto ret = replaceSubString(mat.bump_texname, "\\\\", "/");
-                m_texturePaths.push_back(ret);
-                m.normalTextureID = static_cast<uint32_t>(m_texturePaths.size() - 1);
-            }
-        }
+        m.diffuseTextureID  = textureSlot(mat.diffuse_texname);
+        m.specularTextureID = textureSlot(mat.specular_texname);
+        m.normalTextureID   = textureSlot(mat.bump_texname);
 
         m_materials.emplace_back(m);
     }
@@ -156,232 +82,124 @@ void VkTools::Model::LoadModelFromFile(const std::string& filepath)
     }
 
 
-    for(const auto& shape : shapes)
-    {
-        uint32_t faceID     = 0;
-        int      indexCount = 0;
-
-        for(const auto& index : shape.mesh.indices)
-        {
-            VertexPNTC vertex = {};
-
-            float* vpos = &attrib.vertices[3 * index.vertex_index];
-            vertex.p    = glm::vec3(*(vpos + 0), *(vpos + 1), *(vpos + 2));
-
-            if(!attrib.normals.empty() && index.normal_index >= 0)
-            {
-                float* vn = &attrib.normals[3 * index.normal_index];
-                vertex.n  = glm::vec3(*(vn + 0), *(vn + 1), *(vn + 2));
-            }
-
-            if(!attrib.texcoords.empty() && index.texcoord_index >= 0)
-            {
-                float* vt = &attrib.texcoords[2 * index.texcoord_index];
-                vertex.t  = glm::vec2(*(vt + 0), -(*(vt + 1)));
-            }
-
-            if(!attrib.colors.empty())
-            {
-                float* vc = &attrib.colors[3 * index.vertex_index];
-                vertex.c  = glm::vec3(*(vc + 0), *(vc + 1), *(vc + 2));
-            }
-
-            vertex.materialID = shape.mesh.material_ids[faceID];
-            if(vertex.materialID < 0 || vertex.materialID >= m_materials.size())
-            {
-                vertex.materialID = 0;
-            }
+    // loadObj already clamped the material ids to m_materials
+    m_vertices = std::move(mesh.vertices);
+    m_indices  = std::move(mesh.indices);
 
-            indexCount++;
-            if(indexCount >= 3)
-            {
-                faceID++;
-                indexCount = 0;
-            }
-
-            m_vertices.push_back(vertex);
-            m_indices.push_back(static_cast<uint32_t>(m_indices.size()));
-        }
+    std::vector<glm::vec3> positions(m_vertices.size());
+    for(size_t i = 0; i < m_vertices.size(); ++i)
+    {
+        positions[i] = m_vertices[i].p;
     }
+    m_clusters = rtutils::buildClusters(positions, m_indices, mesh.shapeEnds);
 
-    if(attrib.normals.empty())
+    // Emissive triangles become lights, the shader uses the material of the second vertex
+    m_emissiveTriangles.clear();
+    for(size_t i = 0; i < m_indices.size(); i += 3)
     {
-        for(size_t i = 0; i < m_indices.size(); i += 3)
+        const Material& mat = m_materials[m_vertices[m_indices[i + 1]].materialID];
+        if(mat.emission == glm::vec3(0.0f))
         {
-            VertexPNTC& v0 = m_vertices[m_indices[i + 0]];
-            VertexPNTC& v1 = m_vertices[m_indices[i + 1]];
-            VertexPNTC& v2 = m_vertices[m_indices[i + 2]];
+            continue;
+        }
 
-            glm::vec3 normal = glm::normalize(glm::cross(v1.p - v0.p, v2.p - v0.p));
-            v0.n             = normal;
-            v1.n             = normal;
-            v2.n             = normal;
+        rtutils::EmissiveTriangle triangle;
+        triangle.p0          = m_vertices[m_indices[i + 0]].p;
+        triangle.p1          = m_vertices[m_indices[i + 1]].p;
+        triangle.p2          = m_vertices[m_indices[i + 2]].p;
+        triangle.emission    = mat.emission;
+        triangle.primitiveID = static_cast<uint32_t>(i / 3);
+        if(triangle.area() > 0.0f)
+        {
+            m_emissiveTriangles.push_back(triangle);
         }
     }
 }
 
-void VkTools::Model::createBuffers()
-{
-    VkBuffer      vStagingBuffer;
-    VmaAllocation vStagingBufferMemory;
-    VkBuffer      iStagingBuffer;
-    VmaAllocation iStagingBufferMemory;
-    VkBuffer      mStagingBuffer;
-    VmaAllocation mStagingBufferMemory;
-
-
-    // Vertices
-    VkDeviceSize vertexBufferSizeInBytes = sizeof(m_vertices[0]) * m_vertices.size();
-    VkTools::createBuffer(vkctx->getAllocator(), vertexBufferSizeInBytes,
-                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY,
-                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                              | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                          &vStagingBuffer, &vStagingBufferMemory);
-
-    void* data;
-    vmaMapMemory(vkctx->getAllocator(), vStagingBufferMemory, &data);
-    memcpy(data, m_vertices.data(), vertexBufferSizeInBytes);
-    vmaUnmapMemory(vkctx->getAllocator(), vStagingBufferMemory);
-
-    VkTools::createBuffer(vkctx->getAllocator(), vertexBufferSizeInBytes,
-                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
-                              | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                          VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                          &vertexBuffer, &vertexMemory);
-
-
-    // Indices
-    VkDeviceSize indexBufferSizeInBytes = sizeof(m_indices[0]) * m_indices.size();
-    VkTools::createBuffer(vkctx->getAllocator(), indexBufferSizeInBytes,
-                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY,
-                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                              | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                          &iStagingBuffer, &iStagingBufferMemory);
-
-    vmaMapMemory(vkctx->getAllocator(), iStagingBufferMemory, &data);
-    memcpy(data, m_indices.data(), indexBufferSizeInBytes);
-    vmaUnmapMemory(vkctx->getAllocator(), iStagingBufferMemory);
-
-    VkTools::createBuffer(vkctx->getAllocator(), indexBufferSizeInBytes,
-                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
-                              | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-                          VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                          &indexBuffer, &indexMemory);
-
-    // Materials
-    VkDeviceSize materialBufferSizeInBytes = sizeof(Material) * m_materials.size();
-    VkTools::createBuffer(vkctx->getAllocator(), materialBufferSizeInBytes,
-                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY,
-                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                              | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                          &mStagingBuffer, &mStagingBufferMemory);
-
-    vmaMapMemory(vkctx->getAllocator(), mStagingBufferMemory, &data);
-    memcpy(data, m_materials.data(), materialBufferSizeInBytes);
-    vmaUnmapMemory(vkctx->getAllocator(), mStagingBufferMemory);
-
-    VkTools::createBuffer(vkctx->getAllocator(), materialBufferSizeInBytes,
-                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                          VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                          &materialBuffer, &materialMemory);
-
-
-    VkCommandBuffer commandBuffer =
-        VkTools::beginRecordingCommandBuffer(vkctx->getDevice(), vkctx->getCommandPool());
-
-    VkBufferCopy copyRegion = {};
-
-    copyRegion.size = vertexBufferSizeInBytes;
-    vkCmdCopyBuffer(commandBuffer, vStagingBuffer, vertexBuffer, 1, &copyRegion);
-
-    copyRegion.size = indexBufferSizeInBytes;
-    vkCmdCopyBuffer(commandBuffer, iStagingBuffer, indexBuffer, 1, &copyRegion);
-
-    copyRegion.size = materialBufferSizeInBytes;
-    vkCmdCopyBuffer(commandBuffer, mStagingBuffer, materialBuffer, 1, &copyRegion);
-
-    VkTools::flushCommandBuffer(vkctx->getDevice(), vkctx->getQueue(), vkctx->getCommandPool(),
-                                commandBuffer);
-
-    vmaDestroyBuffer(vkctx->getAllocator(), vStagingBuffer, vStagingBufferMemory);
-    vmaDestroyBuffer(vkctx->getAllocator(), iStagingBuffer, iStagingBufferMemory);
-    vmaDestroyBuffer(vkctx->getAllocator(), mStagingBuffer, mStagingBufferMemory);
-}
+// ----------------------------------------------------------------------------
+//  Files already loaded by any model are taken from the registry without decoding them again,
+//  decoded ones identical to a registered texture without uploading them
+//
 
 void VkTools::Model::createTextures()
 {
     if(m_texturePaths.empty())
     {
-        int          width = 1, height = 1;
-        glm::u8vec4* color  = new glm::u8vec4(255, 255, 255, 255);
-        stbi_uc*     pixels = reinterpret_cast<stbi_uc*>(color);
-
-        VkImage       textureImage;
-        VmaAllocation textureMemory;
-
-        VkTools::createTextureImage(vkctx->getDevice(), vkctx->getAllocator(), vkctx->getQueue(),
-                                    vkctx->getCommandPool(), pixels, width, height, &textureImage,
-                                    &textureMemory);
-
-        VkImageView view =
-            VkTools::createImageView(vkctx->getDevice(), textureImage, VK_FORMAT_R8G8B8A8_UNORM,
-                                     VK_IMAGE_ASPECT_COLOR_BIT);
-
-        VkSampler sampler;
-        VkTools::createTextureSampler(vkctx->getDevice(), &sampler);
-
-        Texture tex = {};
-        tex.width   = width;
-        tex.height  = height;
-        tex.image   = textureImage;
-        tex.memory  = textureMemory;
-        tex.view    = view;
-        tex.sampler = sampler;
-
-        m_textures.push_back(tex);
+        createPlaceholderTextures();
         return;
     }
 
+    TextureRegistry* registry = vkctx->getTextureRegistry();
     for(const std::string& texture : m_texturePaths)
     {
-        std::string filename = directory + '/' + texture;
-
-        int      width, height, channels;
-        stbi_uc* pixels = stbi_load(filename.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+        const std::string key = TextureRegistry::pathKey(directory + '/' + texture);
 
-        if(!pixels)
+        Texture tex = {};
+        if(!registry->findPath(key, &tex))
         {
-            width              = 1;
-            height             = 1;
-            channels           = 4;
-            glm::u8vec4* color = new glm::u8vec4(255, 255, 255, 255);
-            pixels             = reinterpret_cast<stbi_uc*>(color);
-        }
+            int      width, height, channels;
+            stbi_uc* pixels = stbi_load(key.c_str(), &width, &height, &channels, STBI_rgb_alpha);
 
-        VkImage       textureImage;
-        VmaAllocation textureMemory;
-
-        VkTools::createTextureImage(vkctx->getDevice(), vkctx->getAllocator(), vkctx->getQueue(),
-                                    vkctx->getCommandPool(), pixels, width, height, &textureImage,
-                                    &textureMemory);
-
-        VkImageView view =
-            VkTools::createImageView(vkctx->getDevice(), textureImage, VK_FORMAT_R8G8B8A8_UNORM,
-                                     VK_IMAGE_ASPECT_COLOR_BIT);
+            // Missing images are white
+            const uint8_t  white[4] = {255, 255, 255, 255};
+            const uint8_t* data     = pixels ? pixels : white;
+            if(!pixels)
+            {
+                width  = 1;
+                height = 1;
+            }
 
-        VkSampler sampler;
-        VkTools::createTextureSampler(vkctx->getDevice(), &sampler);
+            const uint64_t hash = TextureRegistry::contentHash(width, height, data);
+            if(!registry->findContent(key, hash, &tex))
+            {
+                tex.width  = width;
+                tex.height = height;
+                VkTools::createTextureImage(vkctx->getAllocator(), vkctx->getStagingArena(), data,
+                                            width, height, &tex.image, &tex.memory);
+                tex.view    = VkTools::createImageView(vkctx->getDevice(), tex.image,
+                                                    VK_FORMAT_R8G8B8A8_UNORM,
+                                                    VK_IMAGE_ASPECT_COLOR_BIT);
+                tex.sampler = registry->getSampler();
+                registry->add(key, hash, tex);
+            }
+            stbi_image_free(pixels);
+        }
+        tex.path = texture;
+        m_textures.push_back(tex);
+    }
+    vkctx->getStagingArena()->submit();
+}
 
-        Texture tex = {};
-        tex.width   = width;
-        tex.height  = height;
-        tex.image   = textureImage;
-        tex.memory  = textureMemory;
-        tex.view    = view;
-        tex.sampler = sampler;
-        tex.path    = texture;
+void VkTools::Model::createPlaceholderTextures()
+{
+    // Every model shares one white texel
+    TextureRegistry* registry = vkctx->getTextureRegistry();
+    const uint8_t    white[4] = {255, 255, 255, 255};
+    const uint64_t   hash     = TextureRegistry::contentHash(1, 1, white);
+    if(!registry->findContent(std::string(), hash, &m_placeholder))
+    {
+        VkTools::createTextureImage(vkctx->getAllocator(), vkctx->getStagingArena(), white, 1, 1,
+                                    &m_placeholder.image, &m_placeholder.memory);
+        vkctx->getStagingArena()->submit();
+        m_placeholder.view    = VkTools::createImageView(vkctx->getDevice(), m_placeholder.image,
+                                                      VK_FORMAT_R8G8B8A8_UNORM,
+                                                      VK_IMAGE_ASPECT_COLOR_BIT);
+        m_placeholder.sampler = registry->getSampler();
+        m_placeholder.width   = 1;
+        m_placeholder.height  = 1;
+        registry->add(std::string(), hash, m_placeholder);
+    }
 
-        m_textures.push_back(tex);
-        stbi_image_free(pixels);
+    // Same slot count as createTextures, a model without textures still binds one
+    const size_t count = std::max<size_t>(m_texturePaths.size(), 1);
+    for(size_t i = 0; i < count; ++i)
+    {
+        Texture slot = {};
+        slot.view    = m_placeholder.view;
+        slot.sampler = m_placeholder.sampler;
+        slot.width   = 1;
+        slot.height  = 1;
+        slot.path    = i < m_texturePaths.size() ? m_texturePaths[i] : std::string();
+        m_textures.push_back(slot);
     }
 }
@@ -18,6 +18,8 @@
 #include <vulkan/vulkan.h>
 
 
+#include "Clusters.h"
+#include "LightSampler.h"
 #include "vkTools.h"
 
 class vkContext;
@@ -129,39 +131,53 @@ struct Texture
 
 struct Model
 {
-    Model(const vkContext* ctx, const std::string& path)
-        : vkctx(ctx)
+    // transform is baked into the vertices and emissive triangles
+    Model(const vkContext*   ctx,
+          const std::string& path,
+          const glm::mat4&   transform = glm::mat4(1.0f))
+        : m_transform(transform)
+        , vkctx(ctx)
     {
         directory = path.substr(0, path.find_last_of('/'));
         LoadModelFromFile(path);
-        createBuffers();
         createTextures();
     }
 
+    // Geometry and materials only, for the CPU path tracer. No buffers or textures are created.
+    explicit Model(const std::string& path, const glm::mat4& transform = glm::mat4(1.0f))
+        : m_transform(transform)
+        , vkctx(nullptr)
+    {
+        directory = path.substr(0, path.find_last_of('/'));
+        LoadModelFromFile(path);
+    }
+
     void cleanUp();
     void LoadModelFromFile(const std::string& filepath);
-    void createBuffers();
     void createTextures();
 
-    std::string directory;
-
-    std::vector<VertexPNTC>  m_vertices;
-    std::vector<uint32_t>    m_indices;
-    std::vector<Material>    m_materials;
-    std::vector<std::string> m_texturePaths;
-    std::vector<std::string> m_loadedTextures;
-    size_t                   numVertices = 0;
-    size_t                   numIndices  = 0;
+    // One slot per texture path, all showing a shared white texel until AssetStreamer swaps the
+    // decoded images in
+    void createPlaceholderTextures();
 
+    std::string directory;
+    glm::mat4   m_transform;
+
+    std::vector<VertexPNTC>                m_vertices;
+    std::vector<uint32_t>                  m_indices;
+    std::vector<Material>                  m_materials;
+    std::vector<std::string>               m_texturePaths;
+    std::vector<std::string>               m_loadedTextures;
+    std::vector<rtutils::EmissiveTriangle> m_emissiveTriangles;  // Light list for pathRT.rgen
+    std::vector<rtutils::Cluster>          m_clusters;           // Culled by the raster preview
+    size_t                                 numVertices = 0;
+    size_t                                 numIndices  = 0;
+
+    // Vertices, indices and materials go to the GPU through SceneGeometry
     const vkContext* vkctx;
-    VkBuffer         vertexBuffer   = VK_NULL_HANDLE;
-    VmaAllocation    vertexMemory   = VK_NULL_HANDLE;
-    VkBuffer         indexBuffer    = VK_NULL_HANDLE;
-    VmaAllocation    indexMemory    = VK_NULL_HANDLE;
-    VkBuffer         materialBuffer = VK_NULL_HANDLE;
-    VmaAllocation    materialMemory = VK_NULL_HANDLE;
 
     std::vector<Texture> m_textures;
+    Texture              m_placeholder;  // Slots without an image of their own view this one
 };
 
 
@@ -0,0 +1,812 @@
+#include "ObjLoader.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include <glm/gtc/matrix_inverse.hpp>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VkTools {
+namespace {
+
+// ----------------------------------------------------------------------------
+//  Read only view of a whole file
+//
+
+class MappedFile
+{
+    public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return m_data; }
+    size_t      size() const { return m_size; }
+
+    private:
+    const char* m_data = nullptr;
+    size_t      m_size = 0;
+#ifdef _WIN32
+    HANDLE m_file    = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#endif
+};
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path)
+{
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size;
+    if(m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size))
+    {
+        if(m_file != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_file);
+        }
+        throw std::runtime_error("Could not open " + path);
+    }
+    m_size = size_t(size.QuadPart);
+    if(m_size == 0)
+    {
+        return;
+    }
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(m_mapping != nullptr)
+    {
+        m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if(m_data == nullptr)
+    {
+        // The destructor does not run for a throwing constructor
+        if(m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+        }
+        CloseHandle(m_file);
+        throw std::runtime_error("Could not map " + path);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if(m_data != nullptr)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if(m_mapping != nullptr)
+    {
+        CloseHandle(m_mapping);
+    }
+    if(m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+    }
+}
+#else
+MappedFile::MappedFile(const std::string& path)
+{
+    const int file = open(path.c_str(), O_RDONLY);
+    struct stat status;
+    if(file < 0 || fstat(file, &status) != 0)
+    {
+        if(file >= 0)
+        {
+            close(file);
+        }
+        throw std::runtime_error("Could not open " + path);
+    }
+    m_size = size_t(status.st_size);
+    if(m_size == 0)
+    {
+        close(file);
+        return;
+    }
+
+    // The mapping keeps the file referenced after closing it
+    void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if(data == MAP_FAILED)
+    {
+        throw std::runtime_error("Could not map " + path);
+    }
+    madvise(data, m_size, MADV_SEQUENTIAL);
+    m_data = static_cast<const char*>(data);
+}
+
+MappedFile::~MappedFile()
+{
+    if(m_data != nullptr)
+    {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+#endif
+
+// ----------------------------------------------------------------------------
+//  Parsing of one chunk. Attribute indices are kept as written until the chunks before are known:
+//  positive ones are already global, negative ones count back from the attributes of this chunk
+//  and get the attribute count of the chunks before added later.
+//
+
+constexpr int32_t kMissing = INT_MIN;
+
+enum RelativeBits : uint8_t
+{
+    kRelativeV  = 1,
+    kRelativeVt = 2,
+    kRelativeVn = 4,
+};
+
+struct Corner
+{
+    int32_t v        = kMissing;
+    int32_t vt       = kMissing;
+    int32_t vn       = kMissing;
+    uint8_t relative = 0;
+};
+
+struct Chunk
+{
+    const char* begin = nullptr;
+    const char* end   = nullptr;
+
+    std::vector<float>  positions;  // xyz
+    std::vector<float>  colors;     // rgb for every position, empty without any v x y z r g b
+    std::vector<float>  normals;
+    std::vector<float>  texcoords;
+    std::vector<Corner> corners;    // Three per triangle
+    std::vector<int>    materials;  // Per triangle into materialNames, -1 before the first usemtl
+
+    std::vector<std::string>             materialNames;
+    std::unordered_map<std::string, int> materialSlots;
+    int                                  lastMaterial = -1;
+
+    std::vector<uint32_t>    shapeBreaks;  // Triangles before every o and g line
+    std::vector<std::string> mtllibs;      // Rest of the mtllib lines
+
+    uint32_t lines     = 0;
+    uint32_t errorLine = 0;  // Line in the chunk of a zero index, 0 when none
+
+    // Filled by the merge
+    size_t                vBase  = 0;
+    size_t                vtBase = 0;
+    size_t                vnBase = 0;
+    int                   initialMaterial = -1;
+    std::vector<int>      materialIDs;         // Of materialNames
+    size_t                triangleBase   = 0;  // Valid triangles of the chunks before
+    size_t                validTriangles = 0;
+    std::vector<uint32_t> validBreaks;  // Valid triangles before every shape break
+};
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t';
+}
+
+inline const char* skipSpace(const char* p, const char* end)
+{
+    while(p < end && isSpace(*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+// Decimal number with optional fraction and exponent, false when there is none. Exact for the
+// usual 6 to 9 significant digits, longer mantissas lose digits past 19.
+bool parseFloat(const char** cursor, const char* end, float* value)
+{
+    static const double kPowers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                     1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                     1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char* p        = skipSpace(*cursor, end);
+    const bool  negative = p < end && *p == '-';
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int      exponent = 0;
+    int      digits   = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; ++p, ++digits)
+    {
+        if(mantissa < 1000000000000000000ull)
+        {
+            mantissa = mantissa * 10 + uint64_t(*p - '0');
+        }
+        else
+        {
+            ++exponent;
+        }
+    }
+    if(p < end && *p == '.')
+    {
+        for(++p; p < end && *p >= '0' && *p <= '9'; ++p, ++digits)
+        {
+            if(mantissa < 1000000000000000000ull)
+            {
+                mantissa = mantissa * 10 + uint64_t(*p - '0');
+                --exponent;
+            }
+        }
+    }
+    if(digits == 0)
+    {
+        return false;
+    }
+
+    if(p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* q       = p + 1;
+        const bool  minus   = q < end && *q == '-';
+        int         written = 0;
+        if(q < end && (*q == '-' || *q == '+'))
+        {
+            ++q;
+        }
+        if(q < end && *q >= '0' && *q <= '9')
+        {
+            for(; q < end && *q >= '0' && *q <= '9'; ++q)
+            {
+                written = std::min(written * 10 + (*q - '0'), 1000);
+            }
+            exponent += minus ? -written : written;
+            p = q;
+        }
+    }
+
+    double result = double(mantissa);
+    if(exponent < 0 && exponent >= -22)
+    {
+        result /= kPowers[-exponent];
+    }
+    else if(exponent > 0 && exponent <= 22)
+    {
+        result *= kPowers[exponent];
+    }
+    else if(exponent != 0)
+    {
+        result *= std::pow(10.0, double(exponent));
+    }
+
+    *value  = float(negative ? -result : result);
+    *cursor = p;
+    return true;
+}
+
+// Integer like atoi, 0 when there are no digits
+int32_t parseIndex(const char** cursor, const char* end)
+{
+    const char* p        = *cursor;
+    const bool  negative = p < end && *p == '-';
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        ++p;
+    }
+    int64_t value = 0;
+    for(; p < end && *p >= '0' && *p <= '9'; ++p)
+    {
+        value = std::min<int64_t>(value * 10 + (*p - '0'), INT_MAX);
+    }
+    *cursor = p;
+    return int32_t(negative ? -value : value);
+}
+
+// One index of a corner, false for the zero index the specification does not allow
+bool parseCornerIndex(const char** cursor, const char* end, size_t localCount, uint8_t relativeBit,
+                      int32_t* index, uint8_t* relative)
+{
+    const int32_t value = parseIndex(cursor, end);
+    if(value == 0)
+    {
+        return false;
+    }
+    if(value > 0)
+    {
+        *index = value - 1;
+    }
+    else
+    {
+        *index = int32_t(int64_t(localCount) + value);
+        *relative |= relativeBit;
+    }
+
+    // Skip to the next / or whitespace like tinyobjloader
+    const char* p = *cursor;
+    while(p < end && *p != '/' && !isSpace(*p))
+    {
+        ++p;
+    }
+    *cursor = p;
+    return true;
+}
+
+// v, v/vt, v//vn or v/vt/vn
+bool parseCorner(const char** cursor, const char* end, const Chunk& chunk, Corner* corner)
+{
+    *corner = Corner();
+    if(!parseCornerIndex(cursor, end, chunk.positions.size() / 3, kRelativeV, &corner->v,
+                         &corner->relative))
+    {
+        return false;
+    }
+    if(*cursor >= end || **cursor != '/')
+    {
+        return true;
+    }
+    ++*cursor;
+    if(*cursor < end && **cursor != '/')
+    {
+        if(!parseCornerIndex(cursor, end, chunk.texcoords.size() / 2, kRelativeVt, &corner->vt,
+                             &corner->relative))
+        {
+            return false;
+        }
+        if(*cursor >= end || **cursor != '/')
+        {
+            return true;
+        }
+    }
+    ++*cursor;
+    return parseCornerIndex(cursor, end, chunk.normals.size() / 3, kRelativeVn, &corner->vn,
+                            &corner->relative);
+}
+
+// Keyword followed by whitespace
+bool startsWith(const char* p, const char* end, const char* keyword)
+{
+    const size_t length = std::strlen(keyword);
+    return size_t(end - p) > length && std::memcmp(p, keyword, length) == 0
+           && isSpace(p[length]);
+}
+
+void parseChunk(Chunk* chunk)
+{
+    std::vector<Corner> face;
+
+    const char* line = chunk->begin;
+    while(line < chunk->end)
+    {
+        const char* next = static_cast<const char*>(std::memchr(line, '\n', chunk->end - line));
+        const char* end  = next != nullptr ? next : chunk->end;
+        next             = next != nullptr ? next + 1 : chunk->end;
+        ++chunk->lines;
+
+        if(end > line && end[-1] == '\r')
+        {
+            --end;
+        }
+        const char* p = skipSpace(line, end);
+        line          = next;
+        if(p == end)
+        {
+            continue;
+        }
+
+        if(startsWith(p, end, "v"))
+        {
+            p++;
+            float xyz[3] = {0.0f, 0.0f, 0.0f};
+            float rgb[3] = {1.0f, 1.0f, 1.0f};
+            for(float& x : xyz)
+            {
+                parseFloat(&p, end, &x);
+            }
+            const bool colored = parseFloat(&p, end, &rgb[0]) && parseFloat(&p, end, &rgb[1])
+                                 && parseFloat(&p, end, &rgb[2]);
+            if(colored && chunk->colors.empty())
+            {
+                chunk->colors.assign(chunk->positions.size(), 1.0f);
+            }
+            if(!colored)
+            {
+                rgb[0] = rgb[1] = rgb[2] = 1.0f;
+            }
+
+            chunk->positions.insert(chunk->positions.end(), xyz, xyz + 3);
+            if(colored || !chunk->colors.empty())
+            {
+                chunk->colors.insert(chunk->colors.end(), rgb, rgb + 3);
+            }
+        }
+        else if(startsWith(p, end, "vn"))
+        {
+            p += 2;
+            float xyz[3] = {0.0f, 0.0f, 0.0f};
+            for(float& x : xyz)
+            {
+                parseFloat(&p, end, &x);
+            }
+            chunk->normals.insert(chunk->normals.end(), xyz, xyz + 3);
+        }
+        else if(startsWith(p, end, "vt"))
+        {
+            p += 2;
+            float uv[2] = {0.0f, 0.0f};
+            for(float& x : uv)
+            {
+                parseFloat(&p, end, &x);
+            }
+            chunk->texcoords.insert(chunk->texcoords.end(), uv, uv + 2);
+        }
+        else if(startsWith(p, end, "f"))
+        {
+            p = skipSpace(p + 1, end);
+            face.clear();
+            while(p < end)
+            {
+                Corner corner;
+                if(!parseCorner(&p, end, *chunk, &corner))
+                {
+                    chunk->errorLine = chunk->lines;
+                    return;
+                }
+                face.push_back(corner);
+                p = skipSpace(p, end);
+            }
+
+            // Fan, tinyobjloader clips ears which gives the same triangles for convex polygons
+            for(size_t i = 2; i < face.size(); ++i)
+            {
+                chunk->corners.push_back(face[0]);
+                chunk->corners.push_back(face[i - 1]);
+                chunk->corners.push_back(face[i]);
+                chunk->materials.push_back(chunk->lastMaterial);
+            }
+        }
+        else if(startsWith(p, end, "usemtl"))
+        {
+            const std::string name(p + 7, end);
+            const auto        slot =
+                chunk->materialSlots.emplace(name, int(chunk->materialNames.size()));
+            if(slot.second)
+            {
+                chunk->materialNames.push_back(name);
+            }
+            chunk->lastMaterial = slot.first->second;
+        }
+        else if(startsWith(p, end, "o") || startsWith(p, end, "g"))
+        {
+            chunk->shapeBreaks.push_back(uint32_t(chunk->corners.size() / 3));
+        }
+        else if(startsWith(p, end, "mtllib"))
+        {
+            chunk->mtllibs.emplace_back(p + 7, end);
+        }
+    }
+}
+
+// Chunks of about a megabyte, several per thread so the dynamic schedule can balance them. They
+// start after a newline.
+std::vector<Chunk> splitChunks(const char* data, size_t size)
+{
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    const size_t count   = std::max<size_t>(1, std::min(size >> 20, 4 * threads));
+
+    std::vector<Chunk> chunks(count);
+    const char*        begin = data;
+    for(size_t i = 0; i < count; ++i)
+    {
+        const char* end = data + size * (i + 1) / count;
+        if(end < begin)
+        {
+            end = begin;
+        }
+        if(i + 1 < count)
+        {
+            const void* newline = std::memchr(end, '\n', data + size - end);
+            end = newline != nullptr ? static_cast<const char*>(newline) + 1 : data + size;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end   = end;
+        begin           = end;
+    }
+    return chunks;
+}
+
+// Global index, or -1 when missing or out of range
+inline int64_t resolve(int32_t index, bool relative, size_t base, size_t count)
+{
+    if(index == kMissing)
+    {
+        return -1;
+    }
+    const int64_t global = relative ? int64_t(base) + index : int64_t(index);
+    return global >= 0 && global < int64_t(count) ? global : -1;
+}
+
+}  // namespace
+
+ObjMesh loadObj(const std::string& path, const std::string& mtlDirectory,
+                const glm::mat4& transform)
+{
+    ObjMesh          mesh;
+    const MappedFile file(path);
+    mesh.bytes = file.size();
+
+    std::vector<Chunk> chunks = splitChunks(file.data(), file.size());
+    const int          count  = int(chunks.size());
+
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int i = 0; i < count; ++i)
+    {
+        parseChunk(&chunks[i]);
+    }
+
+    // Attribute bases, the first error in file order
+    size_t   positions = 0, texcoords = 0, normals = 0;
+    uint32_t lines     = 0;
+    bool     colored   = false;
+    for(Chunk& chunk : chunks)
+    {
+        if(chunk.errorLine != 0)
+        {
+            throw std::runtime_error(path + ":" + std::to_string(lines + chunk.errorLine)
+                                     + ": face index 0 is not allowed");
+        }
+        chunk.vBase  = positions;
+        chunk.vtBase = texcoords;
+        chunk.vnBase = normals;
+        positions += chunk.positions.size() / 3;
+        texcoords += chunk.texcoords.size() / 2;
+        normals += chunk.normals.size() / 3;
+        lines += chunk.lines;
+        colored = colored || !chunk.colors.empty();
+    }
+
+    // Material files in the order of the mtllib lines, every line names alternatives like for
+    // tinyobjloader
+    std::string baseDir = mtlDirectory;
+    if(!baseDir.empty())
+    {
+#ifdef _WIN32
+        const char separator = '\\';
+#else
+        const char separator = '/';
+#endif
+        if(baseDir.back() != separator)
+        {
+            baseDir += separator;
+        }
+    }
+    tinyobj::MaterialFileReader readMaterials(baseDir);
+    std::map<std::string, int>  materialMap;
+    for(const Chunk& chunk : chunks)
+    {
+        for(const std::string& mtllib : chunk.mtllibs)
+        {
+            bool        found = false;
+            size_t      begin = 0;
+            std::string error;
+            while(!found && begin <= mtllib.size())
+            {
+                const size_t end = std::min(mtllib.find(' ', begin), mtllib.size());
+                if(end > begin)
+                {
+                    found = readMaterials(mtllib.substr(begin, end - begin), &mesh.materials,
+                                          &materialMap, &mesh.warnings, &error);
+                }
+                begin = end + 1;
+            }
+            if(!found)
+            {
+                mesh.warnings += "Failed to load material file(s). Use default material.\n";
+            }
+        }
+    }
+
+    // Material names to ids, faces before the first usemtl of a chunk continue the material of
+    // the chunks before
+    int material = -1;
+    for(Chunk& chunk : chunks)
+    {
+        chunk.initialMaterial = material;
+        for(const std::string& name : chunk.materialNames)
+        {
+            const auto id = materialMap.find(name);
+            chunk.materialIDs.push_back(id != materialMap.end() ? id->second : -1);
+        }
+        if(chunk.lastMaterial >= 0)
+        {
+            material = chunk.materialIDs[chunk.lastMaterial];
+        }
+    }
+
+    // Triangles whose positions exist, and the shape breaks among them
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int i = 0; i < count; ++i)
+    {
+        Chunk& chunk  = chunks[i];
+        size_t breaks = 0;
+        for(size_t triangle = 0; triangle < chunk.corners.size() / 3; ++triangle)
+        {
+            for(; breaks < chunk.shapeBreaks.size() && chunk.shapeBreaks[breaks] == triangle;
+                ++breaks)
+            {
+                chunk.validBreaks.push_back(uint32_t(chunk.validTriangles));
+            }
+            bool valid = true;
+            for(size_t k = 0; k < 3; ++k)
+            {
+                const Corner& corner = chunk.corners[3 * triangle + k];
+                valid = valid
+                        && resolve(corner.v, (corner.relative & kRelativeV) != 0, chunk.vBase,
+                                   positions)
+                               >= 0;
+            }
+            chunk.validTriangles += valid ? 1 : 0;
+        }
+        chunk.validBreaks.resize(chunk.shapeBreaks.size(), uint32_t(chunk.validTriangles));
+    }
+
+    // A shape ends at every o and g line after triangles and at the end
+    size_t triangles = 0;
+    for(Chunk& chunk : chunks)
+    {
+        chunk.triangleBase = triangles;
+        for(const uint32_t valid : chunk.validBreaks)
+        {
+            const uint32_t end = uint32_t(3 * (triangles + valid));
+            if(end > (mesh.shapeEnds.empty() ? 0 : mesh.shapeEnds.back()))
+            {
+                mesh.shapeEnds.push_back(end);
+            }
+        }
+        triangles += chunk.validTriangles;
+    }
+    if(3 * triangles > (mesh.shapeEnds.empty() ? 0 : mesh.shapeEnds.back()))
+    {
+        mesh.shapeEnds.push_back(uint32_t(3 * triangles));
+    }
+
+    // Attributes of all chunks in one array each
+    std::vector<float> allPositions(3 * positions);
+    std::vector<float> allColors(colored ? 3 * positions : 0);
+    std::vector<float> allTexcoords(2 * texcoords);
+    std::vector<float> allNormals(3 * normals);
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int i = 0; i < count; ++i)
+    {
+        Chunk& chunk = chunks[i];
+        std::copy(chunk.positions.begin(), chunk.positions.end(),
+                  allPositions.begin() + 3 * chunk.vBase);
+        if(colored && chunk.colors.empty())
+        {
+            std::fill_n(allColors.begin() + 3 * chunk.vBase, chunk.positions.size(), 1.0f);
+        }
+        else if(colored)
+        {
+            std::copy(chunk.colors.begin(), chunk.colors.end(),
+                      allColors.begin() + 3 * chunk.vBase);
+        }
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(),
+                  allTexcoords.begin() + 2 * chunk.vtBase);
+        std::copy(chunk.normals.begin(), chunk.normals.end(),
+                  allNormals.begin() + 3 * chunk.vnBase);
+        chunk.positions = std::vector<float>();
+        chunk.colors    = std::vector<float>();
+        chunk.texcoords = std::vector<float>();
+        chunk.normals   = std::vector<float>();
+    }
+
+    // One vertex per corner
+    const glm::mat3 normalTransform = glm::inverseTranspose(glm::mat3(transform));
+    const int       numMaterials    = int(std::max<size_t>(mesh.materials.size(), 1));
+    mesh.vertices.resize(3 * triangles);
+    mesh.indices.resize(3 * triangles);
+#pragma omp parallel for schedule(dynamic, 1)
+    for(int i = 0; i < count; ++i)
+    {
+        const Chunk& chunk  = chunks[i];
+        size_t       output = 3 * chunk.triangleBase;
+        for(size_t triangle = 0; triangle < chunk.corners.size() / 3; ++triangle)
+        {
+            int64_t v[3];
+            for(size_t k = 0; k < 3; ++k)
+            {
+                const Corner& corner = chunk.corners[3 * triangle + k];
+                v[k] = resolve(corner.v, (corner.relative & kRelativeV) != 0, chunk.vBase,
+                               positions);
+            }
+            if(v[0] < 0 || v[1] < 0 || v[2] < 0)
+            {
+                continue;
+            }
+
+            const int local = chunk.materials[triangle];
+            int       materialID = local >= 0 ? chunk.materialIDs[local] : chunk.initialMaterial;
+            if(materialID < 0 || materialID >= numMaterials)
+            {
+                materialID = 0;
+            }
+
+            VertexPNTC* vertices = &mesh.vertices[output];
+            bool        faceNormal[3];
+            for(size_t k = 0; k < 3; ++k)
+            {
+                const Corner& corner = chunk.corners[3 * triangle + k];
+                VertexPNTC&   vertex = vertices[k];
+
+                const float* p = &allPositions[3 * v[k]];
+                vertex.p       = glm::vec3(transform * glm::vec4(p[0], p[1], p[2], 1.0f));
+
+                const int64_t vn = resolve(corner.vn, (corner.relative & kRelativeVn) != 0,
+                                           chunk.vnBase, normals);
+                vertex.n         = glm::vec3(0.0f);
+                if(vn >= 0)
+                {
+                    const float* n = &allNormals[3 * vn];
+                    vertex.n       = normalTransform * glm::vec3(n[0], n[1], n[2]);
+                }
+                faceNormal[k] = glm::dot(vertex.n, vertex.n) == 0.0f;
+                if(!faceNormal[k])
+                {
+                    vertex.n = glm::normalize(vertex.n);
+                }
+
+                const int64_t vt = resolve(corner.vt, (corner.relative & kRelativeVt) != 0,
+                                           chunk.vtBase, texcoords);
+                vertex.t         = glm::vec2(0.0f);
+                if(vt >= 0)
+                {
+                    vertex.t = glm::vec2(allTexcoords[2 * vt], -allTexcoords[2 * vt + 1]);
+                }
+
+                vertex.c = glm::vec3(1.0f);
+                if(colored)
+                {
+                    const float* c = &allColors[3 * v[k]];
+                    vertex.c       = glm::vec3(c[0], c[1], c[2]);
+                }
+                vertex.materialID = materialID;
+
+                mesh.indices[output + k] = uint32_t(output + k);
+            }
+
+            // Corners without a usable vn take the face normal. Degenerate triangles are never
+            // hit and keep a zero normal, normalizing their zero cross product would give NaN.
+            if(faceNormal[0] || faceNormal[1] || faceNormal[2])
+            {
+                const glm::vec3 cross = glm::cross(vertices[1].p - vertices[0].p,
+                                                   vertices[2].p - vertices[0].p);
+                const float     area2 = glm::length(cross);
+                const glm::vec3 n     = area2 > 0.0f ? cross / area2 : glm::vec3(0.0f);
+                for(size_t k = 0; k < 3; ++k)
+                {
+                    vertices[k].n = faceNormal[k] ? n : vertices[k].n;
+                }
+            }
+            output += 3;
+        }
+    }
+
+    return mesh;
+}
+
+}  // namespace VkTools
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <tinyobjloader/tiny_obj_loader.h>
+
+#include "Model.h"
+
+namespace VkTools {
+
+// ----------------------------------------------------------------------------
+//  Wavefront .obj front end for Model::LoadModelFromFile. The file is memory mapped and split at
+//  line boundaries into chunks that are parsed on all cores. Indices in a chunk are resolved to
+//  global ones from the attribute counts of the chunks before it, faces before the first usemtl
+//  of a chunk take the last material of the chunks before. The vertices are then written
+//  straight into the VertexPNTC array, in parallel again.
+//
+//  The result matches what the tinyobjloader path produced: one vertex per face corner, polygons
+//  fanned into triangles, shapes split at o and g, vertex colors defaulting to white. Material
+//  files are read with tinyobjloader's reader, they are small.
+//
+
+struct ObjMesh
+{
+    std::vector<VertexPNTC>          vertices;  // Transformed, materialID valid for materials
+    std::vector<uint32_t>            indices;   // 0, 1, 2, ...
+    std::vector<uint32_t>            shapeEnds;
+    std::vector<tinyobj::material_t> materials;
+    std::string                      warnings;
+    size_t                           bytes = 0;  // Size of the .obj
+};
+
+// Throws std::runtime_error when the file can not be mapped or a face index is malformed.
+// Corners without a normal or with a zero one get the normal of their triangle.
+ObjMesh loadObj(const std::string& path, const std::string& mtlDirectory,
+                const glm::mat4& transform = glm::mat4(1.0f));
+
+}  // namespace VkTools
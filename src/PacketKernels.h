@@ -0,0 +1,321 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rtutils {
+
+// ----------------------------------------------------------------------------
+//  Plain data and the traversal kernel shared by PacketKernelsAvx2.cpp and
+//  PacketKernelsAvx512.cpp. Those are compiled with their instruction set enabled, so they
+//  include nothing but this file and the intrinsics: an inline function they instantiate could
+//  otherwise be the copy the linker keeps for the whole program.
+//
+
+const uint32_t kMaxPacketSize = 16;
+
+// Traversal stack entries, PacketTraversal.cpp checks that this covers Bvh::kMaxDepth
+const uint32_t kMaxPacketStack = 64;
+
+struct PacketNode
+{
+    float    min[3];
+    float    max[3];
+    uint32_t first;  // Like Bvh::Node
+    uint32_t count;
+};
+
+struct PacketScene
+{
+    const PacketNode* nodes;
+    const float*      vertices;  // Nine floats per triangle in Bvh leaf order
+};
+
+// Structure of arrays, lanes past the kernel width are ignored. Lanes with tmax < tmin are off.
+struct alignas(64) RayPacket
+{
+    float ox[kMaxPacketSize];
+    float oy[kMaxPacketSize];
+    float oz[kMaxPacketSize];
+    float dx[kMaxPacketSize];
+    float dy[kMaxPacketSize];
+    float dz[kMaxPacketSize];
+    float tmin[kMaxPacketSize];
+    float tmax[kMaxPacketSize];
+};
+
+struct alignas(64) PacketHits
+{
+    float    t[kMaxPacketSize];
+    float    u[kMaxPacketSize];
+    float    v[kMaxPacketSize];
+    uint32_t triangle[kMaxPacketSize];  // Leaf order, ~0u on a miss. Any hit for occlusion.
+};
+
+// False when the compiler did not target the instruction set, the kernel must not be called then
+bool packetKernelAvx2Compiled();
+bool packetKernelAvx512Compiled();
+
+void tracePacketAvx2(const PacketScene& scene, const RayPacket& rays, bool anyHit,
+                     PacketHits* hits);
+void tracePacketAvx512(const PacketScene& scene, const RayPacket& rays, bool anyHit,
+                       PacketHits* hits);
+
+// ----------------------------------------------------------------------------
+//  Traces S::kWidth rays through the BVH together. A node is skipped for the whole packet when
+//  interval arithmetic over the origins and inverse directions of its rays shows that none can
+//  enter it, which takes a handful of scalar operations. Only nodes passing that test get the
+//  per lane slab test, leaves test each triangle against all lanes at once with the same
+//  Moeller-Trumbore formulation as Bvh. The interval test needs every lane to have the same
+//  direction signs, incoherent packets fall back to the slab test alone.
+//
+//  S wraps the intrinsics: float vector F, lane mask M and operations on them.
+//
+
+template <typename S>
+void tracePacket(const PacketScene& scene, const RayPacket& rays, bool anyHit, PacketHits* hits)
+{
+    using F = typename S::F;
+    using M = typename S::M;
+
+    const uint32_t width = S::kWidth;
+    const uint32_t all   = width == 32 ? ~0u : (1u << width) - 1u;
+
+    const F ox   = S::load(rays.ox);
+    const F oy   = S::load(rays.oy);
+    const F oz   = S::load(rays.oz);
+    const F dx   = S::load(rays.dx);
+    const F dy   = S::load(rays.dy);
+    const F dz   = S::load(rays.dz);
+    const F one  = S::set1(1.0f);
+    const F ix   = S::div(one, dx);
+    const F iy   = S::div(one, dy);
+    const F iz   = S::div(one, dz);
+    const F tmin = S::load(rays.tmin);
+    F       tmax = S::load(rays.tmax);
+    F       hitU = S::set1(0.0f);
+    F       hitV = S::set1(0.0f);
+
+    uint32_t done = S::bits(S::lt(tmax, tmin));
+    for(uint32_t lane = 0; lane < width; ++lane)
+    {
+        hits->triangle[lane] = ~0u;
+    }
+    if(done == all)
+    {
+        return;
+    }
+
+    // Ranges of origins and inverse directions over the lanes that are on, the mean direction
+    // orders the children
+    const float* origins[3]    = {rays.ox, rays.oy, rays.oz};
+    const float* directions[3] = {rays.dx, rays.dy, rays.dz};
+    float        originLo[3], originHi[3], inverseLo[3], inverseHi[3], meanDir[3];
+    float        tminLo   = 0.0f;
+    float        tmaxHi   = 0.0f;
+    bool         coherent = true;
+    for(int axis = 0; axis < 3; ++axis)
+    {
+        bool first     = true;
+        bool positive  = false;
+        meanDir[axis]  = 0.0f;
+        for(uint32_t lane = 0; lane < width; ++lane)
+        {
+            if(done >> lane & 1u)
+            {
+                continue;
+            }
+            const float o = origins[axis][lane];
+            const float d = directions[axis][lane];
+            const float i = 1.0f / d;
+            if(first)
+            {
+                originLo[axis] = originHi[axis] = o;
+                inverseLo[axis] = inverseHi[axis] = i;
+                positive                          = d > 0.0f;
+                if(axis == 0)
+                {
+                    tminLo = rays.tmin[lane];
+                    tmaxHi = rays.tmax[lane];
+                }
+                first = false;
+            }
+            originLo[axis]  = o < originLo[axis] ? o : originLo[axis];
+            originHi[axis]  = o > originHi[axis] ? o : originHi[axis];
+            inverseLo[axis] = i < inverseLo[axis] ? i : inverseLo[axis];
+            inverseHi[axis] = i > inverseHi[axis] ? i : inverseHi[axis];
+            meanDir[axis] += d;
+            if(axis == 0)
+            {
+                tminLo = rays.tmin[lane] < tminLo ? rays.tmin[lane] : tminLo;
+                tmaxHi = rays.tmax[lane] > tmaxHi ? rays.tmax[lane] : tmaxHi;
+            }
+
+            // A zero component has an infinite inverse, the products below would turn into NaN
+            const bool finite = i - i == 0.0f;
+            coherent          = coherent && d != 0.0f && finite && (d > 0.0f) == positive;
+        }
+    }
+
+    // Conservative bounds of the entry and exit distances of every lane, the packet misses the
+    // node when the latest possible entry is past the earliest possible exit
+    const auto intervalMiss = [&](const PacketNode& node) {
+        float enter = tminLo;
+        float exit  = tmaxHi;
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            const bool  positive = inverseLo[axis] > 0.0f;
+            const float nearSide = positive ? node.min[axis] : node.max[axis];
+            const float farSide  = positive ? node.max[axis] : node.min[axis];
+
+            // Products of [side - originHi, side - originLo] and [inverseLo, inverseHi]
+            const float n0 = (nearSide - originHi[axis]) * inverseLo[axis];
+            const float n1 = (nearSide - originHi[axis]) * inverseHi[axis];
+            const float n2 = (nearSide - originLo[axis]) * inverseLo[axis];
+            const float n3 = (nearSide - originLo[axis]) * inverseHi[axis];
+            const float f0 = (farSide - originHi[axis]) * inverseLo[axis];
+            const float f1 = (farSide - originHi[axis]) * inverseHi[axis];
+            const float f2 = (farSide - originLo[axis]) * inverseLo[axis];
+            const float f3 = (farSide - originLo[axis]) * inverseHi[axis];
+
+            const float nearLo = n0 < n1 ? (n0 < n2 ? (n0 < n3 ? n0 : n3) : (n2 < n3 ? n2 : n3))
+                                         : (n1 < n2 ? (n1 < n3 ? n1 : n3) : (n2 < n3 ? n2 : n3));
+            const float farHi  = f0 > f1 ? (f0 > f2 ? (f0 > f3 ? f0 : f3) : (f2 > f3 ? f2 : f3))
+                                         : (f1 > f2 ? (f1 > f3 ? f1 : f3) : (f2 > f3 ? f2 : f3));
+            enter = nearLo > enter ? nearLo : enter;
+            exit  = farHi < exit ? farHi : exit;
+        }
+        return enter > exit;
+    };
+
+    const auto slab = [&](const PacketNode& node) {
+        const F t0x = S::mul(S::sub(S::set1(node.min[0]), ox), ix);
+        const F t1x = S::mul(S::sub(S::set1(node.max[0]), ox), ix);
+        const F t0y = S::mul(S::sub(S::set1(node.min[1]), oy), iy);
+        const F t1y = S::mul(S::sub(S::set1(node.max[1]), oy), iy);
+        const F t0z = S::mul(S::sub(S::set1(node.min[2]), oz), iz);
+        const F t1z = S::mul(S::sub(S::set1(node.max[2]), oz), iz);
+
+        const F enter = S::max(S::max(S::min(t0x, t1x), S::min(t0y, t1y)),
+                               S::max(S::min(t0z, t1z), tmin));
+        const F exit  = S::min(S::min(S::max(t0x, t1x), S::max(t0y, t1y)),
+                              S::min(S::max(t0z, t1z), tmax));
+        return S::bits(S::le(enter, exit));
+    };
+
+    uint32_t stack[kMaxPacketStack];
+    uint32_t stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize > 0)
+    {
+        const PacketNode& node = scene.nodes[stack[--stackSize]];
+        if(coherent && intervalMiss(node))
+        {
+            continue;
+        }
+        uint32_t active = slab(node) & ~done;
+        if(active == 0)
+        {
+            continue;
+        }
+
+        if(node.count == 0)
+        {
+            // The child nearer along the mean direction goes on top
+            const PacketNode& left  = scene.nodes[node.first];
+            const PacketNode& right = scene.nodes[node.first + 1];
+            float             order = 0.0f;
+            for(int axis = 0; axis < 3; ++axis)
+            {
+                order += (left.min[axis] + left.max[axis] - right.min[axis] - right.max[axis])
+                         * meanDir[axis];
+            }
+            stack[stackSize++] = order > 0.0f ? node.first : node.first + 1;
+            stack[stackSize++] = order > 0.0f ? node.first + 1 : node.first;
+            continue;
+        }
+
+        for(uint32_t i = node.first; i < node.first + node.count && active != 0; ++i)
+        {
+            const float* v   = scene.vertices + 9 * size_t(i);
+            const F      e1x = S::set1(v[3] - v[0]);
+            const F      e1y = S::set1(v[4] - v[1]);
+            const F      e1z = S::set1(v[5] - v[2]);
+            const F      e2x = S::set1(v[6] - v[0]);
+            const F      e2y = S::set1(v[7] - v[1]);
+            const F      e2z = S::set1(v[8] - v[2]);
+
+            const F px  = S::sub(S::mul(dy, e2z), S::mul(dz, e2y));
+            const F py  = S::sub(S::mul(dz, e2x), S::mul(dx, e2z));
+            const F pz  = S::sub(S::mul(dx, e2y), S::mul(dy, e2x));
+            const F det = S::add(S::add(S::mul(e1x, px), S::mul(e1y, py)), S::mul(e1z, pz));
+            M       ok  = S::ge(S::abs(det), S::set1(1e-12f));
+
+            const F invDet = S::div(one, det);
+            const F sx     = S::sub(ox, S::set1(v[0]));
+            const F sy     = S::sub(oy, S::set1(v[1]));
+            const F sz     = S::sub(oz, S::set1(v[2]));
+            const F u =
+                S::mul(S::add(S::add(S::mul(sx, px), S::mul(sy, py)), S::mul(sz, pz)), invDet);
+            ok = S::andMask(ok, S::andMask(S::ge(u, S::set1(0.0f)), S::le(u, one)));
+
+            const F qx = S::sub(S::mul(sy, e1z), S::mul(sz, e1y));
+            const F qy = S::sub(S::mul(sz, e1x), S::mul(sx, e1z));
+            const F qz = S::sub(S::mul(sx, e1y), S::mul(sy, e1x));
+            const F w =
+                S::mul(S::add(S::add(S::mul(dx, qx), S::mul(dy, qy)), S::mul(dz, qz)), invDet);
+            ok = S::andMask(ok, S::andMask(S::ge(w, S::set1(0.0f)), S::le(S::add(u, w), one)));
+
+            const F t =
+                S::mul(S::add(S::add(S::mul(e2x, qx), S::mul(e2y, qy)), S::mul(e2z, qz)), invDet);
+            ok = S::andMask(ok, S::andMask(S::ge(t, tmin), S::le(t, tmax)));
+
+            const uint32_t hit = S::bits(ok) & active;
+            if(hit == 0)
+            {
+                continue;
+            }
+            for(uint32_t lane = 0; lane < width; ++lane)
+            {
+                if(hit >> lane & 1u)
+                {
+                    hits->triangle[lane] = i;
+                }
+            }
+
+            if(anyHit)
+            {
+                done |= hit;
+                active &= ~hit;
+                if(done == all)
+                {
+                    return;
+                }
+                continue;
+            }
+
+            const M mask = S::fromBits(hit);
+            tmax         = S::blend(mask, t, tmax);
+            hitU         = S::blend(mask, u, hitU);
+            hitV         = S::blend(mask, w, hitV);
+
+            // Farthest lane distance left for the interval test
+            alignas(64) float distances[kMaxPacketSize];
+            S::store(distances, tmax);
+            tmaxHi = tminLo;
+            for(uint32_t lane = 0; lane < width; ++lane)
+            {
+                if(!(done >> lane & 1u))
+                {
+                    tmaxHi = distances[lane] > tmaxHi ? distances[lane] : tmaxHi;
+                }
+            }
+        }
+    }
+
+    S::store(hits->t, tmax);
+    S::store(hits->u, hitU);
+    S::store(hits->v, hitV);
+}
+
+}  // namespace rtutils
@@ -0,0 +1,98 @@
+#include "PacketKernels.h"
+#include "TriangleKernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace rtutils {
+namespace {
+
+struct Avx2
+{
+    using F = __m256;
+    using M = __m256;
+
+    static const uint32_t kWidth = 8;
+
+    static F        load(const float* p) { return _mm256_load_ps(p); }
+    static void     store(float* p, F a) { _mm256_store_ps(p, a); }
+    static F        set1(float a) { return _mm256_set1_ps(a); }
+    static F        add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F        sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F        mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F        div(F a, F b) { return _mm256_div_ps(a, b); }
+    static F        min(F a, F b) { return _mm256_min_ps(a, b); }
+    static F        max(F a, F b) { return _mm256_max_ps(a, b); }
+    static F        abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static F        signBit(F a) { return _mm256_and_ps(a, _mm256_set1_ps(-0.0f)); }
+    static F        xorSign(F a, F sign) { return _mm256_xor_ps(a, sign); }
+    static M        eq(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+    static M        neq(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_NEQ_UQ); }
+    static M        lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static M        le(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static M        gt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static M        ge(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static M        andMask(M a, M b) { return _mm256_and_ps(a, b); }
+    static M        orMask(M a, M b) { return _mm256_or_ps(a, b); }
+    static M        andNotMask(M a, M b) { return _mm256_andnot_ps(a, b); }  // ~a & b
+    static F        blend(M mask, F a, F b) { return _mm256_blendv_ps(b, a, mask); }
+    static uint32_t bits(M mask) { return uint32_t(_mm256_movemask_ps(mask)); }
+
+    static M fromBits(uint32_t bits)
+    {
+        const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256i set   = _mm256_and_si256(_mm256_set1_epi32(int(bits)), lanes);
+        return _mm256_castsi256_ps(_mm256_cmpeq_epi32(set, lanes));
+    }
+};
+
+}  // namespace
+
+bool packetKernelAvx2Compiled()
+{
+    return true;
+}
+
+void tracePacketAvx2(const PacketScene& scene, const RayPacket& rays, bool anyHit,
+                     PacketHits* hits)
+{
+    tracePacket<Avx2>(scene, rays, anyHit, hits);
+}
+
+bool intersectTrianglesAvx2(const WatertightRay& ray, const TriangleBlock<8>& block,
+                            TriangleHit* hit)
+{
+    return intersectTriangles<Avx2, false>(ray, block, hit);
+}
+
+bool occludedTrianglesAvx2(const WatertightRay& ray, const TriangleBlock<8>& block)
+{
+    return intersectTriangles<Avx2, true>(ray, block, nullptr);
+}
+
+}  // namespace rtutils
+
+#else
+
+namespace rtutils {
+
+bool packetKernelAvx2Compiled()
+{
+    return false;
+}
+
+void tracePacketAvx2(const PacketScene&, const RayPacket&, bool, PacketHits*) {}
+
+bool intersectTrianglesAvx2(const WatertightRay&, const TriangleBlock<8>&, TriangleHit*)
+{
+    return false;
+}
+
+bool occludedTrianglesAvx2(const WatertightRay&, const TriangleBlock<8>&)
+{
+    return false;
+}
+
+}  // namespace rtutils
+
+#endif
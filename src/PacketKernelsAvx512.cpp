@@ -0,0 +1,63 @@
+#include "PacketKernels.h"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+namespace rtutils {
+namespace {
+
+struct Avx512
+{
+    using F = __m512;
+    using M = __mmask16;
+
+    static const uint32_t kWidth = 16;
+
+    static F        load(const float* p) { return _mm512_load_ps(p); }
+    static void     store(float* p, F a) { _mm512_store_ps(p, a); }
+    static F        set1(float a) { return _mm512_set1_ps(a); }
+    static F        add(F a, F b) { return _mm512_add_ps(a, b); }
+    static F        sub(F a, F b) { return _mm512_sub_ps(a, b); }
+    static F        mul(F a, F b) { return _mm512_mul_ps(a, b); }
+    static F        div(F a, F b) { return _mm512_div_ps(a, b); }
+    static F        min(F a, F b) { return _mm512_min_ps(a, b); }
+    static F        max(F a, F b) { return _mm512_max_ps(a, b); }
+    static F        abs(F a) { return _mm512_abs_ps(a); }
+    static M        lt(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+    static M        le(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+    static M        ge(F a, F b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+    static M        andMask(M a, M b) { return M(a & b); }
+    static F        blend(M mask, F a, F b) { return _mm512_mask_blend_ps(mask, b, a); }
+    static uint32_t bits(M mask) { return uint32_t(mask); }
+    static M        fromBits(uint32_t bits) { return M(bits); }
+};
+
+}  // namespace
+
+bool packetKernelAvx512Compiled()
+{
+    return true;
+}
+
+void tracePacketAvx512(const PacketScene& scene, const RayPacket& rays, bool anyHit,
+                       PacketHits* hits)
+{
+    tracePacket<Avx512>(scene, rays, anyHit, hits);
+}
+
+}  // namespace rtutils
+
+#else
+
+namespace rtutils {
+
+bool packetKernelAvx512Compiled()
+{
+    return false;
+}
+
+void tracePacketAvx512(const PacketScene&, const RayPacket&, bool, PacketHits*) {}
+
+}  // namespace rtutils
+
+#endif
@@ -0,0 +1,223 @@
+#include "PacketTraversal.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace rtutils {
+namespace {
+
+static_assert(kMaxPacketStack >= Bvh::kMaxDepth, "Packet traversal stack shallower than the BVH");
+
+bool cpuSupports(SimdLevel level)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuidex(info, 1, 0);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx     = (info[2] & (1 << 28)) != 0;
+    if(!osxsave || !avx)
+    {
+        return false;
+    }
+
+    // The OS has to save the YMM registers, and the ZMM and mask registers for AVX-512
+    const unsigned long long xcr0 = _xgetbv(0);
+    __cpuidex(info, 7, 0);
+    if(level == SimdLevel::Avx2)
+    {
+        return (xcr0 & 0x6) == 0x6 && (info[1] & (1 << 5)) != 0;
+    }
+    return (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    // Checks the OS state as well
+    __builtin_cpu_init();
+    return level == SimdLevel::Avx2 ? __builtin_cpu_supports("avx2") != 0
+                                    : __builtin_cpu_supports("avx512f") != 0;
+#else
+    (void)level;
+    return false;
+#endif
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+const char* toString(SimdLevel level)
+{
+    switch(level)
+    {
+        case SimdLevel::Avx2:
+            return "avx2";
+        case SimdLevel::Avx512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+bool simdLevelSupported(SimdLevel level)
+{
+    switch(level)
+    {
+        case SimdLevel::Avx2:
+            return packetKernelAvx2Compiled() && cpuSupports(level);
+        case SimdLevel::Avx512:
+            return packetKernelAvx512Compiled() && cpuSupports(level);
+        default:
+            return true;
+    }
+}
+
+SimdLevel detectSimdLevel()
+{
+    if(simdLevelSupported(SimdLevel::Avx512))
+    {
+        return SimdLevel::Avx512;
+    }
+    if(simdLevelSupported(SimdLevel::Avx2))
+    {
+        return SimdLevel::Avx2;
+    }
+    return SimdLevel::Scalar;
+}
+
+// ----------------------------------------------------------------------------
+//  The kernels get their own copy of the BVH without glm types
+//
+
+PacketTracer::PacketTracer(const Bvh& bvh, SimdLevel level)
+    : m_bvh(bvh)
+    , m_level(level)
+{
+    if(m_level == SimdLevel::Scalar)
+    {
+        return;
+    }
+
+    m_nodes.resize(bvh.nodes().size());
+    for(size_t i = 0; i < m_nodes.size(); ++i)
+    {
+        const Bvh::Node& node = bvh.nodes()[i];
+        for(int axis = 0; axis < 3; ++axis)
+        {
+            m_nodes[i].min[axis] = node.bounds.min[axis];
+            m_nodes[i].max[axis] = node.bounds.max[axis];
+        }
+        m_nodes[i].first = node.first;
+        m_nodes[i].count = node.count;
+    }
+
+    m_vertices.reserve(3 * bvh.leafVertices().size());
+    for(const glm::vec3& v : bvh.leafVertices())
+    {
+        m_vertices.insert(m_vertices.end(), {v.x, v.y, v.z});
+    }
+}
+
+uint32_t PacketTracer::packetSize() const
+{
+    return m_level == SimdLevel::Avx512 ? 16 : m_level == SimdLevel::Avx2 ? 8 : 1;
+}
+
+// ----------------------------------------------------------------------------
+//  Packets are traced in parallel. The last packet is padded with lanes that are off.
+//
+
+template <typename Store>
+void PacketTracer::trace(const std::vector<Ray>& rays, bool anyHit, Store store) const
+{
+    if(m_nodes.empty())
+    {
+        return;
+    }
+
+    const PacketScene scene = {m_nodes.data(), m_vertices.data()};
+    const uint32_t    size  = packetSize();
+    const int         count = int((rays.size() + size - 1) / size);
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for(int packet = 0; packet < count; ++packet)
+    {
+        const size_t first = size_t(packet) * size;
+        RayPacket    packetRays;
+        for(uint32_t lane = 0; lane < size; ++lane)
+        {
+            const bool inside = first + lane < rays.size();
+            const Ray& ray    = rays[inside ? first + lane : first];
+
+            packetRays.ox[lane]   = ray.origin.x;
+            packetRays.oy[lane]   = ray.origin.y;
+            packetRays.oz[lane]   = ray.origin.z;
+            packetRays.dx[lane]   = ray.dir.x;
+            packetRays.dy[lane]   = ray.dir.y;
+            packetRays.dz[lane]   = ray.dir.z;
+            packetRays.tmin[lane] = ray.tmin;
+            packetRays.tmax[lane] = inside ? ray.tmax : -1.0f;
+        }
+
+        PacketHits packetHits;
+        if(m_level == SimdLevel::Avx512)
+        {
+            tracePacketAvx512(scene, packetRays, anyHit, &packetHits);
+        }
+        else
+        {
+            tracePacketAvx2(scene, packetRays, anyHit, &packetHits);
+        }
+
+        for(uint32_t lane = 0; lane < size && first + lane < rays.size(); ++lane)
+        {
+            store(first + lane, packetHits, lane);
+        }
+    }
+}
+
+void PacketTracer::intersect(const std::vector<Ray>& rays, std::vector<RayHit>* hits) const
+{
+    hits->assign(rays.size(), RayHit());
+    if(m_level == SimdLevel::Scalar)
+    {
+#pragma omp parallel for schedule(dynamic, 1024)
+        for(int i = 0; i < int(rays.size()); ++i)
+        {
+            m_bvh.intersect(rays[i], &(*hits)[i]);
+        }
+        return;
+    }
+
+    const std::vector<uint32_t>& triangleIDs = m_bvh.triangleIDs();
+    trace(rays, false, [&](size_t index, const PacketHits& packetHits, uint32_t lane) {
+        if(packetHits.triangle[lane] == ~0u)
+        {
+            return;
+        }
+        RayHit& hit      = (*hits)[index];
+        hit.t            = packetHits.t[lane];
+        hit.triangle     = triangleIDs[packetHits.triangle[lane]];
+        hit.barycentrics = glm::vec2(packetHits.u[lane], packetHits.v[lane]);
+    });
+}
+
+void PacketTracer::occluded(const std::vector<Ray>& rays, std::vector<uint8_t>* occluded) const
+{
+    occluded->assign(rays.size(), 0);
+    if(m_level == SimdLevel::Scalar)
+    {
+#pragma omp parallel for schedule(dynamic, 1024)
+        for(int i = 0; i < int(rays.size()); ++i)
+        {
+            (*occluded)[i] = m_bvh.occluded(rays[i]) ? 1 : 0;
+        }
+        return;
+    }
+
+    trace(rays, true, [&](size_t index, const PacketHits& packetHits, uint32_t lane) {
+        (*occluded)[index] = packetHits.triangle[lane] != ~0u ? 1 : 0;
+    });
+}
+
+}  // namespace rtutils
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Bvh.h"
+#include "PacketKernels.h"
+
+namespace rtutils {
+
+enum class SimdLevel
+{
+    Scalar,
+    Avx2,
+    Avx512
+};
+
+const char* toString(SimdLevel level);
+
+// The build has kernels for level and the CPU and OS support it, always true for Scalar
+bool simdLevelSupported(SimdLevel level);
+
+// Widest supported level
+SimdLevel detectSimdLevel();
+
+// ----------------------------------------------------------------------------
+//  Traces batches of coherent rays, primary rays of a screen tile or shadow rays toward the area
+//  light, 8 (AVX2) or 16 (AVX-512) at a time through the BVH of a Bvh. Consecutive rays of a
+//  batch form a packet, so the batch should be in tile order. Hits match Bvh::intersect and
+//  Bvh::occluded, the scalar level calls them for each ray.
+//
+
+class PacketTracer
+{
+    public:
+    PacketTracer(const Bvh& bvh, SimdLevel level);
+
+    SimdLevel level() const { return m_level; }
+    uint32_t  packetSize() const;
+
+    void intersect(const std::vector<Ray>& rays, std::vector<RayHit>* hits) const;
+
+    // 1 for rays that hit anything in [tmin, tmax]
+    void occluded(const std::vector<Ray>& rays, std::vector<uint8_t>* occluded) const;
+
+    private:
+    template <typename Store>
+    void trace(const std::vector<Ray>& rays, bool anyHit, Store store) const;
+
+    const Bvh&              m_bvh;
+    SimdLevel               m_level;
+    std::vector<PacketNode> m_nodes;
+    std::vector<float>      m_vertices;
+};
+
+}  // namespace rtutils
@@ -0,0 +1,115 @@
+#include "RaySorting.h"
+
+#include <algorithm>
+
+namespace rtutils {
+namespace {
+
+const uint32_t kMortonBits = 9;  // Per axis
+
+// Spreads the lowest kMortonBits bits of v to every third bit
+uint32_t expandBits(uint32_t v)
+{
+    v = (v | (v << 16)) & 0x030000FFu;
+    v = (v | (v << 8)) & 0x0300F00Fu;
+    v = (v | (v << 4)) & 0x030C30C3u;
+    v = (v | (v << 2)) & 0x09249249u;
+    return v;
+}
+
+uint32_t quantize(float value, float min, float extent)
+{
+    const float scale = float((1u << kMortonBits) - 1);
+    const float x     = extent > 0.0f ? (value - min) / extent : 0.0f;
+    return uint32_t(glm::clamp(x, 0.0f, 1.0f) * scale + 0.5f);
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+uint32_t rayKey(const Ray& ray, const AABB& bounds)
+{
+    const uint32_t octant = (ray.dir.x < 0.0f ? 1u : 0u) | (ray.dir.y < 0.0f ? 2u : 0u)
+                            | (ray.dir.z < 0.0f ? 4u : 0u);
+
+    const glm::vec3 extent = bounds.max - bounds.min;
+    const uint32_t  x      = quantize(ray.origin.x, bounds.min.x, extent.x);
+    const uint32_t  y      = quantize(ray.origin.y, bounds.min.y, extent.y);
+    const uint32_t  z      = quantize(ray.origin.z, bounds.min.z, extent.z);
+    const uint32_t  morton = (expandBits(x) << 2) | (expandBits(y) << 1) | expandBits(z);
+
+    return (octant << (3 * kMortonBits)) | morton;
+}
+
+void radixSort(const std::vector<uint32_t>& keys, std::vector<uint32_t>* order)
+{
+    const size_t count = keys.size();
+    order->resize(count);
+    for(size_t i = 0; i < count; ++i)
+    {
+        (*order)[i] = uint32_t(i);
+    }
+
+    // Bits set in some key and clear in another, passes without any of them keep the order
+    uint32_t allOr  = 0;
+    uint32_t allAnd = ~0u;
+    for(const uint32_t key : keys)
+    {
+        allOr |= key;
+        allAnd &= key;
+    }
+    const uint32_t varying = allOr ^ allAnd;
+
+    std::vector<uint32_t> scratch(count);
+    for(uint32_t shift = 0; shift < 32; shift += 8)
+    {
+        if(((varying >> shift) & 0xFFu) == 0)
+        {
+            continue;
+        }
+
+        uint32_t offsets[256] = {};
+        for(const uint32_t key : keys)
+        {
+            ++offsets[(key >> shift) & 0xFFu];
+        }
+        uint32_t sum = 0;
+        for(uint32_t& offset : offsets)
+        {
+            const uint32_t n = offset;
+            offset           = sum;
+            sum += n;
+        }
+
+        for(const uint32_t index : *order)
+        {
+            scratch[offsets[(keys[index] >> shift) & 0xFFu]++] = index;
+        }
+        order->swap(scratch);
+    }
+}
+
+void sortRays(std::vector<Ray>* rays, const AABB& bounds)
+{
+    std::vector<uint32_t> keys(rays->size());
+#pragma omp parallel for schedule(static)
+    for(int i = 0; i < int(rays->size()); ++i)
+    {
+        keys[i] = rayKey((*rays)[i], bounds);
+    }
+
+    std::vector<uint32_t> order;
+    radixSort(keys, &order);
+
+    std::vector<Ray> sorted(rays->size());
+    for(size_t i = 0; i < order.size(); ++i)
+    {
+        sorted[i] = (*rays)[order[i]];
+    }
+    rays->swap(sorted);
+}
+
+}  // namespace rtutils
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Bvh.h"
+
+namespace rtutils {
+
+// ----------------------------------------------------------------------------
+//  Reorders a batch of incoherent rays, like the extension rays of a bounce, so consecutive
+//  rays traverse similar parts of the BVH. The signs of the direction select one of eight
+//  bins, within a bin rays follow a Morton curve through the bounds of their origins.
+//
+//      key = octant << 27 | morton(origin quantized to 9 bits per axis)
+//
+
+uint32_t rayKey(const Ray& ray, const AABB& bounds);
+
+// Stable LSD radix sort, 8 bits per pass. Passes over a byte that is the same in every key are
+// skipped. order receives the indices of keys in sorted order.
+void radixSort(const std::vector<uint32_t>& keys, std::vector<uint32_t>* order);
+
+// Sorts rays by rayKey, origins outside bounds are clamped to it
+void sortRays(std::vector<Ray>* rays, const AABB& bounds);
+
+}  // namespace rtutils
@@ -0,0 +1,380 @@
+#include "Reprojection.h"
+
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace rtutils {
+namespace {
+
+// Keep these in sync with denoiseTemporal.comp and reprojectAccumulation.comp
+const float kDepthTolerance  = 0.05f;
+const float kNormalTolerance = 0.9f;
+const float kMinTapWeight    = 1e-3f;
+
+// Camera of checkReprojection, looking down -z at the wall z = 0
+const uint32_t kCheckWidth  = 64;
+const uint32_t kCheckHeight = 48;
+const float    kCheckFov    = 60.0f;
+
+// Vulkan depth range like CameraControls
+glm::mat4 checkViewProj(const glm::vec3& eye)
+{
+    glm::mat4 proj = glm::perspectiveRH_ZO(glm::radians(kCheckFov),
+                                           float(kCheckWidth) / float(kCheckHeight), 0.01f, 100.0f);
+    proj[1][1] *= -1.0f;
+    return proj * glm::lookAt(eye, eye - glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// Failing pixels of one checkReprojection case, the first one ends up in the problem
+struct PixelFailures
+{
+    uint32_t  count = 0;
+    uint32_t  x     = 0;
+    uint32_t  y     = 0;
+    glm::vec4 value = glm::vec4(0.0f);
+
+    void add(uint32_t px, uint32_t py, const glm::vec4& v)
+    {
+        if(count++ == 0)
+        {
+            x     = px;
+            y     = py;
+            value = v;
+        }
+    }
+};
+
+// Pixel center rays intersected with the wall, like CpuPathTracer::renderGBuffer
+Image4f wallGBuffer(const glm::vec3& eye)
+{
+    const glm::mat4 viewProjInverse = glm::inverse(checkViewProj(eye));
+
+    Image4f normalDepth(kCheckWidth, kCheckHeight);
+    for(uint32_t y = 0; y < kCheckHeight; ++y)
+    {
+        for(uint32_t x = 0; x < kCheckWidth; ++x)
+        {
+            const glm::vec2 d = glm::vec2((x + 0.5f) / float(kCheckWidth),
+                                          (y + 0.5f) / float(kCheckHeight))
+                                    * 2.0f
+                                - 1.0f;
+            const glm::vec4 p0 = viewProjInverse * glm::vec4(d, 0.0f, 1.0f);
+            const glm::vec4 p1 = viewProjInverse * glm::vec4(d, 1.0f, 1.0f);
+
+            const glm::vec3 origin = glm::vec3(p0) / p0.w;
+            const glm::vec3 dir    = glm::normalize(glm::vec3(p1) / p1.w - origin);
+            const glm::vec3 hit    = origin - dir * (origin.z / dir.z);
+
+            normalDepth.at(x, y) = glm::vec4(0.0f, 0.0f, 1.0f, glm::distance(hit, eye));
+        }
+    }
+    return normalDepth;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+glm::vec3 reconstructWorldPosition(const FrameCamera& camera,
+                                   uint32_t           x,
+                                   uint32_t           y,
+                                   uint32_t           width,
+                                   uint32_t           height,
+                                   float              depth)
+{
+    const glm::vec2 d =
+        glm::vec2((x + 0.5f) / float(width), (y + 0.5f) / float(height)) * 2.0f - 1.0f;
+
+    const glm::vec4 p0 = camera.viewProjInverse * glm::vec4(d, 0.0f, 1.0f);
+    const glm::vec4 p1 = camera.viewProjInverse * glm::vec4(d, 1.0f, 1.0f);
+
+    const glm::vec3 dir = glm::normalize(glm::vec3(p1) / p1.w - glm::vec3(p0) / p0.w);
+    return camera.position + dir * depth;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+bool projectToPreviousFrame(const FrameCamera& camera,
+                            const glm::vec3&   worldPos,
+                            uint32_t           width,
+                            uint32_t           height,
+                            glm::vec2*         pixel)
+{
+    const glm::vec4 prevClip = camera.prevViewProj * glm::vec4(worldPos, 1.0f);
+    if(prevClip.w <= 0.0f)
+    {
+        return false;
+    }
+
+    *pixel = (glm::vec2(prevClip) / prevClip.w * 0.5f + 0.5f)
+                 * glm::vec2(float(width), float(height))
+             - 0.5f;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+bool isHistoryConsistent(const glm::vec4& normalDepth,
+                         const glm::vec4& prevNormalDepth,
+                         float            expectedDepth)
+{
+    if(prevNormalDepth.w <= 0.0f)
+    {
+        return false;
+    }
+    if(std::abs(prevNormalDepth.w - expectedDepth) > kDepthTolerance * expectedDepth)
+    {
+        return false;
+    }
+    return glm::dot(glm::vec3(normalDepth), glm::vec3(prevNormalDepth)) > kNormalTolerance;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+int findHistoryTaps(const FrameCamera& camera,
+                    const Image4f&     normalDepth,
+                    const Image4f&     prevNormalDepth,
+                    uint32_t           x,
+                    uint32_t           y,
+                    ReprojectionTap    taps[4])
+{
+    const uint32_t   width  = normalDepth.width;
+    const uint32_t   height = normalDepth.height;
+    const glm::vec4& nd     = normalDepth.at(x, y);
+    if(nd.w <= 0.0f)
+    {
+        return 0;
+    }
+
+    const glm::vec3 worldPos = reconstructWorldPosition(camera, x, y, width, height, nd.w);
+
+    glm::vec2 prevPos;
+    if(!projectToPreviousFrame(camera, worldPos, width, height, &prevPos))
+    {
+        return 0;
+    }
+
+    const glm::ivec2 base          = glm::ivec2(glm::floor(prevPos));
+    const glm::vec2  f             = prevPos - glm::vec2(base);
+    const float      expectedDepth = glm::distance(worldPos, camera.prevPosition);
+
+    int   count = 0;
+    float sumW  = 0.0f;
+    for(int i = 0; i < 4; ++i)
+    {
+        const glm::ivec2 offset(i & 1, i >> 1);
+        const glm::ivec2 q = base + offset;
+        if(q.x < 0 || q.y < 0 || q.x >= int(width) || q.y >= int(height))
+        {
+            continue;
+        }
+        if(!isHistoryConsistent(nd, prevNormalDepth.at(q.x, q.y), expectedDepth))
+        {
+            continue;
+        }
+
+        const float w =
+            (offset.x == 1 ? f.x : 1.0f - f.x) * (offset.y == 1 ? f.y : 1.0f - f.y);
+
+        taps[count].x      = uint32_t(q.x);
+        taps[count].y      = uint32_t(q.y);
+        taps[count].weight = w;
+        sumW += w;
+        ++count;
+    }
+
+    if(sumW <= kMinTapWeight)
+    {
+        return 0;
+    }
+
+    for(int i = 0; i < count; ++i)
+    {
+        taps[i].weight /= sumW;
+    }
+    return count;
+}
+
+// ----------------------------------------------------------------------------
+//  Mirrors reprojectAccumulation.comp
+//
+
+void reprojectAccumulation(const FrameCamera&          camera,
+                           const ReprojectionSettings& settings,
+                           const Image4f&              normalDepth,
+                           const Image4f&              prevNormalDepth,
+                           const Image4f&              prevAccumulation,
+                           Image4f*                    accumulation)
+{
+#pragma omp parallel for schedule(dynamic, 4)
+    for(int y = 0; y < int(normalDepth.height); ++y)
+    {
+        for(uint32_t x = 0; x < normalDepth.width; ++x)
+        {
+            ReprojectionTap taps[4];
+            const int count = findHistoryTaps(camera, normalDepth, prevNormalDepth, x, y, taps);
+
+            glm::vec4 history(0.0f);
+            for(int i = 0; i < count; ++i)
+            {
+                history += taps[i].weight * prevAccumulation.at(taps[i].x, taps[i].y);
+            }
+
+            if(history.w > settings.maxSamples)
+            {
+                history *= settings.maxSamples / history.w;
+            }
+
+            accumulation->at(x, y) += history;
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  The previous accumulation holds the coordinates of its pixels with a sample count of one, so
+//  the reprojected rgb is the bilinear position the history was taken from
+//
+
+std::vector<std::string> checkReprojection()
+{
+    std::vector<std::string> problems;
+
+    const float     distance = 4.0f;
+    const glm::vec3 eye(0.0f, 0.0f, distance);
+    const Image4f   normalDepth = wallGBuffer(eye);
+
+    Image4f prevAccumulation(kCheckWidth, kCheckHeight);
+    for(uint32_t y = 0; y < kCheckHeight; ++y)
+    {
+        for(uint32_t x = 0; x < kCheckWidth; ++x)
+        {
+            prevAccumulation.at(x, y) = glm::vec4(float(x), float(y), 0.0f, 1.0f);
+        }
+    }
+
+    const auto reproject = [&](const glm::vec3& prevEye, const Image4f& prevNormalDepth) {
+        FrameCamera camera;
+        camera.viewProjInverse = glm::inverse(checkViewProj(eye));
+        camera.prevViewProj    = checkViewProj(prevEye);
+        camera.position        = eye;
+        camera.prevPosition    = prevEye;
+
+        Image4f accumulation(kCheckWidth, kCheckHeight);
+        reprojectAccumulation(camera, ReprojectionSettings(), normalDepth, prevNormalDepth,
+                              prevAccumulation, &accumulation);
+        return accumulation;
+    };
+
+    const auto report = [&](const std::string& what, const PixelFailures& failures) {
+        if(failures.count > 0)
+        {
+            problems.push_back(what + ": " + std::to_string(failures.count) + " pixels, first ("
+                               + std::to_string(failures.x) + ", " + std::to_string(failures.y)
+                               + ") got (" + std::to_string(failures.value.x) + ", "
+                               + std::to_string(failures.value.y) + ") with weight "
+                               + std::to_string(failures.value.w));
+        }
+    };
+
+    // Static camera, every pixel maps onto itself
+    {
+        const Image4f accumulation = reproject(eye, normalDepth);
+
+        PixelFailures failures;
+        for(uint32_t y = 0; y < kCheckHeight; ++y)
+        {
+            for(uint32_t x = 0; x < kCheckWidth; ++x)
+            {
+                const glm::vec4& a = accumulation.at(x, y);
+                if(std::abs(a.x - x) > 1e-3f || std::abs(a.y - y) > 1e-3f
+                   || std::abs(a.w - 1.0f) > 1e-3f)
+                {
+                    failures.add(x, y, a);
+                }
+            }
+        }
+        report("static camera not mapped to itself", failures);
+    }
+
+    // The camera moved by translation since the previous frame, the wall appeared shifted by
+    // focal length * translation / distance pixels
+    const float     translation = 0.25f;
+    const glm::vec3 prevEye     = eye - glm::vec3(translation, 0.0f, 0.0f);
+    const float     focalLength = 0.5f * kCheckHeight / std::tan(0.5f * glm::radians(kCheckFov));
+    const float     shift       = focalLength * translation / distance;
+
+    {
+        const Image4f accumulation = reproject(prevEye, wallGBuffer(prevEye));
+
+        PixelFailures failures;
+        for(uint32_t y = 0; y < kCheckHeight; ++y)
+        {
+            for(uint32_t x = 0; x < kCheckWidth; ++x)
+            {
+                // Only pixels whose whole bilinear footprint was on screen
+                const float prevX = x + shift;
+                if(prevX > kCheckWidth - 1.0f)
+                {
+                    continue;
+                }
+
+                const glm::vec4& a = accumulation.at(x, y);
+                if(std::abs(a.w - 1.0f) > 1e-3f || std::abs(a.x - prevX) > 0.5f
+                   || std::abs(a.y - y) > 0.5f)
+                {
+                    failures.add(x, y, a);
+                }
+            }
+        }
+        report("translated camera off the analytic position", failures);
+    }
+
+    // Same motion with a box in front of the wall in the previous frame, the pixels behind it
+    // must not take any history
+    {
+        const uint32_t left = 20, right = 40, top = 12, bottom = 36;
+
+        Image4f prevNormalDepth = wallGBuffer(prevEye);
+        for(uint32_t y = top; y < bottom; ++y)
+        {
+            for(uint32_t x = left; x < right; ++x)
+            {
+                prevNormalDepth.at(x, y).w *= 0.5f;
+            }
+        }
+        const Image4f accumulation = reproject(prevEye, prevNormalDepth);
+
+        PixelFailures failures;
+        for(uint32_t y = top + 1; y + 1 < bottom; ++y)
+        {
+            for(uint32_t x = 0; x < kCheckWidth; ++x)
+            {
+                const int prevX = int(std::floor(x + shift));
+                if(prevX < int(left) || prevX + 1 >= int(right))
+                {
+                    continue;
+                }
+
+                const glm::vec4& a = accumulation.at(x, y);
+                if(a.w != 0.0f)
+                {
+                    failures.add(x, y, a);
+                }
+            }
+        }
+        report("history taken from occluded pixels", failures);
+    }
+
+    return problems;
+}
+
+}  // namespace rtutils
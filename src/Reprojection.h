@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "rtutils.h"
+
+namespace rtutils {
+
+// ----------------------------------------------------------------------------
+//  Reprojection of the first hit into the previous frame. Shared by the denoiser and the
+//  accumulation reprojection, mirrored in denoiseTemporal.comp and reprojectAccumulation.comp.
+//
+
+struct ReprojectionSettings
+{
+    bool  enabled    = true;
+    float maxSamples = 64.0f;  // Cap on the sample count carried over, limits ghosting
+};
+
+// Camera state needed to reproject the previous frame, mirrors the UBO fields
+struct FrameCamera
+{
+    glm::mat4 viewProjInverse = glm::mat4(1.0f);
+    glm::mat4 prevViewProj    = glm::mat4(1.0f);
+    glm::vec3 position        = glm::vec3(0.0f);
+    glm::vec3 prevPosition    = glm::vec3(0.0f);
+};
+
+// Previous frame pixel contributing to the history of a pixel
+struct ReprojectionTap
+{
+    uint32_t x      = 0;
+    uint32_t y      = 0;
+    float    weight = 0.0f;
+};
+
+// World position of the first hit through the center of pixel (x, y), depth is the distance
+// to the camera as stored in the G-buffer
+glm::vec3 reconstructWorldPosition(const FrameCamera& camera,
+                                   uint32_t           x,
+                                   uint32_t           y,
+                                   uint32_t           width,
+                                   uint32_t           height,
+                                   float              depth);
+
+// Continuous pixel coordinates of a world position in the previous frame, pixel centers at
+// integers. False when the point is behind the previous camera.
+bool projectToPreviousFrame(const FrameCamera& camera,
+                            const glm::vec3&   worldPos,
+                            uint32_t           width,
+                            uint32_t           height,
+                            glm::vec2*         pixel);
+
+// Disocclusion test between the current and the previous G-buffer sample
+bool isHistoryConsistent(const glm::vec4& normalDepth,
+                         const glm::vec4& prevNormalDepth,
+                         float            expectedDepth);
+
+// Bilinear footprint of pixel (x, y) in the previous frame restricted to consistent samples.
+// Weights are normalized, returns the number of taps or 0 when the pixel is disoccluded.
+int findHistoryTaps(const FrameCamera& camera,
+                    const Image4f&     normalDepth,
+                    const Image4f&     prevNormalDepth,
+                    uint32_t           x,
+                    uint32_t           y,
+                    ReprojectionTap    taps[4]);
+
+// Adds the reprojected previous accumulation (rgb: radiance sum, w: sample count) to the
+// current one, which holds only the samples traced this frame
+void reprojectAccumulation(const FrameCamera&          camera,
+                           const ReprojectionSettings& settings,
+                           const Image4f&              normalDepth,
+                           const Image4f&              prevNormalDepth,
+                           const Image4f&              prevAccumulation,
+                           Image4f*                    accumulation);
+
+// Reprojects the accumulation of a wall facing the camera and returns what went wrong: pixels of
+// a static camera not mapping to themselves, positions after a camera translation more than half
+// a pixel from the analytic ones and history taken from pixels occluded in the previous frame
+std::vector<std::string> checkReprojection();
+
+}  // namespace rtutils
@@ -0,0 +1,379 @@
+#include "SceneFile.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "IniFile.h"
+
+namespace rtutils {
+namespace {
+
+bool parseBool(const std::string& value, bool* out)
+{
+    if(value == "1" || value == "true" || value == "on")
+    {
+        *out = true;
+        return true;
+    }
+    if(value == "0" || value == "false" || value == "off")
+    {
+        *out = false;
+        return true;
+    }
+    return false;
+}
+
+// Returns an error message, empty when the value was set. Paths are stored as given.
+std::string setValue(SceneDescription*  d,
+                     const std::string& section,
+                     const std::string& key,
+                     const std::string& value)
+{
+    bool valid = true;
+    if(section == "scene")
+    {
+        if(key == "model" || key == "environment")
+        {
+            (key == "model" ? d->scene.model : d->scene.environment) = value;
+            valid = key == "environment" || !value.empty();
+        }
+        else if(key == "environmentE")
+            valid = parseValues(value, &d->scene.environmentE, 1);
+        else if(key == "translate")
+            valid = parseValues(value, &d->scene.translate.x, 3);
+        else if(key == "rotate")
+            valid = parseValues(value, &d->scene.rotate.x, 3);
+        else if(key == "scale")
+        {
+            // One value scales uniformly
+            valid = parseValues(value, &d->scene.scale.x, 3);
+            if(!valid && parseValues(value, &d->scene.scale.x, 1))
+            {
+                d->scene.scale = glm::vec3(d->scene.scale.x);
+                valid          = true;
+            }
+        }
+        else
+            return "unknown key 'scene." + key + "'";
+    }
+    else if(section == "camera")
+    {
+        if(key == "eye" || key == "target")
+        {
+            valid = parseValues(value, key == "eye" ? &d->camera.eye.x : &d->camera.target.x, 3);
+            d->camera.placed = true;
+        }
+        else if(key == "fov")
+            valid = parseValues(value, &d->camera.fov, 1) && d->camera.fov > 0.0f;
+        else if(key == "near")
+            valid = parseValues(value, &d->camera.zNear, 1) && d->camera.zNear > 0.0f;
+        else if(key == "far")
+            valid = parseValues(value, &d->camera.zFar, 1) && d->camera.zFar > 0.0f;
+        else
+            return "unknown key 'camera." + key + "'";
+    }
+    else if(section == "light")
+    {
+        if(key == "position" || key == "target")
+        {
+            glm::vec3* target = key == "position" ? &d->light.position : &d->light.target;
+            valid             = parseValues(value, &target->x, 3);
+            d->light.placed   = true;
+        }
+        else if(key == "size")
+            valid = parseValues(value, &d->light.size, 1) && d->light.size >= 0.0f;
+        else if(key == "emission")
+            valid = parseValues(value, &d->light.emission, 1);
+        else if(key == "otherE")
+            valid = parseValues(value, &d->light.otherE, 1);
+        else
+            return "unknown key 'light." + key + "'";
+    }
+    else if(section == "render")
+    {
+        auto& r = d->render;
+        if(key == "width" || key == "height")
+            valid = parseValues(value, key == "width" ? &r.width : &r.height, 1);
+        else if(key == "raytracing")
+            valid = parseBool(value, &r.raytracing);
+        else if(key == "mode")
+        {
+            r.mode = value == "path" ? 0 : value == "ao" ? 1 : -1;
+            valid  = r.mode >= 0;
+        }
+        else if(key == "spp")
+            valid = parseValues(value, &r.spp, 1) && r.spp > 0;
+        else if(key == "bounces")
+            valid = parseValues(value, &r.bounces, 1) && r.bounces >= 0;
+        else if(key == "aaRays")
+            valid = parseValues(value, &r.aaRays, 1) && r.aaRays > 0;
+        else if(key == "filterRadius")
+            valid = parseValues(value, &r.filterRadius, 1) && r.filterRadius > 0.0f;
+        else if(key == "aoRays")
+            valid = parseValues(value, &r.aoRays, 1) && r.aoRays > 0;
+        else if(key == "aoRayLength")
+            valid = parseValues(value, &r.aoRayLength, 1) && r.aoRayLength > 0.0f;
+        else if(key == "russianRouletteDepth")
+            valid = parseValues(value, &r.russianRouletteDepth, 1);
+        else if(key == "seed")
+            valid = parseValues(value, &r.seed, 1);
+        else if(key == "firstSample")
+            valid = parseValues(value, &r.firstSample, 1);
+        else
+            return "unknown key 'render." + key + "'";
+    }
+    else if(section == "output")
+    {
+        if(key == "image" || key == "accumulation")
+            (key == "image" ? d->output.image : d->output.accumulation) = value;
+        else if(key == "exit")
+            valid = parseBool(value, &d->output.exit);
+        else
+            return "unknown key 'output." + key + "'";
+    }
+    else if(section == "checkpoint")
+    {
+        if(key == "file")
+            d->checkpoint.file = value;
+        else if(key == "interval")
+            valid = parseValues(value, &d->checkpoint.interval, 1) && d->checkpoint.interval > 0.0f;
+        else if(key == "resume")
+            valid = parseBool(value, &d->checkpoint.resume);
+        else
+            return "unknown key 'checkpoint." + key + "'";
+    }
+    else
+    {
+        return "unknown section '" + section + "'";
+    }
+
+    return valid ? std::string() : "invalid value '" + value + "' for " + section + "." + key;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+glm::mat4 SceneDescription::modelTransform() const
+{
+    glm::mat4 transform = glm::translate(glm::mat4(1.0f), scene.translate);
+    transform = glm::rotate(transform, glm::radians(scene.rotate.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    transform = glm::rotate(transform, glm::radians(scene.rotate.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    transform = glm::rotate(transform, glm::radians(scene.rotate.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    return glm::scale(transform, scene.scale);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+SceneDescription loadSceneDescription(const std::string& path)
+{
+    std::ifstream file(path);
+    if(!file)
+    {
+        throw std::runtime_error("Could not open " + path);
+    }
+    return parseSceneDescription(file, path);
+}
+
+SceneDescription parseSceneDescription(std::istream& stream, const std::string& path)
+{
+    SceneDescription description;
+    for(const IniLine& line : readIni(stream, path))
+    {
+        if(line.key.empty())
+        {
+            continue;
+        }
+
+        const bool isPath = line.section == "scene"
+                            && (line.key == "model" || line.key == "environment");
+        const std::string value = isPath ? resolveIniPath(path, line.value) : line.value;
+        const std::string error = setValue(&description, line.section, line.key, value);
+        if(!error.empty())
+        {
+            throwIniError(path, line, error);
+        }
+    }
+    return description;
+}
+
+void applySceneOverride(const std::string& assignment, SceneDescription* description)
+{
+    const size_t dot    = assignment.find('.');
+    const size_t equals = assignment.find('=');
+    if(dot == std::string::npos || equals == std::string::npos || dot > equals)
+    {
+        throw std::runtime_error("Expected section.key=value, got '" + assignment + "'");
+    }
+
+    const std::string error =
+        setValue(description, assignment.substr(0, dot),
+                 assignment.substr(dot + 1, equals - dot - 1), assignment.substr(equals + 1));
+    if(!error.empty())
+    {
+        throw std::runtime_error(error);
+    }
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+std::vector<std::string> checkSceneFile()
+{
+    std::vector<std::string> problems;
+    auto expect = [&](bool ok, const std::string& what) {
+        if(!ok)
+        {
+            problems.push_back(what);
+        }
+    };
+    auto parse = [](const std::string& text) {
+        std::istringstream stream(text);
+        return parseSceneDescription(stream, "/scenes/test.ini");
+    };
+
+    // An empty file is the scene the renderer hardcoded before scene files
+    {
+        const SceneDescription d = parse("");
+        expect(d.scene.model == "../../scenes/conferenceBall/conferenceBallDragon3.obj",
+               "default model is " + d.scene.model);
+        expect(d.scene.environment.empty() && d.scene.environmentE == 1.0f,
+               "default environment");
+        expect(d.modelTransform() == glm::mat4(1.0f), "default model transform is not identity");
+        expect(!d.camera.placed && d.camera.fov == 65.0f && d.camera.zNear == 0.01f
+                   && d.camera.zFar == 100.0f,
+               "default camera");
+        expect(!d.light.placed && d.light.size == 0.02f && d.light.emission == 100.0f
+                   && d.light.otherE == 1.0f,
+               "default light");
+        const auto& r = d.render;
+        expect(!r.raytracing && r.mode == 0 && r.width == 0 && r.height == 0,
+               "default window or mode");
+        expect(r.spp == 128 && r.bounces == 3 && r.aaRays == 1 && r.filterRadius == 1.0f
+                   && r.aoRays == 16 && r.aoRayLength == 1.0f && r.russianRouletteDepth == 2
+                   && r.seed == 0 && r.firstSample == 0,
+               "default render settings");
+        expect(d.output.image.empty() && d.output.accumulation.empty() && !d.output.exit,
+               "default output");
+        expect(d.checkpoint.file.empty() && d.checkpoint.interval == 60.0f
+                   && !d.checkpoint.resume,
+               "default checkpoint");
+    }
+
+    // Every kind of value, with comments and blank lines in between
+    try
+    {
+        const SceneDescription d = parse("# Test scene\n"
+                                         "\n"
+                                         "[scene]\n"
+                                         "model       = m.obj   # Next to the file\n"
+                                         "environment = /sky/sky.hdr\n"
+                                         "scale       = 2\n"
+                                         "[camera]\n"
+                                         "eye = 1 2 3\n"
+                                         "fov = 40\n"
+                                         "[ render ]\n"
+                                         "mode = ao\n"
+                                         "spp  = 4096\n"
+                                         "raytracing = on\n"
+                                         "russianRouletteDepth = -1\n"
+                                         "[output]\n"
+                                         "image = out.pfm\n"
+                                         "exit  = true\n");
+        expect(d.scene.model == "/scenes/m.obj", "model resolved to " + d.scene.model);
+        expect(d.scene.environment == "/sky/sky.hdr", "absolute environment changed");
+        expect(d.scene.scale == glm::vec3(2.0f), "one scale value is not uniform");
+        expect(d.camera.placed && d.camera.eye == glm::vec3(1.0f, 2.0f, 3.0f)
+                   && d.camera.fov == 40.0f,
+               "camera not read");
+        expect(d.render.mode == 1 && d.render.spp == 4096 && d.render.raytracing
+                   && d.render.russianRouletteDepth == -1,
+               "render not read");
+        expect(d.output.image == "out.pfm" && d.output.exit, "output not read");
+        expect(!d.light.placed && d.render.bounces == 3, "keys not given changed");
+    }
+    catch(const std::exception& e)
+    {
+        problems.push_back(std::string("valid file rejected: ") + e.what());
+    }
+
+    // Malformed files, each with the line and the message it has to be reported with
+    const std::pair<const char*, const char*> malformed[] = {
+        {"[render]\nspp = abc", ":2: invalid value 'abc' for render.spp"},
+        {"[render]\nspp = 0", ":2: invalid value '0' for render.spp"},
+        {"[render]\nwidth = -1", ":2: invalid value '-1' for render.width"},
+        {"[camera]\neye = 1 2", ":2: invalid value '1 2' for camera.eye"},
+        {"[camera]\neye = 1 2 3 4", ":2: invalid value '1 2 3 4' for camera.eye"},
+        {"[render]\nmode = fast", ":2: invalid value 'fast' for render.mode"},
+        {"[output]\nexit = maybe", ":2: invalid value 'maybe' for output.exit"},
+        {"[scene]\nmodel =", ":2: invalid value '' for scene.model"},
+        {"[render]\nspp 128", ":2: expected key = value"},
+        {"[render]\n= 5", ":2: expected key = value"},
+        {"[unclosed\nspp = 1", ":1: expected [section]"},
+        {"[render]\nsamples = 8", ":2: unknown key 'render.samples'"},
+        {"[foo]\nbar = 1", ":2: unknown section 'foo'"},
+        {"spp = 1", ":1: unknown section ''"},
+        {"# Comment\n\n[render]\n\nspp = x  # Not a number",
+         ":5: invalid value 'x' for render.spp"},
+    };
+    for(const auto& test : malformed)
+    {
+        const std::string expected = std::string("/scenes/test.ini") + test.second;
+        try
+        {
+            parse(test.first);
+            problems.push_back("accepted '" + std::string(test.first) + "'");
+        }
+        catch(const std::exception& e)
+        {
+            expect(e.what() == expected, "expected '" + expected + "', got '" + e.what() + "'");
+        }
+    }
+
+    // Command line overrides
+    try
+    {
+        SceneDescription d;
+        applySceneOverride("render.spp=4096", &d);
+        applySceneOverride("camera.eye=1 2 3", &d);
+        applySceneOverride("scene.model=a/b.obj", &d);
+        applySceneOverride("light.emission=2.5", &d);
+        expect(d.render.spp == 4096, "override render.spp not applied");
+        expect(d.camera.placed && d.camera.eye == glm::vec3(1.0f, 2.0f, 3.0f),
+               "override camera.eye not applied");
+        expect(d.scene.model == "a/b.obj", "override path resolved to " + d.scene.model);
+        expect(d.light.emission == 2.5f, "override of a float not applied");
+    }
+    catch(const std::exception& e)
+    {
+        problems.push_back(std::string("valid override rejected: ") + e.what());
+    }
+
+    const char* badOverrides[] = {
+        "render.spp", "renderspp=4", "spp=4.render", "=4", "render.=4",
+        "render.foo=1", "foo.spp=1", "render.spp=-1", "render.spp=", "camera.eye=1,2,3",
+    };
+    for(const char* assignment : badOverrides)
+    {
+        SceneDescription d;
+        try
+        {
+            applySceneOverride(assignment, &d);
+            problems.push_back("accepted override '" + std::string(assignment) + "'");
+        }
+        catch(const std::exception&)
+        {
+        }
+    }
+    return problems;
+}
+
+}  // namespace rtutils
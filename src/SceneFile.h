@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace rtutils {
+
+// ----------------------------------------------------------------------------
+//  Everything the renderer used to hardcode, loaded from a scene file at startup. Defaults
+//  match the interactive renderer, so an empty file renders the default scene.
+//
+//      [scene]
+//      model     = conference/conference.obj
+//      rotate    = 0 90 0          # Degrees around x, y and z, applied in that order
+//      [camera]
+//      eye       = -6 4 2
+//      target    = 4 1 -1
+//      [light]
+//      position  = 0 5 0           # At the camera when not given
+//      target    = 0 0 0
+//      emission  = 200
+//      [render]
+//      spp       = 1024
+//      [output]
+//      image     = conference.pfm
+//
+//  Model and environment paths are relative to the file, output images and checkpoints to the
+//  working directory. Keys are named section.key on the command line, see applySceneOverride.
+//
+
+struct SceneDescription
+{
+    struct
+    {
+        std::string model = "../../scenes/conferenceBall/conferenceBallDragon3.obj";
+        std::string environment;  // .hdr, none when empty
+        float       environmentE = 1.0f;
+
+        // Baked into the vertices at load, the ray tracing pipeline has a single instance
+        glm::vec3 translate = glm::vec3(0.0f);
+        glm::vec3 rotate    = glm::vec3(0.0f);  // Degrees
+        glm::vec3 scale     = glm::vec3(1.0f);
+    } scene;
+
+    // CameraControls defaults unless eye or target are given
+    struct
+    {
+        bool      placed = false;
+        glm::vec3 eye    = glm::vec3(0.0f);
+        glm::vec3 target = glm::vec3(0.0f, 0.0f, -1.0f);
+        float     fov    = 65.0f;  // Vertical, degrees
+        float     zNear  = 0.01f;
+        float     zFar   = 100.0f;
+    } camera;
+
+    // Square area light, follows the camera on startup unless position or target are given
+    struct
+    {
+        bool      placed   = false;
+        glm::vec3 position = glm::vec3(0.0f);
+        glm::vec3 target   = glm::vec3(0.0f, 0.0f, -1.0f);
+        float     size     = 0.02f;
+        float     emission = 100.0f;
+        float     otherE   = 1.0f;  // Emissive triangles of the model
+    } light;
+
+    struct
+    {
+        uint32_t width                = 0;  // Window size, 90% of the monitor height when zero
+        uint32_t height               = 0;
+        bool     raytracing           = false;
+        int      mode                 = 0;  // 0: path tracing, 1: ambient occlusion
+        int      spp                  = 128;
+        int      bounces              = 3;
+        int      aaRays               = 1;
+        float    filterRadius         = 1.0f;
+        int      aoRays               = 16;
+        float    aoRayLength          = 1.0f;
+        int      russianRouletteDepth = 2;  // Negative disables Russian roulette
+        uint32_t seed                 = 0;  // Sobol scrambles, random when zero
+        uint32_t firstSample          = 0;  // Sobol index offset, see pathtracer_distribute
+    } render;
+
+    struct
+    {
+        std::string image;         // Resolved accumulation as .pfm once spp is reached
+        std::string accumulation;  // Raw accumulation for merging, see writeAccumulation
+        bool        exit = false;  // Close the window after writing the outputs
+    } output;
+
+    // Accumulation, iteration, scrambles, camera and light, written while accumulating
+    struct
+    {
+        std::string file;              // None when empty
+        float       interval = 60.0f;  // Seconds between checkpoints
+        bool        resume   = false;  // Continue from file when it matches the render target
+    } checkpoint;
+
+    // Model to world of scene.translate, rotate and scale
+    glm::mat4 modelTransform() const;
+};
+
+// Throws std::runtime_error naming the file and line on unknown keys or malformed values
+SceneDescription loadSceneDescription(const std::string& path);
+
+// Scene file text, relative paths are resolved against the directory of path
+SceneDescription parseSceneDescription(std::istream& stream, const std::string& path);
+
+// Applies "section.key=value", e.g. "render.spp=4096". Paths are taken as given. Throws
+// std::runtime_error on unknown keys or malformed values.
+void applySceneOverride(const std::string& assignment, SceneDescription* description);
+
+// Parses sample files and overrides, returns what went wrong: defaults that differ from the
+// scene the renderer used to hardcode, values not read, and malformed values, unknown keys or
+// bad override syntax that were accepted or reported without the file and line
+std::vector<std::string> checkSceneFile();
+
+}  // namespace rtutils
@@ -0,0 +1,463 @@
+#include "TextureResidency.h"
+
+#include <algorithm>
+
+#include "rtutils.h"
+
+namespace rtutils {
+
+MipChain buildMipChain(const uint8_t* pixels, uint32_t width, uint32_t height)
+{
+    MipChain chain;
+    chain.width  = width;
+    chain.height = height;
+    chain.levels.emplace_back(pixels, pixels + size_t(width) * height * 4);
+
+    for(uint32_t level = 1; level < TextureResidency::levelCount(width, height); ++level)
+    {
+        const std::vector<uint8_t>& src = chain.levels[level - 1];
+        const uint32_t              sw  = chain.levelWidth(level - 1);
+        const uint32_t              sh  = chain.levelHeight(level - 1);
+        const uint32_t              w   = chain.levelWidth(level);
+        const uint32_t              h   = chain.levelHeight(level);
+
+        // 2x2 box, a side that is already 1 texel wide averages the same texel twice
+        std::vector<uint8_t> dst(size_t(w) * h * 4);
+        for(uint32_t y = 0; y < h; ++y)
+        {
+            const uint32_t y0 = std::min(2 * y, sh - 1);
+            const uint32_t y1 = std::min(2 * y + 1, sh - 1);
+            for(uint32_t x = 0; x < w; ++x)
+            {
+                const uint32_t x0 = std::min(2 * x, sw - 1);
+                const uint32_t x1 = std::min(2 * x + 1, sw - 1);
+                for(uint32_t c = 0; c < 4; ++c)
+                {
+                    const uint32_t sum = src[(size_t(y0) * sw + x0) * 4 + c]
+                                         + src[(size_t(y0) * sw + x1) * 4 + c]
+                                         + src[(size_t(y1) * sw + x0) * 4 + c]
+                                         + src[(size_t(y1) * sw + x1) * 4 + c];
+                    dst[(size_t(y) * w + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+        chain.levels.push_back(std::move(dst));
+    }
+    return chain;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+uint32_t TextureResidency::levelCount(uint32_t width, uint32_t height)
+{
+    uint32_t count = 1;
+    for(uint32_t size = std::max(width, height); size > 1; size >>= 1)
+    {
+        ++count;
+    }
+    return count;
+}
+
+uint64_t TextureResidency::chainBytes(uint32_t width,
+                                      uint32_t height,
+                                      uint32_t bytesPerPixel,
+                                      uint32_t first)
+{
+    uint64_t bytes = 0;
+    for(uint32_t level = first; level < levelCount(width, height); ++level)
+    {
+        bytes += uint64_t(std::max(width >> level, 1u)) * std::max(height >> level, 1u)
+                 * bytesPerPixel;
+    }
+    return bytes;
+}
+
+uint32_t TextureResidency::baseMip(uint32_t width, uint32_t height) const
+{
+    const uint32_t levels = levelCount(width, height);
+    uint32_t       mip    = 0;
+    while(mip + 1 < levels && std::max(width >> mip, height >> mip) > m_settings.baseSize)
+    {
+        ++mip;
+    }
+    return mip;
+}
+
+uint64_t TextureResidency::extraBytes(const Entry& entry, uint32_t mip) const
+{
+    return chainBytes(entry.width, entry.height, entry.bytesPerPixel, mip)
+           - chainBytes(entry.width, entry.height, entry.bytesPerPixel, entry.baseMip);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void TextureResidency::setTexture(uint32_t texture,
+                                  uint32_t width,
+                                  uint32_t height,
+                                  uint32_t bytesPerPixel)
+{
+    if(texture >= m_entries.size())
+    {
+        m_entries.resize(texture + 1);
+    }
+    Entry& entry = m_entries[texture];
+    if(entry.tracked)
+    {
+        m_residentBytes -= extraBytes(entry, entry.residentMip);
+    }
+
+    entry               = Entry();
+    entry.tracked       = true;
+    entry.width         = width;
+    entry.height        = height;
+    entry.bytesPerPixel = bytesPerPixel;
+    entry.baseMip       = baseMip(width, height);
+    entry.residentMip   = entry.baseMip;
+    entry.wantedMip   = entry.baseMip;
+}
+
+void TextureResidency::clear()
+{
+    m_entries.clear();
+    m_residentBytes = 0;
+}
+
+bool TextureResidency::isTracked(uint32_t texture) const
+{
+    return texture < m_entries.size() && m_entries[texture].tracked;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+std::vector<TextureResidency::Change> TextureResidency::update(
+    const std::vector<uint32_t>& requestedSizes,
+    uint64_t                     frame)
+{
+    std::vector<uint32_t> candidates;
+    for(uint32_t i = 0; i < m_entries.size(); ++i)
+    {
+        Entry& entry = m_entries[i];
+        if(!entry.tracked)
+        {
+            continue;
+        }
+
+        const uint32_t requested = i < requestedSizes.size() ? requestedSizes[i] : 0;
+        if(requested > 0)
+        {
+            // Coarsest level still at least as large as requested
+            const uint32_t size = std::max(entry.width, entry.height);
+            entry.wantedMip     = 0;
+            while(entry.wantedMip < entry.baseMip && (size >> (entry.wantedMip + 1)) >= requested)
+            {
+                ++entry.wantedMip;
+            }
+            entry.lastUsed = frame;
+            if(entry.wantedMip < entry.residentMip)
+            {
+                candidates.push_back(i);
+            }
+        }
+    }
+
+    // Largest deficit first, the most recently used of equal ones
+    std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+        const Entry&   ea = m_entries[a];
+        const Entry&   eb = m_entries[b];
+        const uint32_t da = ea.residentMip - ea.wantedMip;
+        const uint32_t db = eb.residentMip - eb.wantedMip;
+        return da != db ? da > db : ea.lastUsed > eb.lastUsed;
+    });
+
+    std::vector<Change> changes;
+    std::vector<bool>   changed(m_entries.size(), false);
+
+    // A smaller budget than last time evicts even without upgrades
+    if(m_residentBytes > m_settings.budgetBytes)
+    {
+        makeRoom(0, frame, &changed, &changes);
+    }
+
+    uint64_t uploaded = 0;
+    for(uint32_t i : candidates)
+    {
+        Entry& entry = m_entries[i];
+        if(changed[i])
+        {
+            continue;
+        }
+
+        // Falls back to coarser levels than wanted when the finest one doesn't fit
+        for(uint32_t mip = entry.wantedMip; mip < entry.residentMip; ++mip)
+        {
+            const uint64_t upload =
+                chainBytes(entry.width, entry.height, entry.bytesPerPixel, mip);
+            if(uploaded > 0 && uploaded + upload > m_settings.uploadBytes)
+            {
+                continue;
+            }
+
+            const uint64_t grow = extraBytes(entry, mip) - extraBytes(entry, entry.residentMip);
+            changed[i]          = true;
+            if(!makeRoom(grow, frame, &changed, &changes))
+            {
+                changed[i] = false;
+                continue;
+            }
+
+            m_residentBytes += grow;
+            entry.residentMip = mip;
+            changes.push_back({i, mip});
+            uploaded += upload;
+            break;
+        }
+    }
+    return changes;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+bool TextureResidency::makeRoom(uint64_t             bytes,
+                                uint64_t             frame,
+                                std::vector<bool>*   changed,
+                                std::vector<Change>* changes)
+{
+    if(m_residentBytes + bytes <= m_settings.budgetBytes)
+    {
+        return true;
+    }
+
+    struct Victim
+    {
+        uint32_t texture;
+        uint32_t mip;  // Level it drops to
+        uint64_t freed;
+        bool     unused;
+    };
+
+    std::vector<Victim> victims;
+    uint64_t            freeable = 0;
+    for(uint32_t i = 0; i < m_entries.size(); ++i)
+    {
+        const Entry& entry = m_entries[i];
+        if(!entry.tracked || (*changed)[i])
+        {
+            continue;
+        }
+
+        const bool     unused = entry.lastUsed < frame;
+        const uint32_t mip    = unused ? entry.baseMip : entry.wantedMip;
+        if(mip > entry.residentMip)
+        {
+            const uint64_t freed = extraBytes(entry, entry.residentMip) - extraBytes(entry, mip);
+            victims.push_back({i, mip, freed, unused});
+            freeable += freed;
+        }
+    }
+
+    // Partial eviction is wanted only to get back under the budget on its own
+    const bool fits = m_residentBytes + bytes <= m_settings.budgetBytes + freeable;
+    if(!fits && bytes > 0)
+    {
+        return false;
+    }
+
+    // Least recently used first, then the ones holding more than they were asked for
+    std::sort(victims.begin(), victims.end(), [this](const Victim& a, const Victim& b) {
+        if(a.unused != b.unused)
+        {
+            return a.unused;
+        }
+        return m_entries[a.texture].lastUsed < m_entries[b.texture].lastUsed;
+    });
+
+    for(const Victim& victim : victims)
+    {
+        if(m_residentBytes + bytes <= m_settings.budgetBytes)
+        {
+            break;
+        }
+        m_entries[victim.texture].residentMip = victim.mip;
+        m_residentBytes -= victim.freed;
+        (*changed)[victim.texture] = true;
+        changes->push_back({victim.texture, victim.mip});
+    }
+    return fits;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+namespace {
+
+struct TestTexture
+{
+    uint32_t width;
+    uint32_t height;
+};
+
+// update() and what has to hold after every one of them
+std::vector<TextureResidency::Change> checkedUpdate(TextureResidency*               residency,
+                                                    const std::vector<TestTexture>& textures,
+                                                    const std::vector<uint32_t>&    requests,
+                                                    uint64_t                        frame,
+                                                    std::vector<std::string>*       problems)
+{
+    const auto problem = [&](const std::string& what) {
+        problems->push_back("frame " + std::to_string(frame) + ": " + what);
+    };
+
+    std::vector<uint32_t> before(textures.size());
+    for(uint32_t i = 0; i < textures.size(); ++i)
+    {
+        before[i] = residency->getResidentMip(i);
+    }
+
+    const std::vector<TextureResidency::Change> changes = residency->update(requests, frame);
+
+    uint64_t uploaded = 0;
+    uint32_t upgrades = 0;
+    for(const TextureResidency::Change& change : changes)
+    {
+        const TestTexture& t = textures[change.texture];
+        if(change.residentMip < before[change.texture])
+        {
+            uploaded += TextureResidency::chainBytes(t.width, t.height, 4, change.residentMip);
+            ++upgrades;
+        }
+        if(residency->getResidentMip(change.texture) != change.residentMip)
+        {
+            problem("texture " + std::to_string(change.texture) + " changed twice");
+        }
+    }
+    if(upgrades > 1 && uploaded > residency->m_settings.uploadBytes)
+    {
+        problem("uploaded " + std::to_string(uploaded) + " bytes");
+    }
+
+    uint64_t resident = 0;
+    for(uint32_t i = 0; i < textures.size(); ++i)
+    {
+        const TestTexture& t    = textures[i];
+        const uint32_t     mip  = residency->getResidentMip(i);
+        const uint32_t     base = residency->getBaseMip(i);
+        if(mip > base)
+        {
+            problem("texture " + std::to_string(i) + " is coarser than its base mip");
+        }
+        resident += TextureResidency::chainBytes(t.width, t.height, 4, mip)
+                    - TextureResidency::chainBytes(t.width, t.height, 4, base);
+    }
+    if(resident != residency->getResidentBytes())
+    {
+        problem("resident bytes are " + std::to_string(residency->getResidentBytes())
+                + ", the resident mips hold " + std::to_string(resident));
+    }
+    if(resident > residency->m_settings.budgetBytes)
+    {
+        problem(std::to_string(resident) + " bytes resident over a budget of "
+                + std::to_string(residency->m_settings.budgetBytes));
+    }
+    return changes;
+}
+
+std::string describe(const std::vector<TextureResidency::Change>& changes)
+{
+    std::string text;
+    for(const TextureResidency::Change& change : changes)
+    {
+        text += (text.empty() ? "" : " ") + std::to_string(change.texture) + ":"
+                + std::to_string(change.residentMip);
+    }
+    return "changes '" + text + "'";
+}
+
+}  // namespace
+
+std::vector<std::string> checkTextureResidency()
+{
+    std::vector<std::string> problems;
+
+    // Random sizes and feedback under a budget that holds a few full chains
+    {
+        Pcg32                    rng(11);
+        std::vector<TestTexture> textures(40);
+        TextureResidency         residency;
+        residency.m_settings.budgetBytes = 16ull << 20;
+        residency.m_settings.uploadBytes = 4ull << 20;
+        for(uint32_t i = 0; i < textures.size(); ++i)
+        {
+            textures[i] = {1 + rng.next() % 4096, 1 + rng.next() % 4096};
+            residency.setTexture(i, textures[i].width, textures[i].height);
+        }
+        for(uint64_t frame = 1; frame <= 200; ++frame)
+        {
+            std::vector<uint32_t> requests(textures.size(), 0);
+            for(uint32_t& size : requests)
+            {
+                size = rng.next() % 3 == 0 ? 1 + rng.next() % 4096 : 0;
+            }
+            checkedUpdate(&residency, textures, requests, frame, &problems);
+        }
+    }
+
+    // Room for two full chains, the texture unused for longest goes back to its base mip
+    {
+        const std::vector<TestTexture> textures(3, {512, 512});
+        TextureResidency               residency;
+        for(uint32_t i = 0; i < textures.size(); ++i)
+        {
+            residency.setTexture(i, 512, 512);
+        }
+        residency.m_settings.budgetBytes =
+            2 * (TextureResidency::chainBytes(512, 512, 4, 0)
+                 - TextureResidency::chainBytes(512, 512, 4, residency.getBaseMip(0)));
+
+        checkedUpdate(&residency, textures, {512, 512, 0}, 1, &problems);
+        checkedUpdate(&residency, textures, {0, 512, 0}, 2, &problems);
+        const auto changes = checkedUpdate(&residency, textures, {0, 0, 512}, 3, &problems);
+        if(residency.getResidentMip(0) != residency.getBaseMip(0)
+           || residency.getResidentMip(1) != 0 || residency.getResidentMip(2) != 0)
+        {
+            problems.push_back("least recently used texture not evicted, " + describe(changes));
+        }
+    }
+
+    // Deficits of 3, 4, 2 and 1 mips with uploads for the two largest, the rest comes next
+    {
+        const std::vector<TestTexture> textures(4, {1024, 1024});
+        const std::vector<uint32_t>    requests = {512, 1024, 256, 128};
+        TextureResidency               residency;
+        for(uint32_t i = 0; i < textures.size(); ++i)
+        {
+            residency.setTexture(i, 1024, 1024);
+        }
+        residency.m_settings.uploadBytes = TextureResidency::chainBytes(1024, 1024, 4, 0)
+                                           + TextureResidency::chainBytes(1024, 1024, 4, 1);
+
+        auto changes = checkedUpdate(&residency, textures, requests, 1, &problems);
+        if(changes.size() != 2 || changes[0].texture != 1 || changes[0].residentMip != 0
+           || changes[1].texture != 0 || changes[1].residentMip != 1)
+        {
+            problems.push_back("expected upgrades 1:0 0:1, got " + describe(changes));
+        }
+        changes = checkedUpdate(&residency, textures, requests, 2, &problems);
+        if(changes.size() != 2 || changes[0].texture != 2 || changes[0].residentMip != 2
+           || changes[1].texture != 3 || changes[1].residentMip != 3)
+        {
+            problems.push_back("expected upgrades 2:2 3:3, got " + describe(changes));
+        }
+    }
+    return problems;
+}
+
+}  // namespace rtutils
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace rtutils {
+
+// Box filtered mip pyramid of an RGBA8 image, levels[0] is the image itself
+struct MipChain
+{
+    uint32_t                          width  = 0;
+    uint32_t                          height = 0;
+    std::vector<std::vector<uint8_t>> levels;
+
+    uint32_t levelWidth(uint32_t level) const { return width >> level ? width >> level : 1; }
+    uint32_t levelHeight(uint32_t level) const { return height >> level ? height >> level : 1; }
+};
+
+MipChain buildMipChain(const uint8_t* pixels, uint32_t width, uint32_t height);
+
+struct TextureResidencySettings
+{
+    uint64_t budgetBytes = 512ull << 20;  // Levels above the base mips
+    uint32_t baseSize    = 64;            // Largest side of the mip every texture keeps
+    uint64_t uploadBytes = 64ull << 20;   // Per update, the first upgrade is always taken
+};
+
+// ----------------------------------------------------------------------------
+//  Decides which mip level of each texture is the finest one resident on the GPU.
+//
+//  Every texture keeps its base mip, at most baseSize texels on a side. Feedback from the ray
+//  generation shader requests a texel size per texture and upgrades go to the largest deficit
+//  first. When the budget runs out textures not requested in the latest feedback are dropped
+//  back to their base mip, least recently used first, then those holding finer mips than they
+//  were last asked for. Pure bookkeeping, a simulated feedback stream drives it just as well.
+//
+
+class TextureResidency
+{
+    public:
+    struct Change
+    {
+        uint32_t texture;
+        uint32_t residentMip;  // New finest resident level
+    };
+
+    // Starts tracking texture at its base mip, replacing what was tracked in its slot
+    void setTexture(uint32_t texture, uint32_t width, uint32_t height, uint32_t bytesPerPixel = 4);
+    void clear();
+
+    // requestedSizes[i] is the size in texels texture i was asked for across its larger side, 0
+    // when it was not sampled. Returns the residency changes to apply, frame orders the uses.
+    std::vector<Change> update(const std::vector<uint32_t>& requestedSizes, uint64_t frame);
+
+    // Level a width x height texture keeps resident, the one setTexture starts it at
+    uint32_t baseMip(uint32_t width, uint32_t height) const;
+
+    bool     isTracked(uint32_t texture) const;
+    uint32_t getBaseMip(uint32_t texture) const { return m_entries[texture].baseMip; }
+    uint32_t getResidentMip(uint32_t texture) const { return m_entries[texture].residentMip; }
+
+    // Bytes resident above the base mips, what the budget limits
+    uint64_t getResidentBytes() const { return m_residentBytes; }
+
+    // Bytes of levels first up to the 1x1 level of a width x height image
+    static uint64_t chainBytes(uint32_t width, uint32_t height, uint32_t bytesPerPixel,
+                               uint32_t first);
+    static uint32_t levelCount(uint32_t width, uint32_t height);
+
+    TextureResidencySettings m_settings;
+
+    private:
+    struct Entry
+    {
+        bool     tracked       = false;
+        uint32_t width         = 0;
+        uint32_t height        = 0;
+        uint32_t bytesPerPixel = 4;
+        uint32_t baseMip       = 0;
+        uint32_t residentMip   = 0;
+        uint32_t wantedMip     = 0;  // Of the latest request
+        uint64_t lastUsed      = 0;
+    };
+
+    // Bytes resident above the base mip when mip is the finest level
+    uint64_t extraBytes(const Entry& entry, uint32_t mip) const;
+
+    // Drops other textures until bytes fit into the budget, false and nothing dropped when they
+    // can't. Textures already in changed are left alone, dropped ones are added.
+    bool makeRoom(uint64_t             bytes,
+                  uint64_t             frame,
+                  std::vector<bool>*   changed,
+                  std::vector<Change>* changes);
+
+    std::vector<Entry> m_entries;
+    uint64_t           m_residentBytes = 0;
+};
+
+// Drives TextureResidency with synthetic feedback and returns what went wrong: resident bytes
+// over the budget or not matching the resident mips, uploads past the per update limit, least
+// recently used textures not dropped to their base mip and upgrades out of deficit order
+std::vector<std::string> checkTextureResidency();
+
+}  // namespace rtutils
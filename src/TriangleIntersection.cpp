@@ -0,0 +1,529 @@
+#include "TriangleIntersection.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <utility>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Model.h"
+#include "PacketTraversal.h"
+
+namespace rtutils {
+namespace {
+
+using Clock        = std::chrono::high_resolution_clock;
+using Milliseconds = std::chrono::duration<double, std::milli>;
+
+const TriangleKernel kKernels[] = {TriangleKernel::Scalar, TriangleKernel::Sse,
+                                   TriangleKernel::Avx2};
+
+template <uint32_t Width>
+void buildBlocks(const std::vector<glm::vec3>& vertices, std::vector<TriangleBlock<Width>>* blocks)
+{
+    const size_t triangles = vertices.size() / 3;
+    blocks->resize((triangles + Width - 1) / Width);
+    for(size_t b = 0; b < blocks->size(); ++b)
+    {
+        TriangleBlock<Width>& block = (*blocks)[b];
+        for(uint32_t lane = 0; lane < Width; ++lane)
+        {
+            const size_t triangle = std::min(b * Width + lane, triangles - 1);
+            for(int axis = 0; axis < 3; ++axis)
+            {
+                block.v0[axis][lane] = vertices[3 * triangle + 0][axis];
+                block.v1[axis][lane] = vertices[3 * triangle + 1][axis];
+                block.v2[axis][lane] = vertices[3 * triangle + 2][axis];
+            }
+            block.id[lane] = uint32_t(triangle);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  Test meshes for checkWatertight, in a local frame with z up and the surface near z = 0
+//
+
+struct TestMesh
+{
+    std::vector<VkTools::VertexPNTC> vertices;
+    std::vector<uint32_t>            indices;
+    std::vector<uint32_t>            interiorVertices;
+    glm::vec3                        center;
+    float                            extent;
+};
+
+// Jittered height field, quads split along alternating diagonals
+TestMesh heightField(uint32_t n)
+{
+    TestMesh mesh;
+    Pcg32    rng(7);
+    for(uint32_t j = 0; j <= n; ++j)
+    {
+        for(uint32_t i = 0; i <= n; ++i)
+        {
+            const bool interior = i > 0 && i < n && j > 0 && j < n;
+            glm::vec3  p(float(i), float(j), 0.0f);
+            if(interior)
+            {
+                p.x += 0.6f * (rng.uniform() - 0.5f);
+                p.y += 0.6f * (rng.uniform() - 0.5f);
+                mesh.interiorVertices.push_back(uint32_t(mesh.vertices.size()));
+            }
+            p.z = 0.3f * std::sin(0.7f * p.x) * std::cos(0.5f * p.y);
+
+            VkTools::VertexPNTC v;
+            v.p = p;
+            mesh.vertices.push_back(v);
+        }
+    }
+    for(uint32_t j = 0; j < n; ++j)
+    {
+        for(uint32_t i = 0; i < n; ++i)
+        {
+            const uint32_t a = j * (n + 1) + i;
+            const uint32_t b = a + 1;
+            const uint32_t c = a + n + 1;
+            const uint32_t d = c + 1;
+            if((i + j) % 2 == 0)
+            {
+                mesh.indices.insert(mesh.indices.end(), {a, b, d, a, d, c});
+            }
+            else
+            {
+                mesh.indices.insert(mesh.indices.end(), {a, b, c, b, d, c});
+            }
+        }
+    }
+    mesh.center = glm::vec3(0.5f * n, 0.5f * n, 0.0f);
+    mesh.extent = float(n);
+    return mesh;
+}
+
+// Thin triangles around a shared vertex, closed all the way around
+TestMesh fan(uint32_t spokes)
+{
+    TestMesh mesh;
+    Pcg32    rng(11);
+
+    VkTools::VertexPNTC center;
+    center.p = glm::vec3(0.0f);
+    mesh.vertices.push_back(center);
+    mesh.interiorVertices.push_back(0);
+    for(uint32_t k = 0; k < spokes; ++k)
+    {
+        const float angle = 2.0f * 3.14159265f * (k + 0.3f * rng.uniform()) / spokes;
+        const float r     = 0.5f + rng.uniform();
+
+        VkTools::VertexPNTC v;
+        v.p = glm::vec3(r * std::cos(angle), r * std::sin(angle),
+                        0.05f * r * std::sin(3.0f * angle));
+        mesh.vertices.push_back(v);
+        mesh.indices.insert(mesh.indices.end(), {0, 1 + k, 1 + (k + 1) % spokes});
+    }
+    mesh.center = glm::vec3(0.0f);
+    mesh.extent = 2.0f;
+    return mesh;
+}
+
+// Points on every edge shared by two triangles and every interior vertex
+std::vector<glm::vec3> edgeTargets(const TestMesh& mesh)
+{
+    std::map<std::pair<uint32_t, uint32_t>, uint32_t> edges;
+    for(size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+    {
+        for(int e = 0; e < 3; ++e)
+        {
+            const uint32_t a = mesh.indices[t + e];
+            const uint32_t b = mesh.indices[t + (e + 1) % 3];
+            ++edges[std::make_pair(std::min(a, b), std::max(a, b))];
+        }
+    }
+
+    std::vector<glm::vec3> targets;
+    for(const uint32_t i : mesh.interiorVertices)
+    {
+        targets.push_back(mesh.vertices[i].p);
+    }
+    for(const auto& edge : edges)
+    {
+        if(edge.second != 2)
+        {
+            continue;
+        }
+        const glm::vec3& a = mesh.vertices[edge.first.first].p;
+        const glm::vec3& b = mesh.vertices[edge.first.second].p;
+        for(const float s : {0.5f, 1.0f / 3.0f, 0.999f})
+        {
+            targets.push_back(a + s * (b - a));
+        }
+    }
+    return targets;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+const char* toString(TriangleKernel kernel)
+{
+    switch(kernel)
+    {
+        case TriangleKernel::Sse:
+            return "sse";
+        case TriangleKernel::Avx2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+bool triangleKernelSupported(TriangleKernel kernel)
+{
+    switch(kernel)
+    {
+        case TriangleKernel::Sse:
+            return triangleKernelSseCompiled();
+        case TriangleKernel::Avx2:
+            return simdLevelSupported(SimdLevel::Avx2);
+        default:
+            return true;
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  The largest direction component becomes z, x and y are swapped for negative z to keep the
+//  winding
+//
+
+WatertightRay makeWatertightRay(const Ray& ray)
+{
+    const glm::vec3 absDir = glm::abs(ray.dir);
+
+    WatertightRay r;
+    r.kz = absDir.x > absDir.y ? (absDir.x > absDir.z ? 0 : 2) : (absDir.y > absDir.z ? 1 : 2);
+    r.kx = (r.kz + 1) % 3;
+    r.ky = (r.kx + 1) % 3;
+    if(ray.dir[r.kz] < 0.0f)
+    {
+        std::swap(r.kx, r.ky);
+    }
+
+    r.sx   = ray.dir[r.kx] / ray.dir[r.kz];
+    r.sy   = ray.dir[r.ky] / ray.dir[r.kz];
+    r.sz   = 1.0f / ray.dir[r.kz];
+    r.ox   = ray.origin.x;
+    r.oy   = ray.origin.y;
+    r.oz   = ray.origin.z;
+    r.tmin = ray.tmin;
+    r.tmax = ray.tmax;
+    return r;
+}
+
+void watertightEdgesDouble(const WatertightRay& ray,
+                           const float*         v0,
+                           const float*         v1,
+                           const float*         v2,
+                           size_t               stride,
+                           float*               u,
+                           float*               v,
+                           float*               w)
+{
+    const float origin[3] = {ray.ox, ray.oy, ray.oz};
+
+    // Same float shear as the kernels, only the products are exact
+    const auto shear = [&](const float* p, float* x, float* y) {
+        const float px = p[ray.kx * stride] - origin[ray.kx];
+        const float py = p[ray.ky * stride] - origin[ray.ky];
+        const float pz = p[ray.kz * stride] - origin[ray.kz];
+        *x             = px - ray.sx * pz;
+        *y             = py - ray.sy * pz;
+    };
+    float ax, ay, bx, by, cx, cy;
+    shear(v0, &ax, &ay);
+    shear(v1, &bx, &by);
+    shear(v2, &cx, &cy);
+
+    *u = float(double(cx) * double(by) - double(cy) * double(bx));
+    *v = float(double(ax) * double(cy) - double(ay) * double(cx));
+    *w = float(double(bx) * double(ay) - double(by) * double(ax));
+}
+
+bool intersectWatertight(const WatertightRay& ray,
+                         const glm::vec3&     v0,
+                         const glm::vec3&     v1,
+                         const glm::vec3&     v2,
+                         TriangleHit*         hit)
+{
+    const glm::vec3 origin(ray.ox, ray.oy, ray.oz);
+    const glm::vec3 A = v0 - origin;
+    const glm::vec3 B = v1 - origin;
+    const glm::vec3 C = v2 - origin;
+
+    const float Ax = A[ray.kx] - ray.sx * A[ray.kz];
+    const float Ay = A[ray.ky] - ray.sy * A[ray.kz];
+    const float Bx = B[ray.kx] - ray.sx * B[ray.kz];
+    const float By = B[ray.ky] - ray.sy * B[ray.kz];
+    const float Cx = C[ray.kx] - ray.sx * C[ray.kz];
+    const float Cy = C[ray.ky] - ray.sy * C[ray.kz];
+
+    float U = Cx * By - Cy * Bx;
+    float V = Ax * Cy - Ay * Cx;
+    float W = Bx * Ay - By * Ax;
+    if(U == 0.0f || V == 0.0f || W == 0.0f)
+    {
+        watertightEdgesDouble(ray, &v0.x, &v1.x, &v2.x, 1, &U, &V, &W);
+    }
+
+    if((U < 0.0f || V < 0.0f || W < 0.0f) && (U > 0.0f || V > 0.0f || W > 0.0f))
+    {
+        return false;
+    }
+    const float det = U + V + W;
+    if(det == 0.0f)
+    {
+        return false;
+    }
+
+    const float T =
+        U * (ray.sz * A[ray.kz]) + V * (ray.sz * B[ray.kz]) + W * (ray.sz * C[ray.kz]);
+    const float absDet = det < 0.0f ? -det : det;
+    const float tScale = det < 0.0f ? -T : T;
+    if(tScale < ray.tmin * absDet || tScale > ray.tmax * absDet)
+    {
+        return false;
+    }
+
+    const float rcpDet = 1.0f / det;
+    const float t      = T * rcpDet;
+    if(!(t < hit->t))
+    {
+        return false;
+    }
+    hit->t = t;
+    hit->u = V * rcpDet;
+    hit->v = W * rcpDet;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void TriangleSoup::build(const std::vector<VkTools::VertexPNTC>& vertices,
+                         const std::vector<uint32_t>&            indices)
+{
+    m_vertices.clear();
+    m_vertices.reserve(indices.size() - indices.size() % 3);
+    for(size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        m_vertices.push_back(vertices[indices[i + 0]].p);
+        m_vertices.push_back(vertices[indices[i + 1]].p);
+        m_vertices.push_back(vertices[indices[i + 2]].p);
+    }
+
+    m_blocks4.clear();
+    m_blocks8.clear();
+    if(!m_vertices.empty())
+    {
+        buildBlocks(m_vertices, &m_blocks4);
+        buildBlocks(m_vertices, &m_blocks8);
+    }
+}
+
+bool TriangleSoup::intersect(const Ray& ray, TriangleKernel kernel, RayHit* hit) const
+{
+    const WatertightRay r = makeWatertightRay(ray);
+    TriangleHit         closest;
+    switch(kernel)
+    {
+        case TriangleKernel::Sse:
+            for(const TriangleBlock<4>& block : m_blocks4)
+            {
+                intersectTrianglesSse(r, block, &closest);
+            }
+            break;
+        case TriangleKernel::Avx2:
+            for(const TriangleBlock<8>& block : m_blocks8)
+            {
+                intersectTrianglesAvx2(r, block, &closest);
+            }
+            break;
+        default:
+            for(size_t i = 0; i < numTriangles(); ++i)
+            {
+                if(intersectWatertight(r, m_vertices[3 * i + 0], m_vertices[3 * i + 1],
+                                       m_vertices[3 * i + 2], &closest))
+                {
+                    closest.triangle = uint32_t(i);
+                }
+            }
+            break;
+    }
+
+    if(closest.triangle == ~0u)
+    {
+        return false;
+    }
+    hit->t            = closest.t;
+    hit->triangle     = closest.triangle;
+    hit->barycentrics = glm::vec2(closest.u, closest.v);
+    return true;
+}
+
+bool TriangleSoup::occluded(const Ray& ray, TriangleKernel kernel, uint64_t* tests) const
+{
+    const WatertightRay r        = makeWatertightRay(ray);
+    bool                occluded = false;
+    size_t              tested   = 0;
+    switch(kernel)
+    {
+        case TriangleKernel::Sse:
+            for(size_t b = 0; b < m_blocks4.size() && !occluded; ++b)
+            {
+                occluded = occludedTrianglesSse(r, m_blocks4[b]);
+                tested += 4;
+            }
+            break;
+        case TriangleKernel::Avx2:
+            for(size_t b = 0; b < m_blocks8.size() && !occluded; ++b)
+            {
+                occluded = occludedTrianglesAvx2(r, m_blocks8[b]);
+                tested += 8;
+            }
+            break;
+        default:
+            for(size_t i = 0; i < numTriangles() && !occluded; ++i)
+            {
+                TriangleHit any;
+                occluded = intersectWatertight(r, m_vertices[3 * i + 0], m_vertices[3 * i + 1],
+                                               m_vertices[3 * i + 2], &any);
+                ++tested;
+            }
+            break;
+    }
+
+    if(tests)
+    {
+        *tests += std::min(tested, numTriangles());
+    }
+    return occluded;
+}
+
+// ----------------------------------------------------------------------------
+//  Origins are given relative to the mesh center in units of its extent. No target may be
+//  behind a silhouette as seen from an origin, a ray missing it would be no crack.
+//
+
+WatertightCheck checkWatertight(TriangleKernel kernel)
+{
+    const glm::vec3 origins[] = {
+        glm::vec3(0.0f, 0.0f, 2.0f),      // Straight down
+        glm::vec3(0.7f, -0.3f, 1.5f),     // Oblique
+        glm::vec3(-2.5f, 0.4f, 1.0f),     // Low, still above every slope of the meshes
+        glm::vec3(0.3f, 0.5f, -1.8f),     // From below, back faces
+        glm::vec3(0.01f, 0.02f, 100.0f),  // Far, nearly parallel rays
+    };
+
+    // Identity, rotated far from the origin and scaled down
+    const glm::mat4 rotated =
+        glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(1000.0f, -500.0f, 250.0f)), 0.7f,
+                    glm::normalize(glm::vec3(1.0f, 2.0f, 3.0f)));
+    const glm::mat4 transforms[] = {glm::mat4(1.0f), rotated,
+                                    glm::scale(glm::mat4(1.0f), glm::vec3(1e-3f))};
+
+    WatertightCheck check;
+    for(TestMesh mesh : {heightField(12), fan(48)})
+    {
+        for(const glm::mat4& transform : transforms)
+        {
+            // Targets come from the transformed float vertices, like a scene's would
+            TestMesh moved = mesh;
+            for(VkTools::VertexPNTC& v : moved.vertices)
+            {
+                v.p = glm::vec3(transform * glm::vec4(v.p, 1.0f));
+            }
+            const glm::vec4 center = glm::vec4(mesh.center, 1.0f);
+
+            TriangleSoup soup;
+            soup.build(moved.vertices, moved.indices);
+            for(const glm::vec3& target : edgeTargets(moved))
+            {
+                for(const glm::vec3& offset : origins)
+                {
+                    Ray ray;
+                    const glm::vec4 origin = center + glm::vec4(mesh.extent * offset, 0.0f);
+                    ray.origin             = glm::vec3(transform * origin);
+                    ray.dir    = glm::normalize(target - ray.origin);
+
+                    RayHit hit;
+                    ++check.rays;
+                    if(!soup.intersect(ray, kernel, &hit) || !soup.occluded(ray, kernel))
+                    {
+                        ++check.leaks;
+                        continue;
+                    }
+
+                    RayHit reference;
+                    soup.intersect(ray, TriangleKernel::Scalar, &reference);
+                    if(hit.triangle != reference.triangle || hit.t != reference.t
+                       || hit.barycentrics != reference.barycentrics)
+                    {
+                        ++check.mismatches;
+                    }
+                }
+            }
+        }
+    }
+    return check;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+std::vector<TriangleThroughput> benchmarkTriangleKernels(const TriangleSoup&     soup,
+                                                         const std::vector<Ray>& rays)
+{
+    std::vector<TriangleThroughput> results;
+    for(const TriangleKernel kernel : kKernels)
+    {
+        if(!triangleKernelSupported(kernel))
+        {
+            continue;
+        }
+        for(const bool occlusion : {false, true})
+        {
+            TriangleThroughput result;
+            result.kernel    = kernel;
+            result.occlusion = occlusion;
+
+            uint64_t   tests = 0;
+            uint64_t   hits  = 0;
+            const auto start = Clock::now();
+#pragma omp parallel for schedule(dynamic, 16) reduction(+ : tests, hits)
+            for(int i = 0; i < int(rays.size()); ++i)
+            {
+                RayHit hit;
+                if(occlusion)
+                {
+                    hits += soup.occluded(rays[i], kernel, &tests) ? 1 : 0;
+                    continue;
+                }
+                hits += soup.intersect(rays[i], kernel, &hit) ? 1 : 0;
+                tests += soup.numTriangles();
+            }
+            result.ms    = Milliseconds(Clock::now() - start).count();
+            result.tests = tests;
+            result.hits  = hits;
+            results.push_back(result);
+        }
+    }
+    return results;
+}
+
+}  // namespace rtutils
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Bvh.h"
+#include "TriangleKernels.h"
+
+namespace VkTools {
+struct VertexPNTC;
+}
+
+namespace rtutils {
+
+enum class TriangleKernel
+{
+    Scalar,
+    Sse,   // 4 triangles per call
+    Avx2,  // 8 triangles per call
+};
+
+const char* toString(TriangleKernel kernel);
+
+// Compiled in and supported by the CPU, always true for Scalar
+bool triangleKernelSupported(TriangleKernel kernel);
+
+WatertightRay makeWatertightRay(const Ray& ray);
+
+// Scalar watertight test, the reference for the SIMD kernels. Closest hit in [tmin, tmax]
+// nearer than hit->t.
+bool intersectWatertight(const WatertightRay& ray,
+                         const glm::vec3&     v0,
+                         const glm::vec3&     v1,
+                         const glm::vec3&     v2,
+                         TriangleHit*         hit);
+
+// ----------------------------------------------------------------------------
+//  Triangles of an indexed VertexPNTC soup, precomputed into blocks of 4 and 8 for the SIMD
+//  kernels. Rays are tested against every triangle, a BVH would call the same kernels on the
+//  triangles of a leaf.
+//
+
+class TriangleSoup
+{
+    public:
+    void build(const std::vector<VkTools::VertexPNTC>& vertices,
+               const std::vector<uint32_t>&            indices);
+
+    size_t numTriangles() const { return m_vertices.size() / 3; }
+
+    // hit->triangle indexes the index buffer like Bvh
+    bool intersect(const Ray& ray, TriangleKernel kernel, RayHit* hit) const;
+
+    // Any hit in [tmin, tmax]. The number of triangles tested before it is added to tests.
+    bool occluded(const Ray& ray, TriangleKernel kernel, uint64_t* tests = nullptr) const;
+
+    private:
+    std::vector<glm::vec3>        m_vertices;  // Three per triangle
+    std::vector<TriangleBlock<4>> m_blocks4;
+    std::vector<TriangleBlock<8>> m_blocks8;
+};
+
+// ----------------------------------------------------------------------------
+//  Rays aimed exactly at the vertices and at points on the shared edges of a jittered height
+//  field and of a triangle fan, from origins above, below and at low angles, with the
+//  meshes also moved far from the origin. Every ray has to hit, a miss went through a crack.
+//  SIMD kernels also have to report the same hit as the scalar test.
+//
+
+struct WatertightCheck
+{
+    uint64_t rays       = 0;
+    uint64_t leaks      = 0;  // Rays that missed
+    uint64_t mismatches = 0;  // Hits that differ from intersectWatertight
+
+    bool passed() const { return rays > 0 && leaks == 0 && mismatches == 0; }
+};
+
+WatertightCheck checkWatertight(TriangleKernel kernel);
+
+// ----------------------------------------------------------------------------
+//  Ray-triangle tests per second of a kernel, every ray against every triangle of the soup
+//
+
+struct TriangleThroughput
+{
+    TriangleKernel kernel    = TriangleKernel::Scalar;
+    bool           occlusion = false;
+    uint64_t       tests     = 0;  // Occlusion stops at the first hit
+    uint64_t       hits      = 0;  // Rays that hit
+    double         ms        = 0.0;
+
+    double testsPerSecond() const { return ms > 0.0 ? tests / (ms * 1e-3) : 0.0; }
+};
+
+// Closest hit and occlusion for every supported kernel
+std::vector<TriangleThroughput> benchmarkTriangleKernels(const TriangleSoup&     soup,
+                                                         const std::vector<Ray>& rays);
+
+}  // namespace rtutils
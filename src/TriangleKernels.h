@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rtutils {
+
+// ----------------------------------------------------------------------------
+//  Plain data and the watertight ray-triangle kernel, included by the translation units built
+//  for SSE2 and AVX2 like PacketKernels.h.
+//
+//  Woop, Benthin and Wald, "Watertight Ray/Triangle Intersection" (JCGT 2013). The ray is
+//  permuted so its largest direction component becomes z and sheared so it points along +z, the
+//  triangle then only needs 2D edge functions U, V and W around the origin. A point on a shared
+//  edge gives both triangles the same edge function value with opposite sign conventions, so
+//  rays through edges and vertices cannot pass between triangles. Edge functions that evaluate
+//  to exactly zero are recomputed in double precision.
+//
+
+// Per ray constants, see makeWatertightRay
+struct WatertightRay
+{
+    float    ox, oy, oz;
+    float    sx, sy, sz;  // Shear, sx = dir[kx] / dir[kz] ...
+    uint32_t kx, ky, kz;  // kz is the axis of the largest direction component
+    float    tmin, tmax;
+};
+
+// Triangles in structure of arrays. Unused lanes of the last block repeat its last triangle,
+// which never wins over the same triangle in an earlier lane.
+template <uint32_t Width>
+struct alignas(32) TriangleBlock
+{
+    float    v0[3][Width];
+    float    v1[3][Width];
+    float    v2[3][Width];
+    uint32_t id[Width];
+};
+
+// t and the weights of the second and third vertex, like RayHit
+struct TriangleHit
+{
+    float    t        = 3.402823466e+38f;
+    float    u        = 0.0f;
+    float    v        = 0.0f;
+    uint32_t triangle = ~0u;
+};
+
+// Edge functions of triangle lane in double precision, for the ones that were zero in float
+void watertightEdgesDouble(const WatertightRay& ray,
+                           const float*         v0,
+                           const float*         v1,
+                           const float*         v2,
+                           size_t               stride,
+                           float*               u,
+                           float*               v,
+                           float*               w);
+
+// False when the kernel was not compiled for this target and must not be called
+bool triangleKernelSseCompiled();
+
+// Closest hit in [tmin, tmax] that is nearer than hit->t, updates hit and returns true if found.
+// The occlusion variants return whether any triangle is hit in [tmin, tmax].
+bool intersectTrianglesSse(const WatertightRay& ray, const TriangleBlock<4>& block,
+                           TriangleHit* hit);
+bool occludedTrianglesSse(const WatertightRay& ray, const TriangleBlock<4>& block);
+
+bool intersectTrianglesAvx2(const WatertightRay& ray, const TriangleBlock<8>& block,
+                            TriangleHit* hit);
+bool occludedTrianglesAvx2(const WatertightRay& ray, const TriangleBlock<8>& block);
+
+// ----------------------------------------------------------------------------
+//  S wraps the intrinsics like for tracePacket. Operations match the scalar
+//  intersectWatertight one for one, so both report the same hits bit for bit.
+//
+
+template <typename S, bool AnyHit>
+bool intersectTriangles(const WatertightRay&             ray,
+                        const TriangleBlock<S::kWidth>& block,
+                        TriangleHit*                     hit)
+{
+    using F = typename S::F;
+    using M = typename S::M;
+
+    const uint32_t kx = ray.kx;
+    const uint32_t ky = ray.ky;
+    const uint32_t kz = ray.kz;
+
+    // Vertices relative to the origin
+    const F ox  = S::set1(kx == 0 ? ray.ox : kx == 1 ? ray.oy : ray.oz);
+    const F oy  = S::set1(ky == 0 ? ray.ox : ky == 1 ? ray.oy : ray.oz);
+    const F oz  = S::set1(kz == 0 ? ray.ox : kz == 1 ? ray.oy : ray.oz);
+    const F Ax0 = S::sub(S::load(block.v0[kx]), ox);
+    const F Ay0 = S::sub(S::load(block.v0[ky]), oy);
+    const F Az0 = S::sub(S::load(block.v0[kz]), oz);
+    const F Bx0 = S::sub(S::load(block.v1[kx]), ox);
+    const F By0 = S::sub(S::load(block.v1[ky]), oy);
+    const F Bz0 = S::sub(S::load(block.v1[kz]), oz);
+    const F Cx0 = S::sub(S::load(block.v2[kx]), ox);
+    const F Cy0 = S::sub(S::load(block.v2[ky]), oy);
+    const F Cz0 = S::sub(S::load(block.v2[kz]), oz);
+
+    // Shear
+    const F sx = S::set1(ray.sx);
+    const F sy = S::set1(ray.sy);
+    const F Ax = S::sub(Ax0, S::mul(sx, Az0));
+    const F Ay = S::sub(Ay0, S::mul(sy, Az0));
+    const F Bx = S::sub(Bx0, S::mul(sx, Bz0));
+    const F By = S::sub(By0, S::mul(sy, Bz0));
+    const F Cx = S::sub(Cx0, S::mul(sx, Cz0));
+    const F Cy = S::sub(Cy0, S::mul(sy, Cz0));
+
+    F U = S::sub(S::mul(Cx, By), S::mul(Cy, Bx));
+    F V = S::sub(S::mul(Ax, Cy), S::mul(Ay, Cx));
+    F W = S::sub(S::mul(Bx, Ay), S::mul(By, Ax));
+
+    const F        zero = S::set1(0.0f);
+    const uint32_t edge =
+        S::bits(S::orMask(S::orMask(S::eq(U, zero), S::eq(V, zero)), S::eq(W, zero)));
+    if(edge != 0)
+    {
+        alignas(32) float u[S::kWidth], v[S::kWidth], w[S::kWidth];
+        S::store(u, U);
+        S::store(v, V);
+        S::store(w, W);
+        for(uint32_t lane = 0; lane < S::kWidth; ++lane)
+        {
+            if(edge >> lane & 1u)
+            {
+                watertightEdgesDouble(ray, &block.v0[0][lane], &block.v1[0][lane],
+                                      &block.v2[0][lane], S::kWidth, &u[lane], &v[lane],
+                                      &w[lane]);
+            }
+        }
+        U = S::load(u);
+        V = S::load(v);
+        W = S::load(w);
+    }
+
+    // Inside when all edge functions have the same sign, zero counts as either
+    const M negative = S::orMask(S::orMask(S::lt(U, zero), S::lt(V, zero)), S::lt(W, zero));
+    const M positive = S::orMask(S::orMask(S::gt(U, zero), S::gt(V, zero)), S::gt(W, zero));
+    const F det      = S::add(S::add(U, V), W);
+    M       valid    = S::andNotMask(S::andMask(negative, positive), S::neq(det, zero));
+
+    // Distance scaled by det, compared without dividing
+    const F sz     = S::set1(ray.sz);
+    const F T      = S::add(S::add(S::mul(U, S::mul(sz, Az0)), S::mul(V, S::mul(sz, Bz0))),
+                       S::mul(W, S::mul(sz, Cz0)));
+    const F sign   = S::signBit(det);
+    const F absDet = S::xorSign(det, sign);
+    const F tScale = S::xorSign(T, sign);
+    const M inside = S::andMask(S::ge(tScale, S::mul(S::set1(ray.tmin), absDet)),
+                                S::le(tScale, S::mul(S::set1(ray.tmax), absDet)));
+    valid          = S::andMask(valid, inside);
+
+    const uint32_t lanes = S::bits(valid);
+    if(lanes == 0)
+    {
+        return false;
+    }
+    if(AnyHit)
+    {
+        return true;
+    }
+
+    const F rcpDet = S::div(S::set1(1.0f), det);
+    alignas(32) float t[S::kWidth];
+    S::store(t, S::mul(T, rcpDet));
+
+    uint32_t best = S::kWidth;
+    for(uint32_t lane = 0; lane < S::kWidth; ++lane)
+    {
+        if((lanes >> lane & 1u) && t[lane] < hit->t && (best == S::kWidth || t[lane] < t[best]))
+        {
+            best = lane;
+        }
+    }
+    if(best == S::kWidth)
+    {
+        return false;
+    }
+
+    alignas(32) float u[S::kWidth], v[S::kWidth], r[S::kWidth];
+    S::store(u, V);
+    S::store(v, W);
+    S::store(r, rcpDet);
+    hit->t        = t[best];
+    hit->u        = u[best] * r[best];
+    hit->v        = v[best] * r[best];
+    hit->triangle = block.id[best];
+    return true;
+}
+
+}  // namespace rtutils
@@ -0,0 +1,79 @@
+#include "TriangleKernels.h"
+
+// SSE2 is part of x86-64, 32-bit builds need it enabled
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+
+namespace rtutils {
+namespace {
+
+struct Sse
+{
+    using F = __m128;
+    using M = __m128;
+
+    static const uint32_t kWidth = 4;
+
+    static F        load(const float* p) { return _mm_load_ps(p); }
+    static void     store(float* p, F a) { _mm_store_ps(p, a); }
+    static F        set1(float a) { return _mm_set1_ps(a); }
+    static F        add(F a, F b) { return _mm_add_ps(a, b); }
+    static F        sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F        mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F        div(F a, F b) { return _mm_div_ps(a, b); }
+    static F        signBit(F a) { return _mm_and_ps(a, _mm_set1_ps(-0.0f)); }
+    static F        xorSign(F a, F sign) { return _mm_xor_ps(a, sign); }
+    static M        eq(F a, F b) { return _mm_cmpeq_ps(a, b); }
+    static M        neq(F a, F b) { return _mm_cmpneq_ps(a, b); }
+    static M        lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static M        le(F a, F b) { return _mm_cmple_ps(a, b); }
+    static M        gt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+    static M        ge(F a, F b) { return _mm_cmpge_ps(a, b); }
+    static M        andMask(M a, M b) { return _mm_and_ps(a, b); }
+    static M        orMask(M a, M b) { return _mm_or_ps(a, b); }
+    static M        andNotMask(M a, M b) { return _mm_andnot_ps(a, b); }  // ~a & b
+    static uint32_t bits(M mask) { return uint32_t(_mm_movemask_ps(mask)); }
+};
+
+}  // namespace
+
+bool triangleKernelSseCompiled()
+{
+    return true;
+}
+
+bool intersectTrianglesSse(const WatertightRay& ray, const TriangleBlock<4>& block,
+                           TriangleHit* hit)
+{
+    return intersectTriangles<Sse, false>(ray, block, hit);
+}
+
+bool occludedTrianglesSse(const WatertightRay& ray, const TriangleBlock<4>& block)
+{
+    return intersectTriangles<Sse, true>(ray, block, nullptr);
+}
+
+}  // namespace rtutils
+
+#else
+
+namespace rtutils {
+
+bool triangleKernelSseCompiled()
+{
+    return false;
+}
+
+bool intersectTrianglesSse(const WatertightRay&, const TriangleBlock<4>&, TriangleHit*)
+{
+    return false;
+}
+
+bool occludedTrianglesSse(const WatertightRay&, const TriangleBlock<4>&)
+{
+    return false;
+}
+
+}  // namespace rtutils
+
+#endif
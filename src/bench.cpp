@@ -0,0 +1,257 @@
+#include "Benchmark.h"
+#include "vkContext.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <spdlog/spdlog.h>
+
+// ----------------------------------------------------------------------------
+//  pathtracer_bench [--manifest file]
+//                   [--backend cpu|gpu|auto|denoiser|packets|triangles|obj|checks]
+//                   [--scene name] [--spp n] [--json file] [--csv file]
+//
+//  Renders every scene of the manifest, or only --scene, and writes one result per scene. The
+//  auto backend uses the GPU and falls back to the CPU tracer for scenes the GPU fails on. The
+//  denoiser backend renders with the CPU tracer at the scene's spp and 16 times as many and
+//  reports the error of the noisy and the denoised image against the latter. The packets backend
+//  only traces primary and shadow rays, once per ray and once in SIMD packets, and writes a
+//  result for each. The triangles backend times the ray-triangle kernels alone, the
+//  obj backend parses the scene's .obj with tinyobjloader and with the parallel loader. The checks
+//  backend runs the CPU self-checks of the modules instead of the scenes and fails if any does.
+//
+
+namespace {
+
+void usage()
+{
+    std::cerr << "Usage: pathtracer_bench [--manifest file]"
+                 " [--backend cpu|gpu|auto|denoiser|packets|triangles|obj|checks]"
+                 " [--scene name]"
+                 " [--spp n] [--json file] [--csv file]\n";
+}
+
+rtutils::BenchmarkResult runGpu(const rtutils::BenchmarkScene& scene)
+{
+    try
+    {
+        vkContext context;
+        return context.runBenchmark(scene);
+    }
+    catch(const std::exception& e)
+    {
+        rtutils::BenchmarkResult result;
+        result.scene   = scene.name;
+        result.backend = "gpu";
+        result.status  = e.what();
+        return result;
+    }
+}
+
+// The cpu and denoiser backends
+rtutils::BenchmarkResult runCpu(const std::string& backend, const rtutils::BenchmarkScene& scene)
+{
+    try
+    {
+        return backend == "denoiser" ? rtutils::runDenoiserBenchmark(scene)
+                                     : rtutils::runCpuBenchmark(scene);
+    }
+    catch(const std::exception& e)
+    {
+        rtutils::BenchmarkResult result;
+        result.scene   = scene.name;
+        result.backend = backend;
+        result.status  = e.what();
+        return result;
+    }
+}
+
+// The CPU traversal and .obj parsing benchmarks, which write several results per scene
+std::vector<rtutils::BenchmarkResult> runTraversal(const std::string&             backend,
+                                                   const rtutils::BenchmarkScene& scene)
+{
+    try
+    {
+        if(backend == "obj")
+        {
+            return rtutils::runObjBenchmark(scene);
+        }
+        return backend == "packets" ? rtutils::runPacketBenchmark(scene)
+                                    : rtutils::runTriangleBenchmark(scene);
+    }
+    catch(const std::exception& e)
+    {
+        rtutils::BenchmarkResult result;
+        result.scene   = scene.name;
+        result.backend = backend;
+        result.status  = e.what();
+        return {result};
+    }
+}
+
+bool writeResults(const std::string&                           jsonPath,
+                  const std::string&                           csvPath,
+                  const std::vector<rtutils::BenchmarkResult>& results)
+{
+    bool written = true;
+    if(!jsonPath.empty() && !rtutils::writeBenchmarkJson(jsonPath, results))
+    {
+        spdlog::error("Could not write {}", jsonPath);
+        written = false;
+    }
+    if(!csvPath.empty() && !rtutils::writeBenchmarkCsv(csvPath, results))
+    {
+        spdlog::error("Could not write {}", csvPath);
+        written = false;
+    }
+    return written;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    std::string manifest = "../../scenes/benchmark.ini";
+    std::string backend  = "auto";
+    std::string sceneName;
+    std::string jsonPath = "benchmark.json";
+    std::string csvPath;
+    std::string spp;  // Manifest value when empty
+
+    for(int i = 1; i < argc; ++i)
+    {
+        const auto option = [&](const char* name, std::string* value) {
+            if(i + 1 >= argc || std::strcmp(argv[i], name) != 0)
+            {
+                return false;
+            }
+            *value = argv[++i];
+            return true;
+        };
+        if(!option("--manifest", &manifest) && !option("--backend", &backend)
+           && !option("--scene", &sceneName) && !option("--spp", &spp)
+           && !option("--json", &jsonPath) && !option("--csv", &csvPath))
+        {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    const uint32_t sppOverride = uint32_t(std::strtoul(spp.c_str(), nullptr, 10));
+    if(backend != "cpu" && backend != "gpu" && backend != "auto" && backend != "denoiser"
+       && backend != "packets" && backend != "triangles" && backend != "obj"
+       && backend != "checks")
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    if(backend == "checks")
+    {
+        const std::vector<rtutils::BenchmarkResult> results = rtutils::runSelfChecks();
+        bool                                        failed  = false;
+        for(const rtutils::BenchmarkResult& result : results)
+        {
+            failed = failed || result.status != "ok";
+            spdlog::info("{}: {:.1f} ms, {}", result.backend, result.traceMs, result.status);
+        }
+        failed = !writeResults(jsonPath, csvPath, results) || failed;
+        return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+
+    std::vector<rtutils::BenchmarkScene> scenes;
+    try
+    {
+        scenes = rtutils::loadBenchmarkManifest(manifest);
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<rtutils::BenchmarkResult> results;
+    bool                                  failed = false;
+    for(rtutils::BenchmarkScene& scene : scenes)
+    {
+        if(!sceneName.empty() && scene.name != sceneName)
+        {
+            continue;
+        }
+        if(sppOverride > 0)
+        {
+            scene.spp = sppOverride;
+        }
+
+        // Scenes are not in the repository, report missing ones instead of failing the run
+        if(!std::ifstream(scene.model))
+        {
+            spdlog::warn("[{}] {} not found, skipped", scene.name, scene.model);
+            results.emplace_back();
+            results.back().scene   = scene.name;
+            results.back().backend = backend;
+            results.back().status  = "missing";
+            continue;
+        }
+
+        if(backend == "obj")
+        {
+            for(const rtutils::BenchmarkResult& result : runTraversal(backend, scene))
+            {
+                failed = failed || result.status != "ok";
+                spdlog::info("[{}] {}: {:.1f} ms for {:.1f} MB, {:.1f} MB/s, {}, {}", result.scene,
+                             result.backend, result.parseMs, result.bytes * 1e-6,
+                             result.bytesPerSecond() * 1e-6, result.device, result.status);
+                results.push_back(result);
+            }
+            continue;
+        }
+        if(backend == "packets" || backend == "triangles")
+        {
+            const bool triangles = backend == "triangles";
+            for(const rtutils::BenchmarkResult& result : runTraversal(backend, scene))
+            {
+                failed = failed || result.status != "ok";
+                spdlog::info("[{}] {} {}x{}: {:.1f} ms for {} {}, {:.2f} M/s, {}", result.scene,
+                             result.backend, result.width, result.height, result.traceMs,
+                             triangles ? result.tests : result.rays,
+                             triangles ? "ray-triangle tests" : "rays",
+                             (triangles ? result.testsPerSecond() : result.raysPerSecond()) * 1e-6,
+                             result.status);
+                results.push_back(result);
+            }
+            continue;
+        }
+
+        rtutils::BenchmarkResult result =
+            backend == "cpu" || backend == "denoiser" ? runCpu(backend, scene) : runGpu(scene);
+        if(backend == "auto" && result.status != "ok")
+        {
+            spdlog::warn("[{}] GPU backend failed ({}), using the CPU", scene.name, result.status);
+            result = runCpu("cpu", scene);
+        }
+        failed = failed || result.status != "ok";
+
+        spdlog::info("[{}] {} {}x{} {} spp: load {:.1f} ms, build {:.1f} ms, trace {:.1f} ms, "
+                     "postprocess {:.1f} ms, {:.2f} Mrays/s, {}",
+                     result.scene, result.backend, result.width, result.height, result.spp,
+                     result.loadMs, result.buildMs, result.traceMs, result.postprocessMs,
+                     result.raysPerSecond() * 1e-6, result.status);
+        if(result.rmseInput >= 0.0)
+        {
+            spdlog::info("[{}] RMSE {:.5f} noisy, {:.5f} denoised in {:.1f} ms", result.scene,
+                         result.rmseInput, result.rmseOutput, result.postprocessMs);
+        }
+        results.push_back(result);
+    }
+
+    if(!sceneName.empty() && results.empty())
+    {
+        std::cerr << "No scene named " << sceneName << " in " << manifest << "\n";
+        return EXIT_FAILURE;
+    }
+
+    failed = !writeResults(jsonPath, csvPath, results) || failed;
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
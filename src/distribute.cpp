@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "SceneFile.h"
+#include "rtutils.h"
+
+// ----------------------------------------------------------------------------
+//  pathtracer_distribute scene.ini [--workers n] [--set section.key=value]... [--dir parts]
+//                        [--worker path] [--print] [--output image.pfm]
+//  pathtracer_distribute --merge image.pfm part.acc...
+//
+//  Splits the samples of a scene into disjoint Sobol index ranges, one pathtracer process per
+//  range, and sums the partial accumulations they write into the final image. Workers talk to
+//  the coordinator through files only, so --print lists the worker commands for running them
+//  on other hosts sharing the parts directory, and --merge combines their results afterwards.
+//  Workers run in the working directory of the coordinator, like pathtracer itself they expect
+//  the shaders at ../../shaders.
+//
+
+namespace {
+
+struct WorkerRange
+{
+    uint32_t firstSample;  // Sobol index offset, the worker traces firstSample + 1 onwards
+    uint32_t spp;          // render.spp of the worker, iterations start at 1
+};
+
+// A single process traces iterations 1, 1 + aaRays, ... below spp and each iteration takes
+// aaRays consecutive Sobol indices. Handing out whole iterations keeps the union of the worker
+// ranges equal to the indices of one process rendering the scene.
+std::vector<WorkerRange> partitionSamples(int spp, int aaRays, uint32_t workers)
+{
+    const uint32_t iterations = uint32_t(std::max(spp - 1 + aaRays - 1, 0) / aaRays);
+    workers                   = std::max(1u, std::min(workers, iterations));
+
+    std::vector<WorkerRange> ranges;
+    uint32_t                 first = 0;
+    for(uint32_t i = 0; i < workers; ++i)
+    {
+        const uint32_t count = iterations / workers + (i < iterations % workers ? 1 : 0);
+        ranges.push_back({first * uint32_t(aaRays), count * uint32_t(aaRays) + 1});
+        first += count;
+    }
+    return ranges;
+}
+
+std::string quote(const std::string& s)
+{
+    return "\"" + s + "\"";
+}
+
+std::string defaultWorker(const std::string& argv0)
+{
+    const size_t      slash     = argv0.find_last_of("/\\");
+    const std::string directory = slash == std::string::npos ? "." : argv0.substr(0, slash);
+#ifdef _WIN32
+    return directory + "\\pathtracer.exe";
+#else
+    return directory + "/pathtracer";
+#endif
+}
+
+bool merge(const std::vector<std::string>& parts, const std::string& output)
+{
+    rtutils::Image4f accumulation;
+    for(const std::string& part : parts)
+    {
+        rtutils::addAccumulation(rtutils::readAccumulation(part), &accumulation);
+    }
+    if(!rtutils::writePfm(output, rtutils::resolveAccumulation(accumulation)))
+    {
+        spdlog::error("Could not write {}", output);
+        return false;
+    }
+    spdlog::info("Merged {} parts into {}", parts.size(), output);
+    return true;
+}
+
+void usage()
+{
+    std::cerr << "Usage: pathtracer_distribute scene.ini [--workers n] [--set section.key=value]"
+                 " [--dir parts] [--worker path] [--print] [--output image.pfm]\n"
+                 "       pathtracer_distribute --merge image.pfm part.acc...\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    if(argc >= 3 && std::strcmp(argv[1], "--merge") == 0)
+    {
+        try
+        {
+            const std::vector<std::string> parts(argv + 3, argv + argc);
+            return merge(parts, argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        catch(const std::exception& e)
+        {
+            std::cerr << e.what() << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if(argc < 2 || argv[1][0] == '-')
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+
+    const std::string         scenePath = argv[1];
+    rtutils::SceneDescription scene;
+    std::vector<std::string>  overrides;
+    std::string               directory = ".";
+    std::string               worker    = defaultWorker(argv[0]);
+    std::string               output;
+    uint32_t                  workers   = 2;
+    bool                      printOnly = false;
+    try
+    {
+        scene = rtutils::loadSceneDescription(scenePath);
+        for(int i = 2; i < argc; ++i)
+        {
+            const std::string arg      = argv[i];
+            const bool        hasValue = i + 1 < argc;
+            if(arg == "--workers" && hasValue)
+                workers = uint32_t(std::strtoul(argv[++i], nullptr, 10));
+            else if(arg == "--set" && hasValue)
+            {
+                overrides.push_back(argv[++i]);
+                rtutils::applySceneOverride(overrides.back(), &scene);
+            }
+            else if(arg == "--dir" && hasValue)
+                directory = argv[++i];
+            else if(arg == "--worker" && hasValue)
+                worker = argv[++i];
+            else if(arg == "--output" && hasValue)
+                output = argv[++i];
+            else if(arg == "--print")
+                printOnly = true;
+            else
+            {
+                usage();
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    if(scene.render.mode != 0)
+    {
+        std::cerr << "Only the path tracer can be distributed\n";
+        return EXIT_FAILURE;
+    }
+    if(output.empty())
+    {
+        output = scene.output.image.empty() ? "distributed.pfm" : scene.output.image;
+    }
+
+    // Workers have to agree on the scrambles for their index ranges to be disjoint
+    const uint32_t seed = scene.render.seed != 0 ? scene.render.seed : 1;
+
+    const std::vector<WorkerRange> ranges =
+        partitionSamples(scene.render.spp, scene.render.aaRays, workers);
+    std::vector<std::string> commands;
+    std::vector<std::string> parts;
+    for(size_t i = 0; i < ranges.size(); ++i)
+    {
+        parts.push_back(directory + "/part" + std::to_string(i) + ".acc");
+
+        std::string command = quote(worker) + " " + quote(scenePath);
+        for(const std::string& o : overrides)
+        {
+            command += " --set " + quote(o);
+        }
+        command += " --set render.spp=" + std::to_string(ranges[i].spp);
+        command += " --set render.firstSample=" + std::to_string(ranges[i].firstSample);
+        command += " --set render.seed=" + std::to_string(seed);
+        command += " --set output.image= --set " + quote("output.accumulation=" + parts.back());
+        command += " --set output.exit=on";
+#ifdef _WIN32
+        // cmd.exe strips the outermost quotes of the whole line
+        command = "\"" + command + "\"";
+#endif
+        commands.push_back(command);
+    }
+
+    if(printOnly)
+    {
+        for(const std::string& command : commands)
+        {
+            std::cout << command << "\n";
+        }
+        std::cout << "pathtracer_distribute --merge " << quote(output);
+        for(const std::string& part : parts)
+        {
+            std::cout << " " << quote(part);
+        }
+        std::cout << "\n";
+        return EXIT_SUCCESS;
+    }
+
+    spdlog::info("Rendering {} with {} workers", scenePath, commands.size());
+    std::vector<int>         results(commands.size(), 0);
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < commands.size(); ++i)
+    {
+        threads.emplace_back([&, i]() { results[i] = std::system(commands[i].c_str()); });
+    }
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    bool failed = false;
+    for(size_t i = 0; i < results.size(); ++i)
+    {
+        if(results[i] != 0)
+        {
+            spdlog::error("Worker {} failed with {}: {}", i, results[i], commands[i]);
+            failed = true;
+        }
+    }
+    if(failed)
+    {
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        return merge(parts, output) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+}
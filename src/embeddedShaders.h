@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+namespace VkTools {
+
+// SPIR-V compiled into the executable with PATHTRACER_EMBED_SPIRV, the table is generated from
+// shaders/spirv by cmake/EmbedSpirv.cmake
+struct EmbeddedShader
+{
+    const char*          name;  // File name without the directory, e.g. "pathRT.rgen.spv"
+    const unsigned char* data;
+    size_t               size;
+};
+
+extern const EmbeddedShader g_embeddedShaders[];
+extern const size_t         g_numEmbeddedShaders;
+
+}  // namespace VkTools
@@ -1,11 +1,38 @@
 #include "vkContext.h"
+#include <cstring>
 #include <iostream>
 
-int main()
+// ----------------------------------------------------------------------------
+//  pathtracer [scene.ini] [--set section.key=value]...
+//
+//  Overrides are applied in order after the scene file, e.g. --set render.spp=4096
+//
+
+int main(int argc, char** argv)
 {
     vkContext r;
     try
     {
+        rtutils::SceneDescription scene;
+        for(int i = 1; i < argc; ++i)
+        {
+            if(std::strcmp(argv[i], "--set") == 0 && i + 1 < argc)
+            {
+                rtutils::applySceneOverride(argv[++i], &scene);
+            }
+            else if(i == 1 && argv[i][0] != '-')
+            {
+                scene = rtutils::loadSceneDescription(argv[i]);
+            }
+            else
+            {
+                throw std::runtime_error(std::string("Unexpected argument ") + argv[i]
+                                         + "\nUsage: pathtracer [scene.ini] "
+                                           "[--set section.key=value]...\n");
+            }
+        }
+
+        r.setScene(scene);
         r.run();
     }
     catch(const std::exception& e)
@@ -15,4 +42,4 @@ int main()
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -1,7 +1,106 @@
 #include "rtutils.h"
 
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
 float rtutils::AABB::area() const
 {
     glm::vec3 d(max - min);
     return 2.0f * (d.x * d.y + d.x * d.z + d.y * d.z);
 }
+
+double rtutils::rmse(const Image4f& image, const Image4f& reference)
+{
+    if(image.width != reference.width || image.height != reference.height)
+    {
+        throw std::runtime_error("rmse: image dimensions do not match");
+    }
+
+    double sum = 0.0;
+    for(size_t i = 0; i < image.pixels.size(); ++i)
+    {
+        const glm::vec3 d = glm::vec3(image.pixels[i]) - glm::vec3(reference.pixels[i]);
+        sum += double(d.x) * d.x + double(d.y) * d.y + double(d.z) * d.z;
+    }
+
+    return std::sqrt(sum / (3.0 * double(image.pixels.size())));
+}
+
+// PFM stores rows from bottom to top, a negative scale marks little endian data
+bool rtutils::writePfm(const std::string& path, const Image4f& image)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << "PF\n" << image.width << " " << image.height << "\n-1.0\n";
+
+    std::vector<float> row(size_t(image.width) * 3);
+    for(uint32_t y = image.height; y-- > 0;)
+    {
+        for(uint32_t x = 0; x < image.width; ++x)
+        {
+            const glm::vec4& p = image.at(x, y);
+            row[3 * x + 0]     = p.x;
+            row[3 * x + 1]     = p.y;
+            row[3 * x + 2]     = p.z;
+        }
+        file.write(reinterpret_cast<const char*>(row.data()), row.size() * sizeof(float));
+    }
+    return bool(file);
+}
+
+rtutils::Image4f rtutils::resolveAccumulation(const Image4f& accumulation)
+{
+    Image4f result(accumulation.width, accumulation.height);
+    for(size_t i = 0; i < accumulation.pixels.size(); ++i)
+    {
+        const glm::vec4& p = accumulation.pixels[i];
+        result.pixels[i]   = p.w > 0.0f ? glm::vec4(glm::vec3(p) / p.w, 1.0f) : glm::vec4(0.0f);
+    }
+    return result;
+}
+
+bool rtutils::writeAccumulation(const std::string& path, const Image4f& accumulation)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << "PA\n" << accumulation.width << " " << accumulation.height << "\n";
+    file.write(reinterpret_cast<const char*>(accumulation.pixels.data()),
+               accumulation.pixels.size() * sizeof(glm::vec4));
+    return bool(file);
+}
+
+rtutils::Image4f rtutils::readAccumulation(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string   magic;
+    uint32_t      width  = 0;
+    uint32_t      height = 0;
+    if(!(file >> magic >> width >> height) || magic != "PA" || file.get() != '\n')
+    {
+        throw std::runtime_error("Could not read accumulation " + path);
+    }
+
+    Image4f accumulation(width, height);
+    if(!file.read(reinterpret_cast<char*>(accumulation.pixels.data()),
+                  accumulation.pixels.size() * sizeof(glm::vec4)))
+    {
+        throw std::runtime_error("Accumulation " + path + " is truncated");
+    }
+    return accumulation;
+}
+
+void rtutils::addAccumulation(const Image4f& partial, Image4f* accumulation)
+{
+    if(accumulation->pixels.empty())
+    {
+        *accumulation = partial;
+        return;
+    }
+    if(partial.width != accumulation->width || partial.height != accumulation->height)
+    {
+        throw std::runtime_error("addAccumulation: image dimensions do not match");
+    }
+    for(size_t i = 0; i < partial.pixels.size(); ++i)
+    {
+        accumulation->pixels[i] += partial.pixels[i];
+    }
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+#include <vector>
+
 #include <glm/glm.hpp>
 
 namespace rtutils {
@@ -28,4 +32,95 @@ struct AABB
     }
 };
 
-}  // namespace rtutils
\ No newline at end of file
+// CPU side float image, rows from top to bottom like the ray tracing launch grid
+struct Image4f
+{
+    uint32_t               width  = 0;
+    uint32_t               height = 0;
+    std::vector<glm::vec4> pixels;
+
+    Image4f() {}
+    Image4f(uint32_t w, uint32_t h, const glm::vec4& value = glm::vec4(0.0f))
+        : width(w)
+        , height(h)
+        , pixels(size_t(w) * h, value)
+    {
+    }
+
+    glm::vec4&       at(uint32_t x, uint32_t y) { return pixels[size_t(y) * width + x]; }
+    const glm::vec4& at(uint32_t x, uint32_t y) const { return pixels[size_t(y) * width + x]; }
+};
+
+inline float luminance(const glm::vec3& c)
+{
+    return glm::dot(c, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+}
+
+// Root mean square error over rgb, both images must have the same size
+double rmse(const Image4f& image, const Image4f& reference);
+
+// Writes rgb as a little endian .pfm, returns false when the file could not be written
+bool writePfm(const std::string& path, const Image4f& image);
+
+// Unresolved accumulation with rgb sums and the sum of filter weights in w, stored as "PA",
+// width and height on text lines followed by little endian float rgba rows from the top.
+// Partial renders of disjoint samples merge by adding them up.
+Image4f resolveAccumulation(const Image4f& accumulation);  // Divides rgb by w
+bool    writeAccumulation(const std::string& path, const Image4f& accumulation);
+Image4f readAccumulation(const std::string& path);  // Throws std::runtime_error
+void    addAccumulation(const Image4f& partial, Image4f* accumulation);
+
+// Minimal PCG32 generator for the CPU integrators, one instance per pixel and iteration
+struct Pcg32
+{
+    uint64_t state = 0;
+
+    explicit Pcg32(uint64_t seed)
+    {
+        next();
+        state += seed;
+        next();
+    }
+
+    uint32_t next()
+    {
+        const uint64_t old = state;
+        state              = old * 6364136223846793005ull + 1442695040888963407ull;
+        const uint32_t xorshifted = uint32_t(((old >> 18u) ^ old) >> 27u);
+        const uint32_t rot        = uint32_t(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((~rot + 1u) & 31u));
+    }
+
+    // Uniform float in [0, 1)
+    float uniform() { return float(next() >> 8) * (1.0f / 16777216.0f); }
+};
+
+// Rays traced by type and the bounce at which paths ended, same layout for pathRT.rgen's
+// counters and the CPU tracer so the two can be compared. Longer paths land in the last bucket.
+struct RayStatistics
+{
+    static const int kMaxDepth = 16;
+
+    uint64_t primary               = 0;
+    uint64_t extension             = 0;
+    uint64_t shadow                = 0;
+    uint64_t pathLength[kMaxDepth] = {};
+
+    uint64_t total() const { return primary + extension + shadow; }
+
+    void addPath(int bounce) { ++pathLength[bounce < kMaxDepth - 1 ? bounce : kMaxDepth - 1]; }
+
+    RayStatistics& operator+=(const RayStatistics& other)
+    {
+        primary += other.primary;
+        extension += other.extension;
+        shadow += other.shadow;
+        for(int i = 0; i < kMaxDepth; ++i)
+        {
+            pathLength[i] += other.pathLength[i];
+        }
+        return *this;
+    }
+};
+
+}  // namespace rtutils
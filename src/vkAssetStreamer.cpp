@@ -0,0 +1,327 @@
+#include "vkAssetStreamer.h"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+#include <stb/stb_image.h>
+
+#include "vkContext.h"
+#include "vkTextureCache.h"
+#include "vkTextureRegistry.h"
+
+namespace VkTools {
+namespace {
+
+// Pixels staged per batch, the first texture of a batch is always taken
+const size_t kBatchBytes = 64 * 1024 * 1024;
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void AssetStreamer::start(const vkContext* ctx, const std::string& path, const glm::mat4& transform)
+{
+    m_path             = path;
+    m_start            = Clock::now();
+    m_stop             = false;
+    m_modelTaken       = false;
+    m_texturesUploaded = 0;
+    m_textureCount     = 0;
+    m_texturesDecoded  = 0;
+    m_registry         = ctx->getTextureRegistry();
+    m_imageSlots.clear();
+
+    // Room for the batch in flight and the next one being staged
+    m_staging.init(ctx->getDevice(), ctx->getAllocator(), ctx->getTransferQueue(),
+                   ctx->getTransferCommandPool(), 2 * kBatchBytes);
+
+    std::promise<Model> geometry;
+    m_geometry = geometry.get_future();
+    m_thread   = std::thread(&AssetStreamer::run, this, path, transform, std::move(geometry));
+}
+
+// ----------------------------------------------------------------------------
+//  Loader thread
+//
+
+void AssetStreamer::run(std::string path, glm::mat4 transform, std::promise<Model> geometry)
+{
+    std::vector<std::string> paths;
+    std::string              directory;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stage = "parsing";
+    }
+    try
+    {
+        Model model(path, transform);
+        paths          = model.m_texturePaths;
+        directory      = model.directory;
+        m_textureCount = static_cast<uint32_t>(paths.size());
+        geometry.set_value(std::move(model));
+    }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stage = "failed";
+        geometry.set_exception(std::current_exception());
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stage = "decoding textures";
+    }
+
+#pragma omp parallel for schedule(dynamic)
+    for(int i = 0; i < static_cast<int>(paths.size()); ++i)
+    {
+        if(m_stop)
+        {
+            continue;
+        }
+
+        // Missing images stay white, like Model::createTextures. Files the registry already
+        // has are not decoded again.
+        DecodedTexture texture;
+        texture.slot = static_cast<uint32_t>(i);
+        texture.path = paths[i];
+        texture.key  = TextureRegistry::pathKey(directory + '/' + paths[i]);
+        if(!m_registry->hasPath(texture.key))
+        {
+            int      width    = 0;
+            int      height   = 0;
+            int      channels = 0;
+            stbi_uc* pixels =
+                stbi_load(texture.key.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+            if(pixels)
+            {
+                texture.mips = rtutils::buildMipChain(pixels, width, height);
+                stbi_image_free(pixels);
+            }
+            else
+            {
+                const uint8_t white[4] = {255, 255, 255, 255};
+                texture.mips           = rtutils::buildMipChain(white, 1, 1);
+            }
+            texture.hash = TextureRegistry::contentHash(texture.mips.width, texture.mips.height,
+                                                        texture.mips.levels[0].data());
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_decoded.push_back(std::move(texture));
+        ++m_texturesDecoded;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stage = "uploading textures";
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+bool AssetStreamer::isGeometryReady() const
+{
+    return m_geometry.valid()
+           && m_geometry.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+Model AssetStreamer::takeModel()
+{
+    Model model  = m_geometry.get();
+    m_modelTaken = true;
+    m_geometryMs = std::chrono::duration<double, std::milli>(Clock::now() - m_start).count();
+    m_totalMs    = m_geometryMs;
+    spdlog::info("Geometry of {} ready in {:.1f} ms, streaming {} textures", m_path,
+                 m_geometryMs, m_textureCount.load());
+    return model;
+}
+
+bool AssetStreamer::isDone() const
+{
+    return m_modelTaken && m_batch.empty() && m_texturesUploaded == m_textureCount;
+}
+
+AssetStreamer::Progress AssetStreamer::getProgress() const
+{
+    Progress progress;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        progress.stage = isDone() ? "done" : m_stage;
+    }
+    progress.textureCount     = m_textureCount;
+    progress.texturesDecoded  = m_texturesDecoded;
+    progress.texturesUploaded = m_texturesUploaded;
+    progress.geometryMs       = m_geometryMs;
+    progress.totalMs          = m_totalMs;
+    return progress;
+}
+
+// ----------------------------------------------------------------------------
+//  Render thread. At most one batch is in flight, its fence is polled and never waited on.
+//
+
+bool AssetStreamer::update(const vkContext* ctx, Model* model, TextureCache* cache)
+{
+    bool changed = false;
+    if(!m_batch.empty())
+    {
+        if(!m_staging.isComplete(m_batchTicket))
+        {
+            return false;
+        }
+        const bool uploaded = std::any_of(m_batch.begin(), m_batch.end(),
+                                          [](const Upload& upload) { return upload.levels > 0; });
+        if(uploaded && ctx->getTransferQueueFamily() != ctx->getQueueFamily())
+        {
+            // The transfer queue released the images, the copies are complete so the acquire
+            // needs no semaphore. Descriptors are rewritten after a wait for idle anyway.
+            VkCommandBuffer acquire =
+                VkTools::beginRecordingCommandBuffer(ctx->getDevice(), ctx->getCommandPool());
+            for(const Upload& upload : m_batch)
+            {
+                if(upload.levels > 0)
+                {
+                    VkTools::recordTextureImageAcquire(acquire, upload.texture.image,
+                                                       ctx->getTransferQueueFamily(),
+                                                       ctx->getQueueFamily(), upload.levels);
+                }
+            }
+            VkTools::flushCommandBuffer(ctx->getDevice(), ctx->getQueue(), ctx->getCommandPool(),
+                                        acquire);
+        }
+        for(Upload& upload : m_batch)
+        {
+            model->m_textures[upload.slot] = upload.texture;
+            if(cache && !upload.mips.levels.empty())
+            {
+                cache->addTexture(upload.slot, std::move(upload.mips));
+            }
+            else if(cache && upload.owner >= 0)
+            {
+                cache->addAlias(upload.slot, static_cast<uint32_t>(upload.owner));
+            }
+        }
+        m_texturesUploaded += static_cast<uint32_t>(m_batch.size());
+        m_batch.clear();
+        m_batchTicket = 0;
+
+        m_totalMs = std::chrono::duration<double, std::milli>(Clock::now() - m_start).count();
+        if(isDone())
+        {
+            const StagingArena::Stats&   stats    = m_staging.getStats();
+            const TextureRegistry::Stats registry = m_registry->getStats();
+            spdlog::info("{} textures streamed in, {:.1f} ms after the load started, {:.1f} MB in "
+                         "{} submits at {:.0f} MB/s",
+                         m_texturesUploaded, m_totalMs, stats.bytes / 1e6, stats.submits,
+                         stats.megabytesPerSecond());
+            spdlog::info("Texture registry: {} images for {} slots, {} shared by path and {} by "
+                         "content",
+                         registry.images, registry.requests, registry.pathHits,
+                         registry.contentHits);
+            m_staging.cleanUp();
+        }
+        changed = true;
+    }
+
+    std::vector<DecodedTexture> decoded;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t bytes = 0;
+        while(!m_decoded.empty() && (decoded.empty() || bytes < kBatchBytes))
+        {
+            const rtutils::MipChain& mips = m_decoded.front().mips;
+            const uint32_t first = cache ? cache->baseMip(mips.width, mips.height) : 0;
+            bytes += rtutils::TextureResidency::chainBytes(mips.width, mips.height, 4, first);
+            decoded.push_back(std::move(m_decoded.front()));
+            m_decoded.pop_front();
+        }
+    }
+    if(decoded.empty())
+    {
+        return changed;
+    }
+
+    const VkDevice     device    = ctx->getDevice();
+    const VmaAllocator allocator = ctx->getAllocator();
+
+    for(DecodedTexture& texture : decoded)
+    {
+        Upload upload = {};
+        upload.slot   = texture.slot;
+
+        // The image of the same file or the same pixels, swapped in with this batch when it is
+        // one of its uploads
+        if(m_registry->findPath(texture.key, &upload.texture)
+           || (!texture.mips.levels.empty()
+               && m_registry->findContent(texture.key, texture.hash, &upload.texture)))
+        {
+            const auto owner = m_imageSlots.find(upload.texture.image);
+            if(owner != m_imageSlots.end())
+            {
+                upload.owner = static_cast<int>(owner->second);
+            }
+            upload.texture.path = texture.path;
+            m_batch.push_back(std::move(upload));
+            continue;
+        }
+
+        // Smallest mips first, the cache streams in the finer ones
+        const rtutils::MipChain& mips  = texture.mips;
+        const uint32_t           first = cache ? cache->baseMip(mips.width, mips.height) : 0;
+
+        upload.levels         = static_cast<uint32_t>(mips.levels.size()) - first;
+        upload.texture.width  = mips.levelWidth(first);
+        upload.texture.height = mips.levelHeight(first);
+        VkTools::createImage(allocator, {upload.texture.width, upload.texture.height},
+                             VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+                             VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                             VMA_MEMORY_USAGE_GPU_ONLY, &upload.texture.image,
+                             &upload.texture.memory, upload.levels);
+        m_staging.uploadImageMips(upload.texture.image, mips, first,
+                                  ctx->getTransferQueueFamily(), ctx->getQueueFamily());
+
+        upload.texture.view =
+            VkTools::createImageView(device, upload.texture.image, VK_FORMAT_R8G8B8A8_UNORM,
+                                     VK_IMAGE_ASPECT_COLOR_BIT, upload.levels);
+        upload.texture.sampler = m_registry->getSampler();
+        m_registry->add(texture.key, texture.hash, upload.texture);
+        m_imageSlots[upload.texture.image] = upload.slot;
+        upload.texture.path                = texture.path;
+        if(cache)
+        {
+            upload.mips = std::move(texture.mips);
+        }
+        m_batch.push_back(std::move(upload));
+    }
+    m_batchTicket = m_staging.submit();
+
+    return changed;
+}
+
+// ----------------------------------------------------------------------------
+//  Images of a batch that never made it into the model belong to the registry already
+//
+
+void AssetStreamer::cleanUp()
+{
+    m_stop = true;
+    if(m_thread.joinable())
+    {
+        m_thread.join();
+    }
+
+    m_staging.cleanUp();
+    m_batch.clear();
+    m_batchTicket = 0;
+    m_imageSlots.clear();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_decoded.clear();
+    m_geometry = std::future<Model>();
+}
+
+}  // namespace VkTools
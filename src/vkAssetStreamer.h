@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "Model.h"
+#include "TextureResidency.h"
+#include "vkStagingArena.h"
+
+class vkContext;
+
+namespace VkTools {
+
+class TextureCache;
+class TextureRegistry;
+
+// ----------------------------------------------------------------------------
+//  Loads a model off the render thread so the window stays responsive on large scenes.
+//
+//      loader thread:  parse OBJ -> geometry ready -> decode textures and their mips (OpenMP)
+//      render thread:  takeModel, buffers on the transfer queue, acceleration structures
+//                      update() each frame: stage decoded textures, upload, swap them in
+//
+//  Texture slots show a white placeholder until their image arrives. Uploads are submitted in
+//  batches to the transfer queue with their own fence and never waited on, a finished batch is
+//  acquired by the graphics queue family and swapped into the model on a later update(). With a
+//  TextureCache only the small base mips are uploaded, the cache gets the chains and streams
+//  in finer levels on demand. Slots whose file or pixels the TextureRegistry already has get
+//  its image instead of an upload of their own.
+//
+
+class AssetStreamer
+{
+    public:
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct Progress
+    {
+        const char* stage            = "idle";
+        uint32_t    textureCount     = 0;
+        uint32_t    texturesDecoded  = 0;
+        uint32_t    texturesUploaded = 0;
+        double      geometryMs       = 0.0;  // Start to takeModel
+        double      totalMs          = 0.0;  // Start to the last texture swapped in, so far
+    };
+
+    // Starts parsing path on the loader thread, call cleanUp before starting another model
+    void start(const vkContext* ctx, const std::string& path, const glm::mat4& transform);
+
+    // True once the geometry is parsed or parsing failed, takeModel then returns immediately
+    bool isGeometryReady() const;
+
+    // Model without buffers or textures, throws what parsing threw. The loader continues with
+    // the textures of the model.
+    Model takeModel();
+
+    // On the transfer queue, for the buffers of the model from takeModel. Freed once every
+    // texture is in its slot.
+    StagingArena* getStaging() { return &m_staging; }
+
+    // Swaps finished uploads into the texture slots of model and submits the next batch of
+    // decoded textures. Returns true when textures of model changed, descriptors referring to
+    // them have to be rewritten once the device is idle. Without cache every level is uploaded.
+    bool update(const vkContext* ctx, Model* model, TextureCache* cache);
+
+    // True when every texture is in its slot
+    bool isDone() const;
+
+    Progress getProgress() const;
+
+    // Stops decoding, waits for the loader thread and pending uploads
+    void cleanUp();
+
+    private:
+    struct DecodedTexture
+    {
+        uint32_t          slot;
+        rtutils::MipChain mips;  // RGBA8, empty when the registry had the file
+        std::string       path;
+        std::string       key;  // TextureRegistry::pathKey of the file
+        uint64_t          hash = 0;
+    };
+
+    struct Upload
+    {
+        uint32_t          slot;
+        Texture           texture;
+        uint32_t          levels;      // Zero for a slot sharing the image of another one
+        rtutils::MipChain mips;        // For the cache, empty without one
+        int               owner = -1;  // Streamed slot whose image a sharing slot shows
+    };
+
+    void run(std::string path, glm::mat4 transform, std::promise<Model> geometry);
+
+    std::thread        m_thread;
+    std::future<Model> m_geometry;
+    std::atomic<bool>  m_stop{false};
+    std::string        m_path;
+    Clock::time_point  m_start;
+    TextureRegistry*   m_registry = nullptr;
+
+    // Written by the loader thread, read by the render thread
+    mutable std::mutex         m_mutex;
+    std::deque<DecodedTexture> m_decoded;
+    const char*                m_stage = "idle";
+    std::atomic<uint32_t>      m_textureCount{0};
+    std::atomic<uint32_t>      m_texturesDecoded{0};
+
+    // Render thread only
+    uint32_t            m_texturesUploaded = 0;
+    double              m_geometryMs       = 0.0;
+    double              m_totalMs          = 0.0;
+    bool                m_modelTaken       = false;
+    std::vector<Upload> m_batch;            // In flight while not empty
+    uint64_t            m_batchTicket = 0;  // Of m_staging
+    StagingArena        m_staging;          // On the transfer queue, freed once done
+
+    // Slot each streamed image was made for
+    std::unordered_map<VkImage, uint32_t> m_imageSlots;
+};
+
+}  // namespace VkTools
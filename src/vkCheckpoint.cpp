@@ -0,0 +1,234 @@
+#include "vkCheckpoint.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#include <spdlog/spdlog.h>
+
+#include "vkTools.h"
+
+namespace VkTools {
+namespace {
+
+const uint32_t kMagic   = 0x4B435450;  // "PTCK"
+const uint32_t kVersion = 1;
+
+VkDeviceSize texelSize(VkFormat format)
+{
+    return format == VK_FORMAT_R32G32B32A32_SFLOAT ? 4 * sizeof(float) : 4 * sizeof(uint16_t);
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//  The readback buffer stays mapped, the writer reads the texels straight out of it
+//
+
+void Checkpoint::init(VmaAllocator       allocator,
+                      VkImage            image,
+                      VkFormat           format,
+                      VkExtent2D         extent,
+                      const std::string& path,
+                      double             intervalSeconds)
+{
+    m_allocator   = allocator;
+    m_image       = image;
+    m_format      = format;
+    m_extent      = extent;
+    m_path        = path;
+    m_size        = VkDeviceSize(extent.width) * extent.height * texelSize(format);
+    m_interval    = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(intervalSeconds));
+    m_lastCopy    = Clock::now();
+    m_pendingSlot = -1;
+
+    VkTools::createBuffer(m_allocator, m_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VMA_MEMORY_USAGE_GPU_TO_CPU,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                              | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          &m_buffer, &m_memory);
+
+    void* mapped;
+    VK_CHECK_RESULT(vmaMapMemory(m_allocator, m_memory, &mapped));
+    m_mapped = static_cast<const char*>(mapped);
+}
+
+void Checkpoint::cleanUp()
+{
+    if(m_writer.valid())
+    {
+        m_writer.get();
+    }
+    m_pendingSlot = -1;
+
+    if(m_buffer != VK_NULL_HANDLE)
+    {
+        vmaUnmapMemory(m_allocator, m_memory);
+        vmaDestroyBuffer(m_allocator, m_buffer, m_memory);
+        m_buffer = VK_NULL_HANDLE;
+        m_memory = VK_NULL_HANDLE;
+        m_mapped = nullptr;
+    }
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+bool Checkpoint::isDue() const
+{
+    if(m_buffer == VK_NULL_HANDLE || m_pendingSlot >= 0)
+    {
+        return false;
+    }
+    if(m_writer.valid()
+       && m_writer.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        return false;
+    }
+    return Clock::now() - m_lastCopy >= m_interval;
+}
+
+void Checkpoint::recordCopy(VkCommandBuffer cmdBuf, const State& state, uint32_t frameSlot)
+{
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext           = nullptr;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource  = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent       = {m_extent.width, m_extent.height, 1};
+    vkCmdCopyImageToBuffer(cmdBuf, m_image, VK_IMAGE_LAYOUT_GENERAL, m_buffer, 1, &region);
+
+    // For the host once the fence signals, and the next trace has to wait for the copy before
+    // accumulating into the image again
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+
+    m_pendingSlot  = int(frameSlot);
+    m_pendingState = state;
+    m_lastCopy     = Clock::now();
+}
+
+void Checkpoint::resolve(uint32_t frameSlot)
+{
+    if(m_pendingSlot != int(frameSlot))
+    {
+        return;
+    }
+    m_pendingSlot = -1;
+
+    const State state = m_pendingState;
+    m_writer          = std::async(std::launch::async, [this, state]() { return write(state); });
+}
+
+// ----------------------------------------------------------------------------
+//  Runs on the writer thread. Written to a temporary file first so a crash while writing keeps
+//  the previous checkpoint.
+//
+
+bool Checkpoint::write(const State& state) const
+{
+    const auto start = Clock::now();
+
+    Header header      = {};
+    header.magic       = kMagic;
+    header.version     = kVersion;
+    header.width       = m_extent.width;
+    header.height      = m_extent.height;
+    header.format      = uint32_t(m_format);
+    header.iteration   = state.iteration;
+    header.firstSample = state.firstSample;
+    header.seed        = state.seed;
+    header.mode        = state.mode;
+    header.fov         = state.fov;
+    header.dataSize    = m_size;
+    std::memcpy(header.cameraPosition, &state.cameraPosition[0], sizeof(header.cameraPosition));
+    std::memcpy(header.cameraRotation, &state.cameraRotation[0], sizeof(header.cameraRotation));
+    std::memcpy(header.lightTransform, &state.lightTransform[0][0], sizeof(header.lightTransform));
+
+    const std::string temporary = m_path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(m_mapped, std::streamsize(m_size));
+        if(!file)
+        {
+            spdlog::warn("Could not write checkpoint {}", temporary);
+            return false;
+        }
+    }
+    std::remove(m_path.c_str());
+    if(std::rename(temporary.c_str(), m_path.c_str()) != 0)
+    {
+        spdlog::warn("Could not replace checkpoint {}", m_path);
+        return false;
+    }
+
+    spdlog::info("Checkpoint of iteration {} written to {} in {:.1f} ms", state.iteration,
+                 m_path,
+                 std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+bool Checkpoint::load(const std::string& path,
+                      VkFormat           format,
+                      VkExtent2D         extent,
+                      State*             state,
+                      std::vector<char>* texels)
+{
+    std::ifstream file(path, std::ios::binary);
+    Header        header = {};
+    if(!file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        return false;
+    }
+
+    if(header.magic != kMagic || header.version != kVersion || header.seed == 0)
+    {
+        spdlog::warn("{} is not a checkpoint of this version", path);
+        return false;
+    }
+
+    const VkDeviceSize size = VkDeviceSize(extent.width) * extent.height * texelSize(format);
+    if(header.width != extent.width || header.height != extent.height
+       || header.format != uint32_t(format) || header.dataSize != size)
+    {
+        spdlog::warn("Checkpoint {} is {}x{}, does not match the {}x{} render target", path,
+                     header.width, header.height, extent.width, extent.height);
+        return false;
+    }
+
+    std::vector<char> data(size);
+    if(!file.read(data.data(), std::streamsize(size)))
+    {
+        spdlog::warn("Checkpoint {} is truncated", path);
+        return false;
+    }
+
+    state->iteration   = header.iteration;
+    state->firstSample = header.firstSample;
+    state->seed        = header.seed;
+    state->mode        = header.mode;
+    state->fov         = header.fov;
+    std::memcpy(&state->cameraPosition[0], header.cameraPosition, sizeof(header.cameraPosition));
+    std::memcpy(&state->cameraRotation[0], header.cameraRotation, sizeof(header.cameraRotation));
+    std::memcpy(&state->lightTransform[0][0], header.lightTransform,
+                sizeof(header.lightTransform));
+    texels->swap(data);
+    return true;
+}
+
+}  // namespace VkTools
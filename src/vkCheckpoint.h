@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <vector>
+
+#include <vma/vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include <glm/glm.hpp>
+
+namespace VkTools {
+
+// ----------------------------------------------------------------------------
+//  Periodic snapshots of the ray tracing accumulation so long renders survive the process. The
+//  copy to host memory is recorded into a regular frame and the file is written on a worker
+//  thread once the fence of that frame has signaled, the render thread waits on neither.
+//
+
+class Checkpoint
+{
+    public:
+    using Clock = std::chrono::steady_clock;
+
+    // What the accumulation was rendered with, enough to continue the Sobol sequence
+    struct State
+    {
+        uint32_t  iteration   = 1;  // Next iteration to trace, vkContext::m_settings.iteration
+        uint32_t  firstSample = 0;
+        uint32_t  seed        = 0;  // Scramble seed, never zero
+        uint32_t  mode        = 0;
+        glm::vec3 cameraPosition = glm::vec3(0.0f);
+        glm::vec3 cameraRotation = glm::vec3(0.0f);  // Degrees, see CameraControls
+        float     fov            = 65.0f;
+        glm::mat4 lightTransform = glm::mat4(1.0f);
+    };
+
+    // Checkpoints of image go to path, the first one intervalSeconds from now
+    void init(VmaAllocator       allocator,
+              VkImage            image,
+              VkFormat           format,
+              VkExtent2D         extent,
+              const std::string& path,
+              double             intervalSeconds);
+
+    // Waits for a file being written and destroys the readback buffer
+    void cleanUp();
+
+    // True when the interval has passed and the previous checkpoint is on disk
+    bool isDue() const;
+
+    // Copies the image after everything recorded so far in cmdBuf, which is submitted with the
+    // fence of frameSlot. The image has to be in VK_IMAGE_LAYOUT_GENERAL.
+    void recordCopy(VkCommandBuffer cmdBuf, const State& state, uint32_t frameSlot);
+
+    // Call once the fence of frameSlot has signaled, starts writing a copy the slot recorded
+    void resolve(uint32_t frameSlot);
+
+    // Reads a checkpoint of an image with this format and extent. Returns false and leaves the
+    // outputs alone when the file is missing or was written for another image.
+    static bool load(const std::string& path,
+                     VkFormat           format,
+                     VkExtent2D         extent,
+                     State*             state,
+                     std::vector<char>* texels);
+
+    private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t format;
+        uint32_t iteration;
+        uint32_t firstSample;
+        uint32_t seed;
+        uint32_t mode;
+        float    cameraPosition[3];
+        float    cameraRotation[3];
+        float    fov;
+        float    lightTransform[16];
+        uint64_t dataSize;
+    };
+
+    bool write(const State& state) const;
+
+    VmaAllocator  m_allocator = VK_NULL_HANDLE;
+    VkImage       m_image     = VK_NULL_HANDLE;
+    VkFormat      m_format    = VK_FORMAT_UNDEFINED;
+    VkExtent2D    m_extent    = {0, 0};
+    VkBuffer      m_buffer    = VK_NULL_HANDLE;
+    VmaAllocation m_memory    = VK_NULL_HANDLE;
+    const char*   m_mapped    = nullptr;
+    VkDeviceSize  m_size      = 0;
+    std::string   m_path;
+
+    Clock::duration   m_interval;
+    Clock::time_point m_lastCopy;
+
+    // Frame slot whose copy has not been resolved yet, negative when none
+    int   m_pendingSlot = -1;
+    State m_pendingState;
+
+    std::future<bool> m_writer;
+};
+
+}  // namespace VkTools
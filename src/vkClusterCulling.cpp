@@ -0,0 +1,198 @@
+#include "vkClusterCulling.h"
+
+#include <algorithm>
+#include <array>
+
+#include <spdlog/spdlog.h>
+
+#include "vkContext.h"
+#include "vkSceneGeometry.h"
+
+namespace VkTools {
+namespace {
+
+const uint32_t kWorkgroupSize = 64;  // local_size_x of cullClusters.comp
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void ClusterCulling::init(vkContext*                   ctx,
+                          const SceneGeometry&         geometry,
+                          const std::vector<VkBuffer>& uniformBuffers)
+{
+    m_vkctx           = ctx;
+    m_drawBuffer      = geometry.getDrawBuffer();
+    m_drawCountBuffer = geometry.getDrawCountBuffer();
+    m_clusterCount    = geometry.getClusterCount();
+
+    VkDevice                          device     = m_vkctx->getDevice();
+    const VkPhysicalDeviceProperties& properties = m_vkctx->getDeviceProperties();
+    const VkPhysicalDeviceFeatures&   features   = m_vkctx->getDeviceFeatures();
+
+    // The count read on the GPU may not exceed maxDrawIndirectCount, which is 1 without
+    // multiDrawIndirect
+    m_maxDrawsPerCall = features.multiDrawIndirect ? properties.limits.maxDrawIndirectCount : 1;
+    m_drawIndexedIndirectCount = nullptr;
+    if(m_vkctx->hasDrawIndirectCount() && m_clusterCount <= m_maxDrawsPerCall)
+    {
+        m_drawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+    }
+    spdlog::info("Raster preview culls {} clusters, {}", m_clusterCount,
+                 isCompacting() ? "compacted draw count" : "culled draws keep their slot");
+
+    m_dsg.AddBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+    for(uint32_t binding = 1; binding < 4; ++binding)
+    {
+        m_dsg.AddBinding(binding, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                         VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+    m_descriptorSetLayout = m_dsg.GenerateLayout(device);
+
+    // DescriptorSetGenerator sizes its pools for a single set
+    const uint32_t                      setCount  = static_cast<uint32_t>(uniformBuffers.size());
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {};
+    poolSizes[0].type                             = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].descriptorCount                  = setCount;
+    poolSizes[1].type                             = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[1].descriptorCount                  = 3 * setCount;
+
+    VkDescriptorPoolCreateInfo poolInfo = {};
+    poolInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount              = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes                 = poolSizes.data();
+    poolInfo.maxSets                    = setCount;
+    VK_CHECK_RESULT(vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool));
+
+    VkDescriptorBufferInfo clusterInfo = {};
+    clusterInfo.buffer                 = geometry.getClusterBuffer();
+    clusterInfo.offset                 = 0;
+    clusterInfo.range                  = VK_WHOLE_SIZE;
+
+    VkDescriptorBufferInfo drawInfo = {};
+    drawInfo.buffer                 = m_drawBuffer;
+    drawInfo.offset                 = 0;
+    drawInfo.range                  = VK_WHOLE_SIZE;
+
+    VkDescriptorBufferInfo drawCountInfo = {};
+    drawCountInfo.buffer                 = m_drawCountBuffer;
+    drawCountInfo.offset                 = 0;
+    drawCountInfo.range                  = VK_WHOLE_SIZE;
+
+    for(VkBuffer uniformBuffer : uniformBuffers)
+    {
+        VkDescriptorSet set = m_dsg.GenerateSet(device, m_descriptorPool, m_descriptorSetLayout);
+
+        VkDescriptorBufferInfo uboInfo = {};
+        uboInfo.buffer                 = uniformBuffer;
+        uboInfo.offset                 = 0;
+        uboInfo.range                  = sizeof(vkContext::UniformBufferObject);
+
+        m_dsg.Bind(set, 0, {uboInfo});
+        m_dsg.Bind(set, 1, {clusterInfo});
+        m_dsg.Bind(set, 2, {drawInfo});
+        m_dsg.Bind(set, 3, {drawCountInfo});
+        m_dsg.UpdateSetContents(device, set);
+        m_descriptorSets.push_back(set);
+    }
+
+    auto& pipelineCache = m_vkctx->getPipelineCache();
+    auto  timing        = pipelineCache.measure();
+    VkTools::createComputePipeline(device, "../../shaders/spirv/cullClusters.comp.spv",
+                                   m_descriptorSetLayout, sizeof(PushConstants), &m_pipeline,
+                                   &m_pipelineLayout, pipelineCache.get());
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void ClusterCulling::recordCulling(VkCommandBuffer cmdBuf, uint32_t uniformIndex) const
+{
+    // Write after read, an execution dependency is enough
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                         0, nullptr, 0, nullptr, 0, nullptr);
+    vkCmdFillBuffer(cmdBuf, m_drawCountBuffer, 0, sizeof(uint32_t), 0);
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext           = nullptr;
+    barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+
+    const PushConstants pushConstants = {m_clusterCount, isCompacting() ? 1u : 0u};
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1,
+                            &m_descriptorSets[uniformIndex], 0, nullptr);
+    vkCmdPushConstants(cmdBuf, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(cmdBuf, (m_clusterCount + kWorkgroupSize - 1) / kWorkgroupSize, 1, 1);
+
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+}
+
+void ClusterCulling::recordDraws(VkCommandBuffer cmdBuf) const
+{
+    const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if(isCompacting())
+    {
+        m_drawIndexedIndirectCount(cmdBuf, m_drawBuffer, 0, m_drawCountBuffer, 0, m_clusterCount,
+                                   stride);
+        return;
+    }
+
+    for(uint32_t first = 0; first < m_clusterCount; first += m_maxDrawsPerCall)
+    {
+        const uint32_t count = std::min(m_maxDrawsPerCall, m_clusterCount - first);
+        vkCmdDrawIndexedIndirect(cmdBuf, m_drawBuffer, VkDeviceSize(first) * stride, count,
+                                 stride);
+    }
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void ClusterCulling::cleanUp()
+{
+    if(m_vkctx == nullptr)
+    {
+        return;
+    }
+    VkDevice device = m_vkctx->getDevice();
+
+    if(m_pipeline != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(device, m_pipeline, nullptr);
+        m_pipeline = VK_NULL_HANDLE;
+    }
+    if(m_pipelineLayout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+        m_pipelineLayout = VK_NULL_HANDLE;
+    }
+    if(m_descriptorSetLayout != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(device, m_descriptorSetLayout, nullptr);
+        m_descriptorSetLayout = VK_NULL_HANDLE;
+    }
+    if(m_descriptorPool != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+        m_descriptorPool = VK_NULL_HANDLE;
+    }
+    m_descriptorSets.clear();
+}
+
+}  // namespace VkTools
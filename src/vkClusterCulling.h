@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include <NVIDIA_RTX/vkRT_DescriptorSets.h>
+
+class vkContext;
+
+namespace VkTools {
+
+class SceneGeometry;
+
+// ----------------------------------------------------------------------------
+//  GPU driven draws for the raster preview. cullClusters.comp tests the cluster bounds of the
+//  scene geometry against the camera frustum and writes the indirect draws.
+//
+//  With VK_KHR_draw_indirect_count the visible clusters are compacted and drawn with one
+//  vkCmdDrawIndexedIndirectCountKHR. Without it every cluster keeps its command, culled ones
+//  with zero instances, drawn with multi draw indirect or one indirect draw per cluster.
+//
+
+class ClusterCulling
+{
+    public:
+    // One descriptor set per uniform buffer, the graphics UBOs of the swapchain images
+    void init(vkContext*                   ctx,
+              const SceneGeometry&         geometry,
+              const std::vector<VkBuffer>& uniformBuffers);
+    void cleanUp();
+
+    // Outside of a render pass, before recordDraws. Waits for the indirect reads of earlier
+    // submissions, the draw buffers are shared by all swapchain images.
+    void recordCulling(VkCommandBuffer cmdBuf, uint32_t uniformIndex) const;
+
+    // Inside the render pass with the vertex and index buffers of the geometry bound
+    void recordDraws(VkCommandBuffer cmdBuf) const;
+
+    bool isCompacting() const { return m_drawIndexedIndirectCount != nullptr; }
+
+    private:
+    struct PushConstants
+    {
+        uint32_t clusterCount;
+        uint32_t compact;
+    };
+
+    vkContext* m_vkctx = nullptr;
+
+    VkBuffer m_drawBuffer      = VK_NULL_HANDLE;
+    VkBuffer m_drawCountBuffer = VK_NULL_HANDLE;
+    uint32_t m_clusterCount    = 0;
+
+    // Draws per vkCmdDrawIndexedIndirect without compaction, 1 without multiDrawIndirect
+    uint32_t m_maxDrawsPerCall = 1;
+
+    PFN_vkCmdDrawIndexedIndirectCountKHR m_drawIndexedIndirectCount = nullptr;
+
+    DescriptorSetGenerator       m_dsg;
+    VkDescriptorPool             m_descriptorPool      = VK_NULL_HANDLE;
+    VkDescriptorSetLayout        m_descriptorSetLayout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_descriptorSets;
+    VkPipelineLayout             m_pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline                   m_pipeline       = VK_NULL_HANDLE;
+};
+
+}  // namespace VkTools
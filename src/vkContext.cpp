@@ -6,12 +6,47 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <spdlog/spdlog.h>
 #include <string>
+#include <thread>
 
 #include <imgui_impl_glfw_vulkan.h>
 
+
 #define IMGUI_MIN_IMAGE_COUNT 2
 #define MAX_FRAMES_IN_FLIGHT 2
 
+namespace {
+
+// Counts per path so GPU frames and CPU runs of different sizes can be compared
+void logRayStatistics(const char* label, const rtutils::RayStatistics& rays)
+{
+    const double paths = double(std::max<uint64_t>(rays.primary, 1));
+
+    double meanLength = 0.0;
+    for(int i = 0; i < rtutils::RayStatistics::kMaxDepth; ++i)
+    {
+        meanLength += i * double(rays.pathLength[i]) / paths;
+    }
+    spdlog::info("{:>4} {:10} paths {:6.3f} extension/path {:6.3f} shadow/path {:5.2f} bounces",
+                 label, rays.primary, rays.extension / paths, rays.shadow / paths, meanLength);
+
+    std::string histogram;
+    for(int i = 0; i < rtutils::RayStatistics::kMaxDepth; ++i)
+    {
+        histogram += fmt::format(" {:.3f}", rays.pathLength[i] / paths);
+    }
+    spdlog::info("{:>4} ended at bounce 0..15:{}", label, histogram);
+}
+
+void logStagingStats(const char* label, const VkTools::StagingArena::Stats& stats)
+{
+    spdlog::info("{}: {} uploads, {:.1f} MB in {} submits, {} staging buffers, {} stalls, "
+                 "{:.0f} MB/s",
+                 label, stats.uploads, stats.bytes / 1e6, stats.submits, stats.bufferAllocations,
+                 stats.stalls, stats.megabytesPerSecond());
+}
+
+}  // namespace
+
 // ----------------------------------------------------------------------------
 //
 //
@@ -21,6 +56,10 @@ void vkContext::initVulkan()
     m_window             = std::make_unique<vkWindow>(this);
     m_debugAndExtensions = std::make_unique<vkDebugAndExtensions>();
 
+    if(m_scene.render.width > 0 && m_scene.render.height > 0)
+    {
+        m_window->setRequestedSize({m_scene.render.width, m_scene.render.height});
+    }
     m_window->initGLFW();
 
     m_debugAndExtensions->init();
@@ -35,10 +74,22 @@ void vkContext::initVulkan()
     createSurface();
     findQueueFamilyIndices();
     createLogicalDevice();
+    m_pipelineCache.init(m_device, m_gpu.properties, VkTools::hashShaders("../../shaders/spirv"),
+                         "pipeline.cache");
+    m_profiler.init(m_device, m_gpu.properties, m_gpu.features,
+                    m_gpu.queueFamilyProperties[m_gpu.queueFamily], m_gpu.queueFamily,
+                    MAX_FRAMES_IN_FLIGHT);
     createSynchronizationPrimitives();
     createSwapchain();
     createRenderPass();
     createCommandPools();
+
+    // Larger uploads, like big environment maps, get a staging buffer of their own
+    m_staging = std::make_unique<VkTools::StagingArena>();
+    m_staging->init(m_device, m_allocator, m_queue, m_graphics.commandPool, 64 * 1024 * 1024);
+    m_textureRegistry = std::make_unique<VkTools::TextureRegistry>();
+    m_textureRegistry->init(m_device, m_allocator);
+
     createDepthResources();
     createFrameBuffers();
     createCommandBuffers();
@@ -49,39 +100,71 @@ void vkContext::initVulkan()
     m_settings.zNear = &m_window->m_camera.m_near;
     m_settings.zFar  = &m_window->m_camera.m_far;
 
-    //LoadModelFromFile("../../scenes/cornell/cornell.obj");
-    //LoadModelFromFile("../../scenes/sponza/sponza.obj");
-
-
-    //LoadModelFromFile("../../scenes/medieval/Medieval_building.obj");
-    //LoadModelFromFile("../../scenes/cornellBox/cornellBox-Original.obj");
-    //LoadModelFromFile("../../scenes/cornellBox/cornellBox-Sphere.obj");
-    //LoadModelFromFile("../../scenes/cornell/cornell_chesterfield.obj");
-    //LoadModelFromFile("../../scenes/living_room/living_room.obj");
-    //LoadModelFromFile("../../scenes/dragon/dragon.obj");
-    //LoadModelFromFile("../../scenes/crytek-sponza/sponza2.obj");
-    //LoadModelFromFile("../../scenes/crytek_sponza/sponza.obj");
-    //LoadModelFromFile("../../scenes/conference/conference.obj");
-    //LoadModelFromFile("../../scenes/myboxes/mybox.obj");
-    //LoadModelFromFile("../../scenes/classroom/classroom.obj");
+    // Window callbacks feed ImGui, events are polled while the model loads
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
 
-    LoadModelFromFile("../../scenes/conferenceBall/conferenceBallDragon3.obj");
-    //LoadModelFromFile("../../scenes/Balls/balls.obj");
-    //LoadModelFromFile("../../scenes/breakfast_room/breakfast_room.obj");
-    //LoadModelFromFile("../../scenes/gallery/gallery.obj");
-    //LoadModelFromFile("../../scenes/suzanne.obj");
+    {
+        const auto start = std::chrono::high_resolution_clock::now();
+        m_assetStreamer.start(this, m_scene.scene.model, m_scene.modelTransform());
+        if(!m_scene.scene.environment.empty())
+        {
+            LoadEnvironmentMap(m_scene.scene.environment);
+        }
+        waitForModel();
+        m_sceneLoadMs = std::chrono::duration<double, std::milli>(
+                            std::chrono::high_resolution_clock::now() - start)
+                            .count();
+    }
 
     m_vkRTX = std::make_unique<VkRTX>(this, m_window->getWindowSize());
+
+    // A resumed render continues with the scrambles it started with, checkpoints need a seed
+    // they can store
+    VkTools::Checkpoint::State resumeState;
+    std::vector<char>          resumeTexels;
+    const bool resume = m_scene.checkpoint.resume && loadCheckpoint(&resumeState, &resumeTexels);
+    if(resume)
+    {
+        m_scene.render.seed = resumeState.seed;
+    }
+    else if(m_scene.render.seed == 0 && !m_scene.checkpoint.file.empty())
+    {
+        m_scene.render.seed = std::random_device()() | 1u;
+    }
+    m_vkRTX->setScrambleSeed(m_scene.render.seed);
     m_vkRTX->initRaytracing(m_gpu.physicalDevice, &m_models, &m_rtUniformBuffer,
                             &m_rtUniformMemory);
+    m_settings.denoiser       = &m_vkRTX->getDenoiser()->m_settings;
+    m_settings.reprojection   = m_vkRTX->getReprojectionSettings();
+    m_settings.shaderVariants = m_vkRTX->getShaderVariantSettings();
+    m_settings.rayStatistics  = m_vkRTX->getRayStatisticsSettings();
+    applySceneDescription();
+    if(!m_scene.checkpoint.file.empty())
+    {
+        m_checkpoint.init(m_allocator, m_vkRTX->getAccumulationImage(),
+                          m_vkRTX->getAccumulationFormat(), m_vkRTX->getExtent(),
+                          m_scene.checkpoint.file, m_scene.checkpoint.interval);
+    }
+    if(resume)
+    {
+        resumeFromCheckpoint(resumeState, resumeTexels);
+    }
     //m_vkRTX->updateRaytracingRenderTarget(m_swapchain.views[0]);
 
 
     createDescriptorPool();
     setupGraphicsDescriptors();
+    m_clusterCulling.init(this, m_sceneGeometry, m_graphics.uniformBuffers);
     createPipeline();
     initDearImGui();
 
+    spdlog::info("Pipeline creation: {:.2f} ms ({} start)", m_pipelineCache.creationMilliseconds(),
+                 m_pipelineCache.isWarm() ? "warm" : "cold");
+
+    m_staging->flush();
+    logStagingStats("Startup uploads", m_staging->getStats());
+
     recordCommandBuffers();
 }
 
@@ -102,7 +185,13 @@ void vkContext::mainLoop()
         m_window->pollEvents();
         m_window->update(m_deltaTime);
 
+        streamAssets();
+        streamTextureMips();
         renderFrame();
+        if(hasOutput() && !m_outputWritten && isAccumulationDone())
+        {
+            writeOutputImage();
+        }
 
         //m_vkRTX->generateNewScrambles();
         //m_vkRTX->updateScrambleValueImage();
@@ -117,20 +206,280 @@ void vkContext::mainLoop()
     }
 }
 
+// ----------------------------------------------------------------------------
+//  Settings, camera and light of m_scene, called once the UI controlled pointers are set
+//
+
+void vkContext::applySceneDescription()
+{
+    const rtutils::SceneDescription& scene = m_scene;
+
+    // Output images need the ray tracer
+    m_settings.RTX_ON               = scene.render.raytracing || hasOutput();
+    m_settings.rtRenderingMode      = scene.render.mode;
+    m_settings.samplesPerPixel      = scene.render.spp;
+    m_settings.numIndicesBounces    = scene.render.bounces;
+    m_settings.numAArays            = scene.render.aaRays;
+    m_settings.filterRadius         = scene.render.filterRadius;
+    m_settings.numAOrays            = scene.render.aoRays;
+    m_settings.aoRayLength          = scene.render.aoRayLength;
+    m_settings.russianRoulette      = scene.render.russianRouletteDepth >= 0;
+    m_settings.lightSourceArea      = scene.light.size;
+    m_settings.lightE               = scene.light.emission;
+    m_settings.lightOtherE          = scene.light.otherE;
+    m_settings.environmentE         = scene.scene.environmentE;
+    if(scene.render.russianRouletteDepth >= 0)
+    {
+        m_settings.russianRouletteDepth = scene.render.russianRouletteDepth;
+    }
+
+    *m_settings.fov   = scene.camera.fov;
+    *m_settings.zNear = scene.camera.zNear;
+    *m_settings.zFar  = scene.camera.zFar;
+    m_window->m_camera.update(0.0f);
+    if(scene.camera.placed)
+    {
+        m_window->m_camera.lookAt(scene.camera.eye, scene.camera.target);
+    }
+    m_cameraMoved = true;
+
+    // The light faces down its local -z like the camera
+    m_moveLight = !scene.light.placed;
+    if(scene.light.placed)
+    {
+        const glm::vec3 forward = glm::normalize(scene.light.target - scene.light.position);
+        const glm::vec3 up      = std::abs(forward.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f)
+                                                               : glm::vec3(0.0f, 1.0f, 0.0f);
+        m_lightTransform =
+            glm::inverse(glm::lookAt(scene.light.position, scene.light.target, up));
+    }
+}
+
+bool vkContext::isAccumulationDone() const
+{
+    // Streamed textures restart the accumulation
+    if(!m_settings.RTX_ON || !m_assetStreamer.isDone())
+    {
+        return false;
+    }
+    return m_settings.rtRenderingMode == 0
+               ? m_settings.iteration >= uint32_t(m_settings.samplesPerPixel)
+               : m_settings.iteration >= uint32_t(m_settings.numAOrays);
+}
+
+// ----------------------------------------------------------------------------
+//  The image is the accumulation resolved by its filter weights, the denoiser is not applied
+//
+
+void vkContext::writeOutputImage()
+{
+    vkDeviceWaitIdle(m_device);
+
+    const rtutils::Image4f accumulation = m_vkRTX->readAccumulation();
+    const std::string&     imagePath    = m_scene.output.image;
+    if(!imagePath.empty())
+    {
+        if(rtutils::writePfm(imagePath, rtutils::resolveAccumulation(accumulation)))
+        {
+            spdlog::info("Wrote {}x{} image to {}", accumulation.width, accumulation.height,
+                         imagePath);
+        }
+        else
+        {
+            spdlog::error("Could not write {}", imagePath);
+        }
+    }
+
+    const std::string& accumulationPath = m_scene.output.accumulation;
+    if(!accumulationPath.empty())
+    {
+        if(rtutils::writeAccumulation(accumulationPath, accumulation))
+        {
+            spdlog::info("Wrote samples {}..{} to {}", m_scene.render.firstSample + 1,
+                         m_scene.render.firstSample + m_settings.iteration - 1, accumulationPath);
+        }
+        else
+        {
+            spdlog::error("Could not write {}", accumulationPath);
+        }
+    }
+    m_outputWritten = true;
+
+    if(m_scene.output.exit)
+    {
+        glfwSetWindowShouldClose(m_window->getWindow(), GLFW_TRUE);
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  Only checkpoints of the same render target, mode and sample range are resumed
+//
+
+bool vkContext::loadCheckpoint(VkTools::Checkpoint::State* state, std::vector<char>* texels) const
+{
+    const std::string& path = m_scene.checkpoint.file;
+    if(path.empty()
+       || !VkTools::Checkpoint::load(path, m_vkRTX->getAccumulationFormat(),
+                                     m_vkRTX->getExtent(), state, texels))
+    {
+        return false;
+    }
+    if(state->mode != uint32_t(m_scene.render.mode)
+       || state->firstSample != m_scene.render.firstSample)
+    {
+        spdlog::warn("Checkpoint {} was rendered with another mode or first sample, starting over",
+                     path);
+        return false;
+    }
+    return true;
+}
+
+void vkContext::resumeFromCheckpoint(const VkTools::Checkpoint::State& state,
+                                     const std::vector<char>&          texels)
+{
+    CameraControls& camera = m_window->m_camera;
+    *m_settings.fov        = state.fov;
+    camera.update(0.0f);
+    camera.setPose(state.cameraPosition, state.cameraRotation);
+
+    m_lightTransform = state.lightTransform;
+    m_moveLight      = false;
+
+    m_vkRTX->uploadAccumulation(texels);
+    m_settings.iteration = state.iteration;
+    m_cameraMoved        = false;
+
+    spdlog::info("Resumed {} at iteration {}", m_scene.checkpoint.file, state.iteration);
+}
+
+VkTools::Checkpoint::State vkContext::checkpointState() const
+{
+    const CameraControls& camera = m_window->m_camera;
+
+    VkTools::Checkpoint::State state;
+    state.iteration      = m_settings.iteration;
+    state.firstSample    = m_scene.render.firstSample;
+    state.seed           = m_scene.render.seed;
+    state.mode           = uint32_t(m_settings.rtRenderingMode);
+    state.cameraPosition = camera.getPosition();
+    state.cameraRotation = camera.getRotation();
+    state.fov            = camera.m_fov;
+    state.lightTransform = m_lightTransform;
+    return state;
+}
+
+// ----------------------------------------------------------------------------
+//  Runs spp path tracing frames plus enough empty ones for the last counters and timestamps to
+//  be read back. Reprojection and shader variants are off so every frame traces the same
+//  pipeline from scratch, the denoiser keeps its default and counts as postprocess.
+//
+
+rtutils::BenchmarkResult vkContext::runBenchmark(const rtutils::BenchmarkScene& scene)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    m_scene                   = {};
+    m_scene.scene.model       = scene.model;
+    m_scene.scene.environment = scene.environment;
+    m_scene.camera.placed     = true;
+    m_scene.camera.eye        = scene.eye;
+    m_scene.camera.target     = scene.target;
+    m_scene.camera.fov        = scene.fov;
+    m_scene.light.size        = scene.lightSize;
+    m_scene.light.emission    = scene.lightE;
+    m_scene.render.width      = scene.width;
+    m_scene.render.height     = scene.height;
+    m_scene.render.raytracing = true;
+    m_scene.render.spp        = int(scene.spp) + 1;  // Iterations start at 1
+    m_scene.render.bounces    = scene.bounces;
+    m_scene.render.seed       = scene.seed;
+
+    // Every frame traces the textures at full size
+    m_textureCache.m_settings.enabled = false;
+    initVulkan();
+    finishAssetStreaming();
+
+    m_settings.hideUI                  = true;
+    m_settings.reprojection->enabled   = false;
+    m_settings.shaderVariants->enabled = false;
+    m_settings.rayStatistics->enabled  = true;
+
+    rtutils::BenchmarkResult result;
+    result.scene   = scene.name;
+    result.backend = "gpu";
+    result.device  = m_gpu.properties.deviceName;
+    result.width   = m_swapchain.extent.width;
+    result.height  = m_swapchain.extent.height;
+    result.spp     = scene.spp;
+    result.bounces = scene.bounces;
+    result.seed    = scene.seed;
+    result.loadMs  = std::max(m_sceneLoadMs, m_assetStreamer.getProgress().totalMs);
+    result.buildMs = m_vkRTX->getAccelerationStructureBuildMs();
+
+    uint64_t resolved = 0;
+    for(uint32_t frame = 0; frame < scene.spp + MAX_FRAMES_IN_FLIGHT; ++frame)
+    {
+        m_window->pollEvents();
+        renderFrame();
+
+        // Counters and timestamps of a frame are read back together, frames without a trace
+        // have neither
+        const VkRTX::RayStatisticsFrame& rays = m_vkRTX->getRayStatistics();
+        if(rays.frames == resolved)
+        {
+            continue;
+        }
+        resolved = rays.frames;
+        result.rays += rays.rays.total();
+        result.traceMs += std::max(rays.traceMs, 0.0);
+        for(const char* scope : {"Reproject and denoise", "Post-process"})
+        {
+            result.postprocessMs += std::max(m_profiler.lastGpuDurationMs(scope), 0.0);
+        }
+    }
+    vkDeviceWaitIdle(m_device);
+
+    if(resolved != scene.spp)
+    {
+        result.status = fmt::format("read back {} of {} frames", resolved, scene.spp);
+    }
+    result.totalMs = std::chrono::duration<double, std::milli>(
+                         std::chrono::high_resolution_clock::now() - start)
+                         .count();
+
+    cleanUp();
+    return result;
+}
+
 // ----------------------------------------------------------------------------
 //
 //
 
 void vkContext::renderFrame()
 {
-    vkWaitForFences(m_device, 1, &m_graphics.inFlightFences[m_currentImage], VK_TRUE, UINT64_MAX);
+    m_profiler.newFrame();
+    {
+        auto timing = m_profiler.cpuScope("Wait for fence");
+        vkWaitForFences(m_device, 1, &m_graphics.inFlightFences[m_currentImage], VK_TRUE,
+                        UINT64_MAX);
+    }
     vkResetFences(m_device, 1, &m_graphics.inFlightFences[m_currentImage]);
 
+    // Resets the queries of this frame, submitted ahead of everything else
+    VkCommandBuffer profilerCommandBuffer = m_profiler.recordFrameStart(m_currentImage);
+    m_vkRTX->resolveRayStatistics(m_currentImage);
+    m_vkRTX->resolveTextureFeedback(m_currentImage);
+    m_checkpoint.resolve(m_currentImage);
+
     uint32_t imageIndex = 0;
-    VkResult result =
-        vkAcquireNextImageKHR(m_device, m_swapchain.swapchain, std::numeric_limits<uint64_t>::max(),
-                              m_graphics.imageAvailableSemaphores[m_currentImage], VK_NULL_HANDLE,
-                              &imageIndex);
+    VkResult result;
+    {
+        auto timing = m_profiler.cpuScope("Acquire image");
+        result      = vkAcquireNextImageKHR(m_device, m_swapchain.swapchain,
+                                       std::numeric_limits<uint64_t>::max(),
+                                       m_graphics.imageAvailableSemaphores[m_currentImage],
+                                       VK_NULL_HANDLE, &imageIndex);
+    }
     if(result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR)
     {
         recreateSwapchain();
@@ -146,12 +495,15 @@ void vkContext::renderFrame()
     // ImGui
     VkCommandBuffer cmdBufImGui = beginSingleTimeCommands();
     {
+        auto     timing = m_profiler.cpuScope("Record ImGui");
+        uint32_t scope  = m_profiler.beginGpuScope(cmdBufImGui, "ImGui", true);
         beginRenderPass(cmdBufImGui, m_graphics.renderpassImGui);
         vkCmdBindPipeline(cmdBufImGui, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphics.pipeline);
 
         renderImGui(cmdBufImGui);
 
         endRenderPass(cmdBufImGui);
+        m_profiler.endGpuScope(cmdBufImGui, scope);
         vkEndCommandBuffer(cmdBufImGui);
     }
 
@@ -160,18 +512,31 @@ void vkContext::renderFrame()
     if(m_settings.RTX_ON)
     {
         VkCommandBuffer rtCommandBuffer = beginSingleTimeCommands();
-        VkRenderPass    renderpass      = m_cameraMoved ? m_rtRenderpass : m_rtRenderpassNoClear;
+        VkRenderPass    renderpass      = (m_cameraMoved && !m_settings.reprojection->enabled)
+                                              ? m_rtRenderpass
+                                              : m_rtRenderpassNoClear;
         if(m_settings.iteration < m_settings.samplesPerPixel)
         {
+            auto timing = m_profiler.cpuScope("Record ray tracing");
+            m_vkRTX->selectPipelineVariant(m_settings.rtRenderingMode,
+                                           m_settings.numIndicesBounces, m_settings.numAArays,
+                                           m_settings.numAOrays);
             m_vkRTX->recordCommandBuffer(rtCommandBuffer, renderpass,
                                          m_swapchain.frameBuffers[m_currentImage],
                                          m_swapchain.images[m_currentImage],
-                                         m_settings.rtRenderingMode);
+                                         m_settings.rtRenderingMode, m_reprojectFrame);
+
+            // Copied after the trace, the file is written once this frame's fence signals
+            if(m_checkpoint.isDue())
+            {
+                m_checkpoint.recordCopy(rtCommandBuffer, checkpointState(), m_currentImage);
+            }
         }
 
         VK_CHECK_RESULT(vkEndCommandBuffer(rtCommandBuffer));
 
-        std::array<VkCommandBuffer, 2> cmdBuffersRT = {rtCommandBuffer, cmdBufImGui};
+        std::array<VkCommandBuffer, 3> cmdBuffersRT = {profilerCommandBuffer, rtCommandBuffer,
+                                                       cmdBufImGui};
 
         VkSubmitInfo submitInfo         = {};
         submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -183,7 +548,11 @@ void vkContext::renderFrame()
         submitInfo.commandBufferCount   = static_cast<uint32_t>(cmdBuffersRT.size());
         submitInfo.pCommandBuffers      = cmdBuffersRT.data();
 
-        result = vkQueueSubmit(m_queue, 1, &submitInfo, m_graphics.inFlightFences[m_currentImage]);
+        {
+            auto timing = m_profiler.cpuScope("Submit");
+            result      = vkQueueSubmit(m_queue, 1, &submitInfo,
+                                   m_graphics.inFlightFences[m_currentImage]);
+        }
         if(result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR)
         {
             recreateSwapchain();
@@ -191,8 +560,8 @@ void vkContext::renderFrame()
     }
     else
     {
-        std::array<VkCommandBuffer, 2> cmdBuffers = {m_swapchain.commandBuffers[imageIndex],
-                                                     cmdBufImGui};
+        std::array<VkCommandBuffer, 3> cmdBuffers = {
+            profilerCommandBuffer, m_swapchain.commandBuffers[imageIndex], cmdBufImGui};
 
         VkSubmitInfo submitInfo         = {};
         submitInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -204,7 +573,11 @@ void vkContext::renderFrame()
         submitInfo.commandBufferCount   = static_cast<uint32_t>(cmdBuffers.size());
         submitInfo.pCommandBuffers      = cmdBuffers.data();
 
-        result = vkQueueSubmit(m_queue, 1, &submitInfo, m_graphics.inFlightFences[m_currentImage]);
+        {
+            auto timing = m_profiler.cpuScope("Submit");
+            result      = vkQueueSubmit(m_queue, 1, &submitInfo,
+                                   m_graphics.inFlightFences[m_currentImage]);
+        }
         if(result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR)
         {
             recreateSwapchain();
@@ -221,7 +594,10 @@ void vkContext::renderFrame()
     presentInfo.pImageIndices      = &imageIndex;
     presentInfo.pResults           = nullptr;
 
-    result = vkQueuePresentKHR(m_queue, &presentInfo);
+    {
+        auto timing = m_profiler.cpuScope("Present");
+        result      = vkQueuePresentKHR(m_queue, &presentInfo);
+    }
     if(result == VK_SUBOPTIMAL_KHR || result == VK_ERROR_OUT_OF_DATE_KHR)
     {
         recreateSwapchain();
@@ -254,6 +630,33 @@ void vkContext::renderImGui(VkCommandBuffer commandBuffer)
     ImGui::SetNextWindowPos(windowPos, 0);
 
     ImGui::Text("%.3f ms/frame", 1000.0f / io.Framerate);
+    if(!m_assetStreamer.isDone())
+    {
+        const VkTools::AssetStreamer::Progress progress = m_assetStreamer.getProgress();
+        ImGui::Text("Textures: %u of %u uploaded, %u decoded", progress.texturesUploaded,
+                    progress.textureCount, progress.texturesDecoded);
+    }
+    {
+        uint32_t slots = 0;
+        for(const auto& model : m_models)
+        {
+            slots += static_cast<uint32_t>(model.m_textures.size());
+        }
+        ImGui::Text("%u texture images in %u slots, 1 sampler",
+                    m_textureRegistry->getStats().images, slots);
+    }
+    const VkTools::TextureCache::Stats& textureStats = m_textureCache.getStats();
+    if(textureStats.textures > 0)
+    {
+        ImGui::Checkbox("Texture residency", &m_textureCache.m_settings.enabled);
+        ImGui::SliderInt("Texture budget (MB)", &m_textureCache.m_settings.budgetMB, 16, 4096,
+                         "%d");
+        ImGui::Text("%u of %u textures above their base mip, %u at full size",
+                    textureStats.aboveBase, textureStats.textures, textureStats.fullSize);
+        ImGui::Text("%.1f MB resident, %.1f MB uploaded, %u evictions",
+                    textureStats.residentBytes / 1048576.0, textureStats.uploadedBytes / 1048576.0,
+                    textureStats.evictions);
+    }
 
     ImGui::Checkbox("RTX ON", &m_settings.RTX_ON);
     ImGui::Separator();
@@ -264,6 +667,11 @@ void vkContext::renderImGui(VkCommandBuffer commandBuffer)
     ImGui::Separator();
 
     ImGui::SliderInt("Indirect bounces", &m_settings.numIndicesBounces, 0, 10, "%d");
+    ImGui::Checkbox("Russian roulette", &m_settings.russianRoulette);
+    if(m_settings.russianRoulette)
+    {
+        ImGui::SliderInt("Russian roulette depth", &m_settings.russianRouletteDepth, 0, 10, "%d");
+    }
     ImGui::SliderInt("SPP", &m_settings.samplesPerPixel, 1, 4096 * 8, "%d");
     ImGui::SliderInt("AA Rays", &m_settings.numAArays, 1, 8, "%d");
     ImGui::SliderFloat("AA filter radius", &m_settings.filterRadius, 0.0f, 4.0f, "%.3f", 1.0f);
@@ -271,6 +679,11 @@ void vkContext::renderImGui(VkCommandBuffer commandBuffer)
                        4.0f);
     ImGui::SliderFloat("Area light intensity", &m_settings.lightE, 0.1f, 100000.0f, "%.1f", 4.0f);
     ImGui::SliderFloat("Light intensity", &m_settings.lightOtherE, 0.0f, 10000.0f, "%.1f", 4.0f);
+    if(m_environmentMap)
+    {
+        ImGui::SliderFloat("Environment intensity", &m_settings.environmentE, 0.0f, 100.0f,
+                           "%.2f", 4.0f);
+    }
     ImGui::Separator();
 
     ImGui::SliderInt("AO rays", &m_settings.numAOrays, 1, 256, "%d");
@@ -283,33 +696,298 @@ void vkContext::renderImGui(VkCommandBuffer commandBuffer)
         ImGui::Combo("Sampling mode", &m_settings.rtRenderingMode, modes, IM_ARRAYSIZE(modes));
         //m_settings.rtRenderingMode = select;
     }
+    ImGui::Checkbox("Specialized shaders", &m_settings.shaderVariants->enabled);
+    ImGui::Checkbox("Ray statistics", &m_settings.rayStatistics->enabled);
+    if(m_settings.rayStatistics->enabled)
+    {
+        drawRayStatistics();
+    }
+    ImGui::Separator();
+
+    ImGui::Checkbox("Reproject on camera motion", &m_settings.reprojection->enabled);
+    if(m_settings.reprojection->enabled)
+    {
+        ImGui::SliderFloat("Max reprojected samples", &m_settings.reprojection->maxSamples, 1.0f,
+                           4096.0f, "%.0f", 4.0f);
+    }
+    ImGui::Checkbox("Denoiser", &m_settings.denoiser->enabled);
+    if(m_settings.denoiser->enabled)
+    {
+        ImGui::SliderInt("A-trous iterations", &m_settings.denoiser->atrousIterations, 1, 8, "%d");
+        ImGui::SliderFloat("Phi color", &m_settings.denoiser->phiColor, 0.1f, 64.0f, "%.2f", 2.0f);
+        ImGui::SliderFloat("Phi normal", &m_settings.denoiser->phiNormal, 1.0f, 256.0f, "%.1f",
+                           2.0f);
+        ImGui::SliderFloat("Phi depth", &m_settings.denoiser->phiDepth, 0.001f, 1.0f, "%.3f", 2.0f);
+        ImGui::SliderFloat("Temporal alpha", &m_settings.denoiser->alpha, 0.01f, 1.0f, "%.2f");
+        ImGui::SliderFloat("Moments alpha", &m_settings.denoiser->momentsAlpha, 0.01f, 1.0f,
+                           "%.2f");
+    }
     ImGui::Separator();
+    if(ImGui::Button("Benchmark light sampling (CPU)"))
+    {
+        runSamplingBenchmark();
+    }
+    if(ImGui::Button("Benchmark Russian roulette (CPU)"))
+    {
+        runRouletteBenchmark();
+    }
+    if(ImGui::Button("Benchmark 8K environment tables"))
+    {
+        runEnvironmentBenchmark();
+    }
+    if(ImGui::Button("Benchmark ray sorting (CPU)"))
+    {
+        runRaySortingBenchmark();
+    }
     ImGui::Text("%d samples accumulated", m_settings.iteration);
+    ImGui::Checkbox("Profiler", &m_settings.showProfiler);
 
 
     ImGui::End();
 
+    if(m_settings.showProfiler)
+    {
+        m_profiler.drawImGui(&m_settings.showProfiler);
+    }
+
 
     ImGui_ImplGlfwVulkan_Render(commandBuffer);
 }
 
 // ----------------------------------------------------------------------------
+//  CPU copy of the loaded models, the area light and the current view for the reference path
+//  tracer
 //
+
+rtutils::CpuScene vkContext::createCpuScene() const
+{
+    rtutils::CpuScene scene;
+    for(const auto& m : m_models)
+    {
+        rtutils::appendModel(m, &scene);
+    }
+
+    scene.light.transform  = m_lightTransform;
+    scene.light.size       = glm::vec2(m_settings.lightSourceArea);
+    scene.light.radiance   = glm::vec3(1.0f) * m_settings.lightE;
+    scene.emissionScale    = m_settings.lightOtherE;
+    scene.environment      = m_environmentMap;
+    scene.environmentScale = m_settings.environmentE;
+
+    glm::mat4 proj = m_window->m_camera.matrices.projection;
+    proj[1][1] *= -1.0f;
+    scene.viewProjInverse = glm::inverse(m_window->m_camera.matrices.view) * glm::inverse(proj);
+    return scene;
+}
+
+// ----------------------------------------------------------------------------
+//  RMSE versus time of BSDF sampling, light sampling and MIS on the CPU reference path tracer,
+//  current view at quarter resolution. Blocks the render loop until done.
 //
 
-void vkContext::cleanUp()
+void vkContext::runSamplingBenchmark()
+{
+    const rtutils::CpuScene scene = createCpuScene();
+
+    const uint32_t width  = std::max(1u, m_swapchain.extent.width / 4);
+    const uint32_t height = std::max(1u, m_swapchain.extent.height / 4);
+
+    spdlog::info("Sampling benchmark: {}x{}, {} bounces", width, height,
+                 m_settings.numIndicesBounces);
+
+    const auto results = rtutils::benchmarkSamplingStrategies(
+        scene, m_settings.numIndicesBounces, width, height, 256, 5.0);
+
+    for(const auto& result : results)
+    {
+        // Log at power of two sample counts to keep the output short
+        for(const auto& sample : result.samples)
+        {
+            if((sample.samples & (sample.samples - 1)) == 0 || &sample == &result.samples.back())
+            {
+                spdlog::info("{:>5} {:8.3f} s {:6} spp {:8.2f} rays/px  rmse {:.5f}",
+                             rtutils::toString(result.strategy), sample.seconds, sample.samples,
+                             sample.raysPerPixel, sample.rmse);
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  Time and rays per pixel with and without Russian roulette at equal error, same setup as
+//  runSamplingBenchmark
+//
+
+void vkContext::runRouletteBenchmark()
 {
+    const rtutils::CpuScene scene = createCpuScene();
+
+    const uint32_t width  = std::max(1u, m_swapchain.extent.width / 4);
+    const uint32_t height = std::max(1u, m_swapchain.extent.height / 4);
+
+    spdlog::info("Russian roulette benchmark: {}x{}, {} bounces, roulette from bounce {}", width,
+                 height, m_settings.numIndicesBounces, m_settings.russianRouletteDepth);
+
+    const auto result = rtutils::benchmarkRussianRoulette(
+        scene, m_settings.numIndicesBounces, m_settings.russianRouletteDepth, width, height, 256,
+        32);
+
+    for(const auto* sample : {&result.withoutRoulette, &result.withRoulette})
+    {
+        spdlog::info("{:>8} {:8.3f} s {:6} spp {:8.2f} rays/px  rmse {:.5f}",
+                     sample == &result.withRoulette ? "roulette" : "full", sample->seconds,
+                     sample->samples, sample->raysPerPixel, sample->rmse);
+    }
+    if(!result.converged)
+    {
+        spdlog::info("Russian roulette did not reach the baseline error within the sample cap");
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  Construction time of the environment sampling tables for an 8192x4096 map
+//
+
+void vkContext::runEnvironmentBenchmark()
+{
+    const double milliseconds = rtutils::benchmarkEnvironmentTables(8192, 4096, 5);
+    spdlog::info("Environment tables 8192x4096: {:.1f} ms", milliseconds);
+}
+
+// ----------------------------------------------------------------------------
+//  Closest hit throughput of the first bounce on the CPU, extension rays traced in pixel order
+//  and binned by direction octant and origin, current view at quarter resolution
+//
+
+void vkContext::runRaySortingBenchmark()
+{
+    const rtutils::CpuScene scene = createCpuScene();
+
+    const uint32_t width  = std::max(1u, m_swapchain.extent.width / 4);
+    const uint32_t height = std::max(1u, m_swapchain.extent.height / 4);
+
+    const rtutils::RaySortingComparison result =
+        rtutils::benchmarkRaySorting(scene, width, height, 8);
 
+    spdlog::info("Ray sorting: {} extension rays of {}x{} frames", result.rays, width, height);
+    spdlog::info("  unsorted {:8.1f} ms  {:6.2f} Mrays/s", result.unsortedMs,
+                 result.unsortedRaysPerSecond() * 1e-6);
+    spdlog::info("  sorted   {:8.1f} ms  {:6.2f} Mrays/s including {:.1f} ms of sorting",
+                 result.sortMs + result.sortedMs, result.sortedRaysPerSecond() * 1e-6,
+                 result.sortMs);
+    if(result.sortedHits != result.unsortedHits)
+    {
+        spdlog::warn("Ray sorting: {} hits sorted, {} unsorted", result.sortedHits,
+                     result.unsortedHits);
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  Counters of the last GPU frame next to the CPU reference tracing the same view at quarter
+//  resolution. The CPU tracer ignores textures, so expect small differences in scenes using
+//  them for albedo.
+//
+
+void vkContext::runRayStatisticsCrossCheck()
+{
+    const VkRTX::RayStatisticsFrame& frame = m_vkRTX->getRayStatistics();
+    if(frame.frames > 0 && frame.mode == 0)
+    {
+        logRayStatistics("GPU", frame.rays);
+    }
+    else
+    {
+        spdlog::info("No GPU ray statistics of the path tracer to compare against");
+    }
+
+    const rtutils::CpuScene      scene = createCpuScene();
+    const rtutils::CpuPathTracer tracer(scene);
+
+    rtutils::PathTracerSettings settings;
+    settings.maxBounces           = m_settings.numIndicesBounces;
+    settings.strategy             = rtutils::SamplingStrategy::Mis;
+    settings.russianRouletteDepth =
+        m_settings.russianRoulette ? m_settings.russianRouletteDepth : -1;
+
+    const uint32_t width  = std::max(1u, m_swapchain.extent.width / 4);
+    const uint32_t height = std::max(1u, m_swapchain.extent.height / 4);
+
+    rtutils::Image4f       accumulation(width, height);
+    rtutils::RayStatistics rays;
+    const auto             start = std::chrono::high_resolution_clock::now();
+    for(uint32_t i = 0; i < 4; ++i)
+    {
+        rays += tracer.render(settings, i, &accumulation);
+    }
+    const std::chrono::duration<double> seconds = std::chrono::high_resolution_clock::now() - start;
+
+    logRayStatistics("CPU", rays);
+    spdlog::info(" CPU {:.2f} Mrays/s", rays.total() / seconds.count() * 1e-6);
+}
+
+// ----------------------------------------------------------------------------
+//  Counters of the latest frame read back, Mrays/s over the "Trace rays" GPU scope
+//
+
+void vkContext::drawRayStatistics()
+{
+    const VkRTX::RayStatisticsFrame& frame = m_vkRTX->getRayStatistics();
+    if(frame.frames == 0)
+    {
+        ImGui::Text("Waiting for the first frame");
+        return;
+    }
+
+    const rtutils::RayStatistics& rays = frame.rays;
+    ImGui::Text("Primary %llu", static_cast<unsigned long long>(rays.primary));
+    ImGui::Text("Extension %llu", static_cast<unsigned long long>(rays.extension));
+    ImGui::Text("Shadow %llu", static_cast<unsigned long long>(rays.shadow));
+    if(frame.traceMs > 0.0)
+    {
+        ImGui::Text("%.1f Mrays/s in %.2f ms", rays.total() / (frame.traceMs * 1e3),
+                    frame.traceMs);
+    }
+
+    // Fraction of paths ending at each bounce, AO paths all end at 0
+    const double paths = double(std::max<uint64_t>(rays.primary, 1));
+    float        histogram[rtutils::RayStatistics::kMaxDepth];
+    for(int i = 0; i < rtutils::RayStatistics::kMaxDepth; ++i)
+    {
+        histogram[i] = float(rays.pathLength[i] / paths);
+    }
+    ImGui::PlotHistogram("Path length", histogram, rtutils::RayStatistics::kMaxDepth, 0, nullptr,
+                         0.0f, 1.0f, ImVec2(0.0f, 60.0f));
+
+    if(ImGui::Button("Log and cross-check (CPU)"))
+    {
+        runRayStatisticsCrossCheck();
+    }
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void vkContext::cleanUp()
+{
+    vkDeviceWaitIdle(m_device);
     cleanUpSwapchain();
 
 
+    m_assetStreamer.cleanUp();
+    m_textureCache.cleanUp();
+    m_staging->cleanUp();
+    m_checkpoint.cleanUp();
     m_vkRTX->cleanUp();
     ImGui_ImplGlfwVulkan_Shutdown();
 
+    m_clusterCulling.cleanUp();
+    m_sceneGeometry.cleanUp();
     for(auto& m : m_models)
     {
         m.cleanUp();
     }
+    m_textureRegistry->cleanUp();
 
     if(m_rtUniformBuffer != VK_NULL_HANDLE)
     {
@@ -349,6 +1027,10 @@ void vkContext::cleanUp()
         vkDestroyDescriptorPool(m_device, m_graphics.descriptorPool, nullptr);
     }
 
+    if(m_transfer.commandPool != VK_NULL_HANDLE && m_transfer.commandPool != m_graphics.commandPool)
+    {
+        vkDestroyCommandPool(m_device, m_transfer.commandPool, nullptr);
+    }
     if(m_graphics.commandPool != VK_NULL_HANDLE)
     {
         vkDestroyCommandPool(m_device, m_graphics.commandPool, nullptr);
@@ -360,6 +1042,9 @@ void vkContext::cleanUp()
         vkDestroyFence(m_device, m_graphics.inFlightFences[i], nullptr);
     }
 
+    m_pipelineCache.cleanUp();
+    m_profiler.cleanUp();
+
     if(m_allocator != VK_NULL_HANDLE)
     {
         vmaDestroyAllocator(m_allocator);
@@ -538,7 +1223,6 @@ void vkContext::findQueueFamilyIndices()
 {
     // Search for first QueueFamily that provides supports requested queue operations.
     // Assume all GPUs support graphics and compute queues within same family.
-    // TODO: Possibility to use separate graphics & compute queue
     for(int i = 0; i < m_gpu.queueFamilyProperties.size(); ++i)
     {
         const auto& queueFamilyProp = m_gpu.queueFamilyProperties[i];
@@ -565,6 +1249,24 @@ void vkContext::findQueueFamilyIndices()
             throw std::runtime_error("Graphics queue does not support presenting!");
         }
     }
+
+    // A family with transfer but neither graphics nor compute is usually backed by the copy
+    // engines, uploads submitted there run alongside rendering
+    m_transfer.queueFamily = m_gpu.queueFamily;
+    for(uint32_t i = 0; i < m_gpu.queueFamilyProperties.size(); ++i)
+    {
+        const VkQueueFlags flags = m_gpu.queueFamilyProperties[i].queueFlags;
+        if(m_gpu.queueFamilyProperties[i].queueCount > 0 && flags & VK_QUEUE_TRANSFER_BIT
+           && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+        {
+            m_transfer.queueFamily = static_cast<int>(i);
+            break;
+        }
+    }
+    if(m_transfer.queueFamily != m_gpu.queueFamily)
+    {
+        spdlog::info("Uploading on transfer queue family {}", m_transfer.queueFamily);
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -575,14 +1277,22 @@ void vkContext::createLogicalDevice()
 {
     float queuePriority[] = {1.0f};
 
-    VkDeviceQueueCreateInfo queueInfo = {};
-    queueInfo.sType                   = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueInfo.pNext                   = nullptr;
-    queueInfo.flags                   = 0;
+    VkDeviceQueueCreateInfo queueInfo[2] = {};
+    queueInfo[0].sType                   = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo[0].pNext                   = nullptr;
+    queueInfo[0].flags                   = 0;
+
+    queueInfo[0].queueFamilyIndex = m_gpu.queueFamily;
+    queueInfo[0].queueCount       = 1;
+    queueInfo[0].pQueuePriorities = queuePriority;
 
-    queueInfo.queueFamilyIndex = m_gpu.queueFamily;
-    queueInfo.queueCount       = 1;
-    queueInfo.pQueuePriorities = queuePriority;
+    uint32_t queueInfoCount = 1;
+    if(m_transfer.queueFamily != m_gpu.queueFamily)
+    {
+        queueInfo[1]                  = queueInfo[0];
+        queueInfo[1].queueFamilyIndex = m_transfer.queueFamily;
+        queueInfoCount                = 2;
+    }
 
     // Add requested features here
     VkPhysicalDeviceDescriptorIndexingFeaturesEXT descFeatures = {};
@@ -595,14 +1305,29 @@ void vkContext::createLogicalDevice()
 
     vkGetPhysicalDeviceFeatures2(m_gpu.physicalDevice, &requestedDeviceFeatures);
 
-    const auto extensions = m_debugAndExtensions->getRequiredDeviceExtensions();
+    auto extensions = m_debugAndExtensions->getRequiredDeviceExtensions();
+
+    // Lets the raster preview draw only the clusters that survived culling
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(m_gpu.physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(m_gpu.physicalDevice, nullptr, &extensionCount,
+                                         availableExtensions.data());
+    for(const VkExtensionProperties& extension : availableExtensions)
+    {
+        if(std::string(extension.extensionName) == VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)
+        {
+            extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+            m_gpu.drawIndirectCount = true;
+        }
+    }
 
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType              = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
     createInfo.pNext              = &descFeatures;
     createInfo.flags;
-    createInfo.queueCreateInfoCount    = 1;
-    createInfo.pQueueCreateInfos       = &queueInfo;
+    createInfo.queueCreateInfoCount    = queueInfoCount;
+    createInfo.pQueueCreateInfos       = queueInfo;
     createInfo.enabledLayerCount       = 0;
     createInfo.ppEnabledLayerNames     = nullptr;
     createInfo.enabledExtensionCount   = static_cast<uint32_t>(extensions.size());
@@ -612,6 +1337,7 @@ void vkContext::createLogicalDevice()
     VK_CHECK_RESULT(vkCreateDevice(m_gpu.physicalDevice, &createInfo, nullptr, &m_device));
 
     vkGetDeviceQueue(m_device, m_gpu.queueFamily, 0, &m_queue);
+    vkGetDeviceQueue(m_device, m_transfer.queueFamily, 0, &m_transfer.queue);
 
     VmaAllocatorCreateInfo allocatorInfo = {};
     allocatorInfo.physicalDevice         = m_gpu.physicalDevice;
@@ -752,6 +1478,14 @@ void vkContext::createCommandPools()
     createInfo.queueFamilyIndex = m_gpu.queueFamily;
 
     VK_CHECK_RESULT(vkCreateCommandPool(m_device, &createInfo, nullptr, &m_graphics.commandPool));
+
+    m_transfer.commandPool = m_graphics.commandPool;
+    if(m_transfer.queueFamily != m_gpu.queueFamily)
+    {
+        createInfo.queueFamilyIndex = m_transfer.queueFamily;
+        VK_CHECK_RESULT(
+            vkCreateCommandPool(m_device, &createInfo, nullptr, &m_transfer.commandPool));
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -1010,12 +1744,14 @@ void vkContext::updateGraphicsUniforms()
     ubo.lightE          = glm::vec3(1.0f) * m_settings.lightE;
     ubo.lightOtherE     = m_settings.lightOtherE;
     ubo.lightSourceArea = m_settings.lightSourceArea;
+    ubo.environmentE    = m_settings.environmentE;
     if(m_moveLight)
     {
         m_lightTransform = glm::inverse(ubo.view);
         m_moveLight      = false;
     }
 
+    ubo.sampleOffset       = m_scene.render.firstSample;
     ubo.numIndirectBounces = m_settings.numIndicesBounces;
     ubo.samplerPerPixel    = m_settings.samplesPerPixel;
 
@@ -1025,6 +1761,18 @@ void vkContext::updateGraphicsUniforms()
     ubo.numAOrays   = m_settings.numAOrays;
     ubo.aoRayLength = m_settings.aoRayLength;
 
+    ubo.russianRouletteDepth =
+        m_settings.russianRoulette ? m_settings.russianRouletteDepth : -1;
+
+    // Restart accumulation before handing out the iteration, otherwise the first frame after
+    // a camera move still blends with the old image
+    m_reprojectFrame = m_cameraMoved;
+    if(m_cameraMoved)
+    {
+        m_cameraMoved        = false;
+        m_settings.iteration = 1;
+    }
+
     if(m_settings.RTX_ON)
     {
         if(m_settings.rtRenderingMode == 0 && m_settings.iteration < m_settings.samplesPerPixel)
@@ -1041,11 +1789,12 @@ void vkContext::updateGraphicsUniforms()
 
     ubo.time = m_runTime;
 
-    if(m_cameraMoved)
-    {
-        m_cameraMoved        = false;
-        m_settings.iteration = 1;
-    }
+    // Previous frame camera for reprojection
+    ubo.cameraPos     = glm::inverse(ubo.view)[3];
+    ubo.prevCameraPos = m_prevCameraPos;
+    ubo.prevViewProj  = m_prevViewProj;
+    m_prevCameraPos   = ubo.cameraPos;
+    m_prevViewProj    = ubo.proj * ubo.view;
 
     void* data;
     // Graphics pipeline
@@ -1207,8 +1956,9 @@ void vkContext::createPipeline()
     pipelineInfo.basePipelineHandle           = VK_NULL_HANDLE;
     pipelineInfo.basePipelineIndex            = -1;
 
-    VK_CHECK_RESULT(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr,
-                                              &m_graphics.pipeline));
+    auto timing = m_pipelineCache.measure();
+    VK_CHECK_RESULT(vkCreateGraphicsPipelines(m_device, m_pipelineCache.get(), 1, &pipelineInfo,
+                                              nullptr, &m_graphics.pipeline));
 
     vkDestroyShaderModule(m_device, vertexShader, nullptr);
     vkDestroyShaderModule(m_device, fragmentShader, nullptr);
@@ -1274,11 +2024,15 @@ void vkContext::setupGraphicsDescriptors()
         textureDescriptorCount += static_cast<uint32_t>(m.m_textures.size());
     }
 
+    // Every texture is sampled with the sampler of the registry
+    const std::vector<VkSampler> textureSamplers(textureDescriptorCount,
+                                                 m_textureRegistry->getSampler());
+
     bindings[2].binding            = 2;
     bindings[2].descriptorType     = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     bindings[2].descriptorCount    = textureDescriptorCount;
     bindings[2].stageFlags         = VK_SHADER_STAGE_FRAGMENT_BIT;
-    bindings[2].pImmutableSamplers = nullptr;
+    bindings[2].pImmutableSamplers = textureSamplers.data();
 
     VkDescriptorSetLayoutCreateInfo layoutInfo = {};
     layoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1314,25 +2068,11 @@ void vkContext::setupGraphicsDescriptors()
         bufferInfos[0].offset = 0;
         bufferInfos[0].range  = VK_WHOLE_SIZE;
 
-        bufferInfos[1].buffer = m_models[0].materialBuffer;
+        bufferInfos[1].buffer = m_sceneGeometry.getMaterialBuffer();
         bufferInfos[1].offset = 0;
         bufferInfos[1].range  = VK_WHOLE_SIZE;
 
-        std::vector<VkDescriptorImageInfo> imageInfos;
-        VkDescriptorImageInfo              imageInfo = {};
-
-        for(size_t k = 0; k < m_models.size(); ++k)
-        {
-            const auto& model = m_models[k];
-            for(size_t j = 0; j < model.m_textures.size(); ++j)
-            {
-                const auto& texture   = model.m_textures[j];
-                imageInfo.sampler     = texture.sampler;
-                imageInfo.imageView   = texture.view;
-                imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                imageInfos.push_back(imageInfo);
-            }
-        }
+        const std::vector<VkDescriptorImageInfo> imageInfos = textureImageInfos();
 
         std::array<VkWriteDescriptorSet, 3> writeDescriptors = {};
 
@@ -1411,6 +2151,9 @@ void vkContext::recordCommandBuffers()
 
             vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
+            // Frustum culling reads the camera of this swapchain image
+            m_clusterCulling.recordCulling(commandBuffer, i);
+
             vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
             vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphics.pipeline);
@@ -1419,15 +2162,14 @@ void vkContext::recordCommandBuffers()
                                     m_graphics.pipelineLayout, 0, 1, &m_graphics.descriptorSets[i],
                                     0, nullptr);
 
-            for(const auto& m : m_models)
-            {
-
-                vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m.vertexBuffer, offsets);
-
-                vkCmdBindIndexBuffer(commandBuffer, m.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+            // Every model shares the buffers, indices are already rebased onto the one
+            // vertex buffer
+            const VkBuffer vertexBuffer = m_sceneGeometry.getVertexBuffer();
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, offsets);
+            vkCmdBindIndexBuffer(commandBuffer, m_sceneGeometry.getIndexBuffer(), 0,
+                                 VK_INDEX_TYPE_UINT32);
 
-                vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(m.numIndices), 1, 0, 0, 0);
-            }
+            m_clusterCulling.recordDraws(commandBuffer);
 
             vkCmdEndRenderPass(commandBuffer);
 
@@ -1447,50 +2189,24 @@ void vkContext::createVertexAndIndexBuffers(const std::vector<VkTools::VertexPNT
                                             VkBuffer*                               indexBuffer,
                                             VmaAllocation*                          indexMemory)
 {
-    VkBuffer      stagingBuffer;
-    VmaAllocation stagingBufferMemory;
-
     // Vertices
     VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-    VkTools::createBuffer(
-        m_allocator, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer,
-        &stagingBufferMemory);
-
-    void* data;
-    vmaMapMemory(m_allocator, stagingBufferMemory, &data);
-    memcpy(data, vertices.data(), bufferSize);
-    vmaUnmapMemory(m_allocator, stagingBufferMemory);
-
     VkTools::createBuffer(m_allocator, bufferSize,
                           VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                           VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                           vertexBuffer, vertexMemory);
-
-    copyBuffer(stagingBuffer, *vertexBuffer, bufferSize);
-
-    vmaDestroyBuffer(m_allocator, stagingBuffer, stagingBufferMemory);
+    m_staging->uploadBuffer(*vertexBuffer, vertices.data(), bufferSize);
 
 
     // Indices
     bufferSize = sizeof(indices[0]) * indices.size();
-    VkTools::createBuffer(
-        m_allocator, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer,
-        &stagingBufferMemory);
-
-    vmaMapMemory(m_allocator, stagingBufferMemory, &data);
-    memcpy(data, indices.data(), bufferSize);
-    vmaUnmapMemory(m_allocator, stagingBufferMemory);
-
     VkTools::createBuffer(m_allocator, bufferSize,
                           VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
                           VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                           indexBuffer, indexMemory);
+    m_staging->uploadBuffer(*indexBuffer, indices.data(), bufferSize);
 
-    copyBuffer(stagingBuffer, *indexBuffer, bufferSize);
-
-    vmaDestroyBuffer(m_allocator, stagingBuffer, stagingBufferMemory);
+    m_staging->submit();
 }
 
 // ----------------------------------------------------------------------------
@@ -1538,9 +2254,6 @@ void check_vk_result(VkResult res)
 
 void vkContext::initDearImGui()
 {
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-
     ImGui_ImplGlfwVulkan_Init_Data initInfo = {};
     initInfo.allocator                      = VK_NULL_HANDLE;
     initInfo.gpu                            = m_gpu.physicalDevice;
@@ -1568,27 +2281,13 @@ inline void vkContext::createBufferWithStaging(std::vector<T>        src,
                                                VkBuffer*             buffer,
                                                VmaAllocation*        bufferMemory)
 {
-    VkBuffer      stagingBuffer;
-    VmaAllocation stagingBufferMemory;
-
     VkDeviceSize bufferSize = sizeof(src[0]) * src.size();
-    createBuffer(m_allocator, bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                 VMA_MEMORY_USAGE_CPU_ONLY,
-                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                 stagingBuffer, stagingBufferMemory);
+    VkTools::createBuffer(m_allocator, bufferSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer,
+                          bufferMemory);
 
-    void* data;
-    vmaMapMemory(m_allocator, stagingBufferMemory, &data);
-    memcpy(data, src.data(), bufferSize);
-    vmaUnmapMemory(m_allocator, stagingBufferMemory);
-
-    createBuffer(m_allocator, bufferSize, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                 VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, *buffer,
-                 *bufferMemory);
-
-    copyBuffer(stagingBuffer, *buffer, bufferSize);
-
-    vmaDestroyBuffer(m_allocator, stagingBuffer, stagingBufferMemory);
+    m_staging->uploadBuffer(*buffer, src.data(), bufferSize);
+    m_staging->submit();
 }
 
 // ----------------------------------------------------------------------------
@@ -1670,11 +2369,132 @@ void vkContext::endRenderPass(VkCommandBuffer commandBuffer)
 //
 //
 
-void vkContext::LoadModelFromFile(const std::string& objPath)
+// ----------------------------------------------------------------------------
+//  Keeps the window responsive until the loader thread has parsed the model, then packs it into
+//  the scene geometry. Textures are placeholders until streamAssets swaps them in.
+//
+
+void vkContext::waitForModel()
 {
-    VkTools::Model model(this, objPath);
+    const std::string title = m_gpu.properties.deviceName;
+    while(!m_assetStreamer.isGeometryReady())
+    {
+        const VkTools::AssetStreamer::Progress progress = m_assetStreamer.getProgress();
+        m_window->setWindowTitle(title + " - " + progress.stage + " " + m_scene.scene.model);
+        m_window->pollEvents();
+        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+    }
+    m_window->setWindowTitle(title);
 
+    VkTools::Model model = m_assetStreamer.takeModel();
+    model.vkctx          = this;
+    model.createPlaceholderTextures();
     m_models.push_back(model);
+
+    // Rebuilt as a whole, material texture ids depend on the textures of the models before.
+    // Staged on the transfer queue like the textures that follow.
+    m_sceneGeometry.cleanUp();
+    m_sceneGeometry.build(this, m_models, m_assetStreamer.getStaging(), getTransferQueueFamily());
+}
+
+// ----------------------------------------------------------------------------
+//  Descriptor sets are rewritten between frames, so the device has to be idle. That happens
+//  once per uploaded batch while textures stream in.
+//
+
+void vkContext::streamAssets()
+{
+    VkTools::TextureCache* cache = m_textureCache.m_settings.enabled ? &m_textureCache : nullptr;
+    if(m_assetStreamer.isDone() || !m_assetStreamer.update(this, &m_models[0], cache))
+    {
+        return;
+    }
+
+    vkDeviceWaitIdle(m_device);
+    rewriteTextureDescriptors();
+
+    // Samples so far were shaded with placeholders
+    m_cameraMoved = true;
+}
+
+// ----------------------------------------------------------------------------
+//  Every updateInterval frames the feedback gathered since goes to the texture cache, which
+//  waits for the device itself when it swaps images
+//
+
+void vkContext::streamTextureMips()
+{
+    if(!m_textureCache.isUpdateDue()
+       || !m_textureCache.update(this, &m_models[0], m_vkRTX->takeTextureFeedback()))
+    {
+        return;
+    }
+
+    rewriteTextureDescriptors();
+    m_cameraMoved = true;
+}
+
+void vkContext::rewriteTextureDescriptors()
+{
+    const std::vector<VkDescriptorImageInfo> imageInfos = textureImageInfos();
+    for(VkDescriptorSet set : m_graphics.descriptorSets)
+    {
+        VkWriteDescriptorSet write = {};
+        write.sType                = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.pNext                = nullptr;
+        write.dstSet               = set;
+        write.dstBinding           = 2;
+        write.dstArrayElement      = 0;
+        write.descriptorCount      = static_cast<uint32_t>(imageInfos.size());
+        write.descriptorType       = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        write.pImageInfo           = imageInfos.data();
+        vkUpdateDescriptorSets(m_device, 1, &write, 0, nullptr);
+    }
+    m_vkRTX->updateTextureDescriptors();
+    recordCommandBuffers();
+}
+
+std::vector<VkDescriptorImageInfo> vkContext::textureImageInfos() const
+{
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    for(const auto& model : m_models)
+    {
+        for(const auto& texture : model.m_textures)
+        {
+            VkDescriptorImageInfo imageInfo = {};
+            imageInfo.sampler               = texture.sampler;
+            imageInfo.imageView             = texture.view;
+            imageInfo.imageLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imageInfos.push_back(imageInfo);
+        }
+    }
+    return imageInfos;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void vkContext::finishAssetStreaming()
+{
+    while(!m_assetStreamer.isDone())
+    {
+        streamAssets();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void vkContext::LoadEnvironmentMap(const std::string& hdrPath)
+{
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    m_environmentMap = std::make_shared<rtutils::EnvironmentMap>();
+    m_environmentMap->load(hdrPath);
+
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    spdlog::info("Environment map {}: {}x{}, loaded with sampling tables in {:.1f} ms", hdrPath,
+                 m_environmentMap->width(), m_environmentMap->height(), elapsed.count());
 }
 
 void vkContext::handleKeyPresses(int key, int action)
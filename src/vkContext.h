@@ -29,15 +29,30 @@
 #define VULKAN_PATCH_VERSION 101
 
 #include "AreaLight.h"
+#include "Benchmark.h"
+#include "CpuPathTracer.h"
 #include "Model.h"
+#include "SceneFile.h"
+#include "vkAssetStreamer.h"
+#include "vkCheckpoint.h"
+#include "vkClusterCulling.h"
 #include "vkDebugLayers.h"
+#include "vkPipelineCache.h"
+#include "vkProfiler.h"
 #include "vkRTX_setup.h"
+#include "vkSceneGeometry.h"
+#include "vkStagingArena.h"
+#include "vkTextureCache.h"
+#include "vkTextureRegistry.h"
 #include "vkTools.h"
 #include "vkWindow.h"
 
 class vkContext
 {
     public:
+    // Scene, camera and settings of the next run, the default scene otherwise
+    void setScene(const rtutils::SceneDescription& scene) { m_scene = scene; }
+
     void run()
     {
         initVulkan();
@@ -45,11 +60,41 @@ class vkContext
         cleanUp();
     }
 
+    // Renders scene.spp samples from the fixed camera of scene instead of running the UI, the
+    // context is torn down again before returning
+    rtutils::BenchmarkResult runBenchmark(const rtutils::BenchmarkScene& scene);
+
     VkDevice         getDevice() const { return m_device; }
     VkPhysicalDevice getPhysicalDevice() const { return m_gpu.physicalDevice; }
     VmaAllocator     getAllocator() const { return m_allocator; }
     VkCommandPool    getCommandPool() const { return m_graphics.commandPool; }
     VkQueue          getQueue() const { return m_queue; }
+    uint32_t         getQueueFamily() const { return uint32_t(m_gpu.queueFamily); }
+
+    const VkPhysicalDeviceProperties& getDeviceProperties() const { return m_gpu.properties; }
+    const VkPhysicalDeviceFeatures&   getDeviceFeatures() const { return m_gpu.features; }
+
+    // VK_KHR_draw_indirect_count is optional and enabled when the device has it
+    bool hasDrawIndirectCount() const { return m_gpu.drawIndirectCount; }
+
+    // Staged uploads on the graphics queue, see VkTools::StagingArena
+    VkTools::StagingArena* getStagingArena() const { return m_staging.get(); }
+
+    // Texture images of all models and their one sampler, see VkTools::TextureRegistry
+    VkTools::TextureRegistry* getTextureRegistry() const { return m_textureRegistry.get(); }
+
+    // Vertices, indices and materials of m_models in shared buffers
+    const VkTools::SceneGeometry& getSceneGeometry() const { return m_sceneGeometry; }
+
+    // Same as the graphics queue and pool when the GPU has no transfer-only queue family
+    VkCommandPool getTransferCommandPool() const { return m_transfer.commandPool; }
+    VkQueue       getTransferQueue() const { return m_transfer.queue; }
+    uint32_t      getTransferQueueFamily() const { return uint32_t(m_transfer.queueFamily); }
+
+    VkTools::PipelineCache& getPipelineCache() { return m_pipelineCache; }
+    VkTools::Profiler&      getProfiler() { return m_profiler; }
+
+    const rtutils::EnvironmentMap* getEnvironmentMap() const { return m_environmentMap.get(); }
 
     struct UniformBufferObject
     {
@@ -63,8 +108,8 @@ class vkContext
         glm::vec2 lightSize = glm::vec2(0.25f, 0.25f);
         glm::vec2 pad0;
 
-        glm::vec3 lightE = glm::vec3(1.0f);
-        float     pad1;
+        glm::vec3 lightE       = glm::vec3(1.0f);
+        uint32_t  sampleOffset = 0;  // Added to the Sobol index, disjoint per distributed worker
 
         int   numIndirectBounces = 4;
         int   samplerPerPixel    = 1;
@@ -78,7 +123,13 @@ class vkContext
         float    aoRayLength = 1.0f;
         uint32_t iteration   = 0;
 
-        float time = 0.0f;
+        float time                 = 0.0f;
+        int   russianRouletteDepth = -1;  // Negative disables Russian roulette
+        float environmentE         = 1.0f;
+
+        glm::mat4 prevViewProj;
+        glm::vec4 cameraPos;
+        glm::vec4 prevCameraPos;
     };
 
     // This is dirty, TODO something better
@@ -86,16 +137,35 @@ class vkContext
     bool      m_moveLight      = true;
     glm::mat4 m_lightTransform = glm::mat4(1.0f);
     bool      m_cameraMoved    = true;
+    bool      m_reprojectFrame = false;
 
     void handleKeyPresses(int key, int action);
     void handleMousePresses(int key, int action);
 
     private:
     void initVulkan();
+    void applySceneDescription();
+    bool isAccumulationDone() const;
+    bool hasOutput() const
+    {
+        return !m_scene.output.image.empty() || !m_scene.output.accumulation.empty();
+    }
+    void writeOutputImage();
+    bool loadCheckpoint(VkTools::Checkpoint::State* state, std::vector<char>* texels) const;
+    void resumeFromCheckpoint(const VkTools::Checkpoint::State& state,
+                              const std::vector<char>&          texels);
+    VkTools::Checkpoint::State checkpointState() const;
 
     void mainLoop();
     void renderFrame();
     void renderImGui(VkCommandBuffer commandBuffer);
+    void runSamplingBenchmark();
+    void runRouletteBenchmark();
+    void runEnvironmentBenchmark();
+    void runRaySortingBenchmark();
+    void runRayStatisticsCrossCheck();
+    void drawRayStatistics();
+    rtutils::CpuScene createCpuScene() const;
     void cleanUp();
     void cleanUpSwapchain();
     void recreateSwapchain();
@@ -139,7 +209,13 @@ class vkContext
     void beginRenderPass(VkCommandBuffer commandBuffer, VkRenderPass renderpass);
     void endRenderPass(VkCommandBuffer commandBuffer);
 
-    void LoadModelFromFile(const std::string& objPath);
+    void waitForModel();
+    void streamAssets();
+    void streamTextureMips();
+    void rewriteTextureDescriptors();
+    void finishAssetStreaming();
+    std::vector<VkDescriptorImageInfo> textureImageInfos() const;
+    void LoadEnvironmentMap(const std::string& hdrPath);
 
 
     std::unique_ptr<vkWindow>             m_window;
@@ -150,13 +226,37 @@ class vkContext
     VkInstance                            m_instance          = VK_NULL_HANDLE;
     VkDevice                              m_device            = VK_NULL_HANDLE;
     VmaAllocator                          m_allocator         = VK_NULL_HANDLE;
+    VkTools::PipelineCache                m_pipelineCache;
+    VkTools::Profiler                     m_profiler;
     VkQueue                               m_queue             = VK_NULL_HANDLE;
     float                                 m_deltaTime         = 0.00001f;
     float                                 m_runTime           = 0.00000f;
 
+    // Camera of the previously rendered frame
+    glm::mat4 m_prevViewProj  = glm::mat4(1.0f);
+    glm::vec4 m_prevCameraPos = glm::vec4(0.0f);
+
     std::vector<VkTools::Model> m_models;
+    VkTools::SceneGeometry      m_sceneGeometry;
+    VkTools::ClusterCulling     m_clusterCulling;
+    VkTools::AssetStreamer      m_assetStreamer;
+    VkTools::TextureCache       m_textureCache;
     AreaLight                   m_light;
 
+    // Lights rays that leave the scene, none when null
+    std::shared_ptr<rtutils::EnvironmentMap> m_environmentMap;
+
+    // Created with the command pools, shared by every upload but the streamed textures
+    std::unique_ptr<VkTools::StagingArena> m_staging;
+
+    // Outlives the models, which only refer to its images
+    std::unique_ptr<VkTools::TextureRegistry> m_textureRegistry;
+
+    rtutils::SceneDescription m_scene;
+    double                    m_sceneLoadMs   = 0.0;  // Model and environment map
+    bool                      m_outputWritten = false;
+    VkTools::Checkpoint       m_checkpoint;
+
 
     struct  // Settings
     {
@@ -180,14 +280,26 @@ class vkContext
         float lightSourceArea = 0.02f;
         float lightE          = 100.0f;
         float lightOtherE     = 1.0f;
+        float environmentE    = 1.0f;
 
         // 0: Cook-Torrance BSDF, 1: AO
         int rtRenderingMode = 0;
 
-        bool hideUI = false;
+        // Russian roulette on the path throughput after this many bounces
+        bool russianRoulette      = true;
+        int  russianRouletteDepth = 2;
+
+        bool hideUI       = false;
+        bool showProfiler = false;
 
         uint32_t iteration = 1;
 
+        // VkRTX owns the denoiser, reprojection, shader variants and ray counters, set pointers
+        // over there
+        rtutils::DenoiserSettings*     denoiser       = nullptr;
+        rtutils::ReprojectionSettings* reprojection   = nullptr;
+        VkRTX::ShaderVariantSettings*  shaderVariants = nullptr;
+        VkRTX::RayStatisticsSettings*  rayStatistics  = nullptr;
 
     } m_settings;
 
@@ -198,7 +310,8 @@ class vkContext
         VkPhysicalDeviceProperties           properties;
         VkPhysicalDeviceFeatures             features;
         std::vector<VkQueueFamilyProperties> queueFamilyProperties;
-        int                                  queueFamily = -1;
+        int                                  queueFamily       = -1;
+        bool                                 drawIndirectCount = false;
     } m_gpu;
 
     struct  // Surface
@@ -253,6 +366,13 @@ class vkContext
         } depth;
     } m_graphics;
 
+    struct  // Transfer
+    {
+        int           queueFamily = -1;
+        VkQueue       queue       = VK_NULL_HANDLE;
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+    } m_transfer;
+
     // ---------------------------
     // RTX related items
 
@@ -0,0 +1,278 @@
+#include "vkDenoiser.h"
+#include "vkContext.h"
+
+namespace {
+
+void computeToComputeBarrier(VkCommandBuffer cmdBuf)
+{
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext           = nullptr;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+}
+
+VkDescriptorImageInfo storageImageInfo(VkImageView view)
+{
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.sampler               = VK_NULL_HANDLE;
+    imageInfo.imageView             = view;
+    imageInfo.imageLayout           = VK_IMAGE_LAYOUT_GENERAL;
+    return imageInfo;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void VkDenoiser::init(VkImageView accumulationView,
+                      VkImageView normalDepthView,
+                      VkImageView prevNormalDepthView,
+                      VkImageView albedoView,
+                      VkImageView emissionView,
+                      VkBuffer    uniformBuffer)
+{
+    createImages();
+    createTemporalPass(accumulationView, normalDepthView, prevNormalDepthView, albedoView,
+                       emissionView, uniformBuffer);
+    createAtrousPass(normalDepthView, albedoView, emissionView);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void VkDenoiser::createImages()
+{
+    const VkImageUsageFlags usage =
+        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    VkDevice      device    = m_vkctx->getDevice();
+    VmaAllocator  allocator = m_vkctx->getAllocator();
+    VkQueue       queue     = m_vkctx->getQueue();
+    VkCommandPool pool      = m_vkctx->getCommandPool();
+
+    for(auto& image : m_images.pingPong)
+    {
+        VkTools::createStorageImage(device, allocator, queue, pool, m_extent,
+                                    VK_FORMAT_R16G16B16A16_SFLOAT, usage, &image);
+    }
+    VkTools::createStorageImage(device, allocator, queue, pool, m_extent,
+                                VK_FORMAT_R16G16B16A16_SFLOAT, usage, &m_images.historyColor);
+    VkTools::createStorageImage(device, allocator, queue, pool, m_extent,
+                                VK_FORMAT_R32G32B32A32_SFLOAT, usage, &m_images.moments);
+    VkTools::createStorageImage(device, allocator, queue, pool, m_extent,
+                                VK_FORMAT_R32G32B32A32_SFLOAT, usage, &m_images.historyMoments);
+    VkTools::createStorageImage(device, allocator, queue, pool, m_extent,
+                                VK_FORMAT_R16G16B16A16_SFLOAT, usage, &m_images.output);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void VkDenoiser::createTemporalPass(VkImageView accumulationView,
+                                    VkImageView normalDepthView,
+                                    VkImageView prevNormalDepthView,
+                                    VkImageView albedoView,
+                                    VkImageView emissionView,
+                                    VkBuffer    uniformBuffer)
+{
+    VkDevice device = m_vkctx->getDevice();
+    auto&    dsg    = m_temporal.dsg;
+
+    for(uint32_t binding = 0; binding < 9; ++binding)
+    {
+        dsg.AddBinding(binding, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+    dsg.AddBinding(9, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    m_temporal.descriptorPool      = dsg.GeneratePool(device);
+    m_temporal.descriptorSetLayout = dsg.GenerateLayout(device);
+    m_temporal.descriptorSet =
+        dsg.GenerateSet(device, m_temporal.descriptorPool, m_temporal.descriptorSetLayout);
+
+    dsg.Bind(m_temporal.descriptorSet, 0, {storageImageInfo(accumulationView)});
+    dsg.Bind(m_temporal.descriptorSet, 1, {storageImageInfo(normalDepthView)});
+    dsg.Bind(m_temporal.descriptorSet, 2, {storageImageInfo(albedoView)});
+    dsg.Bind(m_temporal.descriptorSet, 3, {storageImageInfo(prevNormalDepthView)});
+    dsg.Bind(m_temporal.descriptorSet, 4, {storageImageInfo(m_images.historyColor.view)});
+    dsg.Bind(m_temporal.descriptorSet, 5, {storageImageInfo(m_images.historyMoments.view)});
+    dsg.Bind(m_temporal.descriptorSet, 6, {storageImageInfo(m_images.pingPong[0].view)});
+    dsg.Bind(m_temporal.descriptorSet, 7, {storageImageInfo(m_images.moments.view)});
+    dsg.Bind(m_temporal.descriptorSet, 8, {storageImageInfo(emissionView)});
+
+    VkDescriptorBufferInfo uboInfo = {};
+    uboInfo.buffer                 = uniformBuffer;
+    uboInfo.offset                 = 0;
+    uboInfo.range                  = sizeof(vkContext::UniformBufferObject);
+
+    dsg.Bind(m_temporal.descriptorSet, 9, {uboInfo});
+    dsg.UpdateSetContents(device, m_temporal.descriptorSet);
+
+    auto& pipelineCache = m_vkctx->getPipelineCache();
+    auto  timing        = pipelineCache.measure();
+    VkTools::createComputePipeline(device, "../../shaders/spirv/denoiseTemporal.comp.spv",
+                                   m_temporal.descriptorSetLayout, sizeof(TemporalPushConstants),
+                                   &m_temporal.pipeline, &m_temporal.pipelineLayout,
+                                   pipelineCache.get());
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void VkDenoiser::createAtrousPass(VkImageView normalDepthView,
+                                  VkImageView albedoView,
+                                  VkImageView emissionView)
+{
+    VkDevice device = m_vkctx->getDevice();
+    auto&    dsg    = m_atrous.dsg;
+
+    for(uint32_t binding = 0; binding < 7; ++binding)
+    {
+        dsg.AddBinding(binding, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+
+    m_atrous.descriptorPool      = dsg.GeneratePool(device);
+    m_atrous.descriptorSetLayout = dsg.GenerateLayout(device);
+    m_atrous.descriptorSet =
+        dsg.GenerateSet(device, m_atrous.descriptorPool, m_atrous.descriptorSetLayout);
+
+    dsg.Bind(m_atrous.descriptorSet, 0, {storageImageInfo(m_images.pingPong[0].view)});
+    dsg.Bind(m_atrous.descriptorSet, 1, {storageImageInfo(m_images.pingPong[1].view)});
+    dsg.Bind(m_atrous.descriptorSet, 2, {storageImageInfo(normalDepthView)});
+    dsg.Bind(m_atrous.descriptorSet, 3, {storageImageInfo(albedoView)});
+    dsg.Bind(m_atrous.descriptorSet, 4, {storageImageInfo(m_images.historyColor.view)});
+    dsg.Bind(m_atrous.descriptorSet, 5, {storageImageInfo(m_images.output.view)});
+    dsg.Bind(m_atrous.descriptorSet, 6, {storageImageInfo(emissionView)});
+    dsg.UpdateSetContents(device, m_atrous.descriptorSet);
+
+    auto& pipelineCache = m_vkctx->getPipelineCache();
+    auto  timing        = pipelineCache.measure();
+    VkTools::createComputePipeline(device, "../../shaders/spirv/denoiseAtrous.comp.spv",
+                                   m_atrous.descriptorSetLayout, sizeof(AtrousPushConstants),
+                                   &m_atrous.pipeline, &m_atrous.pipelineLayout,
+                                   pipelineCache.get());
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void VkDenoiser::recordCommandBuffer(VkCommandBuffer cmdBuf)
+{
+    const uint32_t groupsX = (m_extent.width + 15) / 16;
+    const uint32_t groupsY = (m_extent.height + 15) / 16;
+
+    // Temporal accumulation
+    TemporalPushConstants temporalConstants = {};
+    temporalConstants.alpha                 = m_settings.alpha;
+    temporalConstants.momentsAlpha          = m_settings.momentsAlpha;
+    temporalConstants.hasHistory            = m_hasHistory ? 1 : 0;
+
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_temporal.pipeline);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_temporal.pipelineLayout, 0,
+                            1, &m_temporal.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cmdBuf, m_temporal.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(temporalConstants), &temporalConstants);
+    vkCmdDispatch(cmdBuf, groupsX, groupsY, 1);
+
+    computeToComputeBarrier(cmdBuf);
+
+    // A-trous wavelet, ping-ponging between the two illumination images
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_atrous.pipeline);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, m_atrous.pipelineLayout, 0, 1,
+                            &m_atrous.descriptorSet, 0, nullptr);
+
+    const int iterations = std::max(1, m_settings.atrousIterations);
+    for(int i = 0; i < iterations; ++i)
+    {
+        AtrousPushConstants atrousConstants = {};
+        atrousConstants.stepSize            = 1 << i;
+        atrousConstants.phiColor            = m_settings.phiColor;
+        atrousConstants.phiNormal           = m_settings.phiNormal;
+        atrousConstants.phiDepth            = m_settings.phiDepth;
+        atrousConstants.readIndex           = i % 2;
+        atrousConstants.writeHistory        = i == 0 ? 1 : 0;
+        atrousConstants.final               = i == iterations - 1 ? 1 : 0;
+
+        vkCmdPushConstants(cmdBuf, m_atrous.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(atrousConstants), &atrousConstants);
+        vkCmdDispatch(cmdBuf, groupsX, groupsY, 1);
+
+        computeToComputeBarrier(cmdBuf);
+    }
+
+    // Moments of this frame become the history of the next one
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext           = nullptr;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkImageCopy region    = {};
+    region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.srcOffset      = {0, 0, 0};
+    region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.dstOffset      = {0, 0, 0};
+    region.extent         = {m_extent.width, m_extent.height, 1};
+
+    vkCmdCopyImage(cmdBuf, m_images.moments.image, VK_IMAGE_LAYOUT_GENERAL,
+                   m_images.historyMoments.image, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+
+    m_hasHistory = true;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void VkDenoiser::cleanUp()
+{
+    VkDevice     device    = m_vkctx->getDevice();
+    VmaAllocator allocator = m_vkctx->getAllocator();
+
+    for(Pass* pass : {&m_temporal, &m_atrous})
+    {
+        if(pass->pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(device, pass->pipeline, nullptr);
+        }
+        if(pass->pipelineLayout != VK_NULL_HANDLE)
+        {
+            vkDestroyPipelineLayout(device, pass->pipelineLayout, nullptr);
+        }
+        if(pass->descriptorSetLayout != VK_NULL_HANDLE)
+        {
+            vkDestroyDescriptorSetLayout(device, pass->descriptorSetLayout, nullptr);
+        }
+        if(pass->descriptorPool != VK_NULL_HANDLE)
+        {
+            vkDestroyDescriptorPool(device, pass->descriptorPool, nullptr);
+        }
+    }
+
+    VkTools::destroyStorageImage(device, allocator, &m_images.pingPong[0]);
+    VkTools::destroyStorageImage(device, allocator, &m_images.pingPong[1]);
+    VkTools::destroyStorageImage(device, allocator, &m_images.historyColor);
+    VkTools::destroyStorageImage(device, allocator, &m_images.moments);
+    VkTools::destroyStorageImage(device, allocator, &m_images.historyMoments);
+    VkTools::destroyStorageImage(device, allocator, &m_images.output);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+#include <NVIDIA_RTX/vkRT_DescriptorSets.h>
+
+#include "Denoiser.h"
+#include "vkTools.h"
+
+class vkContext;
+
+// ----------------------------------------------------------------------------
+//  GPU side of the SVGF style denoiser, see rtutils::Denoiser for the CPU reference.
+//  Reads the accumulated path tracer output and the first hit G-buffer, writes linear
+//  radiance into getOutputView() for pathRTpostprocess.comp.
+//
+
+class VkDenoiser
+{
+    public:
+    VkDenoiser(vkContext* ctx, VkExtent2D extent)
+        : m_vkctx(ctx)
+        , m_extent(extent)
+    {
+    }
+
+    void init(VkImageView accumulationView,
+              VkImageView normalDepthView,
+              VkImageView prevNormalDepthView,
+              VkImageView albedoView,
+              VkImageView emissionView,
+              VkBuffer    uniformBuffer);
+
+    // Expects the path tracer writes to be visible to compute shaders
+    void recordCommandBuffer(VkCommandBuffer cmdBuf);
+
+    // Drop the temporal history, e.g. after the scene changes
+    void resetHistory() { m_hasHistory = false; }
+
+    VkImageView getOutputView() const { return m_images.output.view; }
+
+    void cleanUp();
+
+    rtutils::DenoiserSettings m_settings;
+
+    private:
+    void createImages();
+    void createTemporalPass(VkImageView accumulationView,
+                            VkImageView normalDepthView,
+                            VkImageView prevNormalDepthView,
+                            VkImageView albedoView,
+                            VkImageView emissionView,
+                            VkBuffer    uniformBuffer);
+    void createAtrousPass(VkImageView normalDepthView,
+                          VkImageView albedoView,
+                          VkImageView emissionView);
+
+    vkContext* m_vkctx = nullptr;
+    VkExtent2D m_extent;
+    bool       m_hasHistory = false;
+
+    struct
+    {
+        VkTools::StorageImage pingPong[2];     // rgb: illumination, w: variance
+        VkTools::StorageImage historyColor;    // Filtered illumination of the previous frame
+        VkTools::StorageImage moments;         // x: luminance, y: luminance^2, z: history length
+        VkTools::StorageImage historyMoments;  // Moments of the previous frame
+        VkTools::StorageImage output;          // Remodulated radiance
+    } m_images;
+
+    struct Pass
+    {
+        DescriptorSetGenerator dsg;
+        VkDescriptorPool       descriptorPool      = VK_NULL_HANDLE;
+        VkDescriptorSetLayout  descriptorSetLayout = VK_NULL_HANDLE;
+        VkDescriptorSet        descriptorSet       = VK_NULL_HANDLE;
+        VkPipelineLayout       pipelineLayout      = VK_NULL_HANDLE;
+        VkPipeline             pipeline            = VK_NULL_HANDLE;
+    };
+
+    Pass m_temporal;
+    Pass m_atrous;
+
+    // Push constant blocks, keep in sync with the shaders
+    struct TemporalPushConstants
+    {
+        float alpha;
+        float momentsAlpha;
+        int   hasHistory;
+    };
+
+    struct AtrousPushConstants
+    {
+        int   stepSize;
+        float phiColor;
+        float phiNormal;
+        float phiDepth;
+        int   readIndex;
+        int   writeHistory;
+        int   final;
+    };
+};
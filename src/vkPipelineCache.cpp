@@ -0,0 +1,117 @@
+#include "vkPipelineCache.h"
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "vkTools.h"
+
+namespace VkTools {
+namespace {
+
+const uint32_t kMagic   = 0x50434348;  // "PCCH"
+const uint32_t kVersion = 1;
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+PipelineCache::Header PipelineCache::makeHeader() const
+{
+    Header header        = {};
+    header.magic         = kMagic;
+    header.version       = kVersion;
+    header.vendorID      = m_properties.vendorID;
+    header.deviceID      = m_properties.deviceID;
+    header.driverVersion = m_properties.driverVersion;
+    header.shaderHash    = m_shaderHash;
+    std::memcpy(header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE);
+    return header;
+}
+
+void PipelineCache::init(VkDevice                          device,
+                         const VkPhysicalDeviceProperties& properties,
+                         uint64_t                          shaderHash,
+                         const std::string&                path)
+{
+    m_device     = device;
+    m_properties = properties;
+    m_shaderHash = shaderHash;
+    m_path       = path;
+    m_warm       = false;
+
+    // Everything but the size has to match, otherwise the old data is dropped
+    std::vector<char> data;
+    std::ifstream     file(path, std::ios::binary);
+    Header            header = {};
+    if(file.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    {
+        Header expected   = makeHeader();
+        expected.dataSize = header.dataSize;
+        if(std::memcmp(&header, &expected, sizeof(header)) == 0)
+        {
+            data.resize(header.dataSize);
+            m_warm = bool(file.read(data.data(), data.size()));
+        }
+        if(!m_warm)
+        {
+            data.clear();
+            spdlog::info("Pipeline cache {} is stale, starting cold", path);
+        }
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.pNext                     = nullptr;
+    createInfo.flags                     = 0;
+    createInfo.initialDataSize           = data.size();
+    createInfo.pInitialData              = data.empty() ? nullptr : data.data();
+
+    VK_CHECK_RESULT(vkCreatePipelineCache(m_device, &createInfo, nullptr, &m_cache));
+}
+
+// ----------------------------------------------------------------------------
+//  Written to a temporary file first so an interrupted run cannot leave a truncated cache
+//
+
+void PipelineCache::cleanUp()
+{
+    if(m_cache == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    size_t size = 0;
+    VK_CHECK_RESULT(vkGetPipelineCacheData(m_device, m_cache, &size, nullptr));
+    std::vector<char> data(size);
+    VK_CHECK_RESULT(vkGetPipelineCacheData(m_device, m_cache, &size, data.data()));
+
+    Header header   = makeHeader();
+    header.dataSize = size;
+
+    const std::string temporary = m_path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(data.data(), size);
+        if(!file)
+        {
+            spdlog::warn("Could not write pipeline cache {}", temporary);
+        }
+    }
+    std::remove(m_path.c_str());
+    if(std::rename(temporary.c_str(), m_path.c_str()) != 0)
+    {
+        spdlog::warn("Could not replace pipeline cache {}", m_path);
+    }
+
+    vkDestroyPipelineCache(m_device, m_cache, nullptr);
+    m_cache = VK_NULL_HANDLE;
+}
+
+}  // namespace VkTools
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+
+#include <vulkan/vulkan.h>
+
+namespace VkTools {
+
+// ----------------------------------------------------------------------------
+//  VkPipelineCache persisted to disk between runs. The file is only reused when it was written
+//  by the same driver and device for the same set of shaders, see Header.
+//
+
+class PipelineCache
+{
+    public:
+    using Clock = std::chrono::high_resolution_clock;
+
+    // Adds its lifetime to the pipeline creation time, wrap vkCreate*Pipelines calls in one
+    struct Timing
+    {
+        PipelineCache*    cache;
+        Clock::time_point start;
+
+        ~Timing() { cache->m_creationTime += Clock::now() - start; }
+    };
+
+    // Loads path when it matches the device and shaderHash, starts empty otherwise
+    void init(VkDevice                          device,
+              const VkPhysicalDeviceProperties& properties,
+              uint64_t                          shaderHash,
+              const std::string&                path);
+
+    // Writes the cache back to path and destroys it
+    void cleanUp();
+
+    VkPipelineCache get() const { return m_cache; }
+
+    // True when the pipelines were created from a cache written by an earlier run
+    bool isWarm() const { return m_warm; }
+
+    Timing measure() { return Timing{this, Clock::now()}; }
+    double creationMilliseconds() const { return m_creationTime.count(); }
+
+    private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vendorID;
+        uint32_t deviceID;
+        uint32_t driverVersion;
+        uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+        uint32_t pad;
+        uint64_t shaderHash;
+        uint64_t dataSize;
+    };
+
+    Header makeHeader() const;
+
+    VkDevice                   m_device = VK_NULL_HANDLE;
+    VkPipelineCache            m_cache  = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties m_properties;
+    uint64_t                   m_shaderHash = 0;
+    std::string                m_path;
+    bool                       m_warm = false;
+
+    std::chrono::duration<double, std::milli> m_creationTime{0.0};
+};
+
+}  // namespace VkTools
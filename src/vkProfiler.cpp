@@ -0,0 +1,438 @@
+#include "vkProfiler.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#include <imgui.h>
+#include <spdlog/spdlog.h>
+
+#include "vkTools.h"
+
+namespace VkTools {
+namespace {
+
+const VkQueryPipelineStatisticFlags kStatistics =
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+    | VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//  Timestamps of a slot: the frame start followed by a begin and end pair per scope
+//
+
+void Profiler::init(VkDevice                          device,
+                    const VkPhysicalDeviceProperties& properties,
+                    const VkPhysicalDeviceFeatures&   features,
+                    const VkQueueFamilyProperties&    queueFamilyProperties,
+                    uint32_t                          queueFamily,
+                    uint32_t                          framesInFlight)
+{
+    m_device          = device;
+    m_epoch           = Clock::now();
+    m_frame           = 0;
+    m_queriesPerSlot  = 1 + 2 * kMaxGpuScopes;
+    m_timestampPeriod = properties.limits.timestampPeriod;
+
+    const uint32_t validBits = queueFamilyProperties.timestampValidBits;
+    m_timestampMask          = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    m_slots.assign(framesInFlight, FrameSlot());
+    m_history.assign(kHistorySize, FrameRecord());
+
+    VkCommandPoolCreateInfo poolInfo = {};
+    poolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags                   = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex        = queueFamily;
+    VK_CHECK_RESULT(vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool));
+
+    for(FrameSlot& slot : m_slots)
+    {
+        VkCommandBufferAllocateInfo allocateInfo = {};
+        allocateInfo.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocateInfo.commandPool        = m_commandPool;
+        allocateInfo.level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocateInfo.commandBufferCount = 1;
+        VK_CHECK_RESULT(vkAllocateCommandBuffers(m_device, &allocateInfo, &slot.commandBuffer));
+    }
+
+    if(validBits == 0 || m_timestampPeriod <= 0.0)
+    {
+        spdlog::info("Profiler: no GPU timestamps on this queue, CPU timers only");
+        return;
+    }
+
+    VkQueryPoolCreateInfo queryInfo = {};
+    queryInfo.sType                 = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryInfo.queryType             = VK_QUERY_TYPE_TIMESTAMP;
+    queryInfo.queryCount            = m_queriesPerSlot * framesInFlight;
+    VK_CHECK_RESULT(vkCreateQueryPool(m_device, &queryInfo, nullptr, &m_timestampPool));
+
+    if(features.pipelineStatisticsQuery)
+    {
+        queryInfo.queryType          = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        queryInfo.queryCount         = kMaxGpuScopes * framesInFlight;
+        queryInfo.pipelineStatistics = kStatistics;
+        VK_CHECK_RESULT(vkCreateQueryPool(m_device, &queryInfo, nullptr, &m_statisticsPool));
+    }
+}
+
+void Profiler::cleanUp()
+{
+    if(m_timestampPool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(m_device, m_timestampPool, nullptr);
+        m_timestampPool = VK_NULL_HANDLE;
+    }
+    if(m_statisticsPool != VK_NULL_HANDLE)
+    {
+        vkDestroyQueryPool(m_device, m_statisticsPool, nullptr);
+        m_statisticsPool = VK_NULL_HANDLE;
+    }
+    if(m_commandPool != VK_NULL_HANDLE)
+    {
+        vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+        m_commandPool = VK_NULL_HANDLE;
+    }
+    m_slots.clear();
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+double Profiler::now() const
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - m_epoch).count();
+}
+
+Profiler::FrameRecord* Profiler::record(uint64_t frame)
+{
+    if(frame > m_frame || m_frame - frame >= kHistorySize)
+    {
+        return nullptr;
+    }
+    FrameRecord& record = m_history[frame % kHistorySize];
+    return record.frame == frame ? &record : nullptr;
+}
+
+void Profiler::newFrame()
+{
+    const double time = now();
+    if(FrameRecord* previous = record(m_frame))
+    {
+        previous->frameMs = time - previous->startMs;
+        ++m_frame;
+    }
+
+    FrameRecord& current = m_history[m_frame % kHistorySize];
+    current.frame        = m_frame;
+    current.startMs      = time;
+    current.frameMs      = 0.0;
+    current.events.clear();
+}
+
+void Profiler::addCpuEvent(const char* name, double startMs)
+{
+    if(FrameRecord* current = record(m_frame))
+    {
+        const double endMs = now();
+        current->events.push_back({name, startMs, endMs - startMs, false, false, 0, 0, 0});
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  GPU and CPU clocks are not calibrated against each other, the frame start timestamp is
+//  placed at the time recordFrameStart() ran. Good enough to see the overlap in a trace.
+//
+
+void Profiler::resolveSlot(FrameSlot& slot)
+{
+    FrameRecord* target = record(slot.frame);
+    if(!target || slot.scopes.empty() || m_timestampPool == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    const uint32_t        slotIndex = uint32_t(&slot - m_slots.data());
+    const uint32_t        count     = 1 + 2 * uint32_t(slot.scopes.size());
+    std::vector<uint64_t> timestamps(count);
+    if(vkGetQueryPoolResults(m_device, m_timestampPool, slotIndex * m_queriesPerSlot, count,
+                             count * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t),
+                             VK_QUERY_RESULT_64_BIT)
+       != VK_SUCCESS)
+    {
+        return;
+    }
+
+    const double toMs = m_timestampPeriod * 1e-6;
+    for(uint32_t i = 0; i < slot.scopes.size(); ++i)
+    {
+        const GpuScope& scope = slot.scopes[i];
+        const uint64_t  begin = (timestamps[1 + 2 * i] - timestamps[0]) & m_timestampMask;
+        const uint64_t  end   = (timestamps[2 + 2 * i] - timestamps[0]) & m_timestampMask;
+
+        Event event      = {};
+        event.name       = scope.name;
+        event.startMs    = slot.startMs + double(begin) * toMs;
+        event.durationMs = double(end - begin) * toMs;
+        event.gpu        = true;
+
+        uint64_t stats[3] = {};
+        if(scope.statisticsQuery != ~0u
+           && vkGetQueryPoolResults(m_device, m_statisticsPool,
+                                    slotIndex * kMaxGpuScopes + scope.statisticsQuery, 1,
+                                    sizeof(stats), stats, sizeof(stats), VK_QUERY_RESULT_64_BIT)
+                  == VK_SUCCESS)
+        {
+            // Results come in bit order of kStatistics
+            event.hasStatistics       = true;
+            event.vertexInvocations   = stats[0];
+            event.fragmentInvocations = stats[1];
+            event.computeInvocations  = stats[2];
+        }
+        target->events.push_back(event);
+    }
+    m_resolvedFrame = slot.frame;
+}
+
+double Profiler::lastGpuDurationMs(const char* name) const
+{
+    if(m_resolvedFrame == ~0ull)
+    {
+        return -1.0;
+    }
+    const FrameRecord& resolved = m_history[m_resolvedFrame % kHistorySize];
+    if(resolved.frame != m_resolvedFrame)
+    {
+        return -1.0;
+    }
+
+    double duration = -1.0;
+    for(const Event& event : resolved.events)
+    {
+        if(event.gpu && std::strcmp(event.name, name) == 0)
+        {
+            duration = std::max(duration, 0.0) + event.durationMs;
+        }
+    }
+    return duration;
+}
+
+VkCommandBuffer Profiler::recordFrameStart(uint32_t frameSlot)
+{
+    FrameSlot& slot = m_slots[frameSlot];
+    resolveSlot(slot);
+
+    slot.frame    = m_frame;
+    slot.startMs  = now();
+    m_currentSlot = frameSlot;
+    slot.scopes.clear();
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(slot.commandBuffer, &beginInfo));
+
+    if(m_timestampPool != VK_NULL_HANDLE)
+    {
+        const uint32_t first = frameSlot * m_queriesPerSlot;
+        vkCmdResetQueryPool(slot.commandBuffer, m_timestampPool, first, m_queriesPerSlot);
+        vkCmdWriteTimestamp(slot.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            m_timestampPool, first);
+    }
+    if(m_statisticsPool != VK_NULL_HANDLE)
+    {
+        vkCmdResetQueryPool(slot.commandBuffer, m_statisticsPool, frameSlot * kMaxGpuScopes,
+                            kMaxGpuScopes);
+    }
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(slot.commandBuffer));
+    return slot.commandBuffer;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+uint32_t Profiler::beginGpuScope(VkCommandBuffer cmdBuf, const char* name, bool statistics)
+{
+    FrameSlot& slot = m_slots[m_currentSlot];
+    if(m_timestampPool == VK_NULL_HANDLE || slot.scopes.size() >= kMaxGpuScopes)
+    {
+        return ~0u;
+    }
+
+    const uint32_t scope = uint32_t(slot.scopes.size());
+    GpuScope       entry = {name, ~0u};
+    if(statistics && m_statisticsPool != VK_NULL_HANDLE)
+    {
+        entry.statisticsQuery = scope;
+        vkCmdBeginQuery(cmdBuf, m_statisticsPool, m_currentSlot * kMaxGpuScopes + scope, 0);
+    }
+    slot.scopes.push_back(entry);
+
+    vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampPool,
+                        m_currentSlot * m_queriesPerSlot + 1 + 2 * scope);
+    return scope;
+}
+
+void Profiler::endGpuScope(VkCommandBuffer cmdBuf, uint32_t scope)
+{
+    if(scope == ~0u)
+    {
+        return;
+    }
+
+    vkCmdWriteTimestamp(cmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampPool,
+                        m_currentSlot * m_queriesPerSlot + 2 + 2 * scope);
+    if(m_slots[m_currentSlot].scopes[scope].statisticsQuery != ~0u)
+    {
+        vkCmdEndQuery(cmdBuf, m_statisticsPool, m_currentSlot * kMaxGpuScopes + scope);
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  Only finished frames are averaged, the current one has no GPU events yet
+//
+
+void Profiler::drawImGui(bool* open)
+{
+    if(!ImGui::Begin("Profiler", open))
+    {
+        ImGui::End();
+        return;
+    }
+
+    struct Total
+    {
+        double   ms    = 0.0;
+        int      count = 0;
+        uint64_t invocations[3];
+        bool     hasStatistics = false;
+    };
+    std::map<std::pair<bool, std::string>, Total> totals;
+    std::vector<float>                            frameTimes;
+    double                                        frameSum = 0.0;
+
+    for(uint64_t i = m_frame >= kHistorySize ? m_frame - kHistorySize + 1 : 0; i < m_frame; ++i)
+    {
+        const FrameRecord* frame = record(i);
+        if(!frame)
+        {
+            continue;
+        }
+        frameTimes.push_back(float(frame->frameMs));
+        frameSum += frame->frameMs;
+
+        for(const Event& event : frame->events)
+        {
+            Total& total = totals[{event.gpu, event.name}];
+            total.ms += event.durationMs;
+            total.count++;
+            if(event.hasStatistics)
+            {
+                total.hasStatistics  = true;
+                total.invocations[0] = event.vertexInvocations;
+                total.invocations[1] = event.fragmentInvocations;
+                total.invocations[2] = event.computeInvocations;
+            }
+        }
+    }
+
+    if(!frameTimes.empty())
+    {
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%.2f ms average", frameSum / frameTimes.size());
+        ImGui::PlotLines("Frame", frameTimes.data(), int(frameTimes.size()), 0, overlay, 0.0f,
+                         FLT_MAX, ImVec2(0.0f, 60.0f));
+    }
+    if(!hasGpuTimestamps())
+    {
+        ImGui::Text("No GPU timestamps on this device");
+    }
+
+    ImGui::Columns(3, "profilerScopes");
+    ImGui::Text("Scope");
+    ImGui::NextColumn();
+    ImGui::Text("Average ms");
+    ImGui::NextColumn();
+    ImGui::Text("Invocations VS / FS / CS");
+    ImGui::NextColumn();
+    ImGui::Separator();
+    for(const auto& entry : totals)
+    {
+        const Total& total = entry.second;
+        ImGui::Text("%s %s", entry.first.first ? "GPU" : "CPU", entry.first.second.c_str());
+        ImGui::NextColumn();
+        ImGui::Text("%.3f", total.ms / total.count);
+        ImGui::NextColumn();
+        if(total.hasStatistics)
+        {
+            ImGui::Text("%llu / %llu / %llu", (unsigned long long)total.invocations[0],
+                        (unsigned long long)total.invocations[1],
+                        (unsigned long long)total.invocations[2]);
+        }
+        ImGui::NextColumn();
+    }
+    ImGui::Columns(1);
+
+    if(ImGui::Button("Export Chrome trace"))
+    {
+        exportChromeTrace("profile.json");
+    }
+    ImGui::End();
+}
+
+// ----------------------------------------------------------------------------
+//  Complete events ("ph": "X") in microseconds, CPU on thread 1 and GPU on thread 2
+//
+
+bool Profiler::exportChromeTrace(const std::string& path) const
+{
+    std::ofstream file(path);
+    if(!file)
+    {
+        spdlog::warn("Profiler: cannot write {}", path);
+        return false;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+            "\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,"
+            "\"args\":{\"name\":\"GPU\"}}";
+
+    auto writeEvent = [&file](const char* name, double startMs, double durationMs, int tid) {
+        file << ",\n{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+             << ",\"ts\":" << startMs * 1000.0 << ",\"dur\":" << durationMs * 1000.0 << "}";
+    };
+
+    size_t numFrames = 0;
+    file.setf(std::ios::fixed);
+    file.precision(3);
+    for(uint64_t i = m_frame >= kHistorySize ? m_frame - kHistorySize + 1 : 0; i < m_frame; ++i)
+    {
+        const FrameRecord& frame = m_history[i % kHistorySize];
+        if(frame.frame != i)
+        {
+            continue;
+        }
+        writeEvent("Frame", frame.startMs, frame.frameMs, 1);
+        for(const Event& event : frame.events)
+        {
+            writeEvent(event.name, event.startMs, event.durationMs, event.gpu ? 2 : 1);
+        }
+        numFrames++;
+    }
+    file << "\n]}\n";
+
+    spdlog::info("Profiler: wrote {} frames to {}", numFrames, path);
+    return bool(file);
+}
+
+}  // namespace VkTools
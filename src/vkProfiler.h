@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace VkTools {
+
+// ----------------------------------------------------------------------------
+//  Frame profiler with CPU scoped timers and GPU timestamp queries. GPU results are read back
+//  when the frame slot comes around again, framesInFlight frames later, and land in the same
+//  ring buffered frame record as the CPU events of that frame.
+//
+//  GPU timing is disabled when the queue has no timestamp bits and pipeline statistics when the
+//  device lacks pipelineStatisticsQuery, so software drivers only lose those columns.
+//
+
+class Profiler
+{
+    public:
+    static const uint32_t kMaxGpuScopes = 16;   // Per frame
+    static const uint32_t kHistorySize  = 256;  // Frames
+
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct Event
+    {
+        const char* name;
+        double      startMs;  // From init(), GPU events are aligned to recordFrameStart()
+        double      durationMs;
+        bool        gpu;
+        bool        hasStatistics;
+        uint64_t    vertexInvocations;
+        uint64_t    fragmentInvocations;
+        uint64_t    computeInvocations;
+    };
+
+    struct FrameRecord
+    {
+        uint64_t           frame   = ~0ull;
+        double             startMs = 0.0;
+        double             frameMs = 0.0;  // Until the next newFrame()
+        std::vector<Event> events;
+    };
+
+    // Adds a CPU event covering its lifetime
+    struct CpuScope
+    {
+        Profiler*   profiler;
+        const char* name;
+        double      startMs;
+
+        ~CpuScope() { profiler->addCpuEvent(name, startMs); }
+    };
+
+    void init(VkDevice                          device,
+              const VkPhysicalDeviceProperties& properties,
+              const VkPhysicalDeviceFeatures&   features,
+              const VkQueueFamilyProperties&    queueFamilyProperties,
+              uint32_t                          queueFamily,
+              uint32_t                          framesInFlight);
+    void cleanUp();
+
+    // Closes the previous frame record and opens a new one, call first thing in a frame
+    void newFrame();
+
+    // Call once the fence of frameSlot has signaled. Reads the queries the slot wrote last time
+    // and returns a command buffer resetting them, it has to be submitted before any other
+    // command buffer of the frame.
+    VkCommandBuffer recordFrameStart(uint32_t frameSlot);
+
+    // Scopes with statistics must not overlap each other and have to begin and end in the same
+    // command buffer and subpass. Returns the scope for endGpuScope.
+    uint32_t beginGpuScope(VkCommandBuffer cmdBuf, const char* name, bool statistics = false);
+    void     endGpuScope(VkCommandBuffer cmdBuf, uint32_t scope);
+
+    CpuScope cpuScope(const char* name) { return CpuScope{this, name, now()}; }
+
+    // Averages over the history in its own window
+    void drawImGui(bool* open);
+
+    // Writes the history as Chrome trace event JSON, open in chrome://tracing or Perfetto
+    bool exportChromeTrace(const std::string& path) const;
+
+    bool hasGpuTimestamps() const { return m_timestampPool != VK_NULL_HANDLE; }
+
+    // Summed duration of the GPU scopes called name in the frame the last recordFrameStart read
+    // back, negative when there were none
+    double lastGpuDurationMs(const char* name) const;
+
+    private:
+    struct GpuScope
+    {
+        const char* name;
+        uint32_t    statisticsQuery;  // ~0u without statistics
+    };
+
+    struct FrameSlot
+    {
+        uint64_t              frame   = ~0ull;
+        double                startMs = 0.0;
+        std::vector<GpuScope> scopes;
+        VkCommandBuffer       commandBuffer = VK_NULL_HANDLE;
+    };
+
+    double now() const;
+    void   addCpuEvent(const char* name, double startMs);
+    void   resolveSlot(FrameSlot& slot);
+
+    FrameRecord* record(uint64_t frame);
+
+    VkDevice      m_device          = VK_NULL_HANDLE;
+    VkCommandPool m_commandPool     = VK_NULL_HANDLE;
+    VkQueryPool   m_timestampPool   = VK_NULL_HANDLE;
+    VkQueryPool   m_statisticsPool  = VK_NULL_HANDLE;
+    double        m_timestampPeriod = 1.0;  // Nanoseconds per tick
+    uint64_t      m_timestampMask   = ~0ull;
+    uint32_t      m_queriesPerSlot  = 0;
+    uint32_t      m_currentSlot     = 0;
+    uint64_t      m_frame           = 0;
+    uint64_t      m_resolvedFrame   = ~0ull;  // Frame of the latest GPU results
+
+    std::vector<FrameSlot>   m_slots;
+    std::vector<FrameRecord> m_history;
+    Clock::time_point        m_epoch;
+};
+
+}  // namespace VkTools
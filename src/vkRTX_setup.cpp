@@ -3,7 +3,25 @@
 
 #include "sobol/sobol.h"
 
+#include <chrono>
+#include <glm/gtc/packing.hpp>
 #include <random>
+#include <spdlog/spdlog.h>
+
+namespace {
+
+// RayStatistics buffer of pathRT.rgen and AO.rgen
+struct RayStatisticsCounters
+{
+    uint32_t enabled;
+    uint32_t primary;
+    uint32_t extension;
+    uint32_t shadow;
+    uint32_t pathLength[rtutils::RayStatistics::kMaxDepth];
+};
+
+}  // namespace
+
 // ----------------------------------------------------------------------------
 //
 //
@@ -41,18 +59,30 @@ void VkRTX::initRaytracing(VkPhysicalDevice    gpu,
     updateScrambleValueImage();
 
     createRaytracingRenderTarget();
+    createGBuffer();
+
+    m_denoiser = std::make_unique<VkDenoiser>(m_vkctx, m_extent);
+    m_denoiser->init(m_rtRenderTarget.view, m_gbuffer.normalDepth.view,
+                     m_gbuffer.prevNormalDepth.view, m_gbuffer.albedo.view,
+                     m_gbuffer.emission.view, *m_rtUniformBuffer);
+
     setupComputePipeline();
+    setupReprojectionPipeline();
 
     createGeometryInstances();
     createAccelerationStructures();
+    createLightBuffers();
+    createEnvironmentResources();
+    createRayStatisticsBuffer();
+    createTextureFeedbackBuffer();
 
     createRaytracingDescriptorSet();
 
-    createRaytracingPipelineCookTorrance();
-    createRaytracingPipelineAmbientOcclusion();
+    createRaytracingPipelineCookTorrance(nullptr, &pipelines.GGX, &layouts.GGX);
+    createRaytracingPipelineAmbientOcclusion(nullptr, &pipelines.AO, &layouts.AO);
 
-    createShaderBindingTableCookTorrance();
-    createShaderBindingTableAmbientOcclusion();
+    createShaderBindingTableCookTorrance(pipelines.GGX, &m_SBTs.ggx);
+    createShaderBindingTableAmbientOcclusion(pipelines.AO, &m_SBTs.ao);
 
     updateRaytracingRenderTarget(m_rtRenderTarget.view);
 }
@@ -64,17 +94,22 @@ void VkRTX::initRaytracing(VkPhysicalDevice    gpu,
 
 void VkRTX::createGeometryInstances()
 {
-    auto&            model = (*m_models)[0];
-    GeometryInstance instance;
-    instance.vertexBuffer = model.vertexBuffer;
-    instance.vertexCount  = model.numVertices;
-    instance.vertexOffset = 0;
-    instance.indexBuffer  = model.indexBuffer;
-    instance.indexCount   = model.numIndices;
-    instance.indexOffset  = 0;
-    instance.transform    = glm::mat4(1.0f);
-
-    m_geometryInstances.push_back(instance);
+    // One bottom level structure per model over its part of the shared buffers. Indices are
+    // already rebased, so every instance sees the whole vertex buffer.
+    const VkTools::SceneGeometry& geometry = m_vkctx->getSceneGeometry();
+    for(const VkTools::GeometryRange& range : geometry.getRanges())
+    {
+        GeometryInstance instance;
+        instance.vertexBuffer = geometry.getVertexBuffer();
+        instance.vertexCount  = geometry.getVertexCount();
+        instance.vertexOffset = 0;
+        instance.indexBuffer  = geometry.getIndexBuffer();
+        instance.indexCount   = range.indexCount;
+        instance.indexOffset  = VkDeviceSize(range.firstIndex) * sizeof(uint32_t);
+        instance.transform    = glm::mat4(1.0f);
+
+        m_geometryInstances.push_back(instance);
+    }
 }
 
 // ----------------------------------------------------------------------------
@@ -143,11 +178,12 @@ void VkRTX::createTopLevelAS(
 
     if(!updateOnly)
     {
+        // Every instance uses the same hit group, the custom index selects the model in the
+        // closest hit shaders
         for(size_t i = 0; i < instances.size(); ++i)
         {
             m_topLevelASGenerator.AddInstance(instances[i].first, instances[i].second,
-                                              static_cast<uint32_t>(i),
-                                              static_cast<uint32_t>(2 * i));
+                                              static_cast<uint32_t>(i), 0);
         }
 
         m_topLevelAS.structure =
@@ -189,7 +225,8 @@ void VkRTX::createRaytracingRenderTarget()
 {
     VkTools::createImage(
         m_vkctx->getAllocator(), m_extent, m_rtRenderTarget.format, VK_IMAGE_TILING_OPTIMAL,
-        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+            | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
         VMA_MEMORY_USAGE_GPU_ONLY, &m_rtRenderTarget.image, &m_rtRenderTarget.memory);
 
     VkCommandBuffer commandBuffer =
@@ -224,12 +261,89 @@ void VkRTX::createRaytracingRenderTarget()
 //
 //
 
+void VkRTX::createGBuffer()
+{
+    VkDevice      device    = m_vkctx->getDevice();
+    VmaAllocator  allocator = m_vkctx->getAllocator();
+    VkQueue       queue     = m_vkctx->getQueue();
+    VkCommandPool pool      = m_vkctx->getCommandPool();
+
+    // Current guides are copied over the previous ones after denoising
+    VkTools::createStorageImage(device, allocator, queue, pool, m_extent,
+                                VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                                &m_gbuffer.normalDepth);
+    VkTools::createStorageImage(device, allocator, queue, pool, m_extent,
+                                VK_FORMAT_R32G32B32A32_SFLOAT, VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                &m_gbuffer.prevNormalDepth);
+    VkTools::createStorageImage(device, allocator, queue, pool, m_extent,
+                                VK_FORMAT_R16G16B16A16_SFLOAT, 0, &m_gbuffer.albedo);
+    VkTools::createStorageImage(device, allocator, queue, pool, m_extent,
+                                VK_FORMAT_R16G16B16A16_SFLOAT, 0, &m_gbuffer.emission);
+
+    VkTools::createStorageImage(device, allocator, queue, pool, m_extent, m_rtRenderTarget.format,
+                                VK_IMAGE_USAGE_TRANSFER_DST_BIT, &m_prevAccumulation);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void VkRTX::setupReprojectionPipeline()
+{
+    VkDevice device = m_vkctx->getDevice();
+    auto&    dsg    = descriptors.reprojectionDSG;
+
+    for(uint32_t binding = 0; binding < 4; ++binding)
+    {
+        dsg.AddBinding(binding, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+    dsg.AddBinding(4, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    descriptors.reprojection.descriptorPool      = dsg.GeneratePool(device);
+    descriptors.reprojection.descriptorSetLayout = dsg.GenerateLayout(device);
+    descriptors.reprojection.descriptorSet =
+        dsg.GenerateSet(device, descriptors.reprojection.descriptorPool,
+                        descriptors.reprojection.descriptorSetLayout);
+
+    const std::array<VkImageView, 4> views = {m_rtRenderTarget.view, m_prevAccumulation.view,
+                                              m_gbuffer.normalDepth.view,
+                                              m_gbuffer.prevNormalDepth.view};
+    for(uint32_t binding = 0; binding < views.size(); ++binding)
+    {
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.sampler               = VK_NULL_HANDLE;
+        imageInfo.imageView             = views[binding];
+        imageInfo.imageLayout           = VK_IMAGE_LAYOUT_GENERAL;
+
+        dsg.Bind(descriptors.reprojection.descriptorSet, binding, {imageInfo});
+    }
+
+    VkDescriptorBufferInfo uboInfo = {};
+    uboInfo.buffer                 = *m_rtUniformBuffer;
+    uboInfo.offset                 = 0;
+    uboInfo.range                  = sizeof(vkContext::UniformBufferObject);
+
+    dsg.Bind(descriptors.reprojection.descriptorSet, 4, {uboInfo});
+    dsg.UpdateSetContents(device, descriptors.reprojection.descriptorSet);
+
+    auto& pipelineCache = m_vkctx->getPipelineCache();
+    auto  timing        = pipelineCache.measure();
+    VkTools::createComputePipeline(device, "../../shaders/spirv/reprojectAccumulation.comp.spv",
+                                   descriptors.reprojection.descriptorSetLayout, sizeof(float),
+                                   &pipelines.reprojection, &layouts.reprojection,
+                                   pipelineCache.get());
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
 void VkRTX::setupComputePipeline()
 {
     std::array<VkDescriptorPoolSize, 2> poolSizes = {};
 
     poolSizes[0].type            = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    poolSizes[0].descriptorCount = 2;
+    poolSizes[0].descriptorCount = 3;
 
     poolSizes[1].type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
     poolSizes[1].descriptorCount = 1;
@@ -246,7 +360,7 @@ void VkRTX::setupComputePipeline()
                                            &descriptors.compute.descriptorPool));
 
 
-    std::array<VkDescriptorSetLayoutBinding, 3> bindings = {};
+    std::array<VkDescriptorSetLayoutBinding, 4> bindings = {};
 
     bindings[0].binding         = 0;
     bindings[0].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
@@ -263,6 +377,11 @@ void VkRTX::setupComputePipeline()
     bindings[2].descriptorCount = 1;
     bindings[2].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
 
+    bindings[3].binding         = 3;
+    bindings[3].descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    bindings[3].descriptorCount = 1;
+    bindings[3].stageFlags      = VK_SHADER_STAGE_COMPUTE_BIT;
+
     VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo = {};
     descriptorLayoutInfo.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     descriptorLayoutInfo.pNext        = nullptr;
@@ -294,14 +413,20 @@ void VkRTX::setupComputePipeline()
     computeShaderStageInfo.module = postProcessShader;
     computeShaderStageInfo.pName  = "main";
 
+    // Selects the denoised image over the raw accumulation
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags          = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset              = 0;
+    pushConstantRange.size                = sizeof(int32_t);
+
     VkPipelineLayoutCreateInfo layoutInfo = {};
     layoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     layoutInfo.pNext                      = nullptr;
     layoutInfo.flags                      = 0;
     layoutInfo.setLayoutCount             = 1;
     layoutInfo.pSetLayouts                = &descriptors.compute.descriptorSetLayout;
-    layoutInfo.pushConstantRangeCount     = 0;
-    layoutInfo.pPushConstantRanges        = nullptr;
+    layoutInfo.pushConstantRangeCount     = 1;
+    layoutInfo.pPushConstantRanges        = &pushConstantRange;
 
     VK_CHECK_RESULT(
         vkCreatePipelineLayout(m_vkctx->getDevice(), &layoutInfo, nullptr, &layouts.compute));
@@ -315,8 +440,10 @@ void VkRTX::setupComputePipeline()
     pipelineInfo.basePipelineHandle          = VK_NULL_HANDLE;
     pipelineInfo.basePipelineIndex           = 0;
 
-    VK_CHECK_RESULT(vkCreateComputePipelines(m_vkctx->getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo,
-                                             nullptr, &pipelines.compute));
+    auto& pipelineCache = m_vkctx->getPipelineCache();
+    auto  timing        = pipelineCache.measure();
+    VK_CHECK_RESULT(vkCreateComputePipelines(m_vkctx->getDevice(), pipelineCache.get(), 1,
+                                             &pipelineInfo, nullptr, &pipelines.compute));
 
     vkDestroyShaderModule(m_vkctx->getDevice(), postProcessShader, nullptr);
 
@@ -331,7 +458,12 @@ void VkRTX::setupComputePipeline()
     rtImageInfo.imageView   = m_rtRenderTarget.view;
     rtImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 
-    std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+    VkDescriptorImageInfo denoisedImageInfo = {};
+    denoisedImageInfo.sampler               = 0;
+    denoisedImageInfo.imageView             = m_denoiser->getOutputView();
+    denoisedImageInfo.imageLayout           = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::array<VkWriteDescriptorSet, 3> descriptorWrites = {};
 
     descriptorWrites[0].sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
     descriptorWrites[0].pNext            = nullptr;
@@ -355,6 +487,17 @@ void VkRTX::setupComputePipeline()
     descriptorWrites[1].pBufferInfo      = &uboInfo;
     descriptorWrites[1].pTexelBufferView = nullptr;
 
+    descriptorWrites[2].sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[2].pNext            = nullptr;
+    descriptorWrites[2].dstSet           = descriptors.compute.descriptorSet;
+    descriptorWrites[2].dstBinding       = 3;
+    descriptorWrites[2].dstArrayElement  = 0;
+    descriptorWrites[2].descriptorCount  = 1;
+    descriptorWrites[2].descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    descriptorWrites[2].pImageInfo       = &denoisedImageInfo;
+    descriptorWrites[2].pBufferInfo      = nullptr;
+    descriptorWrites[2].pTexelBufferView = nullptr;
+
 
     vkUpdateDescriptorSets(m_vkctx->getDevice(), static_cast<uint32_t>(descriptorWrites.size()),
                            descriptorWrites.data(), 0, nullptr);
@@ -390,6 +533,8 @@ void VkRTX::updateWriteDescriptors(VkImageView resultView)
 
 void VkRTX::createAccelerationStructures()
 {
+    const auto start = std::chrono::high_resolution_clock::now();
+
     VkCommandBuffer commandBuffer =
         VkTools::beginRecordingCommandBuffer(m_vkctx->getDevice(), m_vkctx->getCommandPool());
     m_bottomLevelAS.resize(m_geometryInstances.size());
@@ -412,6 +557,10 @@ void VkRTX::createAccelerationStructures()
 
     VkTools::flushCommandBuffer(m_vkctx->getDevice(), m_vkctx->getQueue(),
                                 m_vkctx->getCommandPool(), commandBuffer);
+
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    m_accelerationStructureBuildMs = elapsed.count();
 }
 
 // ----------------------------------------------------------------------------
@@ -456,7 +605,7 @@ void VkRTX::destroyAccelerationStructures(const AccelerationStructure& as)
 
 void VkRTX::createRaytracingDescriptorSet()
 {
-    auto& model = (*m_models)[0];
+    const VkTools::SceneGeometry& geometry = m_vkctx->getSceneGeometry();
 
     VkBufferMemoryBarrier barrier = {};
     barrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
@@ -471,12 +620,12 @@ void VkRTX::createRaytracingDescriptorSet()
     VkCommandBuffer commandBuffer =
         VkTools::beginRecordingCommandBuffer(m_vkctx->getDevice(), m_vkctx->getCommandPool());
 
-    barrier.buffer = model.vertexBuffer;
+    barrier.buffer = geometry.getVertexBuffer();
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
                          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0,
                          nullptr);
 
-    barrier.buffer = model.indexBuffer;
+    barrier.buffer = geometry.getIndexBuffer();
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
                          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0,
                          nullptr);
@@ -525,14 +674,21 @@ void VkRTX::createRaytracingDescriptorSet()
     descriptors.aoDSG.AddBinding(5, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                                  VK_SHADER_STAGE_RAYGEN_BIT_NV);
 
-    // Textures
-    descriptors.ggxDSG.AddBinding(6, static_cast<uint32_t>((*m_models)[0].m_textures.size()),
-                                  VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    // Textures of all models, material texture ids index the concatenation
+    uint32_t textureCount = 0;
+    for(const auto& model : *m_models)
+    {
+        textureCount += static_cast<uint32_t>(model.m_textures.size());
+    }
+    // The sampler of the registry is immutable, the array lives until the layouts are generated
+    std::vector<VkSampler> textureSamplers(textureCount,
+                                           m_vkctx->getTextureRegistry()->getSampler());
+    descriptors.ggxDSG.AddBinding(6, textureCount, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                                   VK_SHADER_STAGE_RAYGEN_BIT_NV
-                                      | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV);
-    descriptors.aoDSG.AddBinding(6, static_cast<uint32_t>((*m_models)[0].m_textures.size()),
-                                 VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-                                 VK_SHADER_STAGE_RAYGEN_BIT_NV);
+                                      | VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV,
+                                  textureSamplers.data());
+    descriptors.aoDSG.AddBinding(6, textureCount, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                 VK_SHADER_STAGE_RAYGEN_BIT_NV, textureSamplers.data());
 
     // Sobol scramble images
     descriptors.ggxDSG.AddBinding(7, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
@@ -548,6 +704,42 @@ void VkRTX::createRaytracingDescriptorSet()
     descriptors.aoDSG.AddBinding(8, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
                                  VK_SHADER_STAGE_RAYGEN_BIT_NV);
 
+    // Denoiser guides, normal + depth, albedo and emission
+    descriptors.ggxDSG.AddBinding(9, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                  VK_SHADER_STAGE_RAYGEN_BIT_NV);
+    descriptors.ggxDSG.AddBinding(10, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                  VK_SHADER_STAGE_RAYGEN_BIT_NV);
+    descriptors.ggxDSG.AddBinding(18, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                                  VK_SHADER_STAGE_RAYGEN_BIT_NV);
+
+    // Emissive triangles and their alias table
+    descriptors.ggxDSG.AddBinding(11, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                  VK_SHADER_STAGE_RAYGEN_BIT_NV);
+    descriptors.ggxDSG.AddBinding(12, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                  VK_SHADER_STAGE_RAYGEN_BIT_NV);
+
+    // Environment map and its sampling tables
+    descriptors.ggxDSG.AddBinding(13, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                                  VK_SHADER_STAGE_RAYGEN_BIT_NV);
+    descriptors.ggxDSG.AddBinding(14, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                  VK_SHADER_STAGE_RAYGEN_BIT_NV);
+
+    // Ray counters
+    descriptors.ggxDSG.AddBinding(15, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                  VK_SHADER_STAGE_RAYGEN_BIT_NV);
+    descriptors.aoDSG.AddBinding(15, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                 VK_SHADER_STAGE_RAYGEN_BIT_NV);
+
+    // First primitive of each instance
+    descriptors.ggxDSG.AddBinding(16, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                  VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV);
+    descriptors.aoDSG.AddBinding(16, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                 VK_SHADER_STAGE_CLOSEST_HIT_BIT_NV);
+
+    // Texel sizes the textures were sampled at, for TextureCache
+    descriptors.ggxDSG.AddBinding(17, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                                  VK_SHADER_STAGE_RAYGEN_BIT_NV);
+
     descriptors.ggx.descriptorPool      = descriptors.ggxDSG.GeneratePool(m_vkctx->getDevice());
     descriptors.ggx.descriptorSetLayout = descriptors.ggxDSG.GenerateLayout(m_vkctx->getDevice());
     descriptors.ggx.descriptorSet =
@@ -580,7 +772,7 @@ void VkRTX::createRaytracingDescriptorSet()
 
     // Vertex buffer
     VkDescriptorBufferInfo vertexInfo = {};
-    vertexInfo.buffer                 = model.vertexBuffer;
+    vertexInfo.buffer                 = geometry.getVertexBuffer();
     vertexInfo.offset                 = 0;
     vertexInfo.range                  = VK_WHOLE_SIZE;
 
@@ -589,7 +781,7 @@ void VkRTX::createRaytracingDescriptorSet()
 
     // Index buffer
     VkDescriptorBufferInfo indexInfo = {};
-    indexInfo.buffer                 = model.indexBuffer;
+    indexInfo.buffer                 = geometry.getIndexBuffer();
     indexInfo.offset                 = 0;
     indexInfo.range                  = VK_WHOLE_SIZE;
 
@@ -598,30 +790,14 @@ void VkRTX::createRaytracingDescriptorSet()
 
     // Material buffer
     VkDescriptorBufferInfo materialInfo = {};
-    materialInfo.buffer                 = model.materialBuffer;
+    materialInfo.buffer                 = geometry.getMaterialBuffer();
     materialInfo.offset                 = 0;
     materialInfo.range                  = VK_WHOLE_SIZE;
 
     descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 5, {materialInfo});
     descriptors.aoDSG.Bind(descriptors.ao.descriptorSet, 5, {materialInfo});
 
-    // Textures
-    std::vector<VkDescriptorImageInfo> imageInfos;
-    for(size_t i = 0; i < model.m_textures.size(); ++i)
-    {
-        auto&                 texture   = model.m_textures[i];
-        VkDescriptorImageInfo imageInfo = {};
-        imageInfo.sampler               = texture.sampler;
-        imageInfo.imageView             = texture.view;
-        imageInfo.imageLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imageInfos.push_back(imageInfo);
-    }
-
-    if(!model.m_textures.empty())
-    {
-        descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 6, imageInfos);
-        descriptors.aoDSG.Bind(descriptors.ao.descriptorSet, 6, imageInfos);
-    }
+    bindTextureDescriptors();
 
     VkDescriptorImageInfo sobolSamplerInfo = {};
     sobolSamplerInfo.sampler               = m_sobol.sampler;
@@ -639,6 +815,108 @@ void VkRTX::createRaytracingDescriptorSet()
     descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 8, {sobolMatrixInfo});
     descriptors.aoDSG.Bind(descriptors.ao.descriptorSet, 8, {sobolMatrixInfo});
 
+    VkDescriptorImageInfo normalDepthInfo = {};
+    normalDepthInfo.sampler               = VK_NULL_HANDLE;
+    normalDepthInfo.imageView             = m_gbuffer.normalDepth.view;
+    normalDepthInfo.imageLayout           = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkDescriptorImageInfo albedoInfo = {};
+    albedoInfo.sampler               = VK_NULL_HANDLE;
+    albedoInfo.imageView             = m_gbuffer.albedo.view;
+    albedoInfo.imageLayout           = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkDescriptorImageInfo emissionInfo = {};
+    emissionInfo.sampler               = VK_NULL_HANDLE;
+    emissionInfo.imageView             = m_gbuffer.emission.view;
+    emissionInfo.imageLayout           = VK_IMAGE_LAYOUT_GENERAL;
+
+    descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 9, {normalDepthInfo});
+    descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 10, {albedoInfo});
+    descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 18, {emissionInfo});
+
+    VkDescriptorBufferInfo lightTriangleInfo = {};
+    lightTriangleInfo.buffer                 = m_lights.triangleBuffer;
+    lightTriangleInfo.offset                 = 0;
+    lightTriangleInfo.range                  = VK_WHOLE_SIZE;
+
+    VkDescriptorBufferInfo aliasTableInfo = {};
+    aliasTableInfo.buffer                 = m_lights.aliasTableBuffer;
+    aliasTableInfo.offset                 = 0;
+    aliasTableInfo.range                  = VK_WHOLE_SIZE;
+
+    descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 11, {lightTriangleInfo});
+    descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 12, {aliasTableInfo});
+
+    VkDescriptorImageInfo environmentInfo = {};
+    environmentInfo.sampler               = m_environment.sampler;
+    environmentInfo.imageView             = m_environment.view;
+    environmentInfo.imageLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    VkDescriptorBufferInfo environmentTableInfo = {};
+    environmentTableInfo.buffer                 = m_environment.tableBuffer;
+    environmentTableInfo.offset                 = 0;
+    environmentTableInfo.range                  = VK_WHOLE_SIZE;
+
+    descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 13, {environmentInfo});
+    descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 14, {environmentTableInfo});
+
+    VkDescriptorBufferInfo rayStatisticsInfo = {};
+    rayStatisticsInfo.buffer                 = m_rayStatistics.counterBuffer;
+    rayStatisticsInfo.offset                 = 0;
+    rayStatisticsInfo.range                  = VK_WHOLE_SIZE;
+
+    descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 15, {rayStatisticsInfo});
+    descriptors.aoDSG.Bind(descriptors.ao.descriptorSet, 15, {rayStatisticsInfo});
+
+    VkDescriptorBufferInfo instanceInfo = {};
+    instanceInfo.buffer                 = geometry.getInstanceBuffer();
+    instanceInfo.offset                 = 0;
+    instanceInfo.range                  = VK_WHOLE_SIZE;
+
+    descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 16, {instanceInfo});
+    descriptors.aoDSG.Bind(descriptors.ao.descriptorSet, 16, {instanceInfo});
+
+    VkDescriptorBufferInfo textureFeedbackInfo = {};
+    textureFeedbackInfo.buffer                 = m_textureFeedback.buffer;
+    textureFeedbackInfo.offset                 = 0;
+    textureFeedbackInfo.range                  = VK_WHOLE_SIZE;
+
+    descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 17, {textureFeedbackInfo});
+
+    descriptors.ggxDSG.UpdateSetContents(m_vkctx->getDevice(), descriptors.ggx.descriptorSet);
+    descriptors.aoDSG.UpdateSetContents(m_vkctx->getDevice(), descriptors.ao.descriptorSet);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void VkRTX::bindTextureDescriptors()
+{
+    // Same order as SceneGeometry rebases the material texture ids in
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    for(const auto& model : *m_models)
+    {
+        for(const auto& texture : model.m_textures)
+        {
+            VkDescriptorImageInfo imageInfo = {};
+            imageInfo.sampler               = texture.sampler;
+            imageInfo.imageView             = texture.view;
+            imageInfo.imageLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            imageInfos.push_back(imageInfo);
+        }
+    }
+
+    if(!imageInfos.empty())
+    {
+        descriptors.ggxDSG.Bind(descriptors.ggx.descriptorSet, 6, imageInfos);
+        descriptors.aoDSG.Bind(descriptors.ao.descriptorSet, 6, imageInfos);
+    }
+}
+
+void VkRTX::updateTextureDescriptors()
+{
+    bindTextureDescriptors();
     descriptors.ggxDSG.UpdateSetContents(m_vkctx->getDevice(), descriptors.ggx.descriptorSet);
     descriptors.aoDSG.UpdateSetContents(m_vkctx->getDevice(), descriptors.ao.descriptorSet);
 }
@@ -667,7 +945,8 @@ void VkRTX::recordCommandBuffer(VkCommandBuffer cmdBuf,
                                 VkRenderPass    renderpass,
                                 VkFramebuffer   frameBuffer,
                                 VkImage         image,
-                                uint32_t        mode)
+                                uint32_t        mode,
+                                bool            cameraMoved)
 {
     //vkQueueWaitIdle(m_vkctx->getQueue()); //  TODO get rid of this, just a quick fix for vkUpdateDescriptorSets
     //updateWriteDescriptors(image);
@@ -718,49 +997,83 @@ void VkRTX::recordCommandBuffer(VkCommandBuffer cmdBuf,
     VkDeviceSize hitGroupOffset;
     VkDeviceSize hitGroupStride;
 
+    // Specialized variant of the pipeline if selectPipelineVariant found one for this mode
+    const uint32_t   pipelineMode = mode == 1 ? 1 : 0;
+    PipelineVariant* variant      = m_activeVariant;
+    if(variant && variant->mode != pipelineMode)
+    {
+        variant = nullptr;
+    }
+
+    recordRayStatisticsReset(cmdBuf);
+    recordTextureFeedbackReset(cmdBuf);
+
+    VkTools::Profiler& profiler   = m_vkctx->getProfiler();
+    uint32_t           traceScope = profiler.beginGpuScope(cmdBuf, "Trace rays");
+
     switch(mode)
     {
         // BRDF
         default:
         case 0:
+        {
+            VkPipeline           pipeline = variant ? variant->pipeline : pipelines.GGX;
+            VkPipelineLayout     layout   = variant ? variant->layout : layouts.GGX;
+            ShaderBindingTables& sbt      = variant ? variant->sbt : m_SBTs.ggx;
 
-            vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, pipelines.GGX);
+            vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, pipeline);
 
-            vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, layouts.GGX, 0,
-                                    1, &descriptors.ggx.descriptorSet, 0, nullptr);
+            vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, layout, 0, 1,
+                                    &descriptors.ggx.descriptorSet, 0, nullptr);
 
-            rayGenOffset   = m_SBTs.ggx.sbtGen.GetRayGenOffset();
-            missOffset     = m_SBTs.ggx.sbtGen.GetMissOffset();
-            missStride     = m_SBTs.ggx.sbtGen.GetMissEntrySize();
-            hitGroupOffset = m_SBTs.ggx.sbtGen.GetHitGroupOffset();
-            hitGroupStride = m_SBTs.ggx.sbtGen.GetHitGroupEntrySize();
+            rayGenOffset   = sbt.sbtGen.GetRayGenOffset();
+            missOffset     = sbt.sbtGen.GetMissOffset();
+            missStride     = sbt.sbtGen.GetMissEntrySize();
+            hitGroupOffset = sbt.sbtGen.GetHitGroupOffset();
+            hitGroupStride = sbt.sbtGen.GetHitGroupEntrySize();
 
-            vkCmdTraceRaysNV(cmdBuf, m_SBTs.ggx.sbtBuffer, rayGenOffset, m_SBTs.ggx.sbtBuffer,
-                             missOffset, missStride, m_SBTs.ggx.sbtBuffer, hitGroupOffset,
-                             hitGroupStride, VK_NULL_HANDLE, 0, 0, m_extent.width, m_extent.height,
-                             1);
+            vkCmdTraceRaysNV(cmdBuf, sbt.sbtBuffer, rayGenOffset, sbt.sbtBuffer, missOffset,
+                             missStride, sbt.sbtBuffer, hitGroupOffset, hitGroupStride,
+                             VK_NULL_HANDLE, 0, 0, m_extent.width, m_extent.height, 1);
 
 
             break;
+        }
         // Ambient occlusion
         case 1:
-            vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, pipelines.AO);
+        {
+            VkPipeline           pipeline = variant ? variant->pipeline : pipelines.AO;
+            VkPipelineLayout     layout   = variant ? variant->layout : layouts.AO;
+            ShaderBindingTables& sbt      = variant ? variant->sbt : m_SBTs.ao;
 
-            vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, layouts.AO, 0, 1,
+            vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, pipeline);
+
+            vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_RAY_TRACING_NV, layout, 0, 1,
                                     &descriptors.ao.descriptorSet, 0, nullptr);
 
-            rayGenOffset   = m_SBTs.ao.sbtGen.GetRayGenOffset();
-            missOffset     = m_SBTs.ao.sbtGen.GetMissOffset();
-            missStride     = m_SBTs.ao.sbtGen.GetMissEntrySize();
-            hitGroupOffset = m_SBTs.ao.sbtGen.GetHitGroupOffset();
-            hitGroupStride = m_SBTs.ao.sbtGen.GetHitGroupEntrySize();
+            rayGenOffset   = sbt.sbtGen.GetRayGenOffset();
+            missOffset     = sbt.sbtGen.GetMissOffset();
+            missStride     = sbt.sbtGen.GetMissEntrySize();
+            hitGroupOffset = sbt.sbtGen.GetHitGroupOffset();
+            hitGroupStride = sbt.sbtGen.GetHitGroupEntrySize();
 
-            vkCmdTraceRaysNV(cmdBuf, m_SBTs.ao.sbtBuffer, rayGenOffset, m_SBTs.ao.sbtBuffer,
-                             missOffset, missStride, m_SBTs.ao.sbtBuffer, hitGroupOffset,
-                             hitGroupStride, VK_NULL_HANDLE, 0, 0, m_extent.width, m_extent.height,
-                             1);
+            vkCmdTraceRaysNV(cmdBuf, sbt.sbtBuffer, rayGenOffset, sbt.sbtBuffer, missOffset,
+                             missStride, sbt.sbtBuffer, hitGroupOffset, hitGroupStride,
+                             VK_NULL_HANDLE, 0, 0, m_extent.width, m_extent.height, 1);
 
             break;
+        }
+    }
+
+    profiler.endGpuScope(cmdBuf, traceScope);
+
+    if(m_rayStatisticsSettings.enabled)
+    {
+        recordRayStatisticsCopy(cmdBuf, pipelineMode);
+    }
+    if(mode == 0)
+    {
+        recordTextureFeedbackCopy(cmdBuf);
     }
 
     imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
@@ -773,10 +1086,56 @@ void VkRTX::recordCommandBuffer(VkCommandBuffer cmdBuf,
                          VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1,
                          &imageMemoryBarrier);
 
+    // G-buffer is only written by the BRDF ray generation shader
+    const int32_t useDenoised = (mode == 0 && m_denoiser->m_settings.enabled) ? 1 : 0;
+    if(mode == 0)
+    {
+        uint32_t denoiseScope = profiler.beginGpuScope(cmdBuf, "Reproject and denoise", true);
+
+        VkMemoryBarrier memoryBarrier = {};
+        memoryBarrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.pNext           = nullptr;
+        memoryBarrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+        memoryBarrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+        vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV,
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0,
+                             nullptr, 0, nullptr);
+
+        // Accumulation was restarted this frame, carry the old samples over
+        if(cameraMoved && m_hasHistory && m_reprojectionSettings.enabled)
+        {
+            recordReprojection(cmdBuf);
+        }
+
+        if(useDenoised)
+        {
+            m_denoiser->recordCommandBuffer(cmdBuf);
+        }
+        else
+        {
+            m_denoiser->resetHistory();
+        }
+
+        recordHistoryCopy(cmdBuf);
+        m_hasHistory = true;
+
+        profiler.endGpuScope(cmdBuf, denoiseScope);
+    }
+    else
+    {
+        m_denoiser->resetHistory();
+        m_hasHistory = false;
+    }
+
+    uint32_t postProcessScope = profiler.beginGpuScope(cmdBuf, "Post-process", true);
     vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.compute);
     vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, layouts.compute, 0, 1,
                             &descriptors.compute.descriptorSet, 0, nullptr);
-    vkCmdDispatch(cmdBuf, m_extent.width / 16, m_extent.height / 16, 1);
+    vkCmdPushConstants(cmdBuf, layouts.compute, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(useDenoised), &useDenoised);
+    vkCmdDispatch(cmdBuf, (m_extent.width + 15) / 16, (m_extent.height + 15) / 16, 1);
+    profiler.endGpuScope(cmdBuf, postProcessScope);
 
     // Transform rendertarget layout GENERAL -> TRANSFER_SRC
     imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
@@ -805,6 +1164,68 @@ void VkRTX::recordCommandBuffer(VkCommandBuffer cmdBuf,
     vkCmdEndRenderPass(cmdBuf);
 }
 
+// ----------------------------------------------------------------------------
+//
+//
+
+void VkRTX::recordReprojection(VkCommandBuffer cmdBuf)
+{
+    const float maxSamples = m_reprojectionSettings.maxSamples;
+
+    vkCmdBindPipeline(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines.reprojection);
+    vkCmdBindDescriptorSets(cmdBuf, VK_PIPELINE_BIND_POINT_COMPUTE, layouts.reprojection, 0, 1,
+                            &descriptors.reprojection.descriptorSet, 0, nullptr);
+    vkCmdPushConstants(cmdBuf, layouts.reprojection, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(maxSamples), &maxSamples);
+    vkCmdDispatch(cmdBuf, (m_extent.width + 15) / 16, (m_extent.height + 15) / 16, 1);
+
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext           = nullptr;
+    memoryBarrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr,
+                         0, nullptr);
+}
+
+// ----------------------------------------------------------------------------
+//  Keep this frame's accumulation and guides around for reprojecting the next one
+//
+
+void VkRTX::recordHistoryCopy(VkCommandBuffer cmdBuf)
+{
+    VkMemoryBarrier memoryBarrier = {};
+    memoryBarrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memoryBarrier.pNext           = nullptr;
+    memoryBarrier.srcAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    memoryBarrier.dstAccessMask   = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0,
+                         nullptr);
+
+    VkImageCopy region    = {};
+    region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.srcOffset      = {0, 0, 0};
+    region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.dstOffset      = {0, 0, 0};
+    region.extent         = {m_extent.width, m_extent.height, 1};
+
+    vkCmdCopyImage(cmdBuf, m_gbuffer.normalDepth.image, VK_IMAGE_LAYOUT_GENERAL,
+                   m_gbuffer.prevNormalDepth.image, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+    vkCmdCopyImage(cmdBuf, m_rtRenderTarget.image, VK_IMAGE_LAYOUT_GENERAL,
+                   m_prevAccumulation.image, VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+    memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0,
+                         nullptr);
+}
+
 void VkRTX::generateNewScrambles()
 {
 
@@ -822,6 +1243,11 @@ void VkRTX::generateNewScrambles()
         std::uniform_int_distribution<uint32_t> uintDist;
         auto&                                   layer = scrambles[dim];
 
+        if(m_scrambleSeed != 0)
+        {
+            gen.seed(m_scrambleSeed * uint32_t(m_numLayers) + uint32_t(dim));
+        }
+
         for(size_t i = 0; i < layer.size(); ++i)
         {
             layer[i] = uintDist(gen);
@@ -931,6 +1357,41 @@ void VkRTX::cleanUp()
         vkDestroyPipeline(m_vkctx->getDevice(), pipelines.compute, nullptr);
     }
 
+    // Denoiser resources
+    if(m_denoiser)
+    {
+        m_denoiser->cleanUp();
+    }
+    VkTools::destroyStorageImage(m_vkctx->getDevice(), m_vkctx->getAllocator(),
+                                 &m_gbuffer.normalDepth);
+    VkTools::destroyStorageImage(m_vkctx->getDevice(), m_vkctx->getAllocator(),
+                                 &m_gbuffer.prevNormalDepth);
+    VkTools::destroyStorageImage(m_vkctx->getDevice(), m_vkctx->getAllocator(),
+                                 &m_gbuffer.albedo);
+    VkTools::destroyStorageImage(m_vkctx->getDevice(), m_vkctx->getAllocator(),
+                                 &m_gbuffer.emission);
+
+    // Reprojection resources
+    if(descriptors.reprojection.descriptorSetLayout != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(m_vkctx->getDevice(),
+                                     descriptors.reprojection.descriptorSetLayout, nullptr);
+    }
+    if(descriptors.reprojection.descriptorPool != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorPool(m_vkctx->getDevice(), descriptors.reprojection.descriptorPool,
+                                nullptr);
+    }
+    if(layouts.reprojection != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(m_vkctx->getDevice(), layouts.reprojection, nullptr);
+    }
+    if(pipelines.reprojection != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(m_vkctx->getDevice(), pipelines.reprojection, nullptr);
+    }
+    VkTools::destroyStorageImage(m_vkctx->getDevice(), m_vkctx->getAllocator(),
+                                 &m_prevAccumulation);
 
     // Sobol resources
     if(m_sobol.sampler != VK_NULL_HANDLE)
@@ -954,6 +1415,60 @@ void VkRTX::cleanUp()
         vmaDestroyBuffer(m_vkctx->getAllocator(), m_sobol.hostSideBuffer, m_sobol.hostsideMemory);
     }
 
+    // Light resources
+    if(m_lights.triangleBuffer != VK_NULL_HANDLE)
+    {
+        vmaDestroyBuffer(m_vkctx->getAllocator(), m_lights.triangleBuffer, m_lights.triangleMemory);
+    }
+    if(m_lights.aliasTableBuffer != VK_NULL_HANDLE)
+    {
+        vmaDestroyBuffer(m_vkctx->getAllocator(), m_lights.aliasTableBuffer,
+                         m_lights.aliasTableMemory);
+    }
+
+    // Environment resources
+    if(m_environment.sampler != VK_NULL_HANDLE)
+    {
+        vkDestroySampler(m_vkctx->getDevice(), m_environment.sampler, nullptr);
+    }
+    if(m_environment.view != VK_NULL_HANDLE)
+    {
+        vkDestroyImageView(m_vkctx->getDevice(), m_environment.view, nullptr);
+    }
+    if(m_environment.image != VK_NULL_HANDLE)
+    {
+        vmaDestroyImage(m_vkctx->getAllocator(), m_environment.image, m_environment.memory);
+    }
+    if(m_environment.tableBuffer != VK_NULL_HANDLE)
+    {
+        vmaDestroyBuffer(m_vkctx->getAllocator(), m_environment.tableBuffer,
+                         m_environment.tableMemory);
+    }
+
+    // Ray statistics
+    if(m_rayStatistics.counterBuffer != VK_NULL_HANDLE)
+    {
+        vmaDestroyBuffer(m_vkctx->getAllocator(), m_rayStatistics.counterBuffer,
+                         m_rayStatistics.counterMemory);
+    }
+    for(auto& readback : m_rayStatistics.readback)
+    {
+        vmaDestroyBuffer(m_vkctx->getAllocator(), readback.buffer, readback.memory);
+    }
+    m_rayStatistics.readback.clear();
+
+    // Texture feedback
+    if(m_textureFeedback.buffer != VK_NULL_HANDLE)
+    {
+        vmaDestroyBuffer(m_vkctx->getAllocator(), m_textureFeedback.buffer,
+                         m_textureFeedback.memory);
+    }
+    for(auto& readback : m_textureFeedback.readback)
+    {
+        vmaDestroyBuffer(m_vkctx->getAllocator(), readback.buffer, readback.memory);
+    }
+    m_textureFeedback.readback.clear();
+
     // RTX resources
     destroyAccelerationStructures(m_topLevelAS);
 
@@ -994,22 +1509,18 @@ void VkRTX::cleanUp()
     {
         vkDestroyPipeline(m_vkctx->getDevice(), pipelines.AO, nullptr);
     }
-    if(m_SBTs.ggx.sbtBuffer != VK_NULL_HANDLE)
-    {
-        vkDestroyBuffer(m_vkctx->getDevice(), m_SBTs.ggx.sbtBuffer, nullptr);
-    }
-    if(m_SBTs.ggx.sbtMemory != VK_NULL_HANDLE)
-    {
-        vkFreeMemory(m_vkctx->getDevice(), m_SBTs.ggx.sbtMemory, nullptr);
-    }
-    if(m_SBTs.ao.sbtBuffer != VK_NULL_HANDLE)
-    {
-        vkDestroyBuffer(m_vkctx->getDevice(), m_SBTs.ao.sbtBuffer, nullptr);
-    }
-    if(m_SBTs.ao.sbtMemory != VK_NULL_HANDLE)
+    destroyShaderBindingTable(&m_SBTs.ggx);
+    destroyShaderBindingTable(&m_SBTs.ao);
+
+    for(auto& entry : m_variants)
     {
-        vkFreeMemory(m_vkctx->getDevice(), m_SBTs.ao.sbtMemory, nullptr);
+        PipelineVariant& variant = entry.second;
+        vkDestroyPipeline(m_vkctx->getDevice(), variant.pipeline, nullptr);
+        vkDestroyPipelineLayout(m_vkctx->getDevice(), variant.layout, nullptr);
+        destroyShaderBindingTable(&variant.sbt);
     }
+    m_variants.clear();
+    m_activeVariant = nullptr;
 
     if(descriptors.ggx.descriptorSetLayout != VK_NULL_HANDLE)
     {
@@ -1104,56 +1615,502 @@ void VkRTX::copySobolMatricesToGPU()
 
     uint32_t numMatrices = sobol::Matrices::size * sobol::Matrices::num_dimensions;
 
-    //std::vector<uint32_t> buffer(numMatrices);
-
-    VkBuffer      stagingBuffer;
-    VmaAllocation stagingMemory;
-
     VkDeviceSize bufferSizeInBytes = numMatrices * sizeof(uint32_t);
 
-    VkTools::createBuffer(m_vkctx->getAllocator(), bufferSizeInBytes,
-                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,
-                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-                              | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                          &stagingBuffer, &stagingMemory);
-
-    uint8_t* data;
-    vmaMapMemory(m_vkctx->getAllocator(), stagingMemory, (void**)&data);
-    memcpy(data, &sobol::Matrices::matrices, bufferSizeInBytes);
-    vmaUnmapMemory(m_vkctx->getAllocator(), stagingMemory);
-
     VkTools::createBuffer(m_vkctx->getAllocator(), bufferSizeInBytes,
                           VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                           VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                           &m_sobol.matrixBuffer, &m_sobol.matrixMemory);
 
+    m_vkctx->getStagingArena()->uploadBuffer(m_sobol.matrixBuffer, &sobol::Matrices::matrices,
+                                             bufferSizeInBytes);
+    m_vkctx->getStagingArena()->submit();
+}
+
+// ----------------------------------------------------------------------------
+//  Light list for next event estimation on emissive geometry of all models, primitive ids
+//  rebased like the hits. Layouts match EmissiveTriangles and LightAliasTable in pathRT.rgen.
+//
+
+void VkRTX::createLightBuffers()
+{
+    const auto& ranges = m_vkctx->getSceneGeometry().getRanges();
+
+    std::vector<rtutils::EmissiveTriangle> emissive;
+    for(size_t i = 0; i < m_models->size(); ++i)
+    {
+        for(rtutils::EmissiveTriangle triangle : (*m_models)[i].m_emissiveTriangles)
+        {
+            triangle.primitiveID += ranges[i].firstIndex / 3;
+            emissive.push_back(triangle);
+        }
+    }
+
+    rtutils::LightSampler sampler;
+    sampler.build(emissive);
+
+    const auto& triangles = sampler.triangles();
+    const auto& table     = sampler.aliasTable();
+    m_lights.numLights    = static_cast<uint32_t>(triangles.size());
+
+    // Three vec4 per triangle, positions in xyz and the emission in w
+    std::vector<glm::vec4> triangleData(3 * std::max<size_t>(triangles.size(), 1),
+                                        glm::vec4(0.0f));
+    for(size_t i = 0; i < triangles.size(); ++i)
+    {
+        const auto& t           = triangles[i];
+        triangleData[3 * i + 0] = glm::vec4(t.p0, t.emission.r);
+        triangleData[3 * i + 1] = glm::vec4(t.p1, t.emission.g);
+        triangleData[3 * i + 2] = glm::vec4(t.p2, t.emission.b);
+    }
+
+    struct AliasTableHeader
+    {
+        uint32_t numLights;
+        float    totalWeight;
+        uint32_t pad0;
+        uint32_t pad1;
+    };
+    static_assert(sizeof(AliasTableHeader) == sizeof(rtutils::AliasTable::Entry),
+                  "Alias table header must keep the entries 16 byte aligned");
+
+    // Header and entries packed as bytes, an empty table gets one default entry
+    std::vector<rtutils::AliasTable::Entry> entries = table.entries();
+    if(entries.empty())
+    {
+        entries.emplace_back();
+    }
+    const AliasTableHeader header = {m_lights.numLights, table.totalWeight(), 0, 0};
+    std::vector<uint8_t>   tableData(sizeof(header) + entries.size() * sizeof(entries[0]));
+    memcpy(tableData.data(), &header, sizeof(header));
+    memcpy(tableData.data() + sizeof(header), entries.data(), entries.size() * sizeof(entries[0]));
+
+    createDeviceBuffer(triangleData.data(), triangleData.size() * sizeof(glm::vec4),
+                       &m_lights.triangleBuffer, &m_lights.triangleMemory);
+    createDeviceBuffer(tableData.data(), tableData.size(), &m_lights.aliasTableBuffer,
+                       &m_lights.aliasTableMemory);
+}
+
+// ----------------------------------------------------------------------------
+//  Without an environment map a black 1x1 texture is bound and the table header has width 0,
+//  pathRT.rgen then keeps its old miss color for camera rays
+//
+
+void VkRTX::createEnvironmentResources()
+{
+    const rtutils::EnvironmentMap* environment = m_vkctx->getEnvironmentMap();
+    const bool hasEnvironment = environment != nullptr && !environment->empty();
+
+    const uint32_t width  = hasEnvironment ? environment->width() : 1;
+    const uint32_t height = hasEnvironment ? environment->height() : 1;
+
+    std::vector<uint64_t> texels(size_t(width) * height, 0);
+    if(hasEnvironment)
+    {
+        const auto& source = environment->texels();
+#pragma omp parallel for
+        for(int64_t i = 0; i < int64_t(texels.size()); ++i)
+        {
+            texels[i] = glm::packHalf4x16(glm::vec4(source[i], 1.0f));
+        }
+    }
+
+    VkTools::createTextureImage(m_vkctx->getAllocator(), m_vkctx->getStagingArena(),
+                                reinterpret_cast<const uint8_t*>(texels.data()), width, height,
+                                &m_environment.image, &m_environment.memory,
+                                VK_FORMAT_R16G16B16A16_SFLOAT, sizeof(uint64_t));
+    m_environment.view =
+        VkTools::createImageView(m_vkctx->getDevice(), m_environment.image,
+                                 VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT);
+    VkTools::createTextureSampler(m_vkctx->getDevice(), &m_environment.sampler);
+
+    // Header, marginal CDF, conditional CDFs. The header is 16 bytes like the light alias table.
+    struct EnvironmentTableHeader
+    {
+        uint32_t width;
+        uint32_t height;
+        float    integral;
+        float    pad;
+    };
+
+    std::vector<float> tableData(sizeof(EnvironmentTableHeader) / sizeof(float), 0.0f);
+    if(hasEnvironment)
+    {
+        const EnvironmentTableHeader header = {width, height, environment->integral(), 0.0f};
+        memcpy(tableData.data(), &header, sizeof(header));
+
+        tableData.insert(tableData.end(), environment->marginalCdf().begin(),
+                         environment->marginalCdf().end());
+        tableData.insert(tableData.end(), environment->conditionalCdf().begin(),
+                         environment->conditionalCdf().end());
+    }
+    else
+    {
+        tableData.push_back(0.0f);
+    }
+
+    createDeviceBuffer(tableData.data(), tableData.size() * sizeof(float),
+                       &m_environment.tableBuffer, &m_environment.tableMemory);
+}
+
+// ----------------------------------------------------------------------------
+//  Counters start out disabled, recordCommandBuffer rewrites them every frame
+//
+
+void VkRTX::createRayStatisticsBuffer()
+{
+    const RayStatisticsCounters counters = {};
+    createDeviceBuffer(&counters, sizeof(counters), &m_rayStatistics.counterBuffer,
+                       &m_rayStatistics.counterMemory);
+}
+
+void VkRTX::recordRayStatisticsReset(VkCommandBuffer cmdBuf)
+{
+    RayStatisticsCounters counters = {};
+    counters.enabled               = m_rayStatisticsSettings.enabled ? 1 : 0;
+
+    // The previous frame may still be tracing or copying the counters
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext           = nullptr;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV
+                             | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdUpdateBuffer(cmdBuf, m_rayStatistics.counterBuffer, 0, sizeof(counters), &counters);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV, 0, 1, &barrier, 0, nullptr,
+                         0, nullptr);
+}
+
+void VkRTX::recordRayStatisticsCopy(VkCommandBuffer cmdBuf, uint32_t mode)
+{
+    if(m_rayStatistics.currentSlot >= m_rayStatistics.readback.size())
+    {
+        return;
+    }
+    RayStatisticsReadback& readback = m_rayStatistics.readback[m_rayStatistics.currentSlot];
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext           = nullptr;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_TRANSFER_READ_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy copyRegion = {};
+    copyRegion.size         = sizeof(RayStatisticsCounters);
+    vkCmdCopyBuffer(cmdBuf, m_rayStatistics.counterBuffer, readback.buffer, 1, &copyRegion);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+
+    readback.written = true;
+    readback.mode    = mode;
+}
+
+// ----------------------------------------------------------------------------
+//  Readback buffers are created on first use of a frame slot
+//
+
+void VkRTX::resolveRayStatistics(uint32_t frameSlot)
+{
+    while(m_rayStatistics.readback.size() <= frameSlot)
+    {
+        RayStatisticsReadback readback;
+        VkTools::createBuffer(m_vkctx->getAllocator(), sizeof(RayStatisticsCounters),
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                  | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &readback.buffer, &readback.memory);
+        m_rayStatistics.readback.push_back(readback);
+    }
+    m_rayStatistics.currentSlot = frameSlot;
+
+    RayStatisticsReadback& readback = m_rayStatistics.readback[frameSlot];
+    if(!readback.written)
+    {
+        return;
+    }
+    readback.written = false;
+
+    RayStatisticsCounters counters;
+    void*                 mapped;
+    vmaMapMemory(m_vkctx->getAllocator(), readback.memory, &mapped);
+    memcpy(&counters, mapped, sizeof(counters));
+    vmaUnmapMemory(m_vkctx->getAllocator(), readback.memory);
+
+    RayStatisticsFrame& frame = m_rayStatistics.last;
+    frame.rays.primary        = counters.primary;
+    frame.rays.extension      = counters.extension;
+    frame.rays.shadow         = counters.shadow;
+    for(int i = 0; i < rtutils::RayStatistics::kMaxDepth; ++i)
+    {
+        frame.rays.pathLength[i] = counters.pathLength[i];
+    }
+    frame.mode    = readback.mode;
+    frame.traceMs = m_vkctx->getProfiler().lastGpuDurationMs("Trace rays");
+    frame.frames += 1;
+}
+
+// ----------------------------------------------------------------------------
+//  Sized for the textures bound at initRaytracing, streamed textures only replace images
+//
+
+void VkRTX::createTextureFeedbackBuffer()
+{
+    for(const auto& model : *m_models)
+    {
+        m_textureFeedback.textureCount += static_cast<uint32_t>(model.m_textures.size());
+    }
+    const std::vector<uint32_t> requested(std::max(m_textureFeedback.textureCount, 1u), 0);
+    createDeviceBuffer(requested.data(), requested.size() * sizeof(uint32_t),
+                       &m_textureFeedback.buffer, &m_textureFeedback.memory);
+}
+
+void VkRTX::recordTextureFeedbackReset(VkCommandBuffer cmdBuf)
+{
+    // The previous frame may still be tracing or copying the feedback
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext           = nullptr;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV
+                             | VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdFillBuffer(cmdBuf, m_textureFeedback.buffer, 0, VK_WHOLE_SIZE, 0);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV, 0, 1, &barrier, 0, nullptr,
+                         0, nullptr);
+}
+
+void VkRTX::recordTextureFeedbackCopy(VkCommandBuffer cmdBuf)
+{
+    if(m_textureFeedback.currentSlot >= m_textureFeedback.readback.size())
+    {
+        return;
+    }
+    TextureFeedbackReadback& readback = m_textureFeedback.readback[m_textureFeedback.currentSlot];
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext           = nullptr;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_TRANSFER_READ_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_NV,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy copyRegion = {};
+    copyRegion.size         = m_textureFeedback.textureCount * sizeof(uint32_t);
+    vkCmdCopyBuffer(cmdBuf, m_textureFeedback.buffer, readback.buffer, 1, &copyRegion);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1,
+                         &barrier, 0, nullptr, 0, nullptr);
+
+    readback.written = true;
+}
+
+void VkRTX::resolveTextureFeedback(uint32_t frameSlot)
+{
+    if(m_textureFeedback.textureCount == 0)
+    {
+        return;
+    }
+    while(m_textureFeedback.readback.size() <= frameSlot)
+    {
+        TextureFeedbackReadback readback;
+        VkTools::createBuffer(m_vkctx->getAllocator(),
+                              m_textureFeedback.textureCount * sizeof(uint32_t),
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                  | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &readback.buffer, &readback.memory);
+        m_textureFeedback.readback.push_back(readback);
+    }
+    m_textureFeedback.currentSlot = frameSlot;
+
+    TextureFeedbackReadback& readback = m_textureFeedback.readback[frameSlot];
+    if(!readback.written)
+    {
+        return;
+    }
+    readback.written = false;
+
+    std::vector<uint32_t>& requested = m_textureFeedback.requested;
+    requested.resize(m_textureFeedback.textureCount, 0);
+
+    void* mapped;
+    vmaMapMemory(m_vkctx->getAllocator(), readback.memory, &mapped);
+    const uint32_t* sizes = static_cast<const uint32_t*>(mapped);
+    for(uint32_t i = 0; i < m_textureFeedback.textureCount; ++i)
+    {
+        requested[i] = std::max(requested[i], sizes[i]);
+    }
+    vmaUnmapMemory(m_vkctx->getAllocator(), readback.memory);
+}
+
+std::vector<uint32_t> VkRTX::takeTextureFeedback()
+{
+    std::vector<uint32_t> requested;
+    requested.swap(m_textureFeedback.requested);
+    return requested;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+rtutils::Image4f VkRTX::readAccumulation()
+{
+    const bool   halfFloat  = m_rtRenderTarget.format == VK_FORMAT_R16G16B16A16_SFLOAT;
+    const size_t pixelCount = size_t(m_extent.width) * m_extent.height;
+    const size_t pixelSize  = halfFloat ? 4 * sizeof(uint16_t) : sizeof(glm::vec4);
+    const VkDeviceSize size = pixelCount * pixelSize;
+
+    VkBuffer      buffer;
+    VmaAllocation memory;
+    VkTools::createBuffer(m_vkctx->getAllocator(), size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VMA_MEMORY_USAGE_GPU_TO_CPU,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                              | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          &buffer, &memory);
 
     VkCommandBuffer cmdBuf =
         VkTools::beginRecordingCommandBuffer(m_vkctx->getDevice(), m_vkctx->getCommandPool());
 
-    VkBufferCopy copyRegion = {};
-    copyRegion.size         = bufferSizeInBytes;
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 
-    vkCmdCopyBuffer(cmdBuf, stagingBuffer, m_sobol.matrixBuffer, 1, &copyRegion);
+    VkBufferImageCopy region = {};
+    region.imageSubresource  = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent       = {m_extent.width, m_extent.height, 1};
+    vkCmdCopyImageToBuffer(cmdBuf, m_rtRenderTarget.image, VK_IMAGE_LAYOUT_GENERAL, buffer, 1,
+                           &region);
 
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+                         1, &barrier, 0, nullptr, 0, nullptr);
 
     VkTools::flushCommandBuffer(m_vkctx->getDevice(), m_vkctx->getQueue(),
                                 m_vkctx->getCommandPool(), cmdBuf);
 
-    vmaDestroyBuffer(m_vkctx->getAllocator(), stagingBuffer, stagingMemory);
+    rtutils::Image4f accumulation(m_extent.width, m_extent.height);
+    void*            mapped;
+    vmaMapMemory(m_vkctx->getAllocator(), memory, &mapped);
+    if(halfFloat)
+    {
+        const uint64_t* texels = static_cast<const uint64_t*>(mapped);
+        for(size_t i = 0; i < pixelCount; ++i)
+        {
+            accumulation.pixels[i] = glm::unpackHalf4x16(texels[i]);
+        }
+    }
+    else
+    {
+        memcpy(accumulation.pixels.data(), mapped, size);
+    }
+    vmaUnmapMemory(m_vkctx->getAllocator(), memory);
+    vmaDestroyBuffer(m_vkctx->getAllocator(), buffer, memory);
+
+    return accumulation;
 }
 
 // ----------------------------------------------------------------------------
 //
 //
 
-void VkRTX::createRaytracingPipelineCookTorrance()
+void VkRTX::uploadAccumulation(const std::vector<char>& texels)
+{
+    VkTools::StagingArena*                  staging    = m_vkctx->getStagingArena();
+    const VkTools::StagingArena::Allocation allocation = staging->allocate(texels.size());
+    memcpy(allocation.data, texels.data(), texels.size());
+
+    VkCommandBuffer cmdBuf = staging->commands();
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask   = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferImageCopy region = {};
+    region.bufferOffset      = allocation.offset;
+    region.imageSubresource  = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent       = {m_extent.width, m_extent.height, 1};
+    vkCmdCopyBufferToImage(cmdBuf, allocation.buffer, m_rtRenderTarget.image,
+                           VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+
+    staging->submit();
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void VkRTX::createDeviceBuffer(const void*    data,
+                               VkDeviceSize   size,
+                               VkBuffer*      buffer,
+                               VmaAllocation* memory)
+{
+    VkTools::createBuffer(m_vkctx->getAllocator(), size,
+                          VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                          VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer,
+                          memory);
+
+    m_vkctx->getStagingArena()->uploadBuffer(*buffer, data, size);
+    m_vkctx->getStagingArena()->submit();
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void VkRTX::createRaytracingPipelineCookTorrance(const VkSpecializationInfo* specialization,
+                                                 VkPipeline*                 pipeline,
+                                                 VkPipelineLayout*           layout)
 {
     RayTracingPipelineGenerator pipelineGen;
 
     VkShaderModule rayGenModule =
         VkTools::createShaderModule("../../shaders/spirv/pathRT.rgen.spv", m_vkctx->getDevice());
-    m_indices.ggx.rayGenIndex = pipelineGen.AddRayGenShaderStage(rayGenModule);
+    m_indices.ggx.rayGenIndex = pipelineGen.AddRayGenShaderStage(rayGenModule, specialization);
 
     VkShaderModule missModule =
         VkTools::createShaderModule("../../shaders/spirv/pathRT.rmiss.spv", m_vkctx->getDevice());
@@ -1186,8 +2143,10 @@ void VkRTX::createRaytracingPipelineCookTorrance()
 
     pipelineGen.SetMaxRecursionDepth(2);
 
-    pipelineGen.Generate(m_vkctx->getDevice(), descriptors.ggx.descriptorSetLayout, &pipelines.GGX,
-                         &layouts.GGX);
+    auto& pipelineCache = m_vkctx->getPipelineCache();
+    auto  timing        = pipelineCache.measure();
+    pipelineGen.Generate(m_vkctx->getDevice(), descriptors.ggx.descriptorSetLayout, pipeline,
+                         layout, pipelineCache.get());
 
     vkDestroyShaderModule(m_vkctx->getDevice(), rayGenModule, nullptr);
     vkDestroyShaderModule(m_vkctx->getDevice(), missModule, nullptr);
@@ -1201,52 +2160,63 @@ void VkRTX::createRaytracingPipelineCookTorrance()
 //
 //
 
-void VkRTX::createShaderBindingTableCookTorrance()
+void VkRTX::createShaderBindingTableCookTorrance(VkPipeline pipeline, ShaderBindingTables* sbt)
 {
-    m_SBTs.ggx.sbtGen.AddRayGenerationProgram(m_indices.ggx.rayGenIndex, {});
-    m_SBTs.ggx.sbtGen.AddMissProgram(m_indices.ggx.missIndex, {});
-    m_SBTs.ggx.sbtGen.AddMissProgram(m_indices.ggx.shadowMissIndex, {});
-    m_SBTs.ggx.sbtGen.AddHitGroup(m_indices.ggx.hitGroupIndex, {});
-    m_SBTs.ggx.sbtGen.AddHitGroup(m_indices.ggx.shadowHitGroupIndex, {});
+    sbt->sbtGen.AddRayGenerationProgram(m_indices.ggx.rayGenIndex, {});
+    sbt->sbtGen.AddMissProgram(m_indices.ggx.missIndex, {});
+    sbt->sbtGen.AddMissProgram(m_indices.ggx.shadowMissIndex, {});
+    sbt->sbtGen.AddHitGroup(m_indices.ggx.hitGroupIndex, {});
+    sbt->sbtGen.AddHitGroup(m_indices.ggx.shadowHitGroupIndex, {});
 
-    VkDeviceSize shaderBindingTableSize =
-        m_SBTs.ggx.sbtGen.ComputeSBTSize(m_raytracingProperties) + 4;
+    VkDeviceSize shaderBindingTableSize = sbt->sbtGen.ComputeSBTSize(m_raytracingProperties) + 4;
 
     VkTools::createBufferNoVMA(m_vkctx->getDevice(), m_vkctx->getPhysicalDevice(),
                                shaderBindingTableSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &m_SBTs.ggx.sbtBuffer,
-                               &m_SBTs.ggx.sbtMemory);
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &sbt->sbtBuffer,
+                               &sbt->sbtMemory);
 
-    m_SBTs.ggx.sbtGen.Generate(m_vkctx->getDevice(), pipelines.GGX, m_SBTs.ggx.sbtBuffer,
-                               m_SBTs.ggx.sbtMemory);
+    sbt->sbtGen.Generate(m_vkctx->getDevice(), pipeline, sbt->sbtBuffer, sbt->sbtMemory);
 }
 
-void VkRTX::createShaderBindingTableAmbientOcclusion()
+void VkRTX::createShaderBindingTableAmbientOcclusion(VkPipeline pipeline, ShaderBindingTables* sbt)
 {
 
-    m_SBTs.ao.sbtGen.AddRayGenerationProgram(m_indices.ao.rayGenIndex, {});
-    m_SBTs.ao.sbtGen.AddMissProgram(m_indices.ao.missIndex, {});
-    m_SBTs.ao.sbtGen.AddMissProgram(m_indices.ao.shadowMissIndex, {});
-    m_SBTs.ao.sbtGen.AddHitGroup(m_indices.ao.hitGroupIndex, {});
-    m_SBTs.ao.sbtGen.AddHitGroup(m_indices.ao.shadowHitGroupIndex, {});
+    sbt->sbtGen.AddRayGenerationProgram(m_indices.ao.rayGenIndex, {});
+    sbt->sbtGen.AddMissProgram(m_indices.ao.missIndex, {});
+    sbt->sbtGen.AddMissProgram(m_indices.ao.shadowMissIndex, {});
+    sbt->sbtGen.AddHitGroup(m_indices.ao.hitGroupIndex, {});
+    sbt->sbtGen.AddHitGroup(m_indices.ao.shadowHitGroupIndex, {});
 
-    VkDeviceSize shaderBindingTableSize = m_SBTs.ao.sbtGen.ComputeSBTSize(m_raytracingProperties);
+    VkDeviceSize shaderBindingTableSize = sbt->sbtGen.ComputeSBTSize(m_raytracingProperties);
 
     VkTools::createBufferNoVMA(m_vkctx->getDevice(), m_vkctx->getPhysicalDevice(),
                                shaderBindingTableSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &m_SBTs.ao.sbtBuffer,
-                               &m_SBTs.ao.sbtMemory);
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &sbt->sbtBuffer,
+                               &sbt->sbtMemory);
 
-    m_SBTs.ao.sbtGen.Generate(m_vkctx->getDevice(), pipelines.AO, m_SBTs.ao.sbtBuffer,
-                              m_SBTs.ao.sbtMemory);
+    sbt->sbtGen.Generate(m_vkctx->getDevice(), pipeline, sbt->sbtBuffer, sbt->sbtMemory);
+}
+
+void VkRTX::destroyShaderBindingTable(ShaderBindingTables* sbt)
+{
+    if(sbt->sbtBuffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(m_vkctx->getDevice(), sbt->sbtBuffer, nullptr);
+    }
+    if(sbt->sbtMemory != VK_NULL_HANDLE)
+    {
+        vkFreeMemory(m_vkctx->getDevice(), sbt->sbtMemory, nullptr);
+    }
 }
-void VkRTX::createRaytracingPipelineAmbientOcclusion()
+void VkRTX::createRaytracingPipelineAmbientOcclusion(const VkSpecializationInfo* specialization,
+                                                     VkPipeline*                 pipeline,
+                                                     VkPipelineLayout*           layout)
 {
     RayTracingPipelineGenerator pipelineGen;
 
     VkShaderModule rayGenModule =
         VkTools::createShaderModule("../../shaders/spirv/AO.rgen.spv", m_vkctx->getDevice());
-    m_indices.ao.rayGenIndex = pipelineGen.AddRayGenShaderStage(rayGenModule);
+    m_indices.ao.rayGenIndex = pipelineGen.AddRayGenShaderStage(rayGenModule, specialization);
 
     VkShaderModule missModule =
         VkTools::createShaderModule("../../shaders/spirv/AO.rmiss.spv", m_vkctx->getDevice());
@@ -1272,11 +2242,100 @@ void VkRTX::createRaytracingPipelineAmbientOcclusion()
 
     pipelineGen.SetMaxRecursionDepth(2);
 
-    pipelineGen.Generate(m_vkctx->getDevice(), descriptors.ao.descriptorSetLayout, &pipelines.AO,
-                         &layouts.AO);
+    auto& pipelineCache = m_vkctx->getPipelineCache();
+    auto  timing        = pipelineCache.measure();
+    pipelineGen.Generate(m_vkctx->getDevice(), descriptors.ao.descriptorSetLayout, pipeline, layout,
+                         pipelineCache.get());
 
     vkDestroyShaderModule(m_vkctx->getDevice(), rayGenModule, nullptr);
     vkDestroyShaderModule(m_vkctx->getDevice(), missModule, nullptr);
     vkDestroyShaderModule(m_vkctx->getDevice(), missShadowModule, nullptr);
     vkDestroyShaderModule(m_vkctx->getDevice(), closestHitModule, nullptr);
 }
+
+// ----------------------------------------------------------------------------
+//  Constant i of the rgen shader gets constants[i], see the constant_id layouts in pathRT.rgen
+//  and AO.rgen
+//
+
+VkRTX::PipelineVariant VkRTX::createPipelineVariant(uint32_t                    mode,
+                                                    const std::vector<int32_t>& constants)
+{
+    std::vector<VkSpecializationMapEntry> entries(constants.size());
+    for(uint32_t i = 0; i < entries.size(); ++i)
+    {
+        entries[i].constantID = i;
+        entries[i].offset     = i * sizeof(int32_t);
+        entries[i].size       = sizeof(int32_t);
+    }
+
+    VkSpecializationInfo specialization = {};
+    specialization.mapEntryCount        = static_cast<uint32_t>(entries.size());
+    specialization.pMapEntries          = entries.data();
+    specialization.dataSize             = constants.size() * sizeof(int32_t);
+    specialization.pData                = constants.data();
+
+    PipelineVariant variant;
+    variant.mode = mode;
+    if(mode == 1)
+    {
+        createRaytracingPipelineAmbientOcclusion(&specialization, &variant.pipeline,
+                                                 &variant.layout);
+        createShaderBindingTableAmbientOcclusion(variant.pipeline, &variant.sbt);
+    }
+    else
+    {
+        createRaytracingPipelineCookTorrance(&specialization, &variant.pipeline, &variant.layout);
+        createShaderBindingTableCookTorrance(variant.pipeline, &variant.sbt);
+    }
+    return variant;
+}
+
+// ----------------------------------------------------------------------------
+//  Sliders sweep through many configurations, so a variant is only compiled once its
+//  configuration has been used for stableFrames frames. Until then, or when maxVariants are
+//  already cached, the generic pipeline runs with the values from the UBO.
+//
+
+void VkRTX::selectPipelineVariant(uint32_t mode, int indirectBounces, int aaRays, int aoRays)
+{
+    m_activeVariant = nullptr;
+    if(!m_variantSettings.enabled)
+    {
+        return;
+    }
+
+    const uint32_t             pipelineMode = mode == 1 ? 1 : 0;
+    const std::vector<int32_t> constants =
+        pipelineMode == 1 ? std::vector<int32_t>{aoRays}
+                          : std::vector<int32_t>{indirectBounces, aaRays};
+
+    uint64_t key = uint64_t(pipelineMode) << 48;
+    for(size_t i = 0; i < constants.size(); ++i)
+    {
+        key |= uint64_t(uint16_t(constants[i])) << (16 * i);
+    }
+
+    auto it = m_variants.find(key);
+    if(it != m_variants.end())
+    {
+        m_activeVariant = &it->second;
+        return;
+    }
+
+    m_pendingVariant.frames = key == m_pendingVariant.key ? m_pendingVariant.frames + 1 : 0;
+    m_pendingVariant.key    = key;
+    if(m_pendingVariant.frames < m_variantSettings.stableFrames
+       || int(m_variants.size()) >= m_variantSettings.maxVariants)
+    {
+        return;
+    }
+
+    auto start      = std::chrono::high_resolution_clock::now();
+    m_activeVariant = &(m_variants[key] = createPipelineVariant(pipelineMode, constants));
+    auto end        = std::chrono::high_resolution_clock::now();
+
+    spdlog::info("Compiled specialized {} pipeline ({} cached) in {:.2f} ms",
+                 pipelineMode == 1 ? "AO" : "GGX", m_variants.size(),
+                 std::chrono::duration<double, std::milli>(end - start).count());
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <map>
+#include <memory>
 #include <vector>
 #include <vulkan/vulkan.h>
 
@@ -10,6 +12,9 @@
 #include <NVIDIA_RTX/vkRT_TLAS.h>
 
 #include "Model.h"
+#include "Reprojection.h"
+#include "rtutils.h"
+#include "vkDenoiser.h"
 
 using namespace VkTools;
 
@@ -29,16 +34,85 @@ class VkRTX
                         VmaAllocation*      uniformMemory);
     void updateRaytracingRenderTarget(VkImageView target);
     void updateWriteDescriptors(VkImageView resultView);
+
+    // Rewrites the texture array from the texture slots of the model, e.g. after AssetStreamer
+    // swapped images in. The descriptor sets must not be in use.
+    void updateTextureDescriptors();
     void recordCommandBuffer(VkCommandBuffer cmdBuf,
                              VkRenderPass    renderpass,
                              VkFramebuffer   frameBuffer,
                              VkImage         image,
-                             uint32_t        mode);
+                             uint32_t        mode,
+                             bool            cameraMoved);
 
     void generateNewScrambles();
     void updateScrambleValueImage();
     void cleanUp();
 
+    // Seeds the Sobol scrambles so runs are repeatable, call before initRaytracing. Zero draws
+    // them from std::random_device.
+    void setScrambleSeed(uint32_t seed) { m_scrambleSeed = seed; }
+
+    // Wall time of the bottom and top level builds in initRaytracing, including the GPU work
+    double getAccelerationStructureBuildMs() const { return m_accelerationStructureBuildMs; }
+
+    // Ray tracing pipelines with the bounce, AA and AO ray counts baked in as specialization
+    // constants. The generic pipelines read them from the UBO and are used until a variant exists.
+    struct ShaderVariantSettings
+    {
+        bool enabled      = true;
+        int  stableFrames = 30;  // Frames a configuration is used before its variant is compiled
+        int  maxVariants  = 16;
+    };
+
+    // Picks the pipeline the next recordCommandBuffer call uses for this configuration
+    void selectPipelineVariant(uint32_t mode, int indirectBounces, int aaRays, int aoRays);
+
+    // Ray counters of the ray generation shaders, one atomic per counter and launch when enabled
+    struct RayStatisticsSettings
+    {
+        bool enabled = false;
+    };
+
+    // Counters of the latest frame read back. traceMs is the "Trace rays" GPU scope of the same
+    // frame, negative without timestamp queries. frames counts the frames read back so far.
+    struct RayStatisticsFrame
+    {
+        rtutils::RayStatistics rays;
+        uint32_t               mode    = 0;
+        double                 traceMs = -1.0;
+        uint64_t               frames  = 0;
+    };
+
+    // Call once the fence of frameSlot has signaled and after Profiler::recordFrameStart for it.
+    // Reads the counters the slot copied last time, the next recordCommandBuffer writes the slot.
+    void resolveRayStatistics(uint32_t frameSlot);
+
+    // Same for the texture feedback of pathRT.rgen, the largest texel size each texture was
+    // sampled at is kept until takeTextureFeedback
+    void resolveTextureFeedback(uint32_t frameSlot);
+
+    // Requested texel size by texture id since the last call, 0 for textures not sampled
+    std::vector<uint32_t> takeTextureFeedback();
+
+    // Raw accumulation of the ray tracing target, rgb sums with the sum of filter weights in w.
+    // Waits for the queue to go idle.
+    rtutils::Image4f readAccumulation();
+
+    // Replaces the accumulation with texels in the format of the render target, e.g. those of a
+    // checkpoint. Waits for the queue to go idle.
+    void uploadAccumulation(const std::vector<char>& texels);
+
+    VkImage    getAccumulationImage() const { return m_rtRenderTarget.image; }
+    VkFormat   getAccumulationFormat() const { return m_rtRenderTarget.format; }
+    VkExtent2D getExtent() const { return m_extent; }
+
+    VkDenoiser*                    getDenoiser() { return m_denoiser.get(); }
+    rtutils::ReprojectionSettings* getReprojectionSettings() { return &m_reprojectionSettings; }
+    ShaderVariantSettings*         getShaderVariantSettings() { return &m_variantSettings; }
+    RayStatisticsSettings*         getRayStatisticsSettings() { return &m_rayStatisticsSettings; }
+    const RayStatisticsFrame&      getRayStatistics() const { return m_rayStatistics.last; }
+
     private:
     void                               initSobolResources();
     void                               copySobolMatricesToGPU();
@@ -46,6 +120,9 @@ class VkRTX
     const int                          m_numLayers           = 32;
     size_t                             m_scrambleSizeInBytes = 0;
     bool                               m_firstRun            = true;
+    uint32_t                           m_scrambleSeed        = 0;
+
+    double m_accelerationStructureBuildMs = 0.0;
 
     struct
     {
@@ -100,18 +177,45 @@ class VkRTX
         VkBool32                                                            updateOnly);
 
     void createRaytracingRenderTarget();
+    void createGBuffer();
     void setupComputePipeline();
+    void setupReprojectionPipeline();
+    void recordReprojection(VkCommandBuffer cmdBuf);
+    void recordHistoryCopy(VkCommandBuffer cmdBuf);
+    void createLightBuffers();
+    void createEnvironmentResources();
+    void createRayStatisticsBuffer();
+    void recordRayStatisticsReset(VkCommandBuffer cmdBuf);
+    void recordRayStatisticsCopy(VkCommandBuffer cmdBuf, uint32_t mode);
+    void createTextureFeedbackBuffer();
+    void recordTextureFeedbackReset(VkCommandBuffer cmdBuf);
+    void recordTextureFeedbackCopy(VkCommandBuffer cmdBuf);
+    void createDeviceBuffer(const void*    data,
+                            VkDeviceSize   size,
+                            VkBuffer*      buffer,
+                            VmaAllocation* memory);
 
     void createAccelerationStructures();
     void destroyAccelerationStructures(const AccelerationStructure& as);
 
+    struct ShaderBindingTables;
+    struct PipelineVariant;
+
     void createRaytracingDescriptorSet();
-    void createRaytracingPipelineCookTorrance();
+    void bindTextureDescriptors();
+    void createRaytracingPipelineCookTorrance(const VkSpecializationInfo* specialization,
+                                              VkPipeline*                 pipeline,
+                                              VkPipelineLayout*           layout);
+
+    void createShaderBindingTableAmbientOcclusion(VkPipeline pipeline, ShaderBindingTables* sbt);
+    void createShaderBindingTableCookTorrance(VkPipeline pipeline, ShaderBindingTables* sbt);
 
-    void createShaderBindingTableAmbientOcclusion();
-    void createShaderBindingTableCookTorrance();
+    void createRaytracingPipelineAmbientOcclusion(const VkSpecializationInfo* specialization,
+                                                  VkPipeline*                 pipeline,
+                                                  VkPipelineLayout*           layout);
 
-    void createRaytracingPipelineAmbientOcclusion();
+    PipelineVariant createPipelineVariant(uint32_t mode, const std::vector<int32_t>& constants);
+    void            destroyShaderBindingTable(ShaderBindingTables* sbt);
 
     private:
     VkPhysicalDeviceRayTracingPropertiesNV m_raytracingProperties = {};
@@ -137,15 +241,18 @@ class VkRTX
         DescriptorSets ggx;
         DescriptorSets ao;
         DescriptorSets compute;
+        DescriptorSets reprojection;
 
         DescriptorSetGenerator ggxDSG;
         DescriptorSetGenerator aoDSG;
+        DescriptorSetGenerator reprojectionDSG;
     } descriptors;
     struct
     {
         VkPipeline GGX = VK_NULL_HANDLE;
         VkPipeline AO  = VK_NULL_HANDLE;
         VkPipeline compute = VK_NULL_HANDLE;
+        VkPipeline reprojection = VK_NULL_HANDLE;
     } pipelines;
 
     struct
@@ -153,6 +260,7 @@ class VkRTX
         VkPipelineLayout GGX = VK_NULL_HANDLE;
         VkPipelineLayout AO  = VK_NULL_HANDLE;
         VkPipelineLayout compute = VK_NULL_HANDLE;
+        VkPipelineLayout reprojection = VK_NULL_HANDLE;
     } layouts;
 
     struct GroupIndices
@@ -183,6 +291,26 @@ class VkRTX
         ShaderBindingTables ao;
     } m_SBTs;
 
+    struct PipelineVariant
+    {
+        uint32_t            mode     = 0;
+        VkPipeline          pipeline = VK_NULL_HANDLE;
+        VkPipelineLayout    layout   = VK_NULL_HANDLE;
+        ShaderBindingTables sbt;
+    };
+
+    // Keyed on the mode and the specialization constants, see selectPipelineVariant
+    std::map<uint64_t, PipelineVariant> m_variants;
+    PipelineVariant*                    m_activeVariant = nullptr;
+    ShaderVariantSettings               m_variantSettings;
+
+    // Configuration waiting to be used for stableFrames before it is compiled
+    struct
+    {
+        uint64_t key    = ~0ull;
+        int      frames = 0;
+    } m_pendingVariant;
+
     struct
     {
         VkImage       image   = VK_NULL_HANDLE;
@@ -192,4 +320,80 @@ class VkRTX
         VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
         //VkFormat format = VK_FORMAT_R32G32B32A32_SFLOAT;
     } m_rtRenderTarget;
+
+    // First hit guides written by pathRT.rgen for the denoiser
+    struct
+    {
+        StorageImage normalDepth;
+        StorageImage prevNormalDepth;
+        StorageImage albedo;
+        StorageImage emission;
+    } m_gbuffer;
+
+    std::unique_ptr<VkDenoiser> m_denoiser;
+
+    // Accumulation of the previous frame, reprojected when the camera moves
+    StorageImage                  m_prevAccumulation;
+    rtutils::ReprojectionSettings m_reprojectionSettings;
+    bool                          m_hasHistory = false;
+
+    // Emissive triangles of the model and the alias table to pick them by power
+    struct
+    {
+        VkBuffer      triangleBuffer   = VK_NULL_HANDLE;
+        VmaAllocation triangleMemory   = VK_NULL_HANDLE;
+        VkBuffer      aliasTableBuffer = VK_NULL_HANDLE;
+        VmaAllocation aliasTableMemory = VK_NULL_HANDLE;
+        uint32_t      numLights        = 0;
+    } m_lights;
+
+    // Environment map as RGBA16F and its importance sampling tables
+    struct
+    {
+        VkImage       image       = VK_NULL_HANDLE;
+        VmaAllocation memory      = VK_NULL_HANDLE;
+        VkImageView   view        = VK_NULL_HANDLE;
+        VkSampler     sampler     = VK_NULL_HANDLE;
+        VkBuffer      tableBuffer = VK_NULL_HANDLE;
+        VmaAllocation tableMemory = VK_NULL_HANDLE;
+    } m_environment;
+
+    struct RayStatisticsReadback
+    {
+        VkBuffer      buffer  = VK_NULL_HANDLE;
+        VmaAllocation memory  = VK_NULL_HANDLE;
+        bool          written = false;
+        uint32_t      mode    = 0;
+    };
+
+    // Device local counters reset at the start of every frame, copied to the host visible buffer
+    // of the frame slot when enabled
+    struct
+    {
+        VkBuffer                           counterBuffer = VK_NULL_HANDLE;
+        VmaAllocation                      counterMemory = VK_NULL_HANDLE;
+        std::vector<RayStatisticsReadback> readback;
+        uint32_t                           currentSlot = 0;
+        RayStatisticsFrame                 last;
+    } m_rayStatistics;
+    RayStatisticsSettings m_rayStatisticsSettings;
+
+    struct TextureFeedbackReadback
+    {
+        VkBuffer      buffer  = VK_NULL_HANDLE;
+        VmaAllocation memory  = VK_NULL_HANDLE;
+        bool          written = false;
+    };
+
+    // One uint per texture, cleared at the start of every frame and copied out like the ray
+    // counters
+    struct
+    {
+        VkBuffer                             buffer       = VK_NULL_HANDLE;
+        VmaAllocation                        memory       = VK_NULL_HANDLE;
+        uint32_t                             textureCount = 0;
+        std::vector<TextureFeedbackReadback> readback;
+        uint32_t                             currentSlot = 0;
+        std::vector<uint32_t>                requested;
+    } m_textureFeedback;
 };
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "vkSceneGeometry.h"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+#include "vkContext.h"
+#include "vkStagingArena.h"
+
+namespace VkTools {
+namespace {
+
+struct GpuCluster
+{
+    glm::vec3 min;
+    uint32_t  firstIndex;
+    glm::vec3 max;
+    uint32_t  indexCount;
+};
+
+// Writes src into mapped staging memory with rebase applied to every element, then records the
+// copy to dst at element dstFirst
+template <typename T, typename Rebase>
+void stageRebased(StagingArena*         staging,
+                  VkBuffer              dst,
+                  uint32_t              dstFirst,
+                  const std::vector<T>& src,
+                  Rebase                rebase)
+{
+    const VkDeviceSize size = sizeof(T) * src.size();
+    if(size == 0)
+    {
+        return;
+    }
+
+    const StagingArena::Allocation allocation = staging->allocate(size);
+    T*                             out        = static_cast<T*>(allocation.data);
+    for(size_t i = 0; i < src.size(); ++i)
+    {
+        T value = src[i];
+        rebase(value);
+        out[i] = value;
+    }
+
+    VkBufferCopy copyRegion = {};
+    copyRegion.srcOffset    = allocation.offset;
+    copyRegion.dstOffset    = VkDeviceSize(dstFirst) * sizeof(T);
+    copyRegion.size         = size;
+    vkCmdCopyBuffer(staging->commands(), allocation.buffer, dst, 1, &copyRegion);
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void SceneGeometry::build(const vkContext*          ctx,
+                          const std::vector<Model>& models,
+                          StagingArena*             staging,
+                          uint32_t                  stagingQueueFamily)
+{
+    m_allocator = ctx->getAllocator();
+    m_ranges.clear();
+
+    std::vector<GpuCluster> clusters;
+
+    GeometryRange end = {};
+    for(const Model& model : models)
+    {
+        GeometryRange range = {};
+        range.firstVertex   = end.firstVertex;
+        range.vertexCount   = static_cast<uint32_t>(model.m_vertices.size());
+        range.firstIndex    = end.firstIndex;
+        range.indexCount    = static_cast<uint32_t>(model.m_indices.size());
+        range.firstMaterial = end.firstMaterial;
+        range.materialCount = static_cast<uint32_t>(model.m_materials.size());
+        range.firstTexture  = end.firstTexture;
+        range.textureCount  = static_cast<uint32_t>(model.m_textures.size());
+        m_ranges.push_back(range);
+
+        for(const rtutils::Cluster& cluster : model.m_clusters)
+        {
+            clusters.push_back({cluster.bounds.min, range.firstIndex + cluster.firstIndex,
+                                cluster.bounds.max, cluster.indexCount});
+        }
+
+        end.firstVertex += range.vertexCount;
+        end.firstIndex += range.indexCount;
+        end.firstMaterial += range.materialCount;
+        end.firstTexture += range.textureCount;
+    }
+    m_vertexCount  = end.firstVertex;
+    m_indexCount   = end.firstIndex;
+    m_clusterCount = static_cast<uint32_t>(clusters.size());
+
+    // Storage usage everywhere, the ray generation shaders fetch vertices and indices themselves
+    createBuffer(sizeof(VertexPNTC) * m_vertexCount,
+                 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 &m_vertices);
+    createBuffer(sizeof(uint32_t) * m_indexCount,
+                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 &m_indices);
+    createBuffer(sizeof(Material) * std::max(end.firstMaterial, 1u),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &m_materials);
+    createBuffer(sizeof(uint32_t) * m_ranges.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 &m_instances);
+    createBuffer(sizeof(GpuCluster) * std::max(m_clusterCount, 1u),
+                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &m_clusters);
+    createBuffer(sizeof(VkDrawIndexedIndirectCommand) * std::max(m_clusterCount, 1u),
+                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 &m_draws);
+    createBuffer(sizeof(uint32_t),
+                 VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 &m_drawCount);
+
+    for(size_t i = 0; i < models.size(); ++i)
+    {
+        const Model&         model = models[i];
+        const GeometryRange& range = m_ranges[i];
+
+        stageRebased(staging, m_vertices.buffer, range.firstVertex, model.m_vertices,
+                     [&](VertexPNTC& v) { v.materialID += range.firstMaterial; });
+        stageRebased(staging, m_indices.buffer, range.firstIndex, model.m_indices,
+                     [&](uint32_t& index) { index += range.firstVertex; });
+        stageRebased(staging, m_materials.buffer, range.firstMaterial, model.m_materials,
+                     [&](Material& m) {
+                         for(int* id : {&m.diffuseTextureID, &m.specularTextureID,
+                                        &m.normalTextureID})
+                         {
+                             if(*id >= 0)
+                             {
+                                 *id += range.firstTexture;
+                             }
+                         }
+                     });
+    }
+
+    std::vector<uint32_t> firstPrimitives;
+    for(const GeometryRange& range : m_ranges)
+    {
+        firstPrimitives.push_back(range.firstIndex / 3);
+    }
+    staging->uploadBuffer(m_instances.buffer, firstPrimitives.data(),
+                          sizeof(uint32_t) * firstPrimitives.size());
+    if(!clusters.empty())
+    {
+        staging->uploadBuffer(m_clusters.buffer, clusters.data(),
+                              sizeof(GpuCluster) * clusters.size());
+    }
+
+    // The draw buffers are only written on the GPU, the graphics queue owns them from the start
+    const Buffer*  uploaded[]  = {&m_vertices, &m_indices, &m_materials, &m_instances, &m_clusters};
+    const uint32_t queueFamily = ctx->getQueueFamily();
+    if(stagingQueueFamily != queueFamily)
+    {
+        for(const Buffer* buffer : uploaded)
+        {
+            recordBufferRelease(staging->commands(), buffer->buffer, stagingQueueFamily,
+                                queueFamily);
+        }
+    }
+    staging->flush();
+
+    if(stagingQueueFamily != queueFamily)
+    {
+        VkCommandBuffer acquire =
+            beginRecordingCommandBuffer(ctx->getDevice(), ctx->getCommandPool());
+        for(const Buffer* buffer : uploaded)
+        {
+            recordBufferAcquire(acquire, buffer->buffer, stagingQueueFamily, queueFamily);
+        }
+        flushCommandBuffer(ctx->getDevice(), ctx->getQueue(), ctx->getCommandPool(), acquire);
+    }
+
+    spdlog::info("Scene geometry: {} models, {} vertices, {} indices, {} clusters, {} materials, "
+                 "{} textures",
+                 m_ranges.size(), m_vertexCount, m_indexCount, m_clusterCount, end.firstMaterial,
+                 end.firstTexture);
+}
+
+void SceneGeometry::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, Buffer* buffer)
+{
+    VkTools::createBuffer(m_allocator, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VMA_MEMORY_USAGE_GPU_ONLY, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                          &buffer->buffer, &buffer->memory);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void SceneGeometry::cleanUp()
+{
+    for(Buffer* buffer :
+        {&m_vertices, &m_indices, &m_materials, &m_instances, &m_clusters, &m_draws, &m_drawCount})
+    {
+        if(buffer->buffer != VK_NULL_HANDLE)
+        {
+            vmaDestroyBuffer(m_allocator, buffer->buffer, buffer->memory);
+            buffer->buffer = VK_NULL_HANDLE;
+            buffer->memory = VK_NULL_HANDLE;
+        }
+    }
+    m_ranges.clear();
+}
+
+}  // namespace VkTools
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+
+#include <vma/vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include "Model.h"
+
+class vkContext;
+
+namespace VkTools {
+
+class StagingArena;
+
+// Where a model landed in the scene-wide buffers, in elements
+struct GeometryRange
+{
+    uint32_t firstVertex   = 0;
+    uint32_t vertexCount   = 0;
+    uint32_t firstIndex    = 0;
+    uint32_t indexCount    = 0;
+    uint32_t firstMaterial = 0;
+    uint32_t materialCount = 0;
+    uint32_t firstTexture  = 0;  // Into the textures of all models in order, textureImageInfos
+    uint32_t textureCount  = 0;
+};
+
+// ----------------------------------------------------------------------------
+//  Vertices, indices and materials of every model packed into one buffer each, so the raster
+//  pass binds them once and the ray tracing descriptor set sees all models.
+//
+//  Indices are rebased onto the shared vertex buffer, vertex material ids onto the shared
+//  material buffer and material texture ids onto the concatenated texture array. Primitive ids
+//  reported by a closest hit are per model, the instance buffer holds the first primitive of
+//  each model indexed by gl_InstanceCustomIndexNV.
+//
+//  The clusters of all models are uploaded with rebased index ranges for the culling pass of
+//  the raster preview, see ClusterCulling.
+//
+
+class SceneGeometry
+{
+    public:
+    // Uploads through staging, which submits to a queue of stagingQueueFamily, and waits for the
+    // copies. From another family than the graphics queue of ctx the buffers are released by
+    // the copies and acquired on the graphics queue before returning.
+    void build(const vkContext*          ctx,
+               const std::vector<Model>& models,
+               StagingArena*             staging,
+               uint32_t                  stagingQueueFamily);
+    void cleanUp();
+
+    VkBuffer getVertexBuffer() const { return m_vertices.buffer; }
+    VkBuffer getIndexBuffer() const { return m_indices.buffer; }
+    VkBuffer getMaterialBuffer() const { return m_materials.buffer; }
+    VkBuffer getInstanceBuffer() const { return m_instances.buffer; }
+
+    // Bounds and index range per cluster, layout of Cluster in cullClusters.comp
+    VkBuffer getClusterBuffer() const { return m_clusters.buffer; }
+    uint32_t getClusterCount() const { return m_clusterCount; }
+
+    // Room for one VkDrawIndexedIndirectCommand per cluster and a uint draw count, written on
+    // the GPU
+    VkBuffer getDrawBuffer() const { return m_draws.buffer; }
+    VkBuffer getDrawCountBuffer() const { return m_drawCount.buffer; }
+
+    uint32_t getVertexCount() const { return m_vertexCount; }
+    uint32_t getIndexCount() const { return m_indexCount; }
+
+    const std::vector<GeometryRange>& getRanges() const { return m_ranges; }
+
+    private:
+    struct Buffer
+    {
+        VkBuffer      buffer = VK_NULL_HANDLE;
+        VmaAllocation memory = VK_NULL_HANDLE;
+    };
+
+    void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, Buffer* buffer);
+
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+
+    Buffer m_vertices;
+    Buffer m_indices;
+    Buffer m_materials;
+    Buffer m_instances;
+    Buffer m_clusters;
+    Buffer m_draws;
+    Buffer m_drawCount;
+
+    uint32_t                   m_vertexCount  = 0;
+    uint32_t                   m_indexCount   = 0;
+    uint32_t                   m_clusterCount = 0;
+    std::vector<GeometryRange> m_ranges;
+};
+
+}  // namespace VkTools
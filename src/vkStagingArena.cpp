@@ -0,0 +1,332 @@
+#include "vkStagingArena.h"
+
+#include <cstring>
+
+#include "vkTools.h"
+
+namespace VkTools {
+namespace {
+
+VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void StagingArena::init(VkDevice      device,
+                        VmaAllocator  allocator,
+                        VkQueue       queue,
+                        VkCommandPool pool,
+                        VkDeviceSize  capacity)
+{
+    m_device    = device;
+    m_allocator = allocator;
+    m_queue     = queue;
+    m_pool      = pool;
+    m_capacity  = capacity;
+    m_head      = 0;
+    m_tail      = 0;
+    m_used      = 0;
+    m_stats     = Stats();
+
+    VkTools::createBuffer(m_allocator, m_capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                          VMA_MEMORY_USAGE_CPU_ONLY,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                              | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          &m_buffer, &m_memory);
+    ++m_stats.bufferAllocations;
+
+    void* mapped;
+    VK_CHECK_RESULT(vmaMapMemory(m_allocator, m_memory, &mapped));
+    m_mapped = static_cast<char*>(mapped);
+}
+
+void StagingArena::cleanUp()
+{
+    if(m_buffer == VK_NULL_HANDLE)
+    {
+        return;
+    }
+    flush();
+
+    vmaUnmapMemory(m_allocator, m_memory);
+    vmaDestroyBuffer(m_allocator, m_buffer, m_memory);
+    m_buffer = VK_NULL_HANDLE;
+    m_memory = VK_NULL_HANDLE;
+    m_mapped = nullptr;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+StagingArena::Allocation StagingArena::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+    ++m_stats.uploads;
+    m_stats.bytes += size;
+
+    Allocation allocation;
+    if(size > m_capacity)
+    {
+        VmaAllocation memory;
+        VkTools::createBuffer(m_allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                              VMA_MEMORY_USAGE_CPU_ONLY,
+                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+                                  | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                              &allocation.buffer, &memory);
+        VK_CHECK_RESULT(vmaMapMemory(m_allocator, memory, &allocation.data));
+        m_openDedicated.emplace_back(allocation.buffer, memory);
+        ++m_stats.bufferAllocations;
+        return allocation;
+    }
+
+    while(!reserve(size, alignment, &allocation.offset))
+    {
+        // The open batch alone can fill the ring
+        if(m_batches.empty())
+        {
+            submit();
+        }
+        ++m_stats.stalls;
+        retireOldest(true);
+    }
+    allocation.buffer = m_buffer;
+    allocation.data   = m_mapped + allocation.offset;
+    return allocation;
+}
+
+bool StagingArena::reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset)
+{
+    if(m_used == 0)
+    {
+        m_head = 0;
+        m_tail = 0;
+    }
+
+    const VkDeviceSize start = alignUp(m_head, alignment);
+    VkDeviceSize       end;
+    if(m_used == 0 || m_head > m_tail)
+    {
+        // Free space is [m_head, capacity) and [0, m_tail)
+        if(start + size <= m_capacity)
+        {
+            *offset = start;
+            end     = start + size;
+        }
+        else if(size <= m_tail)
+        {
+            *offset = 0;
+            end     = size;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else if(start + size <= m_tail)
+    {
+        *offset = start;
+        end     = start + size;
+    }
+    else
+    {
+        return false;
+    }
+
+    const VkDeviceSize used = end >= m_head ? end - m_head : m_capacity - m_head + end;
+    m_used += used;
+    m_openUsed += used;
+    m_head = end;
+    return true;
+}
+
+VkCommandBuffer StagingArena::commands()
+{
+    if(m_commands == VK_NULL_HANDLE)
+    {
+        m_commands = VkTools::beginRecordingCommandBuffer(m_device, m_pool);
+    }
+    return m_commands;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void StagingArena::uploadBuffer(VkBuffer     dst,
+                                const void*  data,
+                                VkDeviceSize size,
+                                VkDeviceSize dstOffset)
+{
+    const Allocation staging = allocate(size);
+    std::memcpy(staging.data, data, size);
+
+    VkBufferCopy copyRegion = {};
+    copyRegion.srcOffset    = staging.offset;
+    copyRegion.dstOffset    = dstOffset;
+    copyRegion.size         = size;
+    vkCmdCopyBuffer(commands(), staging.buffer, dst, 1, &copyRegion);
+}
+
+void StagingArena::uploadImage(VkImage     image,
+                               const void* pixels,
+                               int         width,
+                               int         height,
+                               uint32_t    bytesPerPixel,
+                               uint32_t    srcQueueFamily,
+                               uint32_t    dstQueueFamily)
+{
+    const VkDeviceSize size    = VkDeviceSize(width) * height * bytesPerPixel;
+    const Allocation   staging = allocate(size);
+    std::memcpy(staging.data, pixels, size);
+
+    VkTools::recordTextureImageCopy(commands(), staging.buffer, staging.offset, image, width,
+                                    height, srcQueueFamily, dstQueueFamily);
+}
+
+void StagingArena::uploadImageMips(VkImage                  image,
+                                   const rtutils::MipChain& chain,
+                                   uint32_t                 firstMip,
+                                   uint32_t                 srcQueueFamily,
+                                   uint32_t                 dstQueueFamily)
+{
+    VkDeviceSize size = 0;
+    for(uint32_t level = firstMip; level < chain.levels.size(); ++level)
+    {
+        size += chain.levels[level].size();
+    }
+    const Allocation staging = allocate(size);
+
+    // Levels are packed back to back, every one a multiple of the 4 byte texel
+    std::vector<VkBufferImageCopy> regions;
+    VkDeviceSize                   offset = 0;
+    for(uint32_t level = firstMip; level < chain.levels.size(); ++level)
+    {
+        const std::vector<uint8_t>& pixels = chain.levels[level];
+        std::memcpy(static_cast<char*>(staging.data) + offset, pixels.data(), pixels.size());
+
+        VkBufferImageCopy region  = {};
+        region.bufferOffset       = staging.offset + offset;
+        region.imageSubresource   = {VK_IMAGE_ASPECT_COLOR_BIT, level - firstMip, 0, 1};
+        region.imageExtent.width  = chain.levelWidth(level);
+        region.imageExtent.height = chain.levelHeight(level);
+        region.imageExtent.depth  = 1;
+        regions.push_back(region);
+        offset += pixels.size();
+    }
+
+    VkTools::recordTextureMipCopy(commands(), staging.buffer, image, regions, srcQueueFamily,
+                                  dstQueueFamily);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+uint64_t StagingArena::submit()
+{
+    if(m_commands == VK_NULL_HANDLE && m_openUsed == 0 && m_openDedicated.empty())
+    {
+        return m_nextTicket - 1;
+    }
+
+    VkCommandBuffer cmdBuf = commands();
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType           = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask   = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(cmdBuf, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0,
+                         nullptr);
+    VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuf));
+
+    Batch batch     = {};
+    batch.ticket    = m_nextTicket++;
+    batch.commands  = cmdBuf;
+    batch.end       = m_head;
+    batch.used      = m_openUsed;
+    batch.submitted = Clock::now();
+    batch.dedicated.swap(m_openDedicated);
+
+    VkFenceCreateInfo fenceInfo = {};
+    fenceInfo.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VK_CHECK_RESULT(vkCreateFence(m_device, &fenceInfo, nullptr, &batch.fence));
+
+    VkSubmitInfo submitInfo       = {};
+    submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers    = &cmdBuf;
+    VK_CHECK_RESULT(vkQueueSubmit(m_queue, 1, &submitInfo, batch.fence));
+
+    if(m_batches.empty())
+    {
+        m_busySince = batch.submitted;
+    }
+    m_batches.push_back(std::move(batch));
+    ++m_stats.submits;
+
+    m_commands = VK_NULL_HANDLE;
+    m_openUsed = 0;
+    return m_nextTicket - 1;
+}
+
+bool StagingArena::isComplete(uint64_t ticket)
+{
+    while(!m_batches.empty() && m_batches.front().ticket <= ticket
+          && vkGetFenceStatus(m_device, m_batches.front().fence) == VK_SUCCESS)
+    {
+        retireOldest(false);
+    }
+    return ticket <= m_retiredTicket;
+}
+
+void StagingArena::wait(uint64_t ticket)
+{
+    while(!m_batches.empty() && m_retiredTicket < ticket)
+    {
+        retireOldest(true);
+    }
+}
+
+// ----------------------------------------------------------------------------
+//  Batches complete in submission order on a single queue
+//
+
+void StagingArena::retireOldest(bool wait)
+{
+    Batch& batch = m_batches.front();
+    if(wait)
+    {
+        VK_CHECK_RESULT(vkWaitForFences(m_device, 1, &batch.fence, VK_TRUE, UINT64_MAX));
+    }
+
+    vkDestroyFence(m_device, batch.fence, nullptr);
+    vkFreeCommandBuffers(m_device, m_pool, 1, &batch.commands);
+    for(const auto& dedicated : batch.dedicated)
+    {
+        vmaUnmapMemory(m_allocator, dedicated.second);
+        vmaDestroyBuffer(m_allocator, dedicated.first, dedicated.second);
+    }
+
+    // A batch without ring bytes may predate a reset of the empty ring
+    if(batch.used > 0)
+    {
+        m_tail = batch.end;
+    }
+    m_used -= batch.used;
+    m_retiredTicket = batch.ticket;
+    m_batches.pop_front();
+
+    if(m_batches.empty())
+    {
+        m_stats.seconds += std::chrono::duration<double>(Clock::now() - m_busySince).count();
+    }
+}
+
+}  // namespace VkTools
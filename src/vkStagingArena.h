@@ -0,0 +1,141 @@
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+#include <vma/vk_mem_alloc.h>
+#include <vulkan/vulkan.h>
+
+#include "TextureResidency.h"
+
+namespace VkTools {
+
+// ----------------------------------------------------------------------------
+//  Host to device uploads through one persistently mapped staging buffer used as a ring.
+//
+//      allocate / upload*  ->  copies recorded into the open batch
+//      submit              ->  batch goes to the queue with a fence, returns its ticket
+//      isComplete / wait   ->  retires batches, their part of the ring is reused
+//
+//  Nothing waits for the GPU unless the ring is full or the caller waits on a ticket. Every
+//  batch ends with a barrier making the copies visible to anything submitted after it on the
+//  same queue. Uploads larger than the ring get a buffer of their own, freed with their batch.
+//
+
+class StagingArena
+{
+    public:
+    using Clock = std::chrono::high_resolution_clock;
+
+    struct Allocation
+    {
+        VkBuffer     buffer = VK_NULL_HANDLE;
+        VkDeviceSize offset = 0;
+        void*        data   = nullptr;
+    };
+
+    struct Stats
+    {
+        uint64_t uploads           = 0;  // allocate calls
+        uint64_t bytes             = 0;
+        uint64_t submits           = 0;
+        uint64_t bufferAllocations = 0;  // The ring and every oversized upload
+        uint64_t stalls            = 0;  // Waits because the ring was full
+        double   seconds           = 0.0;  // Some batch submitted and not yet seen complete
+
+        double megabytesPerSecond() const { return seconds > 0.0 ? bytes / seconds / 1e6 : 0.0; }
+    };
+
+    void init(VkDevice      device,
+              VmaAllocator  allocator,
+              VkQueue       queue,
+              VkCommandPool pool,
+              VkDeviceSize  capacity);
+
+    // Waits for every batch and frees the ring
+    void cleanUp();
+
+    // Mapped staging memory for size bytes. May submit the open batch and wait for old ones to
+    // make room, so fetch commands() only after the allocations a copy reads from.
+    Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+    // Open batch, recording
+    VkCommandBuffer commands();
+
+    // Stages data and records its copy into dst at dstOffset
+    void uploadBuffer(VkBuffer     dst,
+                      const void*  data,
+                      VkDeviceSize size,
+                      VkDeviceSize dstOffset = 0);
+
+    // Stages the pixels of mip 0 and records recordTextureImageCopy, see there for the families
+    void uploadImage(VkImage     image,
+                     const void* pixels,
+                     int         width,
+                     int         height,
+                     uint32_t    bytesPerPixel,
+                     uint32_t    srcQueueFamily = VK_QUEUE_FAMILY_IGNORED,
+                     uint32_t    dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+    // Levels firstMip and coarser of an RGBA8 chain, level firstMip goes to mip 0 of image
+    void uploadImageMips(VkImage                  image,
+                         const rtutils::MipChain& chain,
+                         uint32_t                 firstMip,
+                         uint32_t                 srcQueueFamily = VK_QUEUE_FAMILY_IGNORED,
+                         uint32_t                 dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+    // Submits the open batch. Returns its ticket, or the ticket of the last batch when nothing
+    // was recorded since.
+    uint64_t submit();
+
+    bool isComplete(uint64_t ticket);
+    void wait(uint64_t ticket);
+    void flush() { wait(submit()); }
+
+    const Stats& getStats() const { return m_stats; }
+
+    private:
+    struct Batch
+    {
+        uint64_t          ticket;
+        VkCommandBuffer   commands;
+        VkFence           fence;
+        VkDeviceSize      end;   // Ring head after the batch
+        VkDeviceSize      used;  // Ring bytes including alignment and wrap padding
+        Clock::time_point submitted;
+        std::vector<std::pair<VkBuffer, VmaAllocation>> dedicated;
+    };
+
+    bool reserve(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+    void retireOldest(bool wait);
+
+    VkDevice      m_device    = VK_NULL_HANDLE;
+    VmaAllocator  m_allocator = VK_NULL_HANDLE;
+    VkQueue       m_queue     = VK_NULL_HANDLE;
+    VkCommandPool m_pool      = VK_NULL_HANDLE;
+
+    VkBuffer      m_buffer   = VK_NULL_HANDLE;
+    VmaAllocation m_memory   = VK_NULL_HANDLE;
+    char*         m_mapped   = nullptr;
+    VkDeviceSize  m_capacity = 0;
+
+    // Bytes in flight are [m_tail, m_head) around the ring, m_used of them
+    VkDeviceSize m_head = 0;
+    VkDeviceSize m_tail = 0;
+    VkDeviceSize m_used = 0;
+
+    // Open batch
+    VkCommandBuffer m_commands = VK_NULL_HANDLE;
+    VkDeviceSize    m_openUsed = 0;
+    std::vector<std::pair<VkBuffer, VmaAllocation>> m_openDedicated;
+
+    std::deque<Batch> m_batches;
+    uint64_t          m_nextTicket    = 1;
+    uint64_t          m_retiredTicket = 0;
+
+    Stats             m_stats;
+    Clock::time_point m_busySince;  // Start of the current interval with batches in flight
+};
+
+}  // namespace VkTools
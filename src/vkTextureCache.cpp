@@ -0,0 +1,152 @@
+#include "vkTextureCache.h"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+#include "vkContext.h"
+#include "vkTextureRegistry.h"
+
+namespace VkTools {
+
+uint32_t TextureCache::baseMip(uint32_t width, uint32_t height) const
+{
+    return m_residency.baseMip(width, height);
+}
+
+void TextureCache::addTexture(uint32_t slot, rtutils::MipChain chain)
+{
+    if(slot >= m_chains.size())
+    {
+        m_chains.resize(slot + 1);
+    }
+    m_residency.setTexture(slot, chain.width, chain.height, 4);
+    m_chains[slot] = std::move(chain);
+    ++m_stats.textures;
+}
+
+void TextureCache::addAlias(uint32_t slot, uint32_t owner)
+{
+    m_aliases.emplace_back(slot, owner);
+}
+
+bool TextureCache::isUpdateDue()
+{
+    if(!m_settings.enabled || m_stats.textures == 0)
+    {
+        return false;
+    }
+    return ++m_frame % std::max(m_settings.updateInterval, 1) == 0;
+}
+
+// ----------------------------------------------------------------------------
+//  New images are uploaded on the graphics queue, the old ones are destroyed by the registry
+//  once the device is idle. A texture changes at most once per update.
+//
+
+bool TextureCache::update(const vkContext*             ctx,
+                          Model*                       model,
+                          const std::vector<uint32_t>& requestedSizes)
+{
+    m_residency.m_settings.budgetBytes = uint64_t(std::max(m_settings.budgetMB, 0)) << 20;
+
+    std::vector<uint32_t> requested = requestedSizes;
+    for(const auto& alias : m_aliases)
+    {
+        if(alias.first < requested.size() && alias.second < requested.size())
+        {
+            requested[alias.second] = std::max(requested[alias.second], requested[alias.first]);
+        }
+    }
+    const std::vector<rtutils::TextureResidency::Change> changes =
+        m_residency.update(requested, m_frame);
+    if(changes.empty())
+    {
+        return false;
+    }
+
+    const VkDevice     device    = ctx->getDevice();
+    const VmaAllocator allocator = ctx->getAllocator();
+    StagingArena*      staging   = ctx->getStagingArena();
+
+    std::vector<Texture> replaced;
+    for(const rtutils::TextureResidency::Change& change : changes)
+    {
+        const rtutils::MipChain& chain  = m_chains[change.texture];
+        const uint32_t           mip    = change.residentMip;
+        const uint32_t           levels = static_cast<uint32_t>(chain.levels.size()) - mip;
+
+        // Keeps the shared sampler, only the image and its view are replaced
+        Texture& texture = model->m_textures[change.texture];
+        replaced.push_back(texture);
+        if(chain.levelWidth(mip) < texture.width)
+        {
+            ++m_stats.evictions;
+        }
+
+        texture.width  = chain.levelWidth(mip);
+        texture.height = chain.levelHeight(mip);
+        VkTools::createImage(allocator, {texture.width, texture.height}, VK_FORMAT_R8G8B8A8_UNORM,
+                             VK_IMAGE_TILING_OPTIMAL,
+                             VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                             VMA_MEMORY_USAGE_GPU_ONLY, &texture.image, &texture.memory, levels);
+        staging->uploadImageMips(texture.image, chain, mip);
+        texture.view = VkTools::createImageView(device, texture.image, VK_FORMAT_R8G8B8A8_UNORM,
+                                                VK_IMAGE_ASPECT_COLOR_BIT, levels);
+        m_stats.uploadedBytes += rtutils::TextureResidency::chainBytes(chain.width, chain.height,
+                                                                        4, mip);
+    }
+    staging->flush();
+
+    vkDeviceWaitIdle(device);
+    for(size_t i = 0; i < changes.size(); ++i)
+    {
+        const Texture& old     = replaced[i];
+        const Texture& texture = model->m_textures[changes[i].texture];
+        for(Texture& slot : model->m_textures)
+        {
+            if(slot.image == old.image)
+            {
+                slot.image  = texture.image;
+                slot.memory = texture.memory;
+                slot.view   = texture.view;
+                slot.width  = texture.width;
+                slot.height = texture.height;
+            }
+        }
+        ctx->getTextureRegistry()->replace(old, texture);
+    }
+
+    m_stats.aboveBase     = 0;
+    m_stats.fullSize      = 0;
+    m_stats.residentBytes = m_residency.getResidentBytes();
+    for(uint32_t slot = 0; slot < m_chains.size(); ++slot)
+    {
+        if(m_residency.isTracked(slot))
+        {
+            const uint32_t mip = m_residency.getResidentMip(slot);
+            m_stats.aboveBase += mip < m_residency.getBaseMip(slot) ? 1 : 0;
+            m_stats.fullSize += mip == 0 ? 1 : 0;
+        }
+    }
+    spdlog::debug("Texture residency: {} changes, {} of {} textures above their base mip, "
+                  "{:.1f} MB of {} MB",
+                  changes.size(), m_stats.aboveBase, m_stats.textures,
+                  m_stats.residentBytes / 1048576.0, m_settings.budgetMB);
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+//  The images belong to the registry and are destroyed with it
+//
+
+void TextureCache::cleanUp()
+{
+    m_residency.clear();
+    m_chains.clear();
+    m_aliases.clear();
+    m_frame = 0;
+    m_stats = Stats();
+}
+
+}  // namespace VkTools
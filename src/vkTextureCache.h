@@ -0,0 +1,80 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "Model.h"
+#include "TextureResidency.h"
+
+class vkContext;
+
+namespace VkTools {
+
+// ----------------------------------------------------------------------------
+//  Keeps the streamed textures of a model within a GPU memory budget. AssetStreamer uploads
+//  only the base mip of every texture and hands the decoded mip chain over, the finer levels
+//  then stream in from those chains as the ray generation shader asks for them.
+//
+//      VkRTX feedback   ->  requested texel size per texture, gathered over updateInterval
+//      TextureResidency ->  finest resident mip per texture, LRU eviction over the budget
+//      update()         ->  recreates changed images holding that mip and the coarser ones
+//
+//  Slots are those of the first model, whose texture ids in the scene geometry start at 0.
+//  Images are shared through the TextureRegistry, a recreated image replaces the old one in
+//  the registry and in every slot of the model showing it.
+//
+
+class TextureCache
+{
+    public:
+    struct Settings
+    {
+        bool enabled        = true;  // Streamed textures upload every level when off
+        int  budgetMB       = 512;
+        int  updateInterval = 30;  // Frames of feedback per residency update
+    };
+
+    struct Stats
+    {
+        uint32_t textures      = 0;  // Tracked
+        uint32_t aboveBase     = 0;  // Resident finer than their base mip
+        uint32_t fullSize      = 0;  // Resident with mip 0
+        uint64_t residentBytes = 0;  // Above the base mips
+        uint64_t uploadedBytes = 0;  // Since the start
+        uint32_t evictions     = 0;
+    };
+
+    // Level the streamer uploads first for a texture of this size
+    uint32_t baseMip(uint32_t width, uint32_t height) const;
+
+    // Takes over the chain of slot, whose image in the model holds baseMip and coarser levels
+    void addTexture(uint32_t slot, rtutils::MipChain chain);
+
+    // slot shows the image of owner, its feedback counts for owner
+    void addAlias(uint32_t slot, uint32_t owner);
+
+    // Counts a frame, true every updateInterval frames while textures are tracked
+    bool isUpdateDue();
+
+    // Applies the residency policy to the feedback and swaps the recreated images into model.
+    // Waits for the device to go idle when anything changed and returns true, descriptors
+    // referring to the textures have to be rewritten.
+    bool update(const vkContext* ctx, Model* model, const std::vector<uint32_t>& requestedSizes);
+
+    const Stats& getStats() const { return m_stats; }
+
+    void cleanUp();
+
+    Settings m_settings;
+
+    private:
+    rtutils::TextureResidency      m_residency;
+    std::vector<rtutils::MipChain> m_chains;  // By slot, empty until added
+    uint64_t                       m_frame = 0;
+    Stats                          m_stats;
+
+    // Slot and owner of every slot showing the image of another one
+    std::vector<std::pair<uint32_t, uint32_t>> m_aliases;
+};
+
+}  // namespace VkTools
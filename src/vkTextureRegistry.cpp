@@ -0,0 +1,156 @@
+#include "vkTextureRegistry.h"
+
+#include <cstring>
+#include <filesystem>
+
+#include "vkTools.h"
+
+namespace VkTools {
+
+void TextureRegistry::init(VkDevice device, VmaAllocator allocator)
+{
+    m_device    = device;
+    m_allocator = allocator;
+    VkTools::createTextureSampler(m_device, &m_sampler);
+}
+
+void TextureRegistry::cleanUp()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(const Texture& texture : m_textures)
+    {
+        vkDestroyImageView(m_device, texture.view, nullptr);
+        vmaDestroyImage(m_allocator, texture.image, texture.memory);
+    }
+    m_textures.clear();
+    m_byPath.clear();
+    m_byContent.clear();
+
+    if(m_sampler != VK_NULL_HANDLE)
+    {
+        vkDestroySampler(m_device, m_sampler, nullptr);
+        m_sampler = VK_NULL_HANDLE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+std::string TextureRegistry::pathKey(const std::string& path)
+{
+    if(path.empty())
+    {
+        return path;
+    }
+    std::error_code       error;
+    std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+    if(error)
+    {
+        canonical = std::filesystem::path(path).lexically_normal();
+    }
+    return canonical.generic_string();
+}
+
+uint64_t TextureRegistry::contentHash(uint32_t width, uint32_t height, const uint8_t* pixels)
+{
+    // FNV-1a over 8 byte words, every step is a bijection so a single differing word always
+    // changes the hash
+    uint64_t   hash = 14695981039346656037ull;
+    const auto mix  = [&hash](uint64_t word) { hash = (hash ^ word) * 1099511628211ull; };
+
+    mix(width);
+    mix(height);
+    const size_t size = size_t(width) * height * 4;
+    size_t       i    = 0;
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, pixels + i, sizeof(word));
+        mix(word);
+    }
+    for(; i < size; ++i)
+    {
+        mix(pixels[i]);
+    }
+    return hash;
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+bool TextureRegistry::findPath(const std::string& key, Texture* texture)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_stats.requests;
+
+    const auto found = m_byPath.find(key);
+    if(key.empty() || found == m_byPath.end())
+    {
+        return false;
+    }
+    *texture = m_textures[found->second];
+    ++m_stats.pathHits;
+    return true;
+}
+
+bool TextureRegistry::hasPath(const std::string& key) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !key.empty() && m_byPath.count(key) != 0;
+}
+
+bool TextureRegistry::findContent(const std::string& key, uint64_t hash, Texture* texture)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const auto found = m_byContent.find(hash);
+    if(found == m_byContent.end())
+    {
+        return false;
+    }
+    if(!key.empty())
+    {
+        m_byPath.emplace(key, found->second);
+    }
+    *texture = m_textures[found->second];
+    ++m_stats.contentHits;
+    return true;
+}
+
+void TextureRegistry::add(const std::string& key, uint64_t hash, const Texture& texture)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    const uint32_t index = static_cast<uint32_t>(m_textures.size());
+    m_textures.push_back(texture);
+    m_byContent.emplace(hash, index);
+    if(!key.empty())
+    {
+        m_byPath.emplace(key, index);
+    }
+    ++m_stats.images;
+}
+
+void TextureRegistry::replace(const Texture& old, const Texture& texture)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for(Texture& entry : m_textures)
+    {
+        if(entry.image == old.image)
+        {
+            entry = texture;
+        }
+    }
+    vkDestroyImageView(m_device, old.view, nullptr);
+    vmaDestroyImage(m_allocator, old.image, old.memory);
+}
+
+TextureRegistry::Stats TextureRegistry::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+}  // namespace VkTools
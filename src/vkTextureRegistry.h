@@ -0,0 +1,73 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Model.h"
+
+namespace VkTools {
+
+// ----------------------------------------------------------------------------
+//  Owns the images of every texture slot of every model, so slots showing the same pixels
+//  share one image and view. Lookups go by the canonical path of the file first, which saves
+//  decoding it again, then by a hash of the decoded pixels, which saves the upload. Every
+//  texture is sampled with the one sampler created here.
+//
+
+class TextureRegistry
+{
+    public:
+    struct Stats
+    {
+        uint32_t requests    = 0;  // Slots resolved through findPath
+        uint32_t pathHits    = 0;  // Same file as an earlier slot
+        uint32_t contentHits = 0;  // Another file with identical pixels
+        uint32_t images      = 0;  // Created and owned
+    };
+
+    void init(VkDevice device, VmaAllocator allocator);
+
+    // Destroys every image and the sampler, the device has to be idle
+    void cleanUp();
+
+    // Immutable sampler of the texture bindings
+    VkSampler getSampler() const { return m_sampler; }
+
+    // The same for every spelling of a path to the file, empty for an empty path
+    static std::string pathKey(const std::string& path);
+
+    // Of the size and the RGBA8 pixels
+    static uint64_t contentHash(uint32_t width, uint32_t height, const uint8_t* pixels);
+
+    // Texture registered for the file, counts a request. Safe to call from the loader thread,
+    // like hasPath, which doesn't count.
+    bool findPath(const std::string& key, Texture* texture);
+    bool hasPath(const std::string& key) const;
+
+    // Texture with the same pixels. A hit registers key for it as well.
+    bool findContent(const std::string& key, uint64_t hash, Texture* texture);
+
+    // Takes over the image and view of texture
+    void add(const std::string& key, uint64_t hash, const Texture& texture);
+
+    // Points the entry of old at the image and view of texture and destroys those of old. The
+    // device must be done with them.
+    void replace(const Texture& old, const Texture& texture);
+
+    Stats getStats() const;
+
+    private:
+    VkDevice     m_device    = VK_NULL_HANDLE;
+    VmaAllocator m_allocator = VK_NULL_HANDLE;
+    VkSampler    m_sampler   = VK_NULL_HANDLE;
+
+    mutable std::mutex                        m_mutex;
+    std::vector<Texture>                      m_textures;
+    std::unordered_map<std::string, uint32_t> m_byPath;  // Indices into m_textures
+    std::unordered_map<uint64_t, uint32_t>    m_byContent;
+    Stats                                     m_stats;
+};
+
+}  // namespace VkTools
@@ -1,6 +1,15 @@
 #include "vkTools.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
 
+#include "vkStagingArena.h"
+
+#ifdef PATHTRACER_EMBED_SPIRV
+#include "embeddedShaders.h"
+#endif
+
 namespace VkTools {
 // ----------------------------------------------------------------------------
 //
@@ -133,6 +142,19 @@ const char* errorString(VkResult res)
 
 std::vector<char> loadShader(const char* path)
 {
+#ifdef PATHTRACER_EMBED_SPIRV
+    // Embedded shaders are looked up by file name, the directory does not matter
+    const std::string name = std::filesystem::path(path).filename().string();
+    for(size_t i = 0; i < g_numEmbeddedShaders; ++i)
+    {
+        if(name == g_embeddedShaders[i].name)
+        {
+            const char* data = reinterpret_cast<const char*>(g_embeddedShaders[i].data);
+            return std::vector<char>(data, data + g_embeddedShaders[i].size);
+        }
+    }
+#endif
+
     std::ifstream file(path, std::ios::binary | std::ios::ate | std::ios::in);
 
     if(!file.is_open())
@@ -149,6 +171,51 @@ std::vector<char> loadShader(const char* path)
     return buffer;
 }
 
+// ----------------------------------------------------------------------------
+//  64-bit FNV-1a over the names and contents of every .spv file, in name order. Hashes the
+//  embedded table instead of the directory with PATHTRACER_EMBED_SPIRV.
+//
+
+uint64_t hashShaders(const std::string& directory)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto     add  = [&hash](const char* data, size_t size) {
+        for(size_t i = 0; i < size; ++i)
+        {
+            hash = (hash ^ uint8_t(data[i])) * 1099511628211ull;
+        }
+    };
+
+#ifdef PATHTRACER_EMBED_SPIRV
+    (void)directory;
+    for(size_t i = 0; i < g_numEmbeddedShaders; ++i)
+    {
+        add(g_embeddedShaders[i].name, std::strlen(g_embeddedShaders[i].name));
+        add(reinterpret_cast<const char*>(g_embeddedShaders[i].data), g_embeddedShaders[i].size);
+    }
+#else
+    std::vector<std::string> paths;
+    for(const auto& entry : std::filesystem::directory_iterator(directory))
+    {
+        if(entry.path().extension() == ".spv")
+        {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for(const std::string& path : paths)
+    {
+        const std::string       name = std::filesystem::path(path).filename().string();
+        const std::vector<char> code = loadShader(path.c_str());
+        add(name.data(), name.size());
+        add(code.data(), code.size());
+    }
+#endif
+
+    return hash;
+}
+
 // ----------------------------------------------------------------------------
 //
 //
@@ -315,7 +382,8 @@ void createImage(VmaAllocator      allocator,
                  VkImageUsageFlags usage,
                  VmaMemoryUsage    vmaMemoryUsage,
                  VkImage*          image,
-                 VmaAllocation*    imageMemory)
+                 VmaAllocation*    imageMemory,
+                 uint32_t          mipLevels)
 {
     VkImageCreateInfo imageInfo = {};
     imageInfo.sType             = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -326,7 +394,7 @@ void createImage(VmaAllocator      allocator,
     imageInfo.extent.width      = extent.width;
     imageInfo.extent.height     = extent.height;
     imageInfo.extent.depth      = 1;
-    imageInfo.mipLevels         = 1;
+    imageInfo.mipLevels         = mipLevels;
     imageInfo.arrayLayers       = 1;
     imageInfo.samples           = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.tiling            = tiling;
@@ -349,7 +417,8 @@ void createImage(VmaAllocator      allocator,
 VkImageView createImageView(VkDevice           device,
                             VkImage            image,
                             VkFormat           format,
-                            VkImageAspectFlags aspect)
+                            VkImageAspectFlags aspect,
+                            uint32_t           mipLevels)
 {
     VkImageViewCreateInfo createInfo = {};
     createInfo.sType                 = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -363,7 +432,7 @@ VkImageView createImageView(VkDevice           device,
     createInfo.components.a                    = VK_COMPONENT_SWIZZLE_IDENTITY;
     createInfo.subresourceRange.aspectMask     = aspect;
     createInfo.subresourceRange.baseMipLevel   = 0;
-    createInfo.subresourceRange.levelCount     = 1;
+    createInfo.subresourceRange.levelCount     = mipLevels;
     createInfo.subresourceRange.baseArrayLayer = 0;
     createInfo.subresourceRange.layerCount     = 1;
 
@@ -376,36 +445,60 @@ VkImageView createImageView(VkDevice           device,
 //
 //
 
-void createTextureImage(VkDevice       device,
-                        VmaAllocator   allocator,
-                        VkQueue        queue,
-                        VkCommandPool  pool,
-                        uint8_t*       pixels,
+void createTextureImage(VmaAllocator   allocator,
+                        StagingArena*  staging,
+                        const uint8_t* pixels,
                         int            width,
                         int            height,
                         VkImage*       textureImage,
-                        VmaAllocation* textureMemory)
+                        VmaAllocation* textureMemory,
+                        VkFormat       format,
+                        uint32_t       bytesPerPixel)
 {
-    VkDeviceSize imageSizeInBytes = width * height * 4;
-    VkExtent2D   imageSize{width, height};
-
-    VkBuffer      stagingBuffer;
-    VmaAllocation stagingBufferMemory;
-
-    // Vertices
-    VkTools::createBuffer(
-        allocator, imageSizeInBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &stagingBuffer,
-        &stagingBufferMemory);
-
-    void* data;
-    vmaMapMemory(allocator, stagingBufferMemory, &data);
-    memcpy(data, pixels, imageSizeInBytes);
-    vmaUnmapMemory(allocator, stagingBufferMemory);
-    createImage(allocator, imageSize, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL,
+    VkExtent2D imageSize{uint32_t(width), uint32_t(height)};
+    createImage(allocator, imageSize, format, VK_IMAGE_TILING_OPTIMAL,
                 VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
                 VMA_MEMORY_USAGE_GPU_ONLY, textureImage, textureMemory);
 
+    staging->uploadImage(*textureImage, pixels, width, height, bytesPerPixel);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void recordTextureImageCopy(VkCommandBuffer commandBuffer,
+                            VkBuffer        stagingBuffer,
+                            VkDeviceSize    bufferOffset,
+                            VkImage         textureImage,
+                            int             width,
+                            int             height,
+                            uint32_t        srcQueueFamily,
+                            uint32_t        dstQueueFamily)
+{
+    VkBufferImageCopy region  = {};
+    region.bufferOffset       = bufferOffset;
+    region.bufferRowLength    = 0;
+    region.bufferImageHeight  = 0;
+    region.imageSubresource   = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageOffset        = {0, 0, 0};
+    region.imageExtent.width  = width;
+    region.imageExtent.height = height;
+    region.imageExtent.depth  = 1;
+
+    recordTextureMipCopy(commandBuffer, stagingBuffer, textureImage, {region}, srcQueueFamily,
+                         dstQueueFamily);
+}
+
+void recordTextureMipCopy(VkCommandBuffer                       commandBuffer,
+                          VkBuffer                              stagingBuffer,
+                          VkImage                               textureImage,
+                          const std::vector<VkBufferImageCopy>& regions,
+                          uint32_t                              srcQueueFamily,
+                          uint32_t                              dstQueueFamily)
+{
+    const uint32_t mipLevels = static_cast<uint32_t>(regions.size());
+
     VkImageMemoryBarrier barrier = {};
     barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     barrier.srcAccessMask        = 0;
@@ -414,26 +507,14 @@ void createTextureImage(VkDevice       device,
     barrier.newLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
     barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
     barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image                = *textureImage;
-    barrier.subresourceRange     = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-
-    VkCommandBuffer commandBuffer = beginRecordingCommandBuffer(device, pool);
+    barrier.image                = textureImage;
+    barrier.subresourceRange     = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
 
     vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
                          VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 
-    VkBufferImageCopy region  = {};
-    region.bufferOffset       = 0;
-    region.bufferRowLength    = 0;
-    region.bufferImageHeight  = 0;
-    region.imageSubresource   = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
-    region.imageOffset        = {0, 0, 0};
-    region.imageExtent.width  = width;
-    region.imageExtent.height = height;
-    region.imageExtent.depth  = 1;
-
-    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, *textureImage,
-                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, textureImage,
+                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, regions.data());
 
 
     barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
@@ -441,12 +522,85 @@ void createTextureImage(VkDevice       device,
     barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
     barrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 
-    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1,
+    VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    if(srcQueueFamily != dstQueueFamily)
+    {
+        // Release, a transfer queue has no shader stages to make the write visible to
+        barrier.dstAccessMask       = 0;
+        barrier.srcQueueFamilyIndex = srcQueueFamily;
+        barrier.dstQueueFamilyIndex = dstQueueFamily;
+        dstStage                    = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr,
+                         0, nullptr, 1, &barrier);
+}
+
+void recordTextureImageAcquire(VkCommandBuffer commandBuffer,
+                               VkImage         textureImage,
+                               uint32_t        srcQueueFamily,
+                               uint32_t        dstQueueFamily,
+                               uint32_t        mipLevels)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask        = 0;
+    barrier.dstAccessMask        = VK_ACCESS_SHADER_READ_BIT;
+    barrier.oldLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout            = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex  = srcQueueFamily;
+    barrier.dstQueueFamilyIndex  = dstQueueFamily;
+    barrier.image                = textureImage;
+    barrier.subresourceRange     = {VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1};
+
+    // Textures are read by the fragment and ray tracing stages
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1,
                          &barrier);
+}
 
-    flushCommandBuffer(device, queue, pool, commandBuffer);
-    vmaDestroyBuffer(allocator, stagingBuffer, stagingBufferMemory);
+// ----------------------------------------------------------------------------
+//
+//
+
+void recordBufferRelease(VkCommandBuffer commandBuffer,
+                         VkBuffer        buffer,
+                         uint32_t        srcQueueFamily,
+                         uint32_t        dstQueueFamily)
+{
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask         = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask         = 0;
+    barrier.srcQueueFamilyIndex   = srcQueueFamily;
+    barrier.dstQueueFamilyIndex   = dstQueueFamily;
+    barrier.buffer                = buffer;
+    barrier.offset                = 0;
+    barrier.size                  = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0,
+                         nullptr);
+}
+
+void recordBufferAcquire(VkCommandBuffer commandBuffer,
+                         VkBuffer        buffer,
+                         uint32_t        srcQueueFamily,
+                         uint32_t        dstQueueFamily)
+{
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask         = 0;
+    barrier.dstAccessMask         = VK_ACCESS_MEMORY_READ_BIT;
+    barrier.srcQueueFamilyIndex   = srcQueueFamily;
+    barrier.dstQueueFamilyIndex   = dstQueueFamily;
+    barrier.buffer                = buffer;
+    barrier.offset                = 0;
+    barrier.size                  = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0,
+                         nullptr);
 }
 
 // ----------------------------------------------------------------------------
@@ -471,8 +625,8 @@ void createTextureSampler(VkDevice device, VkSampler* sampler)
     createInfo.maxAnisotropy       = 16.0f;
     createInfo.compareEnable       = VK_FALSE;
     createInfo.compareOp           = VK_COMPARE_OP_ALWAYS;
-    createInfo.minLod;
-    createInfo.maxLod;
+    createInfo.minLod              = 0.0f;
+    createInfo.maxLod              = VK_LOD_CLAMP_NONE;  // Every level of the view
     createInfo.borderColor;
     createInfo.unnormalizedCoordinates = VK_FALSE;
 
@@ -483,6 +637,127 @@ void createTextureSampler(VkDevice device, VkSampler* sampler)
 //
 //
 
+void createStorageImage(VkDevice          device,
+                        VmaAllocator      allocator,
+                        VkQueue           queue,
+                        VkCommandPool     pool,
+                        VkExtent2D        extent,
+                        VkFormat          format,
+                        VkImageUsageFlags usage,
+                        StorageImage*     storageImage)
+{
+    storageImage->format = format;
+
+    createImage(allocator, extent, format, VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_STORAGE_BIT | usage, VMA_MEMORY_USAGE_GPU_ONLY,
+                &storageImage->image, &storageImage->memory);
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask        = 0;
+    barrier.dstAccessMask        = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.oldLayout            = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout            = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                = storageImage->image;
+    barrier.subresourceRange     = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    VkCommandBuffer commandBuffer = beginRecordingCommandBuffer(device, pool);
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1,
+                         &barrier);
+
+    // History buffers are read before they are ever written, start from zero
+    VkClearColorValue       clearColor = {};
+    VkImageSubresourceRange range      = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    if(usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+    {
+        vkCmdClearColorImage(commandBuffer, storageImage->image, VK_IMAGE_LAYOUT_GENERAL,
+                             &clearColor, 1, &range);
+    }
+
+    flushCommandBuffer(device, queue, pool, commandBuffer);
+
+    storageImage->view =
+        createImageView(device, storageImage->image, format, VK_IMAGE_ASPECT_COLOR_BIT);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void destroyStorageImage(VkDevice device, VmaAllocator allocator, StorageImage* storageImage)
+{
+    if(storageImage->view != VK_NULL_HANDLE)
+    {
+        vkDestroyImageView(device, storageImage->view, nullptr);
+        storageImage->view = VK_NULL_HANDLE;
+    }
+    if(storageImage->image != VK_NULL_HANDLE)
+    {
+        vmaDestroyImage(allocator, storageImage->image, storageImage->memory);
+        storageImage->image  = VK_NULL_HANDLE;
+        storageImage->memory = VK_NULL_HANDLE;
+    }
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
+void createComputePipeline(VkDevice              device,
+                           const std::string&    shaderPath,
+                           VkDescriptorSetLayout descriptorSetLayout,
+                           uint32_t              pushConstantSize,
+                           VkPipeline*           pipeline,
+                           VkPipelineLayout*     pipelineLayout,
+                           VkPipelineCache       pipelineCache)
+{
+    VkShaderModule shaderModule = createShaderModule(shaderPath, device);
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo = {};
+    shaderStageInfo.sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageInfo.stage  = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStageInfo.module = shaderModule;
+    shaderStageInfo.pName  = "main";
+
+    VkPushConstantRange pushConstantRange = {};
+    pushConstantRange.stageFlags          = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset              = 0;
+    pushConstantRange.size                = pushConstantSize;
+
+    VkPipelineLayoutCreateInfo layoutInfo = {};
+    layoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    layoutInfo.pNext                      = nullptr;
+    layoutInfo.flags                      = 0;
+    layoutInfo.setLayoutCount             = 1;
+    layoutInfo.pSetLayouts                = &descriptorSetLayout;
+    layoutInfo.pushConstantRangeCount     = pushConstantSize > 0 ? 1 : 0;
+    layoutInfo.pPushConstantRanges        = pushConstantSize > 0 ? &pushConstantRange : nullptr;
+
+    VK_CHECK_RESULT(vkCreatePipelineLayout(device, &layoutInfo, nullptr, pipelineLayout));
+
+    VkComputePipelineCreateInfo pipelineInfo = {};
+    pipelineInfo.sType                       = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.pNext                       = nullptr;
+    pipelineInfo.flags                       = 0;
+    pipelineInfo.stage                       = shaderStageInfo;
+    pipelineInfo.layout                      = *pipelineLayout;
+    pipelineInfo.basePipelineHandle          = VK_NULL_HANDLE;
+    pipelineInfo.basePipelineIndex           = 0;
+
+    VK_CHECK_RESULT(
+        vkCreateComputePipelines(device, pipelineCache, 1, &pipelineInfo, nullptr, pipeline));
+
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+}
+
+// ----------------------------------------------------------------------------
+//
+//
+
 std::string replaceSubString(const std::string& str, const std::string& from, const std::string& to)
 {
     return std::regex_replace(str, std::regex(from), to);
@@ -19,10 +19,12 @@
 
 namespace VkTools {
 
+class StagingArena;
 
 const char*       deviceType(VkPhysicalDeviceType type);
 const char*       errorString(VkResult res);
 std::vector<char> loadShader(const char* path);
+uint64_t          hashShaders(const std::string& directory);
 VkShaderModule    createShaderModule(const std::string& path, VkDevice deviceCtx);
 VkCommandBuffer   beginRecordingCommandBuffer(VkDevice device, VkCommandPool pool);
 void              flushCommandBuffer(VkDevice        device,
@@ -57,26 +59,96 @@ void createImage(VmaAllocator      allocator,
                  VkImageUsageFlags usage,
                  VmaMemoryUsage    vmaMemoryUsage,
                  VkImage*          image,
-                 VmaAllocation*    imageMemory);
+                 VmaAllocation*    imageMemory,
+                 uint32_t          mipLevels = 1);
 
 VkImageView createImageView(VkDevice           device,
                             VkImage            image,
                             VkFormat           format,
-                            VkImageAspectFlags aspect);
+                            VkImageAspectFlags aspect,
+                            uint32_t           mipLevels = 1);
 
 
-void createTextureImage(VkDevice       device,
-                        VmaAllocator   allocator,
-                        VkQueue        queue,
-                        VkCommandPool  pool,
-                        uint8_t*       pixels,
+// The copy is recorded into the open batch of staging, submit it before using the image on
+// another command buffer
+void createTextureImage(VmaAllocator   allocator,
+                        StagingArena*  staging,
+                        const uint8_t* pixels,
                         int            width,
                         int            height,
                         VkImage*       textureImage,
-                        VmaAllocation* textureMemory);
+                        VmaAllocation* textureMemory,
+                        VkFormat       format        = VK_FORMAT_R8G8B8A8_UNORM,
+                        uint32_t       bytesPerPixel = 4);
+
+// Layout transitions around a copy from stagingBuffer at bufferOffset into mip 0, ends in
+// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL. When the queue families differ the last transition
+// also releases the image to dstQueueFamily, which has to record recordTextureImageAcquire with
+// the same families before sampling it.
+void recordTextureImageCopy(VkCommandBuffer commandBuffer,
+                            VkBuffer        stagingBuffer,
+                            VkDeviceSize    bufferOffset,
+                            VkImage         textureImage,
+                            int             width,
+                            int             height,
+                            uint32_t        srcQueueFamily = VK_QUEUE_FAMILY_IGNORED,
+                            uint32_t        dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+// Same for every mip level of the image, regions[i] fills level i
+void recordTextureMipCopy(VkCommandBuffer                       commandBuffer,
+                          VkBuffer                              stagingBuffer,
+                          VkImage                               textureImage,
+                          const std::vector<VkBufferImageCopy>& regions,
+                          uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED,
+                          uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED);
+
+void recordTextureImageAcquire(VkCommandBuffer commandBuffer,
+                               VkImage         textureImage,
+                               uint32_t        srcQueueFamily,
+                               uint32_t        dstQueueFamily,
+                               uint32_t        mipLevels = 1);
+
+// Queue family ownership transfer of a whole buffer. The release goes after the writes on the
+// queue of srcQueueFamily, the acquire with the same families before the reads on the queue of
+// dstQueueFamily, which can be anything from vertex input to an acceleration structure build.
+void recordBufferRelease(VkCommandBuffer commandBuffer,
+                         VkBuffer        buffer,
+                         uint32_t        srcQueueFamily,
+                         uint32_t        dstQueueFamily);
+void recordBufferAcquire(VkCommandBuffer commandBuffer,
+                         VkBuffer        buffer,
+                         uint32_t        srcQueueFamily,
+                         uint32_t        dstQueueFamily);
 
 void createTextureSampler(VkDevice device, VkSampler* sampler);
 
+// Single-mip storage image that lives in VK_IMAGE_LAYOUT_GENERAL
+struct StorageImage
+{
+    VkImage       image  = VK_NULL_HANDLE;
+    VkImageView   view   = VK_NULL_HANDLE;
+    VmaAllocation memory = VK_NULL_HANDLE;
+    VkFormat      format = VK_FORMAT_UNDEFINED;
+};
+
+void createStorageImage(VkDevice          device,
+                        VmaAllocator      allocator,
+                        VkQueue           queue,
+                        VkCommandPool     pool,
+                        VkExtent2D        extent,
+                        VkFormat          format,
+                        VkImageUsageFlags usage,
+                        StorageImage*     storageImage);
+void destroyStorageImage(VkDevice device, VmaAllocator allocator, StorageImage* storageImage);
+
+void createComputePipeline(VkDevice              device,
+                           const std::string&    shaderPath,
+                           VkDescriptorSetLayout descriptorSetLayout,
+                           uint32_t              pushConstantSize,
+                           VkPipeline*           pipeline,
+                           VkPipelineLayout*     pipelineLayout,
+                           VkPipelineCache       pipelineCache = VK_NULL_HANDLE);
+
 std::string replaceSubString(const std::string& str, const std::string& from, const std::string& to);
 
 
@@ -21,6 +21,10 @@ void vkWindow::initGLFW()
     const auto* mode    = glfwGetVideoMode(monitor);
     m_WindowSize.height = mode->height * 9.0f / 10.0f;
     m_WindowSize.width  = m_WindowSize.height;
+    if(m_requestedSize.width > 0 && m_requestedSize.height > 0)
+    {
+        m_WindowSize = m_requestedSize;
+    }
 
     m_GLFWwindow =
         glfwCreateWindow(static_cast<int>(m_WindowSize.width),
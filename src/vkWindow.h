@@ -33,6 +33,9 @@ class vkWindow
 
     void initGLFW();
 
+    // Window size for the next initGLFW, by default the window is square at 90% of the monitor
+    void setRequestedSize(VkExtent2D size) { m_requestedSize = size; }
+
     inline bool isOpen() const { return !glfwWindowShouldClose(m_GLFWwindow); }
     inline void pollEvents() { glfwPollEvents(); }
     GLFWwindow* getWindow() const { return m_GLFWwindow; }
@@ -45,7 +48,8 @@ class vkWindow
     private:
     GLFWwindow* m_GLFWwindow = nullptr;
     vkContext*  m_vkctx      = nullptr;
-    VkExtent2D  m_WindowSize = {1280, 1280};
+    VkExtent2D  m_WindowSize    = {1280, 1280};
+    VkExtent2D  m_requestedSize = {0, 0};
 
     void moveLightToCamera();
 